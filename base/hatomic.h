@@ -127,4 +127,38 @@ typedef atomic_long                 hatomic_t;
 #define hatomic_inc                 ATOMIC_INC
 #define hatomic_dec                 ATOMIC_DEC
 
+/*
+ * memory order of plain integers shared between threads, for both c and c++:
+ * hatomic_load_acquire/hatomic_store_release/hatomic_load_seq/hatomic_store_seq
+ * hatomic_inc64/hatomic_load64 (relaxed)
+ * NOTE: only unsigned int and unsigned long long on windows.
+ */
+#include "hplatform.h"
+#if defined(__ATOMIC_ACQUIRE)
+
+#define hatomic_load_acquire(p)     __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define hatomic_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define hatomic_load_seq(p)         __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define hatomic_store_seq(p, v)     __atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+#define hatomic_inc64(p)            __atomic_add_fetch(p, 1, __ATOMIC_RELAXED)
+#define hatomic_load64(p)           __atomic_load_n(p, __ATOMIC_RELAXED)
+
+#elif defined(_WIN32)
+
+static inline unsigned int hatomic_load_acquire(volatile unsigned int* p) {
+    unsigned int v = *p;
+    MemoryBarrier();
+    return v;
+}
+static inline void hatomic_store_release(volatile unsigned int* p, unsigned int v) {
+    MemoryBarrier();
+    *p = v;
+}
+#define hatomic_load_seq(p)         ((unsigned int)InterlockedCompareExchange((volatile LONG*)(p), 0, 0))
+#define hatomic_store_seq(p, v)     InterlockedExchange((volatile LONG*)(p), (LONG)(v))
+#define hatomic_inc64(p)            InterlockedIncrement64((volatile LONG64*)(p))
+#define hatomic_load64(p)           ((unsigned long long)InterlockedCompareExchange64((volatile LONG64*)(p), 0, 0))
+
+#endif
+
 #endif // HV_ATOMIC_H_
@@ -360,6 +360,31 @@ char* get_run_dir(char* buf, int size) {
     return getcwd(buf, size);
 }
 
+char* get_temp_dir(char* buf, int size) {
+    if (buf == NULL || size <= 0) return NULL;
+#ifdef OS_WIN
+    int len = (int)GetTempPath(size, buf);
+    if (len <= 0 || len >= size) {
+        return NULL;
+    }
+#else
+    const char* dir = getenv("TMPDIR");
+    if (dir == NULL || *dir == '\0') {
+        dir = "/tmp";
+    }
+    int len = strlen(dir);
+    if (len >= size) {
+        return NULL;
+    }
+    memcpy(buf, dir, len + 1);
+#endif
+    // remove trailing slash, but keep root dir like / or C:\.
+    while (len > 1 && (buf[len-1] == '/' || buf[len-1] == '\\') && buf[len-2] != ':') {
+        buf[--len] = '\0';
+    }
+    return buf;
+}
+
 int hv_rand(int min, int max) {
     static int s_seed = 0;
     assert(max > min);
@@ -105,6 +105,8 @@ HV_EXPORT char* get_executable_path(char* buf, int size);
 HV_EXPORT char* get_executable_dir(char* buf, int size);
 HV_EXPORT char* get_executable_file(char* buf, int size);
 HV_EXPORT char* get_run_dir(char* buf, int size);
+// GetTempPath on windows, $TMPDIR or /tmp on unix, without trailing slash
+HV_EXPORT char* get_temp_dir(char* buf, int size);
 
 // random
 HV_EXPORT int   hv_rand(int min, int max);
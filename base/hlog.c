@@ -1,53 +1,22 @@
+#include "hplatform.h" // before any system header for _GNU_SOURCE
 #include "hlog.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <time.h>
 
-//#include "hmutex.h"
 #ifdef _WIN32
 #pragma warning (disable: 4244) // conversion loss of data
-#include <windows.h>
-#define hmutex_t            CRITICAL_SECTION
-#define hmutex_init         InitializeCriticalSection
-#define hmutex_destroy      DeleteCriticalSection
-#define hmutex_lock         EnterCriticalSection
-#define hmutex_unlock       LeaveCriticalSection
-#else
-#include <sys/time.h>       // for gettimeofday
-#include <pthread.h>
-#define hmutex_t            pthread_mutex_t
-#define hmutex_init(mutex)  pthread_mutex_init(mutex, NULL)
-#define hmutex_destroy      pthread_mutex_destroy
-#define hmutex_lock         pthread_mutex_lock
-#define hmutex_unlock       pthread_mutex_unlock
 #endif
 
-//#include "htime.h"
-#define SECONDS_PER_HOUR    3600
-#define SECONDS_PER_DAY     86400   // 24*3600
-#define SECONDS_PER_WEEK    604800  // 7*24*3600
-
-static inline struct tm* hv_localtime_r(time_t ts, struct tm* tm) {
-#ifdef _WIN32
-    localtime_s(tm, &ts);
-#else
-    tm = localtime_r(&ts, tm);
-#endif
-    return tm;
-}
-
-static inline struct tm* hv_gmtime_r(time_t ts, struct tm* tm) {
-#ifdef _WIN32
-    gmtime_s(tm, &ts);
-#else
-    tm = gmtime_r(&ts, tm);
-#endif
-    return tm;
-}
+#include "hmutex.h"
+#include "hthread.h"
+#include "hatomic.h"
+#include "htime.h"
 
 static int s_gmtoff = 28800; // 8*3600
 static void init_gmtoff() {
@@ -68,6 +37,34 @@ static void init_gmtoff() {
     }
 }
 
+/*
+ * log_ring_t: single-producer single-consumer ring buffer,
+ * written by the owner thread, read by the flusher.
+ * record = log_record_t + message, 8-byte aligned,
+ * a record never wraps, LOG_RECORD_SKIP pads the tail instead.
+ */
+typedef struct log_record_s {
+    unsigned int    len;
+    int             level;
+} log_record_t;
+
+#define LOG_RECORD_SKIP     0xFFFFFFFF
+#define LOG_RECORD_SIZE(len) ((sizeof(log_record_t) + (len) + 7) & ~7U)
+
+typedef struct log_ring_s {
+    struct log_ring_s*      next;
+    char*                   data;
+    unsigned int            size;   // power of 2
+    volatile unsigned int   wpos;   // written by owner
+    volatile unsigned int   rpos;   // written by flusher
+    volatile unsigned int   exited; // owner thread exited
+    volatile unsigned int   writing; // owner writing a record, see logger_enable_async
+    unsigned int            next_rpos; // rpos after the pending batch, owned by flusher
+    // format buffer of owner
+    char*                   buf;
+    unsigned int            bufsize;
+} log_ring_t;
+
 struct logger_s {
     logger_handler  handler;
     unsigned int    bufsize;
@@ -89,6 +86,22 @@ struct logger_s {
     int                 can_write_cnt;
 
     hmutex_t            mutex_; // thread-safe
+
+    // for async logger
+    volatile unsigned int async;    // atomic, read by writers without lock
+    int                 async_policy;
+    unsigned int        async_bufsize;
+    volatile int        async_quit;
+    int                 async_waiters;
+    unsigned long long  async_dropped;
+    int                 async_inited;
+    htls_key_t          async_key;
+    log_ring_t*         async_rings;
+    hthread_t           async_thread_;
+    hmutex_t            async_mutex_;   // for async_rings, async_cond_, space_cond_
+    hmutex_t            flush_mutex_;   // only one flusher
+    hcondvar_t          async_cond_;    // wakeup flusher
+    hcondvar_t          space_cond_;    // wakeup blocked writers
 };
 
 static void logger_init(logger_t* logger) {
@@ -111,6 +124,15 @@ static void logger_init(logger_t* logger) {
     logger->last_logfile_ts = 0;
     logger->can_write_cnt = -1;
     hmutex_init(&logger->mutex_);
+
+    logger->async = 0;
+    logger->async_policy = LOG_ASYNC_DROP;
+    logger->async_bufsize = DEFAULT_LOG_ASYNC_BUFSIZE;
+    logger->async_quit = 0;
+    logger->async_waiters = 0;
+    logger->async_dropped = 0;
+    logger->async_inited = 0;
+    logger->async_rings = NULL;
 }
 
 logger_t* logger_create() {
@@ -121,8 +143,11 @@ logger_t* logger_create() {
     return logger;
 }
 
+static void logger_async_cleanup(logger_t* logger);
+
 void logger_destroy(logger_t* logger) {
     if (logger) {
+        logger_async_cleanup(logger);
         if (logger->buf) {
             free(logger->buf);
             logger->buf = NULL;
@@ -230,7 +255,12 @@ void logger_enable_fsync(logger_t* logger, int on) {
     logger->enable_fsync = on;
 }
 
+static int logger_async_flush(logger_t* logger);
+
 void logger_fsync(logger_t* logger) {
+    if (logger->async_inited) {
+        logger_async_flush(logger);
+    }
     hmutex_lock(&logger->mutex_);
     if (logger->fp_) {
         fflush(logger->fp_);
@@ -357,7 +387,7 @@ static FILE* logfile_shift(logger_t* logger) {
     if (logger->fp_ && --logger->can_write_cnt < 0) {
         fseek(logger->fp_, 0, SEEK_END);
         long filesize = ftell(logger->fp_);
-        if (filesize > logger->max_filesize) {
+        if ((unsigned long long)filesize > logger->max_filesize) {
             logfile_truncate(logger);
         } else {
             logger->can_write_cnt = (logger->max_filesize - filesize) / logger->bufsize;
@@ -377,6 +407,39 @@ static void logfile_write(logger_t* logger, const char* buf, int len) {
     }
 }
 
+static void logfile_writev(logger_t* logger, struct iovec* iov, int iovcnt, size_t bytes) {
+    FILE* fp = logfile_shift(logger);
+    if (fp == NULL) return;
+    // NOTE: logfile_shift estimates one write as bufsize
+    logger->can_write_cnt -= bytes / logger->bufsize;
+#ifdef _WIN32
+    for (int i = 0; i < iovcnt; ++i) {
+        fwrite(iov[i].iov_base, 1, iov[i].iov_len, fp);
+    }
+    fflush(fp);
+#else
+    // flush what written by fwrite first to keep order
+    fflush(fp);
+    int fd = fileno(fp);
+    while (iovcnt > 0) {
+        ssize_t nwrite = writev(fd, iov, iovcnt);
+        if (nwrite < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        while (iovcnt > 0 && (size_t)nwrite >= iov->iov_len) {
+            nwrite -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + nwrite;
+            iov->iov_len -= nwrite;
+        }
+    }
+#endif
+}
+
 static int i2a(int i, char* buf, int len) {
     for (int l = len - 1; l >= 0; --l) {
         if (i == 0) {
@@ -389,10 +452,7 @@ static int i2a(int i, char* buf, int len) {
     return len;
 }
 
-int logger_print(logger_t* logger, int level, const char* fmt, ...) {
-    if (level < logger->level)
-        return -10;
-
+static int logger_format(logger_t* logger, int level, char* buf, int bufsize, const char* fmt, va_list ap) {
     int year,month,day,hour,min,sec,us;
 #ifdef _WIN32
     SYSTEMTIME tm;
@@ -405,18 +465,24 @@ int logger_print(logger_t* logger, int level, const char* fmt, ...) {
     sec      = tm.wSecond;
     us       = tm.wMilliseconds * 1000;
 #else
+    // NOTE: localtime_r is slow for tzset lock, cache it per second.
+    static __thread time_t s_last_ts = -1;
+    static __thread struct tm s_last_tm;
     struct timeval tv;
     gettimeofday(&tv, NULL);
     time_t ts = tv.tv_sec;
-    struct tm tm;
-    memset(&tm, 0, sizeof(tm));
-    localtime_r(&ts, &tm);
-    year     = tm.tm_year + 1900;
-    month    = tm.tm_mon  + 1;
-    day      = tm.tm_mday;
-    hour     = tm.tm_hour;
-    min      = tm.tm_min;
-    sec      = tm.tm_sec;
+    if (ts != s_last_ts) {
+        memset(&s_last_tm, 0, sizeof(s_last_tm));
+        localtime_r(&ts, &s_last_tm);
+        s_last_ts = ts;
+    }
+    const struct tm* ptm = &s_last_tm;
+    year     = ptm->tm_year + 1900;
+    month    = ptm->tm_mon  + 1;
+    day      = ptm->tm_mday;
+    hour     = ptm->tm_hour;
+    min      = ptm->tm_min;
+    sec      = ptm->tm_sec;
     us       = tv.tv_usec;
 #endif
 
@@ -430,11 +496,6 @@ int logger_print(logger_t* logger, int level, const char* fmt, ...) {
     }
 #undef XXX
 
-    // lock logger->buf
-    hmutex_lock(&logger->mutex_);
-
-    char* buf = logger->buf;
-    int bufsize = logger->bufsize;
     int len = 0;
 
     if (logger->enable_color) {
@@ -480,10 +541,10 @@ int logger_print(logger_t* logger, int level, const char* fmt, ...) {
                     break;
                 case 's':
                 {
-                    va_list ap;
-                    va_start(ap, fmt);
-                    len += vsnprintf(buf + len, bufsize - len, fmt, ap);
-                    va_end(ap);
+                    va_list aq;
+                    va_copy(aq, ap);
+                    len += vsnprintf(buf + len, bufsize - len, fmt, aq);
+                    va_end(aq);
                 }
                     break;
                 case '%':
@@ -502,10 +563,10 @@ int logger_print(logger_t* logger, int level, const char* fmt, ...) {
             year, month, day, hour, min, sec, us/1000,
             plevel);
 
-        va_list ap;
-        va_start(ap, fmt);
-        len += vsnprintf(buf + len, bufsize - len, fmt, ap);
-        va_end(ap);
+        va_list aq;
+        va_copy(aq, ap);
+        len += vsnprintf(buf + len, bufsize - len, fmt, aq);
+        va_end(aq);
     }
 
     if (logger->enable_color && len < bufsize) {
@@ -518,16 +579,309 @@ int logger_print(logger_t* logger, int level, const char* fmt, ...) {
         buf[bufsize - 1] = '\n';
         len = bufsize;
     }
+    return len;
+}
+
+static log_ring_t* logger_async_ring(logger_t* logger);
+static int log_ring_write(logger_t* logger, log_ring_t* ring, int level, const char* msg, unsigned int len);
+
+int logger_print(logger_t* logger, int level, const char* fmt, ...) {
+    if (level < logger->level)
+        return -10;
+
+    int len = 0;
+    va_list ap;
+    va_start(ap, fmt);
+    log_ring_t* ring = hatomic_load_seq(&logger->async) ? logger_async_ring(logger) : NULL;
+    if (ring) {
+        // async may be turned off in between, then wait for this record to be flushed
+        hatomic_store_seq(&ring->writing, 1);
+        if (!hatomic_load_seq(&logger->async)) {
+            hatomic_store_release(&ring->writing, 0);
+            ring = NULL;
+        }
+    }
+    if (ring) {
+        len = logger_format(logger, level, ring->buf, ring->bufsize, fmt, ap);
+        len = log_ring_write(logger, ring, level, ring->buf, len);
+        hatomic_store_release(&ring->writing, 0);
+    } else {
+        // lock logger->buf
+        hmutex_lock(&logger->mutex_);
+        len = logger_format(logger, level, logger->buf, logger->bufsize, fmt, ap);
+        if (logger->handler) {
+            logger->handler(level, logger->buf, len);
+        }
+        else {
+            logfile_write(logger, logger->buf, len);
+        }
+        hmutex_unlock(&logger->mutex_);
+    }
+    va_end(ap);
+    return len;
+}
+
+// async logger
+static HTLS_DESTRUCTOR(log_ring_exit) {
+    log_ring_t* ring = (log_ring_t*)ptr;
+    if (ring) {
+        hatomic_store_release(&ring->exited, 1);
+    }
+}
+
+static void log_ring_free(log_ring_t* ring) {
+    if (ring->data) free(ring->data);
+    if (ring->buf) free(ring->buf);
+    free(ring);
+}
+
+static log_ring_t* logger_async_ring(logger_t* logger) {
+    log_ring_t* ring = (log_ring_t*)htls_get(logger->async_key);
+    if (ring == NULL) {
+        unsigned int min_size = LOG_RECORD_SIZE(logger->bufsize) * 2;
+        if (min_size < logger->async_bufsize) min_size = logger->async_bufsize;
+        unsigned int size = 4096;
+        while (size < min_size) size <<= 1;
+        ring = (log_ring_t*)calloc(1, sizeof(log_ring_t));
+        if (ring == NULL) return NULL;
+        ring->data = (char*)malloc(size);
+        if (ring->data == NULL) {
+            free(ring);
+            return NULL;
+        }
+        ring->size = size;
+        htls_set(logger->async_key, ring);
+        hmutex_lock(&logger->async_mutex_);
+        ring->next = logger->async_rings;
+        logger->async_rings = ring;
+        hmutex_unlock(&logger->async_mutex_);
+    }
+    // a record must fit in half of ring
+    unsigned int bufsize = logger->bufsize;
+    if (LOG_RECORD_SIZE(bufsize) > ring->size / 2) {
+        bufsize = ring->size / 2 - sizeof(log_record_t);
+    }
+    if (ring->bufsize != bufsize) {
+        char* buf = (char*)realloc(ring->buf, bufsize);
+        if (buf == NULL) return NULL;
+        ring->buf = buf;
+        ring->bufsize = bufsize;
+    }
+    return ring;
+}
+
+static int log_ring_write(logger_t* logger, log_ring_t* ring, int level, const char* msg, unsigned int len) {
+    unsigned int size = ring->size;
+    unsigned int mask = size - 1;
+    unsigned int need = LOG_RECORD_SIZE(len);
+    unsigned int wpos = ring->wpos;
+    while (1) {
+        unsigned int used = wpos - hatomic_load_acquire(&ring->rpos);
+        unsigned int tail = size - (wpos & mask);
+        unsigned int total = tail < need ? tail + need : need;
+        if (used + total <= size) {
+            if (tail < need) {
+                ((log_record_t*)(ring->data + (wpos & mask)))->len = LOG_RECORD_SKIP;
+                wpos += tail;
+            }
+            log_record_t* record = (log_record_t*)(ring->data + (wpos & mask));
+            record->len = len;
+            record->level = level;
+            memcpy(record + 1, msg, len);
+            hatomic_store_release(&ring->wpos, wpos + need);
+            // wakeup flusher when half full, else it flushes per interval
+            if (used < size / 2 && used + total >= size / 2) {
+                hcondvar_signal(&logger->async_cond_);
+            }
+            return len;
+        }
+        if (logger->async_policy != LOG_ASYNC_BLOCK) break;
+        // NOTE: logger_enable_async(0) flushes until no writer before async_quit
+        hmutex_lock(&logger->async_mutex_);
+        ++logger->async_waiters;
+        hcondvar_signal(&logger->async_cond_);
+        hcondvar_wait_for(&logger->space_cond_, &logger->async_mutex_, 10);
+        --logger->async_waiters;
+        hmutex_unlock(&logger->async_mutex_);
+    }
+    hatomic_inc64(&logger->async_dropped);
+    return -20;
+}
+
+#define LOG_IOV_MAX     64
+
+// Write records of rings, with flush_mutex_ and mutex_ locked.
+// @return number of flushed records
+static int logger_async_write_locked(logger_t* logger, log_ring_t* rings) {
+    int nrecords = 0;
+    struct iovec iov[LOG_IOV_MAX];
+    int iovcnt = 0;
+    size_t bytes = 0;
+    for (log_ring_t* ring = rings; ring; ring = ring->next) {
+        unsigned int mask = ring->size - 1;
+        unsigned int rpos = ring->rpos;
+        unsigned int wpos = hatomic_load_acquire(&ring->wpos);
+        while (rpos != wpos) {
+            log_record_t* record = (log_record_t*)(ring->data + (rpos & mask));
+            if (record->len == LOG_RECORD_SKIP) {
+                rpos += ring->size - (rpos & mask);
+                continue;
+            }
+            char* msg = (char*)(record + 1);
+            if (logger->handler) {
+                logger->handler(record->level, msg, record->len);
+            } else {
+                iov[iovcnt].iov_base = msg;
+                iov[iovcnt].iov_len = record->len;
+                bytes += record->len;
+                if (++iovcnt == LOG_IOV_MAX) {
+                    logfile_writev(logger, iov, iovcnt, bytes);
+                    iovcnt = 0;
+                    bytes = 0;
+                }
+            }
+            rpos += LOG_RECORD_SIZE(record->len);
+            ++nrecords;
+        }
+        ring->next_rpos = rpos;
+    }
+    // records of all rings are batched into writev
+    if (iovcnt) {
+        logfile_writev(logger, iov, iovcnt, bytes);
+    }
+    return nrecords;
+}
 
-    if (logger->handler) {
-        logger->handler(level, buf, len);
+// Release space of written records, with flush_mutex_ locked.
+static void logger_async_release(logger_t* logger, log_ring_t* rings) {
+    for (log_ring_t* ring = rings; ring; ring = ring->next) {
+        hatomic_store_release(&ring->rpos, ring->next_rpos);
     }
-    else {
-        logfile_write(logger, buf, len);
+
+    hmutex_lock(&logger->async_mutex_);
+    // free rings of exited threads
+    log_ring_t** pring = &logger->async_rings;
+    while (*pring) {
+        log_ring_t* ring = *pring;
+        if (hatomic_load_acquire(&ring->exited) && ring->rpos == hatomic_load_acquire(&ring->wpos)) {
+            *pring = ring->next;
+            log_ring_free(ring);
+        } else {
+            pring = &ring->next;
+        }
     }
+    if (logger->async_waiters) {
+        hcondvar_broadcast(&logger->space_cond_);
+    }
+    hmutex_unlock(&logger->async_mutex_);
+}
 
+// @return number of flushed records
+static int logger_async_flush(logger_t* logger) {
+    hmutex_lock(&logger->flush_mutex_);
+    hmutex_lock(&logger->async_mutex_);
+    log_ring_t* rings = logger->async_rings;
+    hmutex_unlock(&logger->async_mutex_);
+    // NOTE: writers only insert rings at head, so iterate without async_mutex_.
+    hmutex_lock(&logger->mutex_);
+    int nrecords = logger_async_write_locked(logger, rings);
     hmutex_unlock(&logger->mutex_);
-    return len;
+    // release space after written
+    logger_async_release(logger, rings);
+    hmutex_unlock(&logger->flush_mutex_);
+    return nrecords;
+}
+
+static HTHREAD_ROUTINE(logger_async_routine) {
+    logger_t* logger = (logger_t*)userdata;
+    hmutex_lock(&logger->async_mutex_);
+    while (!logger->async_quit) {
+        if (logger->async_waiters == 0) {
+            hcondvar_wait_for(&logger->async_cond_, &logger->async_mutex_, DEFAULT_LOG_ASYNC_FLUSH_INTERVAL);
+        }
+        hmutex_unlock(&logger->async_mutex_);
+        logger_async_flush(logger);
+        hmutex_lock(&logger->async_mutex_);
+    }
+    hmutex_unlock(&logger->async_mutex_);
+    logger_async_flush(logger);
+    return 0;
+}
+
+void logger_enable_async(logger_t* logger, int on) {
+    if (on) {
+        if (hatomic_load_seq(&logger->async)) return;
+        if (!logger->async_inited) {
+            htls_key_create(&logger->async_key, log_ring_exit);
+            hmutex_init(&logger->async_mutex_);
+            hmutex_init(&logger->flush_mutex_);
+            hcondvar_init(&logger->async_cond_);
+            hcondvar_init(&logger->space_cond_);
+            logger->async_inited = 1;
+        }
+        logger->async_quit = 0;
+        logger->async_thread_ = hthread_create(logger_async_routine, logger);
+        hatomic_store_seq(&logger->async, 1);
+    } else {
+        if (!hatomic_load_seq(&logger->async)) return;
+        // Writers which saw async before it was cleared put records into rings
+        // after it: flush them before any sync write gets in, with mutex_ locked,
+        // else they are written later out of order.
+        hmutex_lock(&logger->flush_mutex_);
+        hmutex_lock(&logger->mutex_);
+        hatomic_store_seq(&logger->async, 0);
+        int writing;
+        do {
+            hmutex_lock(&logger->async_mutex_);
+            log_ring_t* rings = logger->async_rings;
+            hmutex_unlock(&logger->async_mutex_);
+            writing = 0;
+            for (log_ring_t* ring = rings; ring; ring = ring->next) {
+                if (hatomic_load_seq(&ring->writing)) writing = 1;
+            }
+            // also makes space for blocked writers
+            logger_async_write_locked(logger, rings);
+            logger_async_release(logger, rings);
+            if (writing) hthread_yield();
+        } while (writing);
+        hmutex_unlock(&logger->mutex_);
+        hmutex_unlock(&logger->flush_mutex_);
+
+        hmutex_lock(&logger->async_mutex_);
+        logger->async_quit = 1;
+        hcondvar_signal(&logger->async_cond_);
+        hmutex_unlock(&logger->async_mutex_);
+        hthread_join(logger->async_thread_);
+    }
+}
+
+static void logger_async_cleanup(logger_t* logger) {
+    if (!logger->async_inited) return;
+    logger_enable_async(logger, 0);
+    logger_async_flush(logger);
+    htls_key_delete(logger->async_key);
+    while (logger->async_rings) {
+        log_ring_t* ring = logger->async_rings;
+        logger->async_rings = ring->next;
+        log_ring_free(ring);
+    }
+    hcondvar_destroy(&logger->space_cond_);
+    hcondvar_destroy(&logger->async_cond_);
+    hmutex_destroy(&logger->flush_mutex_);
+    hmutex_destroy(&logger->async_mutex_);
+    logger->async_inited = 0;
+}
+
+void logger_set_async_bufsize(logger_t* logger, unsigned int bufsize) {
+    logger->async_bufsize = bufsize;
+}
+
+void logger_set_async_policy(logger_t* logger, int policy) {
+    logger->async_policy = policy;
+}
+
+unsigned long long logger_get_dropped(logger_t* logger) {
+    return hatomic_load64(&logger->async_dropped);
 }
 
 static logger_t* s_logger = NULL;
@@ -547,13 +901,16 @@ void hv_destroy_default_logger(void) {
 }
 
 void stdout_logger(int loglevel, const char* buf, int len) {
+    (void)loglevel;
     fprintf(stdout, "%.*s", len, buf);
 }
 
 void stderr_logger(int loglevel, const char* buf, int len) {
+    (void)loglevel;
     fprintf(stderr, "%.*s", len, buf);
 }
 
 void file_logger(int loglevel, const char* buf, int len) {
+    (void)loglevel;
     logfile_write(hv_default_logger(), buf, len);
 }
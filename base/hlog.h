@@ -68,6 +68,14 @@ typedef enum {
 #define DEFAULT_LOG_MAX_BUFSIZE     (1<<14)  // 16k
 #define DEFAULT_LOG_MAX_FILESIZE    (1<<24)  // 16M
 #define DEFAULT_LOG_TRUNCATE_PERCENT 0.99f   // truncate when exceeded max filesize
+#define DEFAULT_LOG_ASYNC_BUFSIZE   (1<<20)  // 1M ring buffer per thread
+#define DEFAULT_LOG_ASYNC_FLUSH_INTERVAL 100 // ms
+
+// what to do when the ring buffer of thread is full in async mode
+typedef enum {
+    LOG_ASYNC_DROP  = 0, // drop message, count in logger_get_dropped
+    LOG_ASYNC_BLOCK = 1, // wait for the flusher thread
+} log_async_policy_e;
 
 // logger: default file_logger
 // network_logger() see event/nlog.h
@@ -119,6 +127,19 @@ HV_EXPORT void logger_enable_fsync(logger_t* logger, int on);
 HV_EXPORT void logger_fsync(logger_t* logger);
 HV_EXPORT const char* logger_get_cur_file(logger_t* logger);
 
+// below for async logger
+/*
+ * logger_print formats into a lock-free ring buffer of the calling thread,
+ * a flusher thread writes all ring buffers to handler or logfile in batches.
+ * NOTE: messages of different threads are only ordered per thread.
+ * NOTE: enable async after fork, and before logging from other threads.
+ */
+HV_EXPORT void logger_enable_async(logger_t* logger, int on);
+HV_EXPORT void logger_set_async_bufsize(logger_t* logger, unsigned int bufsize);
+// policy = [LOG_ASYNC_DROP, LOG_ASYNC_BLOCK]
+HV_EXPORT void logger_set_async_policy(logger_t* logger, int policy);
+HV_EXPORT unsigned long long logger_get_dropped(logger_t* logger);
+
 // hlog: default logger instance
 HV_EXPORT logger_t* hv_default_logger();
 HV_EXPORT void      hv_destroy_default_logger(void);
@@ -140,6 +161,8 @@ HV_EXPORT void      hv_destroy_default_logger(void);
 #define hlog_disable_fsync()            logger_enable_fsync(hlog, 0)
 #define hlog_fsync()                    logger_fsync(hlog)
 #define hlog_get_cur_file()             logger_get_cur_file(hlog)
+#define hlog_enable_async()             logger_enable_async(hlog, 1)
+#define hlog_disable_async()            logger_enable_async(hlog, 0)
 
 #define hlogd(fmt, ...) logger_print(hlog, LOG_LEVEL_DEBUG, fmt " [%s:%d:%s]", ## __VA_ARGS__, __FILENAME__, __LINE__, __FUNCTION__)
 #define hlogi(fmt, ...) logger_print(hlog, LOG_LEVEL_INFO,  fmt " [%s:%d:%s]", ## __VA_ARGS__, __FILENAME__, __LINE__, __FUNCTION__)
@@ -185,6 +185,12 @@
     #define hv_delay(ms)    hv_msleep(ms)
     #define hv_mkdir(dir)   mkdir(dir)
 
+    // writev
+    struct iovec {
+        void*   iov_base;
+        size_t  iov_len;
+    };
+
     // access
     #ifndef F_OK
     #define F_OK            0       /* test for existence of file */
@@ -218,6 +224,7 @@
     #include <netinet/tcp.h>
     #include <netinet/udp.h>
     #include <netdb.h>  // for gethostbyname
+    #include <sys/uio.h>    // for writev
 
     #define hv_sleep(s)     sleep(s)
     #define hv_msleep(ms)   usleep((ms) * 1000)
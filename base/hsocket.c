@@ -195,7 +195,7 @@ int sockaddr_compare(const sockaddr_u* addr1, const sockaddr_u* addr2) {
     return memcmp(addr1, addr2, sizeof(sockaddr_u));
 }
 
-static int sockaddr_bind(sockaddr_u* localaddr, int type) {
+static int sockaddr_bind(sockaddr_u* localaddr, int type, int reuseport) {
     // socket -> setsockopt -> bind
 #ifdef SOCK_CLOEXEC
     type |= SOCK_CLOEXEC;
@@ -208,7 +208,10 @@ static int sockaddr_bind(sockaddr_u* localaddr, int type) {
 
 #ifdef OS_UNIX
     so_reuseaddr(sockfd, 1);
-    // so_reuseport(sockfd, 1);
+    if (reuseport && so_reuseport(sockfd, 1) != 0) {
+        perror("setsockopt SO_REUSEPORT");
+        goto error;
+    }
 #endif
 
     if (localaddr->sa.sa_family == AF_INET6) {
@@ -313,7 +316,7 @@ int Bind(int port, const char* host, int type) {
     if (ret != 0) {
         return NABS(ret);
     }
-    return sockaddr_bind(&localaddr, type);
+    return sockaddr_bind(&localaddr, type, 0);
 }
 
 int Listen(int port, const char* host) {
@@ -322,6 +325,19 @@ int Listen(int port, const char* host) {
     return ListenFD(sockfd);
 }
 
+int ListenReusePort(int port, const char* host) {
+#ifdef OS_WIN
+    WSAInit();
+#endif
+    sockaddr_u localaddr;
+    memset(&localaddr, 0, sizeof(localaddr));
+    int ret = sockaddr_set_ipport(&localaddr, host, port);
+    if (ret != 0) {
+        return NABS(ret);
+    }
+    return ListenFD(sockaddr_bind(&localaddr, SOCK_STREAM, 1));
+}
+
 int Connect(const char* host, int port, int nonblock) {
 #ifdef OS_WIN
     WSAInit();
@@ -357,7 +373,7 @@ int BindUnix(const char* path, int type) {
     sockaddr_u localaddr;
     memset(&localaddr, 0, sizeof(localaddr));
     sockaddr_set_path(&localaddr, path);
-    return sockaddr_bind(&localaddr, type);
+    return sockaddr_bind(&localaddr, type, 0);
 }
 
 int ListenUnix(const char* path) {
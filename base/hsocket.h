@@ -155,6 +155,11 @@ HV_EXPORT int Bind(int port, const char* host DEFAULT(ANYADDR), int type DEFAULT
 // @return listenfd
 HV_EXPORT int Listen(int port, const char* host DEFAULT(ANYADDR));
 
+// Listen with SO_REUSEPORT, every socket of the same port must be created by it.
+// The kernel spreads incoming connections over them, one listenfd per worker.
+// @return listenfd
+HV_EXPORT int ListenReusePort(int port, const char* host DEFAULT(ANYADDR));
+
 // @return connfd
 // ResolveAddr -> socket -> nonblocking -> connect
 HV_EXPORT int Connect(const char* host, int port, int nonblock DEFAULT(0));
@@ -266,6 +271,15 @@ HV_INLINE int so_reuseport(int sockfd, int on DEFAULT(1)) {
 #endif
 }
 
+HV_INLINE int so_incoming_cpu(int sockfd, int cpu) {
+#ifdef SO_INCOMING_CPU
+    // NOTE: SO_REUSEPORT group prefers the socket whose cpu handles the incoming packets
+    return setsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, (const char*)&cpu, sizeof(int));
+#else
+    return 0;
+#endif
+}
+
 HV_INLINE int so_linger(int sockfd, int timeout DEFAULT(1)) {
 #ifdef SO_LINGER
     struct linger linger;
@@ -65,6 +65,16 @@ static inline int hthread_join(hthread_t th) {
     return 0;
 }
 
+#define hthread_yield   SwitchToThread
+
+// NOTE: fiber local storage has destructor as pthread_key
+typedef DWORD       htls_key_t;
+#define HTLS_DESTRUCTOR(fname) void WINAPI fname(void* ptr)
+#define htls_key_create(pkey, destructor)   (*(pkey) = FlsAlloc(destructor))
+#define htls_key_delete FlsFree
+#define htls_get        FlsGetValue
+#define htls_set        FlsSetValue
+
 #else
 
 typedef pthread_t   hthread_t;
@@ -81,6 +91,16 @@ static inline int hthread_join(hthread_t th) {
     return pthread_join(th, NULL);
 }
 
+#include <sched.h>
+#define hthread_yield   sched_yield
+
+typedef pthread_key_t   htls_key_t;
+#define HTLS_DESTRUCTOR(fname) void fname(void* ptr)
+#define htls_key_create pthread_key_create
+#define htls_key_delete pthread_key_delete
+#define htls_get        pthread_getspecific
+#define htls_set        pthread_setspecific
+
 #endif
 
 #ifdef __cplusplus
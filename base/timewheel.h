@@ -0,0 +1,146 @@
+#ifndef HV_TIMEWHEEL_H_
+#define HV_TIMEWHEEL_H_
+
+/*
+ * hierarchical timing wheel
+ * TIMEWHEEL_LEVELS levels of TIMEWHEEL_SLOTS slots, a node expiring within
+ * SLOTS^(level+1) ticks is put into level, and cascaded to lower levels when
+ * the wheel turns to its slot, so add and remove are O(1).
+ */
+
+#include <stdint.h>
+
+#include "hdef.h" // for container_of
+#include "list.h"
+
+#define TIMEWHEEL_BITS      6
+#define TIMEWHEEL_SLOTS     (1 << TIMEWHEEL_BITS)
+#define TIMEWHEEL_MASK      (TIMEWHEEL_SLOTS - 1)
+#define TIMEWHEEL_LEVELS    4
+// NOTE: farther node is put into the last level and cascaded again.
+#define TIMEWHEEL_MAX_TICKS (((uint64_t)1 << (TIMEWHEEL_BITS * TIMEWHEEL_LEVELS)) - 1)
+
+struct timewheel_node {
+    struct list_head    list;   // empty if not in wheel
+    uint64_t            expire; // tick
+    uint32_t            slot;   // level * TIMEWHEEL_SLOTS + idx
+};
+
+struct timewheel {
+    uint64_t            cur_tick;   // last advanced tick
+    uint32_t            nelts;
+    uint64_t            bitmap[TIMEWHEEL_LEVELS]; // not empty slots
+    struct list_head    slots[TIMEWHEEL_LEVELS][TIMEWHEEL_SLOTS];
+};
+
+static inline void timewheel_init(struct timewheel* tw, uint64_t cur_tick) {
+    tw->cur_tick = cur_tick;
+    tw->nelts = 0;
+    for (int level = 0; level < TIMEWHEEL_LEVELS; ++level) {
+        tw->bitmap[level] = 0;
+        for (int idx = 0; idx < TIMEWHEEL_SLOTS; ++idx) {
+            list_init(&tw->slots[level][idx]);
+        }
+    }
+}
+
+static inline void timewheel_node_init(struct timewheel_node* node) {
+    list_init(&node->list);
+    node->expire = 0;
+    node->slot = 0;
+}
+
+static inline void __timewheel_place(struct timewheel* tw, struct timewheel_node* node) {
+    uint64_t expire = node->expire;
+    uint64_t delta = expire > tw->cur_tick ? expire - tw->cur_tick : 0;
+    if (delta > TIMEWHEEL_MAX_TICKS) {
+        delta = TIMEWHEEL_MAX_TICKS;
+        expire = tw->cur_tick + delta;
+    }
+    int level = 0;
+    while (level < TIMEWHEEL_LEVELS - 1 && delta >= ((uint64_t)1 << (TIMEWHEEL_BITS * (level + 1)))) {
+        ++level;
+    }
+    int idx = (expire >> (TIMEWHEEL_BITS * level)) & TIMEWHEEL_MASK;
+    node->slot = level * TIMEWHEEL_SLOTS + idx;
+    list_add_tail(&node->list, &tw->slots[level][idx]);
+    tw->bitmap[level] |= (uint64_t)1 << idx;
+}
+
+// NOTE: node->expire not after cur_tick expires at next tick.
+static inline void timewheel_add(struct timewheel* tw, struct timewheel_node* node) {
+    if (node->expire <= tw->cur_tick) {
+        node->expire = tw->cur_tick + 1;
+    }
+    __timewheel_place(tw, node);
+    ++tw->nelts;
+}
+
+static inline void timewheel_remove(struct timewheel* tw, struct timewheel_node* node) {
+    if (list_empty(&node->list)) return;
+    int level = node->slot / TIMEWHEEL_SLOTS;
+    int idx = node->slot % TIMEWHEEL_SLOTS;
+    list_del_init(&node->list);
+    if (list_empty(&tw->slots[level][idx])) {
+        tw->bitmap[level] &= ~((uint64_t)1 << idx);
+    }
+    --tw->nelts;
+}
+
+// @brief turn the wheel to now_tick, move expired nodes into the tail of expired.
+// @return number of expired nodes
+static inline int timewheel_advance(struct timewheel* tw, uint64_t now_tick, struct list_head* expired) {
+    int nexpired = 0;
+    while (tw->cur_tick < now_tick) {
+        if (tw->nelts == 0) {
+            tw->cur_tick = now_tick;
+            break;
+        }
+        uint64_t tick = ++tw->cur_tick;
+        // cascade from higher levels whose lower levels turned a round
+        int levels = 1;
+        while (levels < TIMEWHEEL_LEVELS && (tick & (((uint64_t)1 << (TIMEWHEEL_BITS * levels)) - 1)) == 0) {
+            ++levels;
+        }
+        for (int level = levels - 1; level > 0; --level) {
+            int idx = (tick >> (TIMEWHEEL_BITS * level)) & TIMEWHEEL_MASK;
+            if ((tw->bitmap[level] & ((uint64_t)1 << idx)) == 0) continue;
+            struct list_head cascade;
+            list_init(&cascade);
+            list_splice_init(&tw->slots[level][idx], &cascade);
+            tw->bitmap[level] &= ~((uint64_t)1 << idx);
+            while (!list_empty(&cascade)) {
+                struct timewheel_node* node = container_of(cascade.next, struct timewheel_node, list);
+                list_del_init(&node->list);
+                __timewheel_place(tw, node);
+            }
+        }
+        int idx = tick & TIMEWHEEL_MASK;
+        if ((tw->bitmap[0] & ((uint64_t)1 << idx)) == 0) continue;
+        struct list_head* slot = &tw->slots[0][idx];
+        while (!list_empty(slot)) {
+            list_move_tail(slot->next, expired);
+            --tw->nelts;
+            ++nexpired;
+        }
+        tw->bitmap[0] &= ~((uint64_t)1 << idx);
+    }
+    return nexpired;
+}
+
+// @return ticks after cur_tick to advance next time, 0 if empty
+static inline uint64_t timewheel_next_ticks(struct timewheel* tw) {
+    if (tw->nelts == 0) return 0;
+    // NOTE: higher levels may cascade at the next round of level 0
+    uint64_t ticks = TIMEWHEEL_SLOTS - (tw->cur_tick & TIMEWHEEL_MASK);
+    if (tw->bitmap[0]) {
+        for (uint64_t d = 1; d < ticks; ++d) {
+            if (tw->bitmap[0] & ((uint64_t)1 << ((tw->cur_tick + d) & TIMEWHEEL_MASK))) {
+                return d;
+            }
+        }
+    }
+    return ticks;
+}
+
+#endif // HV_TIMEWHEEL_H_
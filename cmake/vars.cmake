@@ -89,8 +89,10 @@ set(HTTP_HEADERS
     http/httpdef.h
     http/wsdef.h
     http/http_content.h
+    http/HttpHeaders.h
     http/HttpMessage.h
     http/HttpParser.h
+    http/HttpCompressor.h
     http/WebSocketParser.h
     http/WebSocketChannel.h
 )
@@ -110,6 +112,7 @@ set(HTTP_CLIENT_HEADERS
 set(HTTP_SERVER_HEADERS
     http/server/HttpServer.h
     http/server/HttpService.h
+    http/server/HttpUpstream.h
     http/server/HttpContext.h
     http/server/HttpResponseWriter.h
     http/server/WebSocketServer.h
@@ -14,8 +14,10 @@ WITH_REDIS=yes
 ENABLE_UDS=no
 ENABLE_WINDUMP=no
 USE_MULTIMAP=no
+USE_FLAT_HEADERS=no
 WITH_CURL=no
 WITH_NGHTTP2=no
+WITH_ZLIB=no
 WITH_OPENSSL=no
 WITH_GNUTLS=no
 WITH_MBEDTLS=no
@@ -1,8 +1,9 @@
 /*
  * Asynchronous DNS resolver — implementation.
  *
- * A self-contained, non-blocking, native UDP DNS resolver that runs entirely
- * inside the hloop event loop. See event/hdns.h for the public API.
+ * A self-contained, non-blocking, native DNS resolver (UDP with EDNS0, TCP on
+ * truncation) that runs entirely inside the hloop event loop. See event/hdns.h
+ * for the public API.
  *
  * This file is intentionally independent from protocol/dns.c (a synchronous
  * demo): it carries its own complete DNS wire codec, config loading, query
@@ -11,9 +12,12 @@
  * Organization:
  *   1. DNS wire codec        (build query, parse response, name compression)
  *   2. Config                (nameservers, hosts) with lazy process-wide cache
- *   3. Per-loop resolver      (owns UDP io, in-flight table, cache)
- *   4. Cache                  (TTL positive + negative)
- *   5. Query lifecycle        (hdns_resolve / hdns_cancel / timers / completion)
+ *   3. Per-loop resolver      (owns UDP io, in-flight table, TCP io per
+ *                              truncated sub-query)
+ *   4. Cache                  (process-wide, sharded, TTL positive + negative,
+ *                              refreshed ahead of expiry)
+ *   5. Query lifecycle        (hdns_resolve / hdns_cancel / timers / completion,
+ *                              identical in-flight queries of a loop coalesced)
  */
 
 #include "hdns.h"
@@ -47,10 +51,19 @@
 #define HDNS_TYPE_NS         2
 #define HDNS_TYPE_CNAME      5
 #define HDNS_TYPE_AAAA       28
+#define HDNS_TYPE_SRV        33
+#define HDNS_TYPE_OPT        41          // EDNS0 pseudo record
 #define HDNS_CLASS_IN        1
 
 #define HDNS_HDR_SIZE        12
-#define HDNS_UDP_BUFSIZE     1500        // enough for a non-EDNS UDP response
+#define HDNS_FLAG_TC         0x02        // truncated, of header byte 2
+#define HDNS_RCODE_FORMERR   1
+#define HDNS_UDP_BUFSIZE     1500        // enough for a query packet
+// EDNS0 UDP payload size advertised to nameservers: DNS flag day 2020,
+// no IP fragmentation. Larger answers are truncated and asked again over TCP.
+#define HDNS_EDNS_UDP_SIZE   1232
+#define HDNS_EDNS_OPT_SIZE   11
+#define HDNS_TCP_MAXSIZE     65535       // length prefix of DNS over TCP
 #define HDNS_MAX_NAMESERVERS 4
 #define HDNS_MAX_CNAME_HOPS  16          // guard against CNAME loops
 #define HDNS_MAX_LABEL_JUMPS 128         // guard against compression-pointer loops
@@ -58,7 +71,15 @@
 #define HDNS_CACHE_MIN_TTL   1           // seconds
 #define HDNS_CACHE_MAX_TTL   86400       // seconds
 #define HDNS_CACHE_NEG_TTL   5           // seconds, negative cache
-#define HDNS_CACHE_MAX_ENTRIES 256
+#define HDNS_CACHE_SHARDS    16          // power of 2, one mutex each
+#define HDNS_CACHE_BUCKETS   256         // power of 2, hash buckets per shard
+#define HDNS_CACHE_MAX_ENTRIES 4096      // process-wide, LRU evicted per shard
+// A positive entry is served stale-while-revalidate in the last 1/10 of its
+// TTL (at least HDNS_CACHE_REFRESH_MS): the first lookup there starts one
+// background refresh, lookups go on hitting the entry until it expires.
+#define HDNS_CACHE_REFRESH_MS       1000
+// a refresh not done in this time (e.g. timed out) may be started again
+#define HDNS_CACHE_REFRESH_RETRY_MS HDNS_DEFAULT_TIMEOUT_MS
 
 //==============================================================================
 // 1. DNS wire codec
@@ -127,10 +148,11 @@ static int hdns__decode_name(const uint8_t* buf, int buflen, int* poff,
     return 0;
 }
 
-// Build a DNS query packet for (name, qtype) with the given transaction id.
+// Build a DNS query packet for (name, qtype) with the given transaction id,
+// and an EDNS0 OPT record of HDNS_EDNS_UDP_SIZE if @edns.
 // Returns packet length, or -1 on error.
 static int hdns__build_query(uint16_t txid, const char* name, uint16_t qtype,
-                             uint8_t* buf, int buflen) {
+                             int edns, uint8_t* buf, int buflen) {
     if (buflen < HDNS_HDR_SIZE) return -1;
     memset(buf, 0, HDNS_HDR_SIZE);
     buf[0] = (uint8_t)(txid >> 8);
@@ -149,17 +171,24 @@ static int hdns__build_query(uint16_t txid, const char* name, uint16_t qtype,
     buf[off++] = (uint8_t)(qtype & 0xFF);
     buf[off++] = 0x00; // class hi
     buf[off++] = HDNS_CLASS_IN;
+    if (edns) {
+        if (off + HDNS_EDNS_OPT_SIZE > buflen) return -1;
+        buf[11] = 0x01; // arcount = 1
+        buf[off++] = 0x00; // root name
+        buf[off++] = 0x00;
+        buf[off++] = HDNS_TYPE_OPT;
+        buf[off++] = (uint8_t)(HDNS_EDNS_UDP_SIZE >> 8); // class = udp payload size
+        buf[off++] = (uint8_t)(HDNS_EDNS_UDP_SIZE & 0xFF);
+        memset(buf + off, 0, 6); // extended rcode, version 0, flags, rdlen 0
+        off += 6;
+    }
     return off;
 }
 
-// Parse addresses (A/AAAA) out of a DNS response.
-// @out_addrs / @max: caller-provided address array.
-// @naddrs: number of addresses parsed (appended).
-// @min_ttl: filled with the min TTL across accepted address records (seconds).
-// Returns:  0 ok (addresses may be 0), HDNS_STATUS_* negative on failure.
-static int hdns__parse_response(const uint8_t* buf, int buflen, uint16_t expect_txid,
-                                sockaddr_u* out_addrs, int max, int* naddrs,
-                                uint32_t* min_ttl) {
+// Check the header of a response and skip its questions.
+// Returns 0 with *poff at the answer section, HDNS_STATUS_* on failure.
+static int hdns__parse_header(const uint8_t* buf, int buflen, uint16_t expect_txid,
+                              int* poff, int* pancount) {
     if (buflen < HDNS_HDR_SIZE) return HDNS_STATUS_SERVFAIL;
     uint16_t txid = (buf[0] << 8) | buf[1];
     if (txid != expect_txid) return HDNS_STATUS_SERVFAIL;
@@ -171,8 +200,8 @@ static int hdns__parse_response(const uint8_t* buf, int buflen, uint16_t expect_
     if (rcode != 0) return HDNS_STATUS_SERVFAIL;
 
     int qdcount = (buf[4] << 8) | buf[5];
-    int ancount = (buf[6] << 8) | buf[7];
     // NOTE: never trust ancount for allocation; iterate defensively.
+    *pancount = (buf[6] << 8) | buf[7];
 
     int off = HDNS_HDR_SIZE;
     // skip questions
@@ -181,6 +210,21 @@ static int hdns__parse_response(const uint8_t* buf, int buflen, uint16_t expect_
         if (off + 4 > buflen) return HDNS_STATUS_SERVFAIL;
         off += 4; // qtype + qclass
     }
+    *poff = off;
+    return HDNS_STATUS_OK;
+}
+
+// Parse addresses (A/AAAA) out of a DNS response.
+// @out_addrs / @max: caller-provided address array.
+// @naddrs: number of addresses parsed (appended).
+// @min_ttl: filled with the min TTL across accepted address records (seconds).
+// Returns:  0 ok (addresses may be 0), HDNS_STATUS_* negative on failure.
+static int hdns__parse_response(const uint8_t* buf, int buflen, uint16_t expect_txid,
+                                sockaddr_u* out_addrs, int max, int* naddrs,
+                                uint32_t* min_ttl) {
+    int off = 0, ancount = 0;
+    int rc = hdns__parse_header(buf, buflen, expect_txid, &off, &ancount);
+    if (rc != HDNS_STATUS_OK) return rc;
 
     uint32_t best_ttl = HDNS_CACHE_MAX_TTL;
     int count = *naddrs;
@@ -225,6 +269,49 @@ static int hdns__parse_response(const uint8_t* buf, int buflen, uint16_t expect_
     return HDNS_STATUS_OK;
 }
 
+// Parse SRV records out of a DNS response, appended to *srvs grown as needed
+// up to HDNS_MAX_SRVS.
+// Returns:  0 ok (records may be 0), HDNS_STATUS_* negative on failure.
+static int hdns__parse_srv_response(const uint8_t* buf, int buflen, uint16_t expect_txid,
+                                    hdns_srv_t** srvs, int* nsrvs, int* capacity) {
+    int off = 0, ancount = 0;
+    int rc = hdns__parse_header(buf, buflen, expect_txid, &off, &ancount);
+    if (rc != HDNS_STATUS_OK) return rc;
+
+    for (int i = 0; i < ancount; ++i) {
+        if (hdns__decode_name(buf, buflen, &off, NULL, 0) != 0) return HDNS_STATUS_SERVFAIL;
+        if (off + 10 > buflen) return HDNS_STATUS_SERVFAIL;
+        uint16_t rtype = (buf[off] << 8) | buf[off + 1];
+        uint16_t rdlen = (buf[off + 8] << 8) | buf[off + 9];
+        off += 10;
+        if (off + rdlen > buflen) return HDNS_STATUS_SERVFAIL;
+
+        if (rtype == HDNS_TYPE_SRV && rdlen > 6 && *nsrvs < HDNS_MAX_SRVS) {
+            if (*nsrvs == *capacity) {
+                int newcap = *capacity ? *capacity * 2 : 16;
+                if (newcap > HDNS_MAX_SRVS) newcap = HDNS_MAX_SRVS;
+                hdns_srv_t* p = (hdns_srv_t*)hv_realloc(*srvs, newcap * sizeof(hdns_srv_t),
+                                                        *capacity * sizeof(hdns_srv_t));
+                if (!p) return HDNS_STATUS_NOMEM;
+                *srvs = p;
+                *capacity = newcap;
+            }
+            hdns_srv_t* srv = &(*srvs)[*nsrvs];
+            srv->priority = (buf[off] << 8) | buf[off + 1];
+            srv->weight   = (buf[off + 2] << 8) | buf[off + 3];
+            srv->port     = (buf[off + 4] << 8) | buf[off + 5];
+            // target may be compressed against the whole packet
+            int name_off = off + 6;
+            if (hdns__decode_name(buf, buflen, &name_off, srv->target, sizeof(srv->target)) != 0) {
+                return HDNS_STATUS_SERVFAIL;
+            }
+            ++*nsrvs;
+        }
+        off += rdlen;
+    }
+    return HDNS_STATUS_OK;
+}
+
 //==============================================================================
 // 2. Config: nameservers + hosts (process-wide, loaded lazily once)
 //==============================================================================
@@ -438,19 +525,9 @@ static int hdns__hosts_lookup(const char* name, hdns_family_e family,
 }
 
 //==============================================================================
-// 3/4. Per-loop resolver + cache
+// 3. Per-loop resolver
 //==============================================================================
 
-typedef struct hdns_cache_entry_s {
-    char        host[HDNS_NAME_MAXLEN];
-    int         family;                     // hdns_family_e bitset
-    int         naddrs;
-    sockaddr_u  addrs[HDNS_MAX_ADDRS];
-    uint64_t    expire_ms;                  // loop clock ms
-    int         negative;                   // 1 = cached failure
-    struct list_node node;
-} hdns_cache_entry_t;
-
 // One logical resolve.
 // NOTE: hdns_s is a subclass of hevent_t (like htimer_s / hio_s): it starts
 // with HEVENT_FIELDS so it inherits `loop`, `event_id`, `userdata`, `priority`
@@ -464,10 +541,15 @@ struct hdns_s {
     // to share the same storage unit and save space.
     unsigned        detached   : 1; // cancelled: run to completion, drop result
     unsigned        delivering : 1; // inside hdns__deliver's callback (cancel guard)
+    unsigned        no_edns    : 1; // nameserver answered FORMERR to EDNS0
     struct hdns_resolver_s* resolver;
     char            host[HDNS_NAME_MAXLEN];
     hdns_setting_t  opt;
+    char            nameserver[64]; // copy of opt.nameserver, which points here
     hdns_cb         dns_cb;         // user callback (hevent_t::cb has a different type)
+    hdns_srv_cb     srv_cb;         // instead of dns_cb for a SRV query
+    // coalesced: waits for the same query in flight, settled with its result
+    struct hdns_s*  leader;
 
     // sub-queries: index 0 = A, index 1 = AAAA (per opt.family)
     struct {
@@ -475,6 +557,7 @@ struct hdns_s {
         int         done;           // settled (answer/empty/error)
         uint16_t    txid;
         uint16_t    qtype;
+        hio_t*      tcp_io;         // truncated over UDP: asked again over TCP
     } sub[2];
 
     int             attempt;        // current attempt (0..retries)
@@ -488,6 +571,9 @@ struct hdns_s {
     int             naddrs;
     uint32_t        min_ttl;
     int             any_error;      // last non-timeout error seen
+    hdns_srv_t*     srvs;           // of a SRV query, grown as parsed
+    int             nsrvs;
+    int             srvs_cap;
 
     struct list_node node;          // in resolver->queries
 };
@@ -497,17 +583,17 @@ typedef struct hdns_resolver_s {
     hio_t*          io4;            // UDP socket for IPv4 nameservers (lazy)
     hio_t*          io6;            // UDP socket for IPv6 nameservers (lazy)
     struct list_head queries;       // in-flight hdns_t
-    struct list_head cache;         // hdns_cache_entry_t (LRU-ish by insertion)
-    int             ncache;
     uint16_t        next_txid;      // monotonic base for sub-query txids (wire)
     uint8_t         sndbuf[HDNS_UDP_BUFSIZE];
 } hdns_resolver_t;
 
 // forward decls
 static void hdns__on_udp_read(hio_t* io, void* buf, int readbytes);
+static void hdns__close_tcp(hdns_t* q);
 static void hdns__on_timeout(htimer_t* timer);
 static void hdns__on_defer(htimer_t* timer);
 static void hdns__send_queries(hdns_t* q);
+static void hdns__defer_complete(hdns_t* q);
 static void hdns__finish(hdns_t* q, int status);
 
 // Lazily create the UDP send/recv socket matching the nameserver's family.
@@ -531,6 +617,11 @@ static hio_t* hdns__resolver_io(hdns_resolver_t* r, int family) {
     return io;
 }
 
+static void hdns__free(hdns_t* q) {
+    HV_FREE(q->srvs);
+    HV_FREE(q);
+}
+
 static hdns_resolver_t* hdns__resolver_get(hloop_t* loop) {
     hdns_resolver_t* r = (hdns_resolver_t*)loop->dns_resolver;
     if (r) return r;
@@ -539,8 +630,6 @@ static hdns_resolver_t* hdns__resolver_get(hloop_t* loop) {
     if (!r) return NULL;
     r->loop = loop;
     list_init(&r->queries);
-    list_init(&r->cache);
-    r->ncache = 0;
     // seed the txid counter randomly to reduce off-path spoofing predictability.
     r->next_txid = (uint16_t)hv_rand(1, 0xFFFF);
     // sockets are created lazily per nameserver family in hdns__resolver_io().
@@ -561,102 +650,252 @@ void hdns_resolver_free(hloop_t* loop) {
         list_del(&q->node);
         if (q->timer) htimer_del(q->timer);
         if (q->defer_timer) htimer_del(q->defer_timer);
-        HV_FREE(q);
+        hdns__free(q);
     }
-    // free cache
-    list_for_each_safe(node, tmp, &r->cache) {
-        hdns_cache_entry_t* e = list_entry(node, hdns_cache_entry_t, node);
-        list_del(&e->node);
-        HV_FREE(e);
-    }
-    // NOTE: r->io4/io6 are owned by the loop and freed by hloop_cleanup's io sweep.
+    // NOTE: r->io4/io6 and tcp ios of queries are owned by the loop and freed
+    // by hloop_cleanup's io sweep, before this.
     HV_FREE(r);
 }
 
-//---------------------------- cache ------------------------------------------
+//==============================================================================
+// 4. Cache
+//==============================================================================
+// Shared by all loops of the process: a name resolved by one loop is a hit for
+// the others. Keyed by (host, family), hashed to a shard by the low bits and
+// to a bucket by the next ones, so loops mostly take different mutexes.
+// Times are hloop_now_hrtime() in ms, the same monotonic clock for all loops.
 
-static hdns_cache_entry_t* hdns__cache_find(hdns_resolver_t* r, const char* host,
-                                            int family) {
-    uint64_t now = hloop_now_ms(r->loop);
-    struct list_node *node, *tmp;
-    list_for_each_safe(node, tmp, &r->cache) {
-        hdns_cache_entry_t* e = list_entry(node, hdns_cache_entry_t, node);
-        if (now >= e->expire_ms) {
-            // expired -> evict
-            list_del(&e->node);
-            HV_FREE(e);
-            --r->ncache;
-            continue;
-        }
-        if (e->family == family && strcasecmp(e->host, host) == 0) {
-            return e;
-        }
+typedef struct hdns_cache_entry_s {
+    char        host[HDNS_NAME_MAXLEN];
+    int         family;                     // hdns_family_e bitset
+    uint64_t    refresh_ms;                 // stale-while-revalidate from
+    uint64_t    expire_ms;
+    uint64_t    refreshing_ms;              // refresh started at, 0 = none
+    int         negative;                   // 1 = cached failure
+    uint32_t    hash;
+    struct hdns_cache_entry_s* next;        // in bucket
+    struct list_node node;                  // in shard lru, newest at head
+    int         naddrs;
+    sockaddr_u  addrs[1];                   // allocated to fit naddrs
+} hdns_cache_entry_t;
+
+typedef struct hdns_cache_shard_s {
+    hmutex_t            mutex;
+    hdns_cache_entry_t* buckets[HDNS_CACHE_BUCKETS];
+    struct list_head    lru;
+    int                 nentries;
+    // GUARDED_BY(mutex)
+    uint64_t            hits;
+    uint64_t            stale_hits;
+    uint64_t            misses;
+    uint64_t            coalesced;
+} hdns_cache_shard_t;
+
+#define HDNS_CACHE_SHARD_MAX_ENTRIES (HDNS_CACHE_MAX_ENTRIES / HDNS_CACHE_SHARDS)
+
+// hdns__cache_get
+#define HDNS_CACHE_MISS     0
+#define HDNS_CACHE_HIT      1
+#define HDNS_CACHE_REFRESH  2   // hit, and the caller starts the refresh
+
+static hdns_cache_shard_t s_cache[HDNS_CACHE_SHARDS];
+static honce_t            s_cache_once = HONCE_INIT;
+
+static void hdns__cache_init_once(void) {
+    for (int i = 0; i < HDNS_CACHE_SHARDS; ++i) {
+        hmutex_init(&s_cache[i].mutex);
+        list_init(&s_cache[i].lru);
     }
-    return NULL;
 }
 
-static void hdns__cache_put(hdns_resolver_t* r, const char* host, int family,
-                            const sockaddr_u* addrs, int naddrs,
-                            uint32_t ttl_sec, int negative) {
-    // drop existing entry for same key
-    struct list_node *node, *tmp;
-    list_for_each_safe(node, tmp, &r->cache) {
-        hdns_cache_entry_t* e = list_entry(node, hdns_cache_entry_t, node);
-        if (e->family == family && strcasecmp(e->host, host) == 0) {
-            list_del(&e->node);
-            HV_FREE(e);
-            --r->ncache;
-            break;
-        }
+// FNV-1a of the lowercased host, mixed with family
+static uint32_t hdns__cache_hash(const char* host, int family) {
+    uint32_t h = 2166136261u;
+    for (const char* p = host; *p; ++p) {
+        h = (h ^ (uint8_t)tolower((uint8_t)*p)) * 16777619u;
+    }
+    h = (h ^ (uint32_t)family) * 16777619u;
+    h ^= h >> 15;
+    return h;
+}
+
+static hdns_cache_shard_t* hdns__cache_shard(uint32_t hash) {
+    honce(&s_cache_once, hdns__cache_init_once);
+    return &s_cache[hash & (HDNS_CACHE_SHARDS - 1)];
+}
+
+// @retval address of the pointer to the entry in its bucket, *ret NULL if none
+static hdns_cache_entry_t** hdns__cache_slot(hdns_cache_shard_t* shard, uint32_t hash,
+                                             const char* host, int family) {
+    hdns_cache_entry_t** pe = &shard->buckets[(hash / HDNS_CACHE_SHARDS) & (HDNS_CACHE_BUCKETS - 1)];
+    while (*pe) {
+        hdns_cache_entry_t* e = *pe;
+        if (e->hash == hash && e->family == family && strcasecmp(e->host, host) == 0) break;
+        pe = &e->next;
+    }
+    return pe;
+}
+
+static void hdns__cache_remove(hdns_cache_shard_t* shard, hdns_cache_entry_t** pe) {
+    hdns_cache_entry_t* e = *pe;
+    *pe = e->next;
+    list_del(&e->node);
+    HV_FREE(e);
+    --shard->nentries;
+}
+
+// Copy a live entry into q. See HDNS_CACHE_* for the return value.
+static int hdns__cache_get(hdns_t* q) {
+    uint64_t now = hloop_now_hrtime(q->loop) / 1000;
+    int family = q->opt.family;
+    uint32_t hash = hdns__cache_hash(q->host, family);
+    hdns_cache_shard_t* shard = hdns__cache_shard(hash);
+    int ret = HDNS_CACHE_MISS;
+    hmutex_lock(&shard->mutex);
+    hdns_cache_entry_t** pe = hdns__cache_slot(shard, hash, q->host, family);
+    hdns_cache_entry_t* e = *pe;
+    if (e && now >= e->expire_ms) {
+        // expired -> evict
+        hdns__cache_remove(shard, pe);
+        e = NULL;
     }
-    // bound cache size: evict oldest (list tail) when full
-    if (r->ncache >= HDNS_CACHE_MAX_ENTRIES && !list_empty(&r->cache)) {
-        hdns_cache_entry_t* old = list_entry(r->cache.prev, hdns_cache_entry_t, node);
-        list_del(&old->node);
-        HV_FREE(old);
-        --r->ncache;
+    if (e) {
+        ret = HDNS_CACHE_HIT;
+        if (e->negative) {
+            q->any_error = HDNS_STATUS_NXDOMAIN;
+        } else {
+            q->naddrs = e->naddrs;
+            memcpy(q->addrs, e->addrs, e->naddrs * sizeof(sockaddr_u));
+            if (now >= e->refresh_ms) {
+                ++shard->stale_hits;
+                if (e->refreshing_ms == 0 || now - e->refreshing_ms >= HDNS_CACHE_REFRESH_RETRY_MS) {
+                    e->refreshing_ms = now;
+                    ret = HDNS_CACHE_REFRESH;
+                }
+            }
+        }
+        ++shard->hits;
+        // most recently used
+        list_del(&e->node);
+        list_add(&e->node, &shard->lru);
+    } else {
+        ++shard->misses;
     }
+    hmutex_unlock(&shard->mutex);
+    return ret;
+}
 
+static void hdns__cache_put(hloop_t* loop, const char* host, int family,
+                            const sockaddr_u* addrs, int naddrs,
+                            uint32_t ttl_sec, int negative) {
+    if (negative || !addrs) naddrs = 0;
+    if (naddrs > HDNS_MAX_ADDRS) naddrs = HDNS_MAX_ADDRS;
     hdns_cache_entry_t* e;
-    HV_ALLOC_SIZEOF(e);
+    HV_ALLOC(e, sizeof(hdns_cache_entry_t) + (naddrs > 1 ? naddrs - 1 : 0) * sizeof(sockaddr_u));
     if (!e) return;
     strncpy(e->host, host, sizeof(e->host) - 1);
     e->family = family;
     e->negative = negative;
-    e->naddrs = 0;
-    if (!negative && addrs && naddrs > 0) {
-        e->naddrs = naddrs > HDNS_MAX_ADDRS ? HDNS_MAX_ADDRS : naddrs;
-        memcpy(e->addrs, addrs, e->naddrs * sizeof(sockaddr_u));
+    e->naddrs = naddrs;
+    if (naddrs > 0) {
+        memcpy(e->addrs, addrs, naddrs * sizeof(sockaddr_u));
     }
     if (ttl_sec < HDNS_CACHE_MIN_TTL) ttl_sec = HDNS_CACHE_MIN_TTL;
     if (ttl_sec > HDNS_CACHE_MAX_TTL) ttl_sec = HDNS_CACHE_MAX_TTL;
-    e->expire_ms = hloop_now_ms(r->loop) + (uint64_t)ttl_sec * 1000;
-    list_add(&e->node, &r->cache); // newest at head
-    ++r->ncache;
+    uint64_t ttl_ms = (uint64_t)ttl_sec * 1000;
+    uint64_t refresh_ahead_ms = MAX(ttl_ms / 10, HDNS_CACHE_REFRESH_MS);
+    e->expire_ms = hloop_now_hrtime(loop) / 1000 + ttl_ms;
+    e->refresh_ms = negative || refresh_ahead_ms >= ttl_ms ? e->expire_ms : e->expire_ms - refresh_ahead_ms;
+    e->hash = hdns__cache_hash(host, family);
+
+    hdns_cache_shard_t* shard = hdns__cache_shard(e->hash);
+    hmutex_lock(&shard->mutex);
+    // replace existing entry for same key
+    hdns_cache_entry_t** pe = hdns__cache_slot(shard, e->hash, host, family);
+    if (*pe) hdns__cache_remove(shard, pe);
+    // bound cache size: evict least recently used (list tail) when full
+    if (shard->nentries >= HDNS_CACHE_SHARD_MAX_ENTRIES) {
+        hdns_cache_entry_t* old = list_entry(shard->lru.prev, hdns_cache_entry_t, node);
+        hdns__cache_remove(shard, hdns__cache_slot(shard, old->hash, old->host, old->family));
+        // NOTE: slot of e may have been the evicted one
+        pe = hdns__cache_slot(shard, e->hash, host, family);
+    }
+    e->next = *pe;
+    *pe = e;
+    list_add(&e->node, &shard->lru);
+    ++shard->nentries;
+    hmutex_unlock(&shard->mutex);
+}
+
+static void hdns__cache_coalesced(const char* host, int family) {
+    hdns_cache_shard_t* shard = hdns__cache_shard(hdns__cache_hash(host, family));
+    hmutex_lock(&shard->mutex);
+    ++shard->coalesced;
+    hmutex_unlock(&shard->mutex);
 }
 
 void hdns_clear_cache(hloop_t* loop) {
-    hdns_resolver_t* r = (hdns_resolver_t*)loop->dns_resolver;
-    if (!r) return;
-    struct list_node *node, *tmp;
-    list_for_each_safe(node, tmp, &r->cache) {
-        hdns_cache_entry_t* e = list_entry(node, hdns_cache_entry_t, node);
-        list_del(&e->node);
-        HV_FREE(e);
+    (void)loop;
+    for (int i = 0; i < HDNS_CACHE_SHARDS; ++i) {
+        hdns_cache_shard_t* shard = hdns__cache_shard(i);
+        hmutex_lock(&shard->mutex);
+        struct list_node *node, *tmp;
+        list_for_each_safe(node, tmp, &shard->lru) {
+            hdns_cache_entry_t* e = list_entry(node, hdns_cache_entry_t, node);
+            list_del(&e->node);
+            HV_FREE(e);
+        }
+        memset(shard->buckets, 0, sizeof(shard->buckets));
+        shard->nentries = 0;
+        hmutex_unlock(&shard->mutex);
+    }
+}
+
+void hdns_cache_stats(hdns_cache_stats_t* stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < HDNS_CACHE_SHARDS; ++i) {
+        hdns_cache_shard_t* shard = hdns__cache_shard(i);
+        hmutex_lock(&shard->mutex);
+        stats->hits += shard->hits;
+        stats->stale_hits += shard->stale_hits;
+        stats->misses += shard->misses;
+        stats->coalesced += shard->coalesced;
+        stats->entries += shard->nentries;
+        hmutex_unlock(&shard->mutex);
     }
-    r->ncache = 0;
 }
 
 //==============================================================================
 // 5. Query lifecycle
 //==============================================================================
 
+// by priority, then weight descending
+static int hdns__srv_compare(const void* lhs, const void* rhs) {
+    const hdns_srv_t* a = (const hdns_srv_t*)lhs;
+    const hdns_srv_t* b = (const hdns_srv_t*)rhs;
+    if (a->priority != b->priority) return (int)a->priority - (int)b->priority;
+    return (int)b->weight - (int)a->weight;
+}
+
 // Fill an hdns_result_t and invoke the user callback, then free the query.
 // A cancelled (detached) query is freed silently without invoking any callback.
 static void hdns__deliver(hdns_t* q, int status) {
     hdns_cb cb = q->detached ? NULL : q->dns_cb;
+    hdns_srv_cb srv_cb = q->detached ? NULL : q->srv_cb;
     void* ud = q->userdata;
 
+    hdns_srv_result_t srv_result;
+    if (srv_cb) {
+        memset(&srv_result, 0, sizeof(srv_result));
+        srv_result.status = status;
+        strncpy(srv_result.name, q->host, sizeof(srv_result.name) - 1);
+        if (status == HDNS_STATUS_OK) {
+            qsort(q->srvs, q->nsrvs, sizeof(hdns_srv_t), hdns__srv_compare);
+            srv_result.nsrvs = q->nsrvs;
+            srv_result.srvs = q->srvs;
+        }
+    }
     hdns_result_t result;
     if (cb) {
         memset(&result, 0, sizeof(result));
@@ -677,11 +916,13 @@ static void hdns__deliver(hdns_t* q, int status) {
     if (q->node.next) { list_del(&q->node); q->node.next = q->node.prev = NULL; }
     if (q->timer) { htimer_del(q->timer); q->timer = NULL; }
     if (q->defer_timer) { htimer_del(q->defer_timer); q->defer_timer = NULL; }
+    hdns__close_tcp(q);
 
     q->delivering = 1;
     if (cb) cb(q, &result, ud);
+    if (srv_cb) srv_cb(q, &srv_result, ud);
 
-    HV_FREE(q);
+    hdns__free(q);
 }
 
 // Sort accumulated addresses: IPv4 first (stable), matching getaddrinfo-ish order.
@@ -698,25 +939,59 @@ static void hdns__sort_v4_first(hdns_t* q) {
     q->naddrs = n;
 }
 
+// A network query, as opposed to numeric IP / hosts / cache hit / coalesced.
+static int hdns__is_network(hdns_t* q) {
+    return q->sub[0].qtype || q->sub[1].qtype;
+}
+
+// Deliver q, then the queries coalesced into it with the same result.
+static void hdns__settle(hdns_t* q, int status) {
+    struct list_head followers;
+    list_init(&followers);
+    if (hdns__is_network(q)) {
+        struct list_node *node, *tmp;
+        list_for_each_safe(node, tmp, &q->resolver->queries) {
+            hdns_t* f = list_entry(node, hdns_t, node);
+            if (f->leader != q) continue;
+            f->leader = NULL;
+            f->naddrs = q->naddrs;
+            memcpy(f->addrs, q->addrs, q->naddrs * sizeof(sockaddr_u));
+            f->any_error = q->any_error;
+            list_del(&f->node);
+            list_add_tail(&f->node, &followers);
+        }
+    }
+    hdns__deliver(q, status);
+    // NOTE: a callback may hdns_cancel a follower, which unlinks it from here.
+    while (!list_empty(&followers)) {
+        hdns_t* f = list_entry(followers.next, hdns_t, node);
+        hdns__deliver(f, status);
+    }
+}
+
 // Called when all requested sub-queries have settled.
 static void hdns__complete(hdns_t* q) {
-    hdns_resolver_t* r = q->resolver;
     int status;
-    if (q->naddrs > 0) {
+    // NOTE: only answers from the network are cached, with their TTL.
+    int cache = q->opt.use_cache && hdns__is_network(q) && !q->srv_cb;
+    if (q->srv_cb) {
+        status = q->nsrvs > 0 ? HDNS_STATUS_OK :
+                 q->any_error ? q->any_error : HDNS_STATUS_NXDOMAIN;
+    } else if (q->naddrs > 0) {
         hdns__sort_v4_first(q);
         status = HDNS_STATUS_OK;
-        if (q->opt.use_cache) {
-            hdns__cache_put(r, q->host, q->opt.family, q->addrs, q->naddrs,
+        if (cache) {
+            hdns__cache_put(q->loop, q->host, q->opt.family, q->addrs, q->naddrs,
                             q->min_ttl, 0);
         }
     } else {
         status = q->any_error ? q->any_error : HDNS_STATUS_NXDOMAIN;
-        if (q->opt.use_cache && status == HDNS_STATUS_NXDOMAIN) {
-            hdns__cache_put(r, q->host, q->opt.family, NULL, 0,
+        if (cache && status == HDNS_STATUS_NXDOMAIN) {
+            hdns__cache_put(q->loop, q->host, q->opt.family, NULL, 0,
                             HDNS_CACHE_NEG_TTL, 1);
         }
     }
-    hdns__deliver(q, status);
+    hdns__settle(q, status);
 }
 
 static int hdns__all_done(hdns_t* q) {
@@ -762,7 +1037,7 @@ static void hdns__send_queries(hdns_t* q) {
     for (int i = 0; i < 2; ++i) {
         if (!q->sub[i].qtype || q->sub[i].done) continue;
         int len = hdns__build_query(q->sub[i].txid, q->host, q->sub[i].qtype,
-                                    r->sndbuf, sizeof(r->sndbuf));
+                                    !q->no_edns, r->sndbuf, sizeof(r->sndbuf));
         if (len < 0) {
             q->sub[i].done = 1;
             q->any_error = HDNS_STATUS_BADNAME;
@@ -789,6 +1064,7 @@ static void hdns__on_timeout(htimer_t* timer) {
     hdns_t* q = (hdns_t*)hevent_userdata(timer);
     if (!q) return;
     q->timer = NULL; // this single-shot timer auto-deletes after firing
+    hdns__close_tcp(q);
 
     if (q->attempt < q->opt.retries) {
         ++q->attempt;
@@ -811,7 +1087,53 @@ static void hdns__on_timeout(htimer_t* timer) {
 static void hdns__finish(hdns_t* q, int status) {
     q->naddrs = 0;
     q->any_error = status;
-    hdns__deliver(q, status);
+    hdns__settle(q, status);
+}
+
+static void hdns__send_tcp(hdns_t* q, int i);
+
+// An answer of sub-query i, over UDP or TCP.
+static void hdns__on_answer(hdns_t* q, int i, const uint8_t* pkt, int len) {
+    // must be a response (QR bit set), not a stray query echo
+    if (!(pkt[2] & 0x80)) return;
+    int rcode = pkt[3] & 0x0F;
+    if (rcode == HDNS_RCODE_FORMERR && !q->no_edns) {
+        // an old nameserver not knowing EDNS0: ask again without it
+        q->no_edns = 1;
+        hdns__close_tcp(q);
+        hdns__send_queries(q);
+        return;
+    }
+    if ((pkt[2] & HDNS_FLAG_TC) && q->sub[i].tcp_io == NULL) {
+        // truncated: ask the same nameserver again over TCP
+        hdns__send_tcp(q, i);
+        return;
+    }
+
+    // parse this sub-query's answer
+    uint32_t ttl = HDNS_CACHE_MAX_TTL;
+    int rc;
+    if (q->srv_cb) {
+        rc = hdns__parse_srv_response(pkt, len, q->sub[i].txid,
+                                      &q->srvs, &q->nsrvs, &q->srvs_cap);
+    } else {
+        rc = hdns__parse_response(pkt, len, q->sub[i].txid,
+                                  q->addrs, HDNS_MAX_ADDRS,
+                                  &q->naddrs, &ttl);
+    }
+    if (rc == HDNS_STATUS_OK) {
+        if (ttl < q->min_ttl) q->min_ttl = ttl;
+    } else if (rc == HDNS_STATUS_NXDOMAIN) {
+        if (!q->any_error) q->any_error = HDNS_STATUS_NXDOMAIN;
+    } else {
+        if (!q->any_error) q->any_error = HDNS_STATUS_SERVFAIL;
+    }
+    q->sub[i].done = 1;
+    q->sub[i].active = 0;
+
+    if (hdns__all_done(q)) {
+        hdns__complete(q);
+    }
 }
 
 // UDP read: demux by transaction id to the matching sub-query.
@@ -830,6 +1152,8 @@ static void hdns__on_udp_read(hio_t* io, void* buf, int readbytes) {
         for (int i = 0; i < 2; ++i) {
             if (!q->sub[i].qtype || q->sub[i].done) continue;
             if (q->sub[i].txid != txid) continue;
+            // asked again over TCP: a duplicate UDP answer
+            if (q->sub[i].tcp_io) continue;
 
             // Only accept a response coming from the nameserver we queried.
             // This drops off-path injected packets that happen to guess the
@@ -840,30 +1164,108 @@ static void hdns__on_udp_read(hio_t* io, void* buf, int readbytes) {
                 continue;
             }
 
-            // parse this sub-query's answer
-            uint32_t ttl = HDNS_CACHE_MAX_TTL;
-            int rc = hdns__parse_response(pkt, readbytes, txid,
-                                          q->addrs, HDNS_MAX_ADDRS,
-                                          &q->naddrs, &ttl);
-            if (rc == HDNS_STATUS_OK) {
-                if (ttl < q->min_ttl) q->min_ttl = ttl;
-            } else if (rc == HDNS_STATUS_NXDOMAIN) {
-                if (!q->any_error) q->any_error = HDNS_STATUS_NXDOMAIN;
-            } else {
-                if (!q->any_error) q->any_error = HDNS_STATUS_SERVFAIL;
-            }
-            q->sub[i].done = 1;
-            q->sub[i].active = 0;
-
-            if (hdns__all_done(q)) {
-                hdns__complete(q);
-            }
+            hdns__on_answer(q, i, pkt, readbytes);
             return;
         }
     }
     // unknown txid: stale/duplicate response, ignore.
 }
 
+//---------------------------- TCP --------------------------------------------
+// DNS over TCP (RFC 7766): each message prefixed by its 2-byte length.
+
+static unpack_setting_t s_tcp_unpack;
+static honce_t          s_tcp_unpack_once = HONCE_INIT;
+
+static void hdns__tcp_unpack_init_once(void) {
+    memset(&s_tcp_unpack, 0, sizeof(s_tcp_unpack));
+    s_tcp_unpack.mode = UNPACK_BY_LENGTH_FIELD;
+    s_tcp_unpack.package_max_length = 2 + HDNS_TCP_MAXSIZE;
+    s_tcp_unpack.body_offset = 2;
+    s_tcp_unpack.length_field_offset = 0;
+    s_tcp_unpack.length_field_bytes = 2;
+    s_tcp_unpack.length_field_coding = ENCODE_BY_BIG_ENDIAN;
+}
+
+static int hdns__tcp_sub(hdns_t* q, hio_t* io) {
+    return q->sub[0].tcp_io == io ? 0 : 1;
+}
+
+static void hdns__on_tcp_connect(hio_t* io) {
+    hdns_t* q = (hdns_t*)hio_context(io);
+    if (!q) return;
+    int i = hdns__tcp_sub(q, io);
+    uint8_t buf[2 + HDNS_UDP_BUFSIZE];
+    int len = hdns__build_query(q->sub[i].txid, q->host, q->sub[i].qtype,
+                                !q->no_edns, buf + 2, sizeof(buf) - 2);
+    // NOTE: built over UDP already, never fails here
+    buf[0] = (uint8_t)(len >> 8);
+    buf[1] = (uint8_t)(len & 0xFF);
+    hio_write(io, buf, len + 2);
+    hio_read(io);
+}
+
+static void hdns__on_tcp_read(hio_t* io, void* buf, int readbytes) {
+    hdns_t* q = (hdns_t*)hio_context(io);
+    if (!q || readbytes < 2 + HDNS_HDR_SIZE) return;
+    const uint8_t* pkt = (const uint8_t*)buf + 2;
+    int i = hdns__tcp_sub(q, io);
+    if (((pkt[0] << 8) | pkt[1]) != q->sub[i].txid) return;
+    hdns__on_answer(q, i, pkt, readbytes - 2);
+}
+
+static void hdns__on_tcp_close(hio_t* io) {
+    hdns_t* q = (hdns_t*)hio_context(io);
+    // closed by hdns__close_tcp
+    if (!q) return;
+    // connect failed or closed before the answer: this sub-query fails
+    int i = hdns__tcp_sub(q, io);
+    q->sub[i].tcp_io = NULL;
+    q->sub[i].done = 1;
+    q->sub[i].active = 0;
+    if (!q->any_error) q->any_error = HDNS_STATUS_SERVFAIL;
+    if (hdns__all_done(q)) {
+        // delivered on the next loop tick, not inside hio_close
+        if (q->timer) { htimer_del(q->timer); q->timer = NULL; }
+        hdns__defer_complete(q);
+    }
+}
+
+static void hdns__send_tcp(hdns_t* q, int i) {
+    honce(&s_tcp_unpack_once, hdns__tcp_unpack_init_once);
+    int fd = socket(q->last_ns.sa.sa_family, SOCK_STREAM, 0);
+    hio_t* io = fd < 0 ? NULL : hio_get(q->loop, fd);
+    if (io == NULL) {
+        if (fd >= 0) closesocket(fd);
+        q->sub[i].done = 1;
+        q->sub[i].active = 0;
+        if (!q->any_error) q->any_error = HDNS_STATUS_ERROR;
+        if (hdns__all_done(q)) hdns__complete(q);
+        return;
+    }
+    hio_set_type(io, HIO_TYPE_TCP);
+    hio_set_peeraddr(io, &q->last_ns.sa, SOCKADDR_LEN(&q->last_ns));
+    hio_set_context(io, q);
+    hio_setcb_connect(io, hdns__on_tcp_connect);
+    hio_setcb_read(io, hdns__on_tcp_read);
+    hio_setcb_close(io, hdns__on_tcp_close);
+    hio_set_unpack(io, &s_tcp_unpack);
+    q->sub[i].tcp_io = io;
+    // the attempt timeout starts again for TCP
+    if (q->timer) htimer_reset(q->timer, q->opt.timeout_ms);
+    hio_connect(io);
+}
+
+static void hdns__close_tcp(hdns_t* q) {
+    for (int i = 0; i < 2; ++i) {
+        hio_t* io = q->sub[i].tcp_io;
+        if (io == NULL) continue;
+        q->sub[i].tcp_io = NULL;
+        hio_set_context(io, NULL);
+        hio_close(io);
+    }
+}
+
 // Deferred delivery for immediate results (numeric IP / hosts / cache hit).
 static void hdns__on_defer(htimer_t* timer) {
     hdns_t* q = (hdns_t*)hevent_userdata(timer);
@@ -894,20 +1296,13 @@ static void hdns__defer_complete(hdns_t* q) {
     }
 }
 
-hdns_t* hdns_resolve_ex(hloop_t* loop, const char* host,
-                        const hdns_setting_t* opt,
-                        hdns_cb cb, void* userdata) {
-    if (!loop || !host || !cb) return NULL;
-    size_t hlen = strlen(host);
-    if (hlen == 0 || hlen >= HDNS_NAME_MAXLEN) return NULL;
-
-    hdns_resolver_t* r = hdns__resolver_get(loop);
-    if (!r) return NULL;
-
+static hdns_t* hdns__query_new(hdns_resolver_t* r, const char* host,
+                               const hdns_setting_t* opt,
+                               hdns_cb cb, void* userdata) {
     hdns_t* q;
     HV_ALLOC_SIZEOF(q);
     if (!q) return NULL;
-    q->loop = loop;
+    q->loop = r->loop;
     q->event_type = HEVENT_TYPE_CUSTOM;
     q->resolver = r;
     strncpy(q->host, host, sizeof(q->host) - 1);
@@ -928,9 +1323,93 @@ hdns_t* hdns_resolve_ex(hloop_t* loop, const char* host,
     if (q->opt.family == 0) q->opt.family = HDNS_QUERY_BOTH;
     if (q->opt.timeout_ms <= 0) q->opt.timeout_ms = HDNS_DEFAULT_TIMEOUT_MS;
     if (q->opt.retries < 0) q->opt.retries = 0;
+    // the query may outlive the caller's string (coalesced, refreshed)
+    if (q->opt.nameserver) {
+        strncpy(q->nameserver, q->opt.nameserver, sizeof(q->nameserver) - 1);
+        q->opt.nameserver = q->nameserver;
+    }
 
     // register in resolver so it can be cancelled / matched
     list_add(&q->node, &r->queries);
+    return q;
+}
+
+// Assign sub-queries + txids, and start on the next loop tick so the caller
+// gets the handle before anything is sent (see the re-entrancy guarantee).
+static void hdns__query_start(hdns_t* q) {
+    // A per-resolver monotonic 16-bit counter (base, base+1 for A/AAAA) is
+    // used for demuxing responses. NOTE: after 65536 it wraps and could in
+    // theory collide with a still-in-flight query, but that would require
+    // tens of thousands of resolves on one loop with an old query still
+    // pending -- it does not happen in practice, so we keep this simple.
+    hdns_resolver_t* r = q->resolver;
+    uint16_t base = r->next_txid;
+    r->next_txid += 2; // A uses base, AAAA uses base+1
+    if (q->srv_cb) {
+        q->sub[0].qtype = HDNS_TYPE_SRV;
+        q->sub[0].txid = base;
+    } else if (q->opt.family & HDNS_QUERY_A) {
+        q->sub[0].qtype = HDNS_TYPE_A;
+        q->sub[0].txid = base;
+    }
+    if ((q->opt.family & HDNS_QUERY_AAAA) && !q->srv_cb) {
+        q->sub[1].qtype = HDNS_TYPE_AAAA;
+        q->sub[1].txid = (uint16_t)(base + 1);
+    }
+    // htimer_add(timeout_ms=1) does not return NULL; on the unreachable
+    // alloc-failure path the query stays registered and is cleaned at teardown.
+    q->defer_timer = htimer_add(q->loop, hdns__on_start, 1, 1);
+    if (q->defer_timer) {
+        hevent_set_userdata(q->defer_timer, q);
+    }
+}
+
+// The network query of the same (host, family, nameserver) in flight on this
+// loop, if any.
+static hdns_t* hdns__find_leader(hdns_t* q) {
+    struct list_node* node;
+    list_for_each(node, &q->resolver->queries) {
+        hdns_t* l = list_entry(node, hdns_t, node);
+        if (l == q || !hdns__is_network(l)) continue;
+        if (l->srv_cb || q->srv_cb) continue;
+        if (l->opt.family == q->opt.family &&
+            strcmp(l->nameserver, q->nameserver) == 0 &&
+            strcasecmp(l->host, q->host) == 0) {
+            return l;
+        }
+    }
+    return NULL;
+}
+
+static int hdns__has_followers(hdns_t* q) {
+    struct list_node* node;
+    list_for_each(node, &q->resolver->queries) {
+        hdns_t* f = list_entry(node, hdns_t, node);
+        if (f->leader == q) return 1;
+    }
+    return 0;
+}
+
+// Stale-while-revalidate: a background query of the same key, without a
+// callback, refreshes the cache entry q was just served from.
+static void hdns__refresh(hdns_t* q) {
+    if (hdns__find_leader(q)) return;
+    hdns_t* rq = hdns__query_new(q->resolver, q->host, &q->opt, NULL, NULL);
+    if (rq) hdns__query_start(rq);
+}
+
+hdns_t* hdns_resolve_ex(hloop_t* loop, const char* host,
+                        const hdns_setting_t* opt,
+                        hdns_cb cb, void* userdata) {
+    if (!loop || !host || !cb) return NULL;
+    size_t hlen = strlen(host);
+    if (hlen == 0 || hlen >= HDNS_NAME_MAXLEN) return NULL;
+
+    hdns_resolver_t* r = hdns__resolver_get(loop);
+    if (!r) return NULL;
+
+    hdns_t* q = hdns__query_new(r, host, opt, cb, userdata);
+    if (!q) return NULL;
 
     // NOTE: htimer_add(loop, cb, 1, 1) below never returns NULL (timeout_ms>0),
     // so completion is always deferred to the next loop tick and this function
@@ -965,44 +1444,27 @@ hdns_t* hdns_resolve_ex(hloop_t* loop, const char* host,
     }
 
     if (q->opt.use_cache) {
-        hdns_cache_entry_t* ce = hdns__cache_find(r, host, q->opt.family);
-        if (ce) {
-            if (ce->negative) {
-                q->any_error = HDNS_STATUS_NXDOMAIN;
-            } else {
-                q->naddrs = ce->naddrs;
-                memcpy(q->addrs, ce->addrs, ce->naddrs * sizeof(sockaddr_u));
+        int cached = hdns__cache_get(q);
+        if (cached != HDNS_CACHE_MISS) {
+            if (cached == HDNS_CACHE_REFRESH) {
+                hdns__refresh(q);
             }
             hdns__defer_complete(q);
             return q;
         }
     }
 
-    // 3) network query: assign sub-queries + txids, and start on the next loop
-    //    tick so this function returns the handle before any send/callback.
-    //    A per-resolver monotonic 16-bit counter (base, base+1 for A/AAAA) is
-    //    used for demuxing responses. NOTE: after 65536 it wraps and could in
-    //    theory collide with a still-in-flight query, but that would require
-    //    tens of thousands of resolves on one loop with an old query still
-    //    pending -- it does not happen in practice, so we keep this simple.
-    uint16_t base = r->next_txid;
-    r->next_txid += 2; // A uses base, AAAA uses base+1
-    if (q->opt.family & HDNS_QUERY_A) {
-        q->sub[0].qtype = HDNS_TYPE_A;
-        q->sub[0].txid = base;
-    }
-    if (q->opt.family & HDNS_QUERY_AAAA) {
-        q->sub[1].qtype = HDNS_TYPE_AAAA;
-        q->sub[1].txid = (uint16_t)(base + 1);
-    }
-    // Start the network query on the next loop tick so this function returns
-    // the handle before anything is sent (see the re-entrancy guarantee).
-    // htimer_add(timeout_ms=1) does not return NULL; on the unreachable
-    // alloc-failure path the query stays registered and is cleaned at teardown.
-    q->defer_timer = htimer_add(loop, hdns__on_start, 1, 1);
-    if (q->defer_timer) {
-        hevent_set_userdata(q->defer_timer, q);
+    // 3) the same query in flight: wait for its result instead of sending
+    //    another one. NOTE: settled by the leader's timeout and retries.
+    hdns_t* leader = hdns__find_leader(q);
+    if (leader) {
+        q->leader = leader;
+        hdns__cache_coalesced(q->host, q->opt.family);
+        return q;
     }
+
+    // 4) network query
+    hdns__query_start(q);
     return q;
 }
 
@@ -1011,6 +1473,24 @@ hdns_t* hdns_resolve(hloop_t* loop, const char* host,
     return hdns_resolve_ex(loop, host, NULL, cb, userdata);
 }
 
+hdns_t* hdns_resolve_srv(hloop_t* loop, const char* name,
+                         const hdns_setting_t* opt,
+                         hdns_srv_cb cb, void* userdata) {
+    if (!loop || !name || !cb) return NULL;
+    size_t nlen = strlen(name);
+    if (nlen == 0 || nlen >= HDNS_NAME_MAXLEN) return NULL;
+
+    hdns_resolver_t* r = hdns__resolver_get(loop);
+    if (!r) return NULL;
+
+    hdns_t* q = hdns__query_new(r, name, opt, NULL, userdata);
+    if (!q) return NULL;
+    q->srv_cb = cb;
+    // not from hosts, not cached: always a network query
+    hdns__query_start(q);
+    return q;
+}
+
 void hdns_cancel(hdns_t* q) {
     if (!q) return;
     // Fail-safe against the forbidden re-entrant case: if q is currently being
@@ -1018,8 +1498,15 @@ void hdns_cancel(hdns_t* q) {
     // will free it right after the callback returns, so do nothing here to
     // avoid a double-free.
     if (q->delivering) return;
+    // queries coalesced into q wait for its result: run it to completion
+    // without a callback, see hdns__deliver.
+    if (hdns__is_network(q) && hdns__has_followers(q)) {
+        q->detached = 1;
+        return;
+    }
     if (q->node.next) list_del(&q->node);
     if (q->timer) { htimer_del(q->timer); q->timer = NULL; }
     if (q->defer_timer) { htimer_del(q->defer_timer); q->defer_timer = NULL; }
-    HV_FREE(q);
+    hdns__close_tcp(q);
+    hdns__free(q);
 }
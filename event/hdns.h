@@ -4,16 +4,18 @@
 /*
  * Asynchronous DNS resolver.
  *
- * A self-contained, non-blocking, native UDP DNS resolver that runs entirely
+ * A self-contained, non-blocking, native DNS resolver that runs entirely
  * inside the hloop event loop. Unlike the blocking getaddrinfo() used by
  * ResolveAddr(), hdns_resolve() never stalls the event loop: DNS queries are
- * sent over a non-blocking UDP socket and results are delivered through a
- * callback in the loop thread.
+ * sent over a non-blocking UDP socket (TCP for truncated answers) and results
+ * are delivered through a callback in the loop thread.
  *
  * NOTE: This is independent from protocol/dns.h (which is a synchronous demo).
  *
  * Features:
- *   - Async A (IPv4) / AAAA (IPv6) queries.
+ *   - Async A (IPv4) / AAAA (IPv6) queries, SRV queries (hdns_resolve_srv).
+ *   - EDNS0 with a UDP payload size of 1232; a truncated (TC) answer is asked
+ *     again over TCP to the same nameserver, a FORMERR again without EDNS0.
  *   - Reads nameservers from /etc/resolv.conf (Unix) or GetAdaptersAddresses (Windows),
  *     falling back to 8.8.8.8.
  *   - Loads /etc/hosts and answers from it before querying the network.
@@ -23,7 +25,9 @@
  *     the answer section; CNAMEs are not chased client-side, relying on the
  *     recursive nameserver to include the final A/AAAA records (as recursive
  *     resolvers do). Non-recursive / CNAME-only responses are not followed.
- *   - TTL-respecting per-loop cache (positive + negative).
+ *   - TTL-respecting cache (positive + negative), shared by all loops of the
+ *     process, refreshed in the background before it expires.
+ *   - Identical queries in flight on a loop are sent once.
  *   - Cancelable query handle.
  *
  * @see examples/host.c
@@ -38,7 +42,8 @@
 #define HDNS_DEFAULT_TIMEOUT_MS     5000
 #define HDNS_DEFAULT_RETRIES        2       // total attempts = retries + 1
 #define HDNS_FALLBACK_NAMESERVER    "8.8.8.8"
-#define HDNS_MAX_ADDRS              16
+#define HDNS_MAX_ADDRS              64
+#define HDNS_MAX_SRVS               1024
 #define HDNS_NAME_MAXLEN           256
 
 // hdns_result_t.status codes (0 = success, negative = failure)
@@ -76,6 +81,14 @@ typedef struct hdns_setting_s {
 #endif
 } hdns_setting_t;
 
+typedef struct hdns_cache_stats_s {
+    uint64_t    hits;           // including stale_hits
+    uint64_t    stale_hits;     // served while refreshing, before expiry
+    uint64_t    misses;
+    uint64_t    coalesced;      // waited for the same query in flight
+    int         entries;
+} hdns_cache_stats_t;
+
 typedef struct hdns_result_s {
     int         status;                     // 0:ok  <0:herr code
     char        host[HDNS_NAME_MAXLEN];     // queried name
@@ -83,6 +96,20 @@ typedef struct hdns_result_s {
     sockaddr_u  addrs[HDNS_MAX_ADDRS];      // A/AAAA merged (IPv4 first), port = 0
 } hdns_result_t;
 
+typedef struct hdns_srv_s {
+    uint16_t    priority;
+    uint16_t    weight;
+    uint16_t    port;
+    char        target[HDNS_NAME_MAXLEN];   // "" if the service is not available
+} hdns_srv_t;
+
+typedef struct hdns_srv_result_s {
+    int         status;                     // 0:ok  <0:herr code
+    char        name[HDNS_NAME_MAXLEN];     // queried name, e.g. _http._tcp.example.com
+    int         nsrvs;
+    hdns_srv_t* srvs;                       // sorted by priority, then weight descending
+} hdns_srv_result_t;
+
 // Cancelable query handle.
 //
 // hdns_t is an event object (subclass of hevent_t, like htimer_t / hio_t), so
@@ -103,6 +130,7 @@ typedef struct hdns_s hdns_t;
  * @result:   only valid during the callback.
  */
 typedef void (*hdns_cb)(hdns_t* query, const hdns_result_t* result, void* userdata);
+typedef void (*hdns_srv_cb)(hdns_t* query, const hdns_srv_result_t* result, void* userdata);
 
 BEGIN_EXTERN_C
 
@@ -123,6 +151,15 @@ HV_EXPORT hdns_t* hdns_resolve_ex(hloop_t* loop, const char* host,
                                   const hdns_setting_t* opt,
                                   hdns_cb cb, void* userdata);
 
+/*
+ * Start an asynchronous SRV query of @name, like hdns_resolve_ex.
+ * The targets are not resolved, use hdns_resolve for them.
+ * NOTE: opt->family and opt->use_cache are ignored, SRV answers are not cached.
+ */
+HV_EXPORT hdns_t* hdns_resolve_srv(hloop_t* loop, const char* name,
+                                   const hdns_setting_t* opt,
+                                   hdns_srv_cb cb, void* userdata);
+
 /*
  * Cancel an in-flight query and free it immediately. After this returns, @cb
  * will NOT be called and @query is invalid. MUST be called from the loop
@@ -130,9 +167,13 @@ HV_EXPORT hdns_t* hdns_resolve_ex(hloop_t* loop, const char* host,
  */
 HV_EXPORT void hdns_cancel(hdns_t* query);
 
-// Clear the per-loop DNS cache (e.g. on a network change). Loop-thread only.
+// Clear the process-wide DNS cache (e.g. on a network change).
+// Thread-safe, @loop is unused.
 HV_EXPORT void hdns_clear_cache(hloop_t* loop);
 
+// Counters of the process-wide DNS cache since start. Thread-safe.
+HV_EXPORT void hdns_cache_stats(hdns_cache_stats_t* stats);
+
 END_EXTERN_C
 
 #endif // HV_DNS_ASYNC_H_
@@ -5,6 +5,7 @@
 #include "herr.h"
 
 #include "unpack.h"
+#include "hdns.h"
 
 uint64_t hloop_next_event_id() {
     static hatomic_t s_id = HATOMIC_VAR_INIT(0);
@@ -89,6 +90,7 @@ void hio_ready(hio_t* io) {
     io->recv = io->send = 0;
     io->recvfrom = io->sendto = 0;
     io->close = 0;
+    io->migrating = 0;
     // public:
     io->id = hio_next_id();
     io->io_type = HIO_TYPE_UNKNOWN;
@@ -106,6 +108,7 @@ void hio_ready(hio_t* io) {
     // write_queue
     io->write_bufsize = 0;
     io->max_write_bufsize = MAX_WRITE_BUFSIZE;
+    io->write_filesize = 0;
     // callbacks
     io->read_cb = NULL;
     io->write_cb = NULL;
@@ -134,7 +137,12 @@ void hio_ready(hio_t* io) {
     io->ssl = NULL;
     io->ssl_ctx = NULL;
     io->alloced_ssl_ctx = 0;
+    io->ktls_send = 0;
     io->hostname = NULL;
+    // async dns
+    io->connect_host = NULL;
+    io->connect_port = 0;
+    io->dns_query = NULL;
     // context
     io->ctx = NULL;
     // private:
@@ -144,6 +152,10 @@ void hio_ready(hio_t* io) {
 #ifdef EVENT_IOCP
     io->hovlp = NULL;
 #endif
+#ifdef EVENT_IO_URING
+    io->uring_mode = 0;
+    io->uring_rop = io->uring_wop = NULL;
+#endif
 
     // io_type
     fill_io_type(io);
@@ -164,15 +176,26 @@ void hio_done(hio_t* io) {
 
     hio_del(io, HV_RDWR);
 
+#ifdef EVENT_IO_URING
+    iouring_cancel(io);
+#endif
+
+    // async dns of hio_connect
+    if (io->dns_query) {
+        hdns_cancel((hdns_t*)io->dns_query);
+        io->dns_query = NULL;
+    }
+    SAFE_FREE(io->connect_host);
+
     // readbuf
     hio_free_readbuf(io);
 
     // write_queue
-    offset_buf_t* pbuf = NULL;
+    hio_wbuf_t* pbuf = NULL;
     hrecursive_mutex_lock(&io->write_mutex);
     while (!write_queue_empty(&io->write_queue)) {
         pbuf = write_queue_front(&io->write_queue);
-        HV_FREE(pbuf->base);
+        hio_wbuf_free(pbuf);
         write_queue_pop_front(&io->write_queue);
     }
     write_queue_cleanup(&io->write_queue);
@@ -582,7 +605,7 @@ void hio_set_read_timeout(hio_t* io, int timeout_ms) {
         htimer_reset(io->read_timer, timeout_ms);
     } else {
         // add
-        io->read_timer = htimer_add(io->loop, __read_timeout_cb, timeout_ms, 1);
+        io->read_timer = htimer_add_coarse(io->loop, __read_timeout_cb, timeout_ms, 1);
         io->read_timer->privdata = io;
     }
     io->read_timeout = timeout_ms;
@@ -618,7 +641,7 @@ void hio_set_write_timeout(hio_t* io, int timeout_ms) {
         htimer_reset(io->write_timer, timeout_ms);
     } else {
         // add
-        io->write_timer = htimer_add(io->loop, __write_timeout_cb, timeout_ms, 1);
+        io->write_timer = htimer_add_coarse(io->loop, __write_timeout_cb, timeout_ms, 1);
         io->write_timer->privdata = io;
     }
     io->write_timeout = timeout_ms;
@@ -655,7 +678,7 @@ void hio_set_keepalive_timeout(hio_t* io, int timeout_ms) {
         htimer_reset(io->keepalive_timer, timeout_ms);
     } else {
         // add
-        io->keepalive_timer = htimer_add(io->loop, __keepalive_timeout_cb, timeout_ms, 1);
+        io->keepalive_timer = htimer_add_coarse(io->loop, __keepalive_timeout_cb, timeout_ms, 1);
         io->keepalive_timer->privdata = io;
     }
     io->keepalive_timeout = timeout_ms;
@@ -680,7 +703,7 @@ void hio_set_heartbeat(hio_t* io, int interval_ms, hio_send_heartbeat_fn fn) {
         htimer_reset(io->heartbeat_timer, interval_ms);
     } else {
         // add
-        io->heartbeat_timer = htimer_add(io->loop, __heartbeat_timer_cb, interval_ms, INFINITE);
+        io->heartbeat_timer = htimer_add_coarse(io->loop, __heartbeat_timer_cb, interval_ms, INFINITE);
         io->heartbeat_timer->privdata = io;
     }
     io->heartbeat_interval = interval_ms;
@@ -752,7 +775,7 @@ void hio_set_max_write_bufsize(hio_t* io, uint32_t size) {
 }
 
 size_t hio_write_bufsize(hio_t* io) {
-    return io->write_bufsize;
+    return io->write_bufsize + io->write_filesize;
 }
 
 int hio_read_once (hio_t* io) {
@@ -11,6 +11,7 @@
 #include "array.h"
 #include "list.h"
 #include "heap.h"
+#include "timewheel.h"
 #include "queue.h"
 
 #define HLOOP_READ_BUFSIZE          8192        // 8K
@@ -55,6 +56,7 @@ struct hloop_s {
     // timers
     struct heap                 timers;     // monotonic time
     struct heap                 realtimers; // realtime
+    struct timewheel            timerwheel; // coarse, tick is HTIMER_COARSE_TICK
     uint32_t                    ntimers;
     // ios: with fd as array.index
     struct io_array             ios;
@@ -68,6 +70,8 @@ struct hloop_s {
     hmutex_t                    custom_events_mutex;
     // async dns resolver (event/hdns.c), created lazily, freed in hloop_cleanup
     void*                       dns_resolver;
+    // for hloop_stats, busy_time is always recorded
+    hloop_stats_t               stats;
 };
 
 uint64_t hloop_next_event_id();
@@ -95,6 +99,9 @@ struct htimer_s {
 struct htimeout_s {
     HTIMER_FIELDS
     uint32_t    timeout;                \
+    // coarse timer is in loop->timerwheel instead of loop->timers, see htimer_add_coarse
+    unsigned    coarse  :1;
+    struct timewheel_node wheel_node;
 };
 
 struct hperiod_s {
@@ -106,7 +113,32 @@ struct hperiod_s {
     int8_t      month;
 };
 
-QUEUE_DECL(offset_buf_t, write_queue);
+// write_queue element
+typedef struct hio_wbuf_s {
+    char*       base;   // NULL means file segment [offset, len) of fd
+    size_t      len;
+    size_t      offset;
+    // for hio_write_owned, NULL means HV_FREE(base)
+    hfree_cb    free_cb;
+    void*       userdata;
+    // for hio_sendfile, dup of caller's fd, -1 otherwise
+    int         fd;
+} hio_wbuf_t;
+QUEUE_DECL(hio_wbuf_t, write_queue);
+
+#define hio_wbuf_is_file(wbuf)  ((wbuf)->base == NULL && (wbuf)->fd >= 0)
+
+static inline void hio_wbuf_free(hio_wbuf_t* wbuf) {
+    if (wbuf->free_cb) {
+        wbuf->free_cb(wbuf->base, wbuf->userdata);
+        wbuf->base = NULL;
+    } else if (hio_wbuf_is_file(wbuf)) {
+        close(wbuf->fd);
+        wbuf->fd = -1;
+    } else {
+        HV_FREE(wbuf->base);
+    }
+}
 // sizeof(struct hio_s)=416 on linux-x64
 struct hio_s {
     HEVENT_FIELDS
@@ -124,6 +156,8 @@ struct hio_s {
     unsigned    close       :1;
     unsigned    alloced_readbuf :1; // for hio_alloc_readbuf
     unsigned    alloced_ssl_ctx :1; // for hio_new_ssl_ctx
+    unsigned    ktls_send   :1; // records encrypted by kernel, see hssl_ktls_send
+    unsigned    migrating   :1; // for hio_migrate
 // public:
     hio_type_e  io_type;
     uint32_t    id; // fd cannot be used as unique identifier, so we provide an id
@@ -150,6 +184,8 @@ struct hio_s {
     hrecursive_mutex_t  write_mutex; // lock write and write_queue
     uint32_t            write_bufsize;
     uint32_t            max_write_bufsize;
+    // file segments queued by hio_sendfile, not limited by max_write_bufsize
+    uint64_t            write_filesize;
     // callbacks
     hread_cb    read_cb;
     hwrite_cb   write_cb;
@@ -178,6 +214,10 @@ struct hio_s {
     void*       ssl;        // for hio_set_ssl
     void*       ssl_ctx;    // for hio_set_ssl_ctx
     char*       hostname;   // for hssl_set_sni_hostname
+    // async dns
+    char*       connect_host;   // resolved by hio_connect, see hio_create_socket
+    int         connect_port;   // port of connect_host
+    void*       dns_query;      // hdns_t* in flight
     // context
     void*       ctx; // for hio_context / hio_set_context
 // private:
@@ -189,6 +229,12 @@ struct hio_s {
     void*       hovlp;          // for iocp/overlapio
 #endif
 
+#ifdef EVENT_IO_URING
+    unsigned    uring_mode :1;  // for io_uring completion-based io
+    void*       uring_rop;      // for IORING_OP_ACCEPT/IORING_OP_RECV
+    void*       uring_wop;      // for IORING_OP_CONNECT/IORING_OP_SEND
+#endif
+
 #if WITH_RUDP
     rudp_t          rudp;
 #if WITH_KCP
@@ -214,6 +260,9 @@ void hio_done(hio_t* io);
 void hio_free(hio_t* io);
 uint32_t hio_next_id();
 
+// the cb of io events, dispatches to accept/connect/read/write by revents
+void hio_handle_events(hio_t* io);
+
 void hio_accept_cb(hio_t* io);
 void hio_connect_cb(hio_t* io);
 void hio_handle_read(hio_t* io, void* buf, int readbytes);
@@ -247,9 +296,22 @@ void hio_alloc_readbuf(hio_t* io, int len);
 void hio_free_readbuf(hio_t* io);
 void hio_memmove_readbuf(hio_t* io);
 
+#ifdef EVENT_IO_URING
+// io_uring completion-based io for plain tcp, @see event/io_uring.c
+// @return 1 if io will use IORING_OP_ACCEPT/CONNECT/RECV/SEND instead of poll.
+int  iouring_enable(hio_t* io);
+// take ownership of wbuf, queue it for IORING_OP_SEND.
+// @return 0 if queued, written bytes are reported by hwrite_cb on completion.
+int  iouring_write(hio_t* io, hio_wbuf_t* wbuf);
+void iouring_handle_events(hio_t* io);
+// cancel in-flight ops when hio_done, ops own their buffers until cqe reaped.
+void iouring_cancel(hio_t* io);
+#endif
+
 #define EVENT_ENTRY(p)          container_of(p, hevent_t, pending_node)
 #define IDLE_ENTRY(p)           container_of(p, hidle_t,  node)
 #define TIMER_ENTRY(p)          container_of(p, htimer_t, node)
+#define COARSE_TIMER_ENTRY(p)   container_of(p, htimeout_t, wheel_node)
 
 #define EVENT_ACTIVE(ev) \
     if (!ev->active) {\
@@ -20,6 +20,7 @@
 
 #define IO_ARRAY_INIT_SIZE              1024
 #define CUSTOM_EVENT_QUEUE_INIT_SIZE    16
+#define CUSTOM_EVENT_BATCH_SIZE         64
 
 #define EVENTFDS_READ_INDEX     0
 #define EVENTFDS_WRITE_INDEX    1
@@ -31,6 +32,41 @@ static int timers_compare(const struct heap_node* lhs, const struct heap_node* r
     return TIMER_ENTRY(lhs)->next_timeout < TIMER_ENTRY(rhs)->next_timeout;
 }
 
+#define HLOOP_STATS_ENABLED(loop) ((loop)->flags & HLOOP_FLAG_STATS)
+
+static void hloop_stats_cb(hloop_t* loop, hevent_t* ev, hevent_cb cb, uint64_t begin_hrtime) {
+    hloop_stats_t* stats = &loop->stats;
+    uint64_t cb_time = gethrtime_us() - begin_hrtime;
+    ++stats->ncbs;
+    stats->cb_time += cb_time;
+    if (cb_time > stats->max_cb_time) {
+        stats->max_cb_time = cb_time;
+        stats->max_cb = cb;
+        stats->max_cb_type = ev->event_type;
+        stats->max_cb_fd = ev->event_type == HEVENT_TYPE_IO ? ((hio_t*)ev)->fd : -1;
+    }
+}
+
+// NOTE: hio_handle_events dispatches to the user callback of the ready event, record that one.
+static hevent_cb hio_stats_cb(hio_t* io) {
+    hevent_cb cb = NULL;
+    if (io->revents & HV_READ) {
+        cb = io->accept ? (hevent_cb)(void*)io->accept_cb : (hevent_cb)(void*)io->read_cb;
+    } else if (io->revents & HV_WRITE) {
+        cb = io->connect ? (hevent_cb)(void*)io->connect_cb : (hevent_cb)(void*)io->write_cb;
+    }
+    return cb ? cb : io->cb;
+}
+
+static void hloop_stats_timer(hloop_t* loop, uint64_t lateness) {
+    hloop_stats_t* stats = &loop->stats;
+    ++stats->ntimers;
+    stats->timer_lateness += lateness;
+    if (lateness > stats->max_timer_lateness) {
+        stats->max_timer_lateness = lateness;
+    }
+}
+
 static int hloop_process_idles(hloop_t* loop) {
     int nidles = 0;
     struct list_node* node = loop->idles.next;
@@ -61,6 +97,9 @@ static int __hloop_process_timers(struct heap* timers, uint64_t timeout) {
         if (timer->next_timeout > timeout) {
             break;
         }
+        if (HLOOP_STATS_ENABLED(timer->loop)) {
+            hloop_stats_timer(timer->loop, timeout - timer->next_timeout);
+        }
         if (timer->repeat != INFINITE) {
             --timer->repeat;
         }
@@ -90,10 +129,48 @@ static int __hloop_process_timers(struct heap* timers, uint64_t timeout) {
     return ntimers;
 }
 
+#define COARSE_TICK_US          (HTIMER_COARSE_TICK * 1000)
+
+static void __htimer_add_coarse(hloop_t* loop, htimeout_t* timer) {
+    timer->wheel_node.expire = (timer->next_timeout + COARSE_TICK_US - 1) / COARSE_TICK_US;
+    timewheel_add(&loop->timerwheel, &timer->wheel_node);
+}
+
+static int __hloop_process_coarse_timers(hloop_t* loop) {
+    struct list_head expired;
+    list_init(&expired);
+    int ntimers = timewheel_advance(&loop->timerwheel, loop->cur_hrtime / COARSE_TICK_US, &expired);
+    htimeout_t* timer = NULL;
+    while (!list_empty(&expired)) {
+        timer = COARSE_TIMER_ENTRY(expired.next);
+        list_del_init(&timer->wheel_node.list);
+        if (HLOOP_STATS_ENABLED(loop)) {
+            hloop_stats_timer(loop, loop->cur_hrtime > timer->next_timeout ? loop->cur_hrtime - timer->next_timeout : 0);
+        }
+        if (timer->repeat != INFINITE) {
+            --timer->repeat;
+        }
+        if (timer->repeat == 0) {
+            // NOTE: Just mark it as destroy, it has been removed from timerwheel.
+            // Real deletion occurs after hloop_process_pendings.
+            __htimer_del((htimer_t*)timer);
+        }
+        else {
+            while (timer->next_timeout <= loop->cur_hrtime) {
+                timer->next_timeout += (uint64_t)timer->timeout * 1000;
+            }
+            __htimer_add_coarse(loop, timer);
+        }
+        EVENT_PENDING(timer);
+    }
+    return ntimers;
+}
+
 static int hloop_process_timers(hloop_t* loop) {
     uint64_t now = hloop_now_us(loop);
     int ntimers = __hloop_process_timers(&loop->timers, loop->cur_hrtime);
     ntimers +=    __hloop_process_timers(&loop->realtimers, now);
+    ntimers +=    __hloop_process_coarse_timers(loop);
     return ntimers;
 }
 
@@ -119,7 +196,19 @@ static int hloop_process_pendings(hloop_t* loop) {
             next = cur->pending_next;
             if (cur->pending && cur->loop == loop) {
                 if (cur->active && cur->cb) {
-                    cur->cb(cur);
+                    // NOTE: custom events are recorded one by one in eventfd_read_cb
+                    if (HLOOP_STATS_ENABLED(loop) &&
+                        !(cur->event_type == HEVENT_TYPE_IO && ((hio_t*)cur)->fd == loop->eventfds[EVENTFDS_READ_INDEX])) {
+                        hevent_cb cb = cur->cb;
+                        if (cur->event_type == HEVENT_TYPE_IO && cb == (hevent_cb)hio_handle_events) {
+                            cb = hio_stats_cb((hio_t*)cur);
+                        }
+                        uint64_t begin_hrtime = gethrtime_us();
+                        cur->cb(cur);
+                        hloop_stats_cb(loop, cur, cb, begin_hrtime);
+                    } else {
+                        cur->cb(cur);
+                    }
                     ++ncbs;
                 }
                 cur->pending = 0;
@@ -141,6 +230,7 @@ int hloop_process_events(hloop_t* loop, int timeout_ms) {
     // ios -> timers -> idles
     int nios, ntimers, nidles;
     nios = ntimers = nidles = 0;
+    uint64_t busy_begin = 0, poll_begin = 0;
 
     // calc blocktime
     int32_t blocktime_ms = timeout_ms;
@@ -155,23 +245,36 @@ int hloop_process_events(hloop_t* loop, int timeout_ms) {
             int64_t min_timeout = TIMER_ENTRY(loop->realtimers.root)->next_timeout - hloop_now_us(loop);
             blocktime_us = MIN(blocktime_us, min_timeout);
         }
+        if (loop->timerwheel.nelts) {
+            uint64_t next_tick = loop->timerwheel.cur_tick + timewheel_next_ticks(&loop->timerwheel);
+            int64_t min_timeout = next_tick * COARSE_TICK_US - loop->cur_hrtime;
+            blocktime_us = MIN(blocktime_us, min_timeout);
+        }
         if (blocktime_us < 0) goto process_timers;
         blocktime_ms = blocktime_us / 1000 + 1;
         blocktime_ms = MIN(blocktime_ms, timeout_ms);
     }
 
+    if (HLOOP_STATS_ENABLED(loop)) {
+        poll_begin = gethrtime_us();
+    }
     if (loop->nios) {
         nios = hloop_process_ios(loop, blocktime_ms);
     } else {
         hv_msleep(blocktime_ms);
     }
     hloop_update_time(loop);
+    if (HLOOP_STATS_ENABLED(loop) && poll_begin) {
+        loop->stats.last_poll_time = loop->cur_hrtime - poll_begin;
+        loop->stats.poll_time += loop->stats.last_poll_time;
+    }
     // wakeup by hloop_stop
     if (loop->status == HLOOP_STATUS_STOP) {
         return 0;
     }
 
 process_timers:
+    busy_begin = loop->cur_hrtime;
     if (loop->ntimers) {
         ntimers = hloop_process_timers(loop);
     }
@@ -183,6 +286,7 @@ process_timers:
         }
     }
     int ncbs = hloop_process_pendings(loop);
+    loop->stats.busy_time += gethrtime_us() - busy_begin;
     // printd("blocktime=%d nios=%d/%u ntimers=%d/%u nidles=%d/%u nactives=%d npendings=%d ncbs=%d\n",
     //         blocktime, nios, loop->nios, ntimers, loop->ntimers, nidles, loop->nidles,
     //         loop->nactives, npendings, ncbs);
@@ -202,35 +306,43 @@ static void hloop_stat_timer_cb(htimer_t* timer) {
 }
 #endif
 
+// NOTE: eventfds is written only if custom_events was empty,
+// so handle all events here, popped in batches to lock less.
 static void eventfd_read_cb(hio_t* io, void* buf, int readbytes) {
     hloop_t* loop = io->loop;
-    hevent_t* pev = NULL;
-    hevent_t ev;
-    uint64_t count = readbytes;
-#if defined(OS_UNIX) && HAVE_EVENTFD
-    assert(readbytes == sizeof(count));
-    count = *(uint64_t*)buf;
-#endif
-    for (uint64_t i = 0; i < count; ++i) {
+    hevent_t events[CUSTOM_EVENT_BATCH_SIZE];
+    int nevents = 0;
+    bool first = true;
+    (void)buf;
+    (void)readbytes;
+    do {
+        nevents = 0;
         hmutex_lock(&loop->custom_events_mutex);
-        if (event_queue_empty(&loop->custom_events)) {
-            goto unlock;
+        if (first && HLOOP_STATS_ENABLED(loop)) {
+            uint32_t depth = event_queue_size(&loop->custom_events);
+            if (depth > loop->stats.max_custom_events) {
+                loop->stats.max_custom_events = depth;
+            }
         }
-        pev = event_queue_front(&loop->custom_events);
-        if (pev == NULL) {
-            goto unlock;
+        first = false;
+        while (nevents < CUSTOM_EVENT_BATCH_SIZE && !event_queue_empty(&loop->custom_events)) {
+            events[nevents++] = *event_queue_front(&loop->custom_events);
+            event_queue_pop_front(&loop->custom_events);
         }
-        ev = *pev;
-        event_queue_pop_front(&loop->custom_events);
         // NOTE: unlock before cb, avoid deadlock if hloop_post_event called in cb.
         hmutex_unlock(&loop->custom_events_mutex);
-        if (ev.cb) {
-            ev.cb(&ev);
+        for (int i = 0; i < nevents; ++i) {
+            hevent_t* ev = &events[i];
+            if (ev->cb == NULL) continue;
+            if (HLOOP_STATS_ENABLED(loop)) {
+                uint64_t begin_hrtime = gethrtime_us();
+                ev->cb(ev);
+                hloop_stats_cb(loop, ev, ev->cb, begin_hrtime);
+            } else {
+                ev->cb(ev);
+            }
         }
-    }
-    return;
-unlock:
-    hmutex_unlock(&loop->custom_events_mutex);
+    } while (nevents == CUSTOM_EVENT_BATCH_SIZE);
 }
 
 static int hloop_create_eventfds(hloop_t* loop) {
@@ -292,16 +404,19 @@ void hloop_post_event(hloop_t* loop, hevent_t* ev) {
             goto unlock;
         }
     }
+    // NOTE: wakeup only if queue is empty, events behind are handled together.
+    if (event_queue_empty(&loop->custom_events)) {
 #if defined(OS_UNIX) && HAVE_EVENTFD
-    nwrite = write(loop->eventfds[EVENTFDS_WRITE_INDEX], &count, sizeof(count));
+        nwrite = write(loop->eventfds[EVENTFDS_WRITE_INDEX], &count, sizeof(count));
 #elif defined(OS_UNIX) && HAVE_PIPE
-    nwrite = write(loop->eventfds[EVENTFDS_WRITE_INDEX], "e", 1);
+        nwrite = write(loop->eventfds[EVENTFDS_WRITE_INDEX], "e", 1);
 #else
-    nwrite =  send(loop->eventfds[EVENTFDS_WRITE_INDEX], "e", 1, 0);
+        nwrite =  send(loop->eventfds[EVENTFDS_WRITE_INDEX], "e", 1, 0);
 #endif
-    if (nwrite <= 0) {
-        hloge("hloop_post_event failed!");
-        goto unlock;
+        if (nwrite <= 0) {
+            hloge("hloop_post_event failed!");
+            goto unlock;
+        }
     }
     if (loop->custom_events.maxsize == 0) {
         event_queue_init(&loop->custom_events, CUSTOM_EVENT_QUEUE_INIT_SIZE);
@@ -351,6 +466,10 @@ static void hloop_init(hloop_t* loop) {
     // NOTE: init start_time here, because htimer_add use it.
     loop->start_ms = gettimeofday_ms();
     loop->start_hrtime = loop->cur_hrtime = gethrtime_us();
+    timewheel_init(&loop->timerwheel, loop->cur_hrtime / COARSE_TICK_US);
+
+    // stats
+    loop->stats.max_cb_fd = -1;
 }
 
 static void hloop_cleanup(hloop_t* loop) {
@@ -360,11 +479,8 @@ static void hloop_cleanup(hloop_t* loop) {
         loop->pendings[i] = NULL;
     }
 
-    // async dns resolver
-    printd("cleanup dns_resolver...\n");
-    hdns_resolver_free(loop);
-
     // ios
+    // NOTE: ios resolving by hio_connect cancel their dns queries, before dns_resolver freed.
     printd("cleanup ios...\n");
     for (int i = 0; i < loop->ios.maxsize; ++i) {
         hio_t* io = loop->ios.ptr[i];
@@ -374,6 +490,10 @@ static void hloop_cleanup(hloop_t* loop) {
     }
     io_array_cleanup(&loop->ios);
 
+    // async dns resolver
+    printd("cleanup dns_resolver...\n");
+    hdns_resolver_free(loop);
+
     // idles
     printd("cleanup idles...\n");
     struct list_node* node = loop->idles.next;
@@ -400,6 +520,17 @@ static void hloop_cleanup(hloop_t* loop) {
         HV_FREE(timer);
     }
     heap_init(&loop->realtimers, NULL);
+    for (int level = 0; level < TIMEWHEEL_LEVELS; ++level) {
+        for (int idx = 0; idx < TIMEWHEEL_SLOTS; ++idx) {
+            struct list_head* slot = &loop->timerwheel.slots[level][idx];
+            while (!list_empty(slot)) {
+                timer = (htimer_t*)COARSE_TIMER_ENTRY(slot->next);
+                list_del(slot->next);
+                HV_FREE(timer);
+            }
+        }
+    }
+    timewheel_init(&loop->timerwheel, 0);
 
     // signals
     printd("cleanup signals...\n");
@@ -578,6 +709,33 @@ uint64_t hloop_count(hloop_t* loop) {
     return loop->loop_cnt;
 }
 
+uint64_t hloop_busy_time(hloop_t* loop) {
+    return loop->stats.busy_time;
+}
+
+void hloop_enable_stats(hloop_t* loop, bool on) {
+    if (on) {
+        loop->flags |= HLOOP_FLAG_STATS;
+    } else {
+        loop->flags &= ~HLOOP_FLAG_STATS;
+    }
+}
+
+void hloop_stats(hloop_t* loop, hloop_stats_t* stats) {
+    *stats = loop->stats;
+    stats->loop_cnt = loop->loop_cnt;
+    hmutex_lock(&loop->custom_events_mutex);
+    stats->custom_events = event_queue_size(&loop->custom_events);
+    hmutex_unlock(&loop->custom_events_mutex);
+}
+
+void hloop_reset_stats(hloop_t* loop) {
+    uint64_t busy_time = loop->stats.busy_time;
+    memset(&loop->stats, 0, sizeof(loop->stats));
+    loop->stats.busy_time = busy_time;
+    loop->stats.max_cb_fd = -1;
+}
+
 uint32_t hloop_nios(hloop_t* loop) {
     return loop->nios;
 }
@@ -696,6 +854,24 @@ htimer_t* htimer_add(hloop_t* loop, htimer_cb cb, uint32_t timeout_ms, uint32_t
     return (htimer_t*)timer;
 }
 
+htimer_t* htimer_add_coarse(hloop_t* loop, htimer_cb cb, uint32_t timeout_ms, uint32_t repeat) {
+    if (timeout_ms == 0)   return NULL;
+    htimeout_t* timer;
+    HV_ALLOC_SIZEOF(timer);
+    timer->event_type = HEVENT_TYPE_TIMEOUT;
+    timer->priority = HEVENT_HIGHEST_PRIORITY;
+    timer->repeat = repeat;
+    timer->timeout = timeout_ms;
+    timer->coarse = 1;
+    // NOTE: no hloop_update_time, cur_hrtime is precise enough.
+    timer->next_timeout = loop->cur_hrtime + (uint64_t)timeout_ms * 1000;
+    timewheel_node_init(&timer->wheel_node);
+    __htimer_add_coarse(loop, timer);
+    EVENT_ADD(loop, timer, cb);
+    loop->ntimers++;
+    return (htimer_t*)timer;
+}
+
 void htimer_reset(htimer_t* timer, uint32_t timeout_ms) {
     if (timer->event_type != HEVENT_TYPE_TIMEOUT) {
         return;
@@ -704,6 +880,8 @@ void htimer_reset(htimer_t* timer, uint32_t timeout_ms) {
     htimeout_t* timeout = (htimeout_t*)timer;
     if (timer->destroy) {
         loop->ntimers++;
+    } else if (timeout->coarse) {
+        timewheel_remove(&loop->timerwheel, &timeout->wheel_node);
     } else {
         heap_remove(&loop->timers, &timer->node);
     }
@@ -713,6 +891,12 @@ void htimer_reset(htimer_t* timer, uint32_t timeout_ms) {
     if (timeout_ms > 0) {
         timeout->timeout = timeout_ms;
     }
+    if (timeout->coarse) {
+        timer->next_timeout = loop->cur_hrtime + (uint64_t)timeout->timeout * 1000;
+        __htimer_add_coarse(loop, timeout);
+        EVENT_RESET(timer);
+        return;
+    }
     timer->next_timeout = loop->cur_hrtime + (uint64_t)timeout->timeout * 1000;
     // NOTE: Limit granularity to 100ms
     if (timeout->timeout >= 1000 && timeout->timeout % 100 == 0) {
@@ -748,7 +932,12 @@ htimer_t* htimer_add_period(hloop_t* loop, htimer_cb cb,
 static void __htimer_del(htimer_t* timer) {
     if (timer->destroy) return;
     if (timer->event_type == HEVENT_TYPE_TIMEOUT) {
-        heap_remove(&timer->loop->timers, &timer->node);
+        htimeout_t* timeout = (htimeout_t*)timer;
+        if (timeout->coarse) {
+            timewheel_remove(&timer->loop->timerwheel, &timeout->wheel_node);
+        } else {
+            heap_remove(&timer->loop->timers, &timer->node);
+        }
     } else if (timer->event_type == HEVENT_TYPE_PERIOD) {
         heap_remove(&timer->loop->realtimers, &timer->node);
     }
@@ -833,6 +1022,98 @@ void hio_attach(hloop_t* loop, hio_t* io) {
     loop->ios.ptr[fd] = io;
 }
 
+static void hio_migrate_event_cb(hevent_t* ev) {
+    hloop_t* loop = ev->loop;
+    hio_t* io = (hio_t*)ev->userdata;
+    int events = (int)(intptr_t)ev->privdata;
+    hrecursive_mutex_lock(&io->write_mutex);
+    hio_attach(loop, io);
+    io->migrating = 0;
+    if (io->closed) {
+        // closed in the new loop thread before attached
+        hrecursive_mutex_unlock(&io->write_mutex);
+        return;
+    }
+    if (io->readbuf.base == NULL) {
+        hio_use_loop_readbuf(io);
+    }
+    // NOTE: written by other threads while moving
+    if (!write_queue_empty(&io->write_queue)) {
+        events |= HV_WRITE;
+    }
+    if (events) {
+        hio_add(io, (hio_cb)io->cb, events);
+    }
+    hrecursive_mutex_unlock(&io->write_mutex);
+
+    if (io->read_timeout > 0) {
+        hio_set_read_timeout(io, io->read_timeout);
+    }
+    if (io->write_timeout > 0) {
+        hio_set_write_timeout(io, io->write_timeout);
+    }
+    if (io->keepalive_timeout > 0) {
+        hio_set_keepalive_timeout(io, io->keepalive_timeout);
+    }
+    if (io->heartbeat_interval > 0) {
+        hio_set_heartbeat(io, io->heartbeat_interval, io->heartbeat_fn);
+    }
+}
+
+int hio_migrate(hio_t* io, hloop_t* loop) {
+    if (io->loop == loop) return 0;
+#if defined(EVENT_IOCP)
+    return -1;
+#else
+    // NOTE: pending io is still linked in loop->pendings, wait for next time.
+    if (!(io->io_type & HIO_TYPE_SOCK_STREAM) || io->pending ||
+        !io->ready || io->closed || io->close || io->migrating ||
+        io->connect_timer || io->close_timer || io->upstream_io ||
+        io->readbuf.tail != io->readbuf.head) {
+        return -1;
+    }
+#ifdef EVENT_IO_URING
+    if (io->uring_mode) return -1;
+#endif
+    assert(hv_gettid() == io->loop->tid);
+
+    hrecursive_mutex_lock(&io->write_mutex);
+    if (!write_queue_empty(&io->write_queue)) {
+        hrecursive_mutex_unlock(&io->write_mutex);
+        return -1;
+    }
+    int events = io->events;
+    hio_del(io, HV_RDWR);
+    // NOTE: keep timeouts, timers are added again in the new loop.
+    htimer_t** timers[] = { &io->read_timer, &io->write_timer, &io->keepalive_timer, &io->heartbeat_timer };
+    for (size_t i = 0; i < ARRAY_SIZE(timers); ++i) {
+        if (*timers[i]) {
+            htimer_del(*timers[i]);
+            *timers[i] = NULL;
+        }
+    }
+    if (hio_is_loop_readbuf(io)) {
+        io->readbuf.base = NULL;
+        io->readbuf.len = 0;
+    }
+    hio_detach(io);
+    // NOTE: From now on, hio_close and hio_write from any thread go to the new loop,
+    // write_queue is not watched until hio_migrate_event_cb.
+    io->migrating = 1;
+    io->loop = loop;
+
+    hevent_t ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.loop = loop;
+    ev.cb = hio_migrate_event_cb;
+    ev.userdata = io;
+    ev.privdata = (void*)(intptr_t)events;
+    hloop_post_event(loop, &ev);
+    hrecursive_mutex_unlock(&io->write_mutex);
+    return 0;
+#endif
+}
+
 bool hio_exists(hloop_t* loop, int fd) {
     if (fd >= loop->ios.maxsize) {
         return false;
@@ -1007,14 +1288,28 @@ hio_t* hio_create_socket(hloop_t* loop, const char* host, int port, hio_type_e t
     if (sock_type == -1) return NULL;
     sockaddr_u addr;
     memset(&addr, 0, sizeof(addr));
-    int ret = sockaddr_set_ipport(&addr, host, port);
-    if (ret != 0) {
-        // fprintf(stderr, "unknown host: %s\n", host);
-        return NULL;
+    char* connect_host = NULL;
+#ifdef OS_UNIX
+    // NOTE: hostname of client is resolved by hdns in hio_connect, not to block the loop,
+    // the socket is AF_INET, replaced by dup2 if resolved to ipv6 only,
+    // peeraddr is AF_UNSPEC until resolved.
+    if (side == HIO_CLIENT_SIDE && sock_type == SOCK_STREAM &&
+        host && *host && port >= 0 && !is_ipaddr(host)) {
+        connect_host = strdup(host);
+        if (connect_host == NULL) return NULL;
+    }
+#endif
+    if (connect_host == NULL) {
+        int ret = sockaddr_set_ipport(&addr, host, port);
+        if (ret != 0) {
+            // fprintf(stderr, "unknown host: %s\n", host);
+            return NULL;
+        }
     }
-    int sockfd = socket(addr.sa.sa_family, sock_type, 0);
+    int sockfd = socket(connect_host ? AF_INET : addr.sa.sa_family, sock_type, 0);
     if (sockfd < 0) {
         perror("socket");
+        SAFE_FREE(connect_host);
         return NULL;
     }
     hio_t* io = NULL;
@@ -1051,6 +1346,8 @@ hio_t* hio_create_socket(hloop_t* loop, const char* host, int port, hio_type_e t
         io->priority = HEVENT_HIGH_PRIORITY;
     } else {
         hio_set_peeraddr(io, &addr.sa, sockaddr_len(&addr));
+        io->connect_host = connect_host;
+        io->connect_port = port;
     }
     return io;
 }
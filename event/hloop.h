@@ -29,6 +29,8 @@ typedef void (*hconnect_cb) (hio_t* io);
 typedef void (*hread_cb)    (hio_t* io, void* buf, int readbytes);
 typedef void (*hwrite_cb)   (hio_t* io, const void* buf, int writebytes);
 typedef void (*hclose_cb)   (hio_t* io);
+// for hio_write_owned
+typedef void (*hfree_cb)    (void* buf, void* userdata);
 
 typedef enum {
     HLOOP_STATUS_STOP,
@@ -131,6 +133,7 @@ BEGIN_EXTERN_C
 #define HLOOP_FLAG_RUN_ONCE                     0x00000001
 #define HLOOP_FLAG_AUTO_FREE                    0x00000002
 #define HLOOP_FLAG_QUIT_WHEN_NO_ACTIVE_EVENTS   0x00000004
+#define HLOOP_FLAG_STATS                        0x00000008 // see hloop_stats
 HV_EXPORT hloop_t* hloop_new(int flags DEFAULT(HLOOP_FLAG_AUTO_FREE));
 
 // WARN: Forbid to call hloop_free if HLOOP_FLAG_AUTO_FREE set.
@@ -162,6 +165,37 @@ HV_EXPORT long hloop_pid(hloop_t* loop);
 HV_EXPORT long hloop_tid(hloop_t* loop);
 // @return count of loop
 HV_EXPORT uint64_t hloop_count(hloop_t* loop);
+// @return accumulated time (us) spent handling events, excluding time blocked in polling
+HV_EXPORT uint64_t hloop_busy_time(hloop_t* loop);
+
+typedef struct hloop_stats_s {
+    uint64_t        loop_cnt;
+    uint64_t        busy_time;          // us, see hloop_busy_time
+    // NOTE: fields below are recorded only if HLOOP_FLAG_STATS set
+    uint64_t        poll_time;          // us, time blocked in polling
+    uint64_t        last_poll_time;     // us, time blocked in the last polling
+    uint64_t        ncbs;               // number of invoked callbacks
+    uint64_t        cb_time;            // us, time of all callbacks
+    // the slowest callback
+    uint64_t        max_cb_time;        // us
+    // for io events, the haccept_cb, hconnect_cb, hread_cb or hwrite_cb of the ready event
+    hevent_cb       max_cb;
+    hevent_type_e   max_cb_type;
+    int             max_cb_fd;          // fd if max_cb_type == HEVENT_TYPE_IO, otherwise -1
+    // timers fired later than expected
+    uint64_t        ntimers;            // number of fired timers
+    uint64_t        timer_lateness;     // us, lateness of all fired timers
+    uint64_t        max_timer_lateness; // us
+    // custom events posted by hloop_post_event
+    uint32_t        custom_events;      // current depth of queue
+    uint32_t        max_custom_events;  // max depth of queue when handling
+} hloop_stats_t;
+// NOTE: enable by hloop_new(HLOOP_FLAG_STATS) or hloop_enable_stats,
+// hloop_stats can be called in any thread, but fields may be inconsistent with each other.
+HV_EXPORT void hloop_enable_stats(hloop_t* loop, bool on DEFAULT(true));
+HV_EXPORT void hloop_stats(hloop_t* loop, hloop_stats_t* stats);
+// NOTE: busy_time is not reset, it is used by load balancing.
+HV_EXPORT void hloop_reset_stats(hloop_t* loop);
 // @return number of ios
 HV_EXPORT uint32_t hloop_nios(hloop_t* loop);
 // @return number of timers
@@ -214,6 +248,12 @@ HV_EXPORT htimer_t* htimer_add_period(hloop_t* loop, htimer_cb cb,
 HV_EXPORT void htimer_del(htimer_t* timer);
 HV_EXPORT void htimer_reset(htimer_t* timer, uint32_t timeout_ms DEFAULT(0));
 
+// NOTE: coarse timer is kept in a hierarchical timing wheel with granularity of HTIMER_COARSE_TICK,
+// htimer_add_coarse, htimer_reset and htimer_del of it are O(1), it may be late by one tick.
+// It is used for massive timeouts such as read/write/keepalive timeouts of connections.
+#define HTIMER_COARSE_TICK  10 // ms
+HV_EXPORT htimer_t* htimer_add_coarse(hloop_t* loop, htimer_cb cb, uint32_t timeout_ms, uint32_t repeat DEFAULT(INFINITE));
+
 // io
 //-----------------------low-level apis---------------------------------------
 #define HV_READ  0x0001
@@ -268,6 +308,13 @@ void on_accpet(hio_t* io) {
  */
 HV_EXPORT void hio_detach(/*hloop_t* loop,*/ hio_t* io);
 HV_EXPORT void hio_attach(hloop_t* loop, hio_t* io);
+// NOTE: move a connected io to another loop, must be called in io's loop thread.
+// Only stream io idle between messages can be moved: no unread data in readbuf,
+// empty write_queue, not connecting/closing and no upstream.
+// Events and read/write/keepalive/heartbeat timers are restored in the new loop,
+// all callbacks of io will be called in the new loop thread afterwards.
+// @return 0: moving, -1: not movable now
+HV_EXPORT int  hio_migrate(hio_t* io, hloop_t* loop);
 HV_EXPORT bool hio_exists(hloop_t* loop, int fd);
 
 // hio_t fields
@@ -279,6 +326,7 @@ HV_EXPORT int hio_events  (hio_t* io);
 HV_EXPORT int hio_revents (hio_t* io);
 HV_EXPORT hio_type_e       hio_type     (hio_t* io);
 HV_EXPORT struct sockaddr* hio_localaddr(hio_t* io);
+// NOTE: peeraddr of a client created by hostname is AF_UNSPEC until resolved by hio_connect.
 HV_EXPORT struct sockaddr* hio_peeraddr (hio_t* io);
 HV_EXPORT void hio_set_context(hio_t* io, void* ctx);
 HV_EXPORT void* hio_context(hio_t* io);
@@ -377,8 +425,21 @@ HV_EXPORT int hio_read_remain(hio_t* io);
 
 // NOTE: hio_write is thread-safe, locked by recursive_mutex, allow to be called by other threads.
 // hio_try_write => hio_add(io, HV_WRITE) => write => hwrite_cb
+// @return bytes written at once, the queued rest is reported by hwrite_cb, -1 if failed.
+// With io_uring, all is queued and sent by IORING_OP_SEND, so 0 is returned.
 HV_EXPORT int hio_write  (hio_t* io, const void* buf, size_t len);
 HV_EXPORT int hio_sendto (hio_t* io, const void* buf, size_t len, struct sockaddr* addr);
+// NOTE: gather write, e.g. http header + body without concatenating them.
+// The unwritten part is copied into write queue, so iov can be freed after return.
+HV_EXPORT int hio_writev (hio_t* io, const struct iovec* iov, int iovcnt);
+// NOTE: take ownership of buf, the unwritten part is queued without copy.
+// buf is released by free_cb(buf, userdata) once written or failed, hv_free(buf) if free_cb is NULL.
+HV_EXPORT int hio_write_owned(hio_t* io, void* buf, size_t len, hfree_cb free_cb DEFAULT(NULL), void* userdata DEFAULT(NULL));
+// NOTE: queue [offset, offset + length) of file fd after the pending data, fd is duplicated so can be closed after return.
+// It is sent by sendfile(2) on linux tcp or ssl with ktls without copying into user space, otherwise read and write chunk by chunk.
+// hwrite_cb is called with buf=NULL for the file part, hio_write_bufsize counts it but max_write_bufsize does not limit it.
+// @return 0 if queued, -1 if failed, errno is ENOTSUP on windows.
+HV_EXPORT int hio_sendfile(hio_t* io, int fd, size_t offset, size_t length);
 
 // NOTE: hio_close is thread-safe, hio_close_async will be called actually in other thread.
 // hio_del(io, HV_RDWR) => close => hclose_cb
@@ -419,6 +480,8 @@ HV_EXPORT hio_t* hsendto   (hloop_t* loop, int sockfd, const void* buf, size_t l
 // sockaddr_set_ipport -> socket -> hio_get(loop, sockfd) ->
 // side == HIO_SERVER_SIDE ? bind ->
 // type & HIO_TYPE_SOCK_STREAM ? listen ->
+// NOTE: hostname of tcp/ssl client is resolved asynchronously by hio_connect on unix,
+// and resolve failure is reported by close_cb with hio_error == ERR_DNS_RESOLVE.
 HV_EXPORT hio_t* hio_create_socket(hloop_t* loop, const char* host, int port,
                             hio_type_e type DEFAULT(HIO_TYPE_TCP),
                             hio_side_e side DEFAULT(HIO_SERVER_SIDE));
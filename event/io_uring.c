@@ -4,19 +4,147 @@
 #include "hplatform.h"
 #include "hdef.h"
 #include "hevent.h"
+#include "hsocket.h"
+#include "hthread.h"
 #include "hlog.h"
+#include "herr.h"
 
 #include <liburing.h>
 #include <poll.h>
 
 #define IO_URING_ENTRIES    1024
 #define IO_URING_CANCEL_TAG ((void*)(uintptr_t)-1)
+// NOTE: poll requests use odd user_data (fd << 1 | 1),
+// completion ops use the address of iouring_op_t which is always even.
+#define IO_URING_POLL_TAG(fd)       ((void*)(((uintptr_t)(fd) << 1) | 1))
+#define IO_URING_IS_POLL_TAG(data)  (((uintptr_t)(data) & 1) != 0)
+#define IO_URING_POLL_FD(data)      ((int)((uintptr_t)(data) >> 1))
+
+/*
+ * completion-based io for plain tcp:
+ *
+ * hio_accept  => iowatcher_add_event(HV_READ)  => IORING_OP_ACCEPT
+ * hio_connect => iowatcher_add_event(HV_WRITE) => IORING_OP_CONNECT
+ * hio_read    => iowatcher_add_event(HV_READ)  => IORING_OP_RECV
+ * hio_write   => iouring_write => write_queue  => IORING_OP_SEND
+ * hio_sendfile=> iouring_write => write_queue  => pread + IORING_OP_SEND
+ *
+ * All sqes are submitted once per iowatcher_poll_events,
+ * cqes set io->revents and EVENT_PENDING(io) like other iowatchers,
+ * then hio_handle_events => iouring_handle_events => hread_cb/hwrite_cb.
+ *
+ * provided buffer ring (IORING_REGISTER_PBUF_RING, linux 5.19+):
+ * IORING_OP_RECV picks a buffer from the loop's ring only when data arrives,
+ * the buffer is lent to hread_cb and returned to the ring after the callback,
+ * so idle connections pin no read buffer at all.
+ *
+ * multishot accept/recv (linux 5.19+/6.0+):
+ * one sqe keeps producing cqes while IORING_CQE_F_MORE is set,
+ * cqes are queued in op->cqes and dispatched by iouring_handle_events.
+ * hio_read_stop cancels them, so a paused io holds no ring buffers.
+ */
+#if defined(IO_URING_VERSION_MAJOR) && \
+    (IO_URING_VERSION_MAJOR > 2 || (IO_URING_VERSION_MAJOR == 2 && IO_URING_VERSION_MINOR >= 4))
+#define IO_URING_PBUF_RING
+#endif
+
+#define IO_URING_PBUF_ENTRIES   512 // must be power of 2
+#define IO_URING_PBUF_BGID      0
+
+// file segment of hio_sendfile is read into op->buf and sent chunk by chunk.
+#define IO_URING_FILE_CHUNK     (1 << 16)   // 64K
+
+typedef struct iouring_cqe_s {
+    int         res;        // cqe->res
+    unsigned    flags;      // cqe->flags
+} iouring_cqe_t;
+QUEUE_DECL(iouring_cqe_t, iouring_cqe_queue);
+
+typedef struct iouring_op_s {
+    hio_t*      io;         // NULL if orphaned by iouring_cancel
+    uint32_t    id;         // io->id when submitted
+    int         event;      // HV_READ: accept/recv, HV_WRITE: connect/send
+    int         opcode;     // IORING_OP_*
+    unsigned    inflight  :1; // submitted, waiting for the last cqe
+    unsigned    busy      :1; // in callbacks
+    unsigned    multishot :1; // IORING_ACCEPT_MULTISHOT/IORING_RECV_MULTISHOT
+    unsigned    bufselect :1; // recv into provided buffer ring
+    unsigned    nobufs    :1; // buffer ring exhausted, recv into op->buf once
+    unsigned    canceling :1; // IORING_OP_ASYNC_CANCEL submitted
+    // cqes reaped, waiting for iouring_handle_events
+    iouring_cqe_queue cqes;
+    // recv buffer without buffer ring, or send buffer of file segment
+    char*       buf;
+    size_t      len;
+    // unsent buffer of orphaned send
+    hio_wbuf_t  wbuf;
+    // for orphans
+    struct list_node node;
+} iouring_op_t;
 
 typedef struct io_uring_ctx_s {
-    struct io_uring ring;
-    int             nfds;
+    struct io_uring     ring;
+    int                 nfds;   // number of poll requests
+    int                 nops;   // number of in-flight completion ops
+    // recv/send/accept/connect/cancel supported by kernel
+    unsigned            completion      :1;
+    // IORING_RECV_MULTISHOT supported by kernel, cleared on -EINVAL
+    unsigned            multishot_recv  :1;
+    // in-flight ops whose io has been closed, free when cqe reaped
+    struct list_head    orphans;
+    // provided buffer ring shared by all IORING_OP_RECV of this loop
+    struct io_uring_buf_ring* br;
+    char*               bufs;
+    unsigned            bufsize;
 } io_uring_ctx_t;
 
+static int io_uring_probe_completion(struct io_uring* ring) {
+    struct io_uring_probe* probe = io_uring_get_probe_ring(ring);
+    if (probe == NULL) return 0;
+    int supported = io_uring_opcode_supported(probe, IORING_OP_ACCEPT) &&
+                    io_uring_opcode_supported(probe, IORING_OP_CONNECT) &&
+                    io_uring_opcode_supported(probe, IORING_OP_RECV) &&
+                    io_uring_opcode_supported(probe, IORING_OP_SEND) &&
+                    io_uring_opcode_supported(probe, IORING_OP_ASYNC_CANCEL);
+    io_uring_free_probe(probe);
+    return supported;
+}
+
+#ifdef IO_URING_PBUF_RING
+static int iouring_setup_pbuf_ring(io_uring_ctx_t* ctx) {
+    int ret = 0;
+    ctx->br = io_uring_setup_buf_ring(&ctx->ring, IO_URING_PBUF_ENTRIES, IO_URING_PBUF_BGID, 0, &ret);
+    if (ctx->br == NULL) return ret < 0 ? ret : -1;
+    ctx->bufsize = HLOOP_READ_BUFSIZE;
+    // NOTE: not zeroed, pages are touched only when the kernel fills them.
+    ctx->bufs = (char*)hv_malloc((size_t)IO_URING_PBUF_ENTRIES * ctx->bufsize);
+    int mask = io_uring_buf_ring_mask(IO_URING_PBUF_ENTRIES);
+    int i;
+    for (i = 0; i < IO_URING_PBUF_ENTRIES; ++i) {
+        io_uring_buf_ring_add(ctx->br, ctx->bufs + (size_t)i * ctx->bufsize, ctx->bufsize, i, mask, i);
+    }
+    io_uring_buf_ring_advance(ctx->br, IO_URING_PBUF_ENTRIES);
+    return 0;
+}
+
+static void iouring_free_pbuf_ring(io_uring_ctx_t* ctx) {
+    if (ctx->br == NULL) return;
+    io_uring_free_buf_ring(&ctx->ring, ctx->br, IO_URING_PBUF_ENTRIES, IO_URING_PBUF_BGID);
+    ctx->br = NULL;
+}
+
+static void iouring_put_pbuf(io_uring_ctx_t* ctx, int bid) {
+    if (ctx->br == NULL) return;
+    io_uring_buf_ring_add(ctx->br, ctx->bufs + (size_t)bid * ctx->bufsize, ctx->bufsize, bid,
+                          io_uring_buf_ring_mask(IO_URING_PBUF_ENTRIES), 0);
+    io_uring_buf_ring_advance(ctx->br, 1);
+}
+#else
+#define iouring_setup_pbuf_ring(ctx)    (-ENOTSUP)
+#define iouring_free_pbuf_ring(ctx)
+#define iouring_put_pbuf(ctx, bid)
+#endif
+
 int iowatcher_init(hloop_t* loop) {
     if (loop->iowatcher) return 0;
     io_uring_ctx_t* ctx;
@@ -28,14 +156,61 @@ int iowatcher_init(hloop_t* loop) {
         return ret;
     }
     ctx->nfds = 0;
+    ctx->nops = 0;
+    ctx->completion = io_uring_probe_completion(&ctx->ring);
+    if (!ctx->completion) {
+        hlogw("io_uring recv/send not supported by kernel, fallback to poll");
+    }
+    else if (iouring_setup_pbuf_ring(ctx) == 0) {
+        ctx->multishot_recv = 1;
+    }
+    else {
+        hlogw("io_uring buffer ring not supported, recv into per-io buffer");
+    }
+    list_init(&ctx->orphans);
     loop->iowatcher = ctx;
     return 0;
 }
 
+// release resources carried by a cqe which will never be delivered
+static void iouring_drop_cqe(io_uring_ctx_t* ctx, int opcode, int res, unsigned flags) {
+    if (flags & IORING_CQE_F_BUFFER) {
+        iouring_put_pbuf(ctx, flags >> IORING_CQE_BUFFER_SHIFT);
+    }
+    else if (opcode == IORING_OP_ACCEPT && res >= 0) {
+        closesocket(res);
+    }
+}
+
+static void iouring_op_free(io_uring_ctx_t* ctx, iouring_op_t* op) {
+    iouring_cqe_t* cqe;
+    while ((cqe = iouring_cqe_queue_front(&op->cqes)) != NULL) {
+        iouring_drop_cqe(ctx, op->opcode, cqe->res, cqe->flags);
+        iouring_cqe_queue_pop_front(&op->cqes);
+    }
+    iouring_cqe_queue_cleanup(&op->cqes);
+    HV_FREE(op->buf);
+    if (op->wbuf.base) {
+        hio_wbuf_free(&op->wbuf);
+    }
+    HV_FREE(op);
+}
+
 int iowatcher_cleanup(hloop_t* loop) {
     if (loop->iowatcher == NULL) return 0;
     io_uring_ctx_t* ctx = (io_uring_ctx_t*)loop->iowatcher;
+    // NOTE: unregister buffer ring before io_uring_queue_exit closes the ring fd.
+    iouring_free_pbuf_ring(ctx);
     io_uring_queue_exit(&ctx->ring);
+    // NOTE: after io_uring_queue_exit, kernel no longer references op buffers.
+    struct list_node* node = ctx->orphans.next;
+    while (node != &ctx->orphans) {
+        iouring_op_t* op = list_entry(node, iouring_op_t, node);
+        node = node->next;
+        iouring_op_free(ctx, op);
+    }
+    list_init(&ctx->orphans);
+    HV_FREE(ctx->bufs);
     HV_FREE(loop->iowatcher);
     return 0;
 }
@@ -50,6 +225,523 @@ static struct io_uring_sqe* io_uring_get_sqe_safe(struct io_uring* ring) {
     return sqe;
 }
 
+//-----------------completion-based io------------------------------
+static iouring_op_t* iouring_op_get(hio_t* io, int event) {
+    void** pop = event == HV_READ ? &io->uring_rop : &io->uring_wop;
+    iouring_op_t* op = (iouring_op_t*)*pop;
+    if (op == NULL) {
+        HV_ALLOC_SIZEOF(op);
+        op->io = io;
+        op->event = event;
+        *pop = op;
+    }
+    return op;
+}
+
+static void iouring_prep_read(io_uring_ctx_t* ctx, struct io_uring_sqe* sqe, hio_t* io, iouring_op_t* op) {
+    op->multishot = 0;
+    op->bufselect = 0;
+    if (io->accept) {
+        // NOTE: localaddr and peeraddr will be filled by hio_get => hio_socket_init
+        op->opcode = IORING_OP_ACCEPT;
+#ifdef IO_URING_PBUF_RING
+        if (ctx->br) {
+            // NOTE: multishot accept came with buffer ring in linux 5.19
+            io_uring_prep_multishot_accept(sqe, io->fd, NULL, NULL, 0);
+            op->multishot = 1;
+            return;
+        }
+#endif
+        io_uring_prep_accept(sqe, io->fd, NULL, NULL, 0);
+        return;
+    }
+    op->opcode = IORING_OP_RECV;
+#ifdef IO_URING_PBUF_RING
+    if (ctx->br && !op->nobufs) {
+        if (ctx->multishot_recv) {
+            io_uring_prep_recv_multishot(sqe, io->fd, NULL, 0, 0);
+            op->multishot = 1;
+        } else {
+            io_uring_prep_recv(sqe, io->fd, NULL, ctx->bufsize, 0);
+        }
+        io_uring_sqe_set_flags(sqe, IOSQE_BUFFER_SELECT);
+        sqe->buf_group = IO_URING_PBUF_BGID;
+        op->bufselect = 1;
+        return;
+    }
+#endif
+    if (op->buf == NULL) {
+        op->len = HLOOP_READ_BUFSIZE;
+        HV_ALLOC(op->buf, op->len);
+    }
+    io_uring_prep_recv(sqe, io->fd, op->buf, op->len, 0);
+}
+
+// read the next chunk of file segment into op->buf
+static int iouring_read_file(iouring_op_t* op, hio_wbuf_t* pbuf) {
+    if (op->buf == NULL) {
+        op->len = IO_URING_FILE_CHUNK;
+        HV_ALLOC(op->buf, op->len);
+    }
+    size_t len = pbuf->len - pbuf->offset;
+    if (len > op->len) len = op->len;
+    int nread = pread(pbuf->fd, op->buf, len, pbuf->offset);
+    if (nread == 0) {
+        // NOTE: file truncated
+        errno = EIO;
+        return -1;
+    }
+    return nread;
+}
+
+static int iouring_submit_op(hio_t* io, iouring_op_t* op) {
+    io_uring_ctx_t* ctx = (io_uring_ctx_t*)io->loop->iowatcher;
+    int nread = 0;
+    if (op->event == HV_WRITE && !io->connect &&
+        hio_wbuf_is_file(write_queue_front(&io->write_queue))) {
+        nread = iouring_read_file(op, write_queue_front(&io->write_queue));
+        if (nread < 0) {
+            io->error = errno;
+            hloge("fd[%d] read file error: %s", io->fd, strerror(io->error));
+            hio_close_async(io);
+            return -1;
+        }
+    }
+    struct io_uring_sqe* sqe = io_uring_get_sqe_safe(&ctx->ring);
+    if (sqe == NULL) return -1;
+    if (op->event == HV_READ) {
+        iouring_prep_read(ctx, sqe, io, op);
+    } else {
+        if (io->connect) {
+            op->opcode = IORING_OP_CONNECT;
+            io_uring_prep_connect(sqe, io->fd, io->peeraddr, SOCKADDR_LEN(io->peeraddr));
+        } else {
+            hio_wbuf_t* pbuf = write_queue_front(&io->write_queue);
+            int flag = 0;
+#ifdef MSG_NOSIGNAL
+            flag |= MSG_NOSIGNAL;
+#endif
+            op->opcode = IORING_OP_SEND;
+            if (hio_wbuf_is_file(pbuf)) {
+                io_uring_prep_send(sqe, io->fd, op->buf, nread, flag);
+            } else {
+                io_uring_prep_send(sqe, io->fd, pbuf->base + pbuf->offset, pbuf->len - pbuf->offset, flag);
+            }
+        }
+    }
+    io_uring_sqe_set_data(sqe, op);
+    op->id = io->id;
+    op->inflight = 1;
+    op->canceling = 0;
+    ctx->nops++;
+    return 0;
+}
+
+static void iouring_cancel_op(io_uring_ctx_t* ctx, iouring_op_t* op) {
+    if (!op->inflight || op->canceling) return;
+    struct io_uring_sqe* sqe = io_uring_get_sqe_safe(&ctx->ring);
+    if (sqe == NULL) return;
+    io_uring_prep_cancel(sqe, op, 0);
+    io_uring_sqe_set_data(sqe, IO_URING_CANCEL_TAG);
+    op->canceling = 1;
+}
+
+static void iouring_orphan_op(io_uring_ctx_t* ctx, iouring_op_t* op) {
+    op->io = NULL;
+    if (op->inflight) {
+        // NOTE: kernel still references op->buf, free it when the last cqe reaped.
+        iouring_cancel_op(ctx, op);
+        list_add(&op->node, &ctx->orphans);
+    }
+    else if (!op->busy) {
+        iouring_op_free(ctx, op);
+    }
+    // NOTE: busy op will be freed after callbacks return.
+}
+
+int iouring_enable(hio_t* io) {
+    if (io->uring_mode) return 1;
+    if (io->io_type != HIO_TYPE_TCP) return 0;
+    // NOTE: io already polled can not switch to completion-based io.
+    if (io->events) return 0;
+    hloop_t* loop = io->loop;
+    if (loop->iowatcher == NULL && iowatcher_init(loop) != 0) return 0;
+    io_uring_ctx_t* ctx = (io_uring_ctx_t*)loop->iowatcher;
+    if (!ctx->completion) return 0;
+    io->uring_mode = 1;
+    return 1;
+}
+
+void iouring_cancel(hio_t* io) {
+    if (!io->uring_mode) return;
+    io_uring_ctx_t* ctx = (io_uring_ctx_t*)io->loop->iowatcher;
+    if (ctx == NULL) return;
+    iouring_op_t* op = (iouring_op_t*)io->uring_rop;
+    if (op) {
+        iouring_orphan_op(ctx, op);
+        io->uring_rop = NULL;
+    }
+    op = (iouring_op_t*)io->uring_wop;
+    if (op) {
+        hrecursive_mutex_lock(&io->write_mutex);
+        if (op->inflight && op->opcode == IORING_OP_SEND && !write_queue_empty(&io->write_queue) &&
+            !hio_wbuf_is_file(write_queue_front(&io->write_queue))) {
+            // NOTE: transfer the sending buffer to op, avoid hio_done freeing it.
+            // A file segment is sent from op->buf, which is freed with op.
+            hio_wbuf_t* pbuf = write_queue_front(&io->write_queue);
+            op->wbuf = *pbuf;
+            io->write_bufsize -= pbuf->len - pbuf->offset;
+            write_queue_pop_front(&io->write_queue);
+        }
+        hrecursive_mutex_unlock(&io->write_mutex);
+        iouring_orphan_op(ctx, op);
+        io->uring_wop = NULL;
+    }
+}
+
+static void iouring_write_event_cb(hevent_t* ev) {
+    hio_t* io = (hio_t*)ev->userdata;
+    uint32_t id = (uintptr_t)ev->privdata;
+    if (io->id != id || io->closed) return;
+    hrecursive_mutex_lock(&io->write_mutex);
+    if (!write_queue_empty(&io->write_queue)) {
+        hio_add(io, iouring_handle_events, HV_WRITE);
+    }
+    hrecursive_mutex_unlock(&io->write_mutex);
+}
+
+int iouring_write(hio_t* io, hio_wbuf_t* wbuf) {
+    size_t len = wbuf->len - wbuf->offset;
+    bool isfile = hio_wbuf_is_file(wbuf);
+    hrecursive_mutex_lock(&io->write_mutex);
+    if (!isfile && io->write_bufsize + len > io->max_write_bufsize) {
+        hrecursive_mutex_unlock(&io->write_mutex);
+        hio_wbuf_free(wbuf);
+        hloge("write bufsize > %u, close it!", io->max_write_bufsize);
+        io->error = ERR_OVER_LIMIT;
+        hio_close_async(io);
+        return -1;
+    }
+    bool queue_empty = write_queue_empty(&io->write_queue);
+    if (io->write_queue.maxsize == 0) {
+        write_queue_init(&io->write_queue, 4);
+    }
+    // NOTE: the buffer must be alive until IORING_OP_SEND completed, free in iouring_handle_write.
+    write_queue_push_back(&io->write_queue, wbuf);
+    if (isfile) {
+        io->write_filesize += len;
+    } else {
+        io->write_bufsize += len;
+    }
+    if (io->write_bufsize > WRITE_BUFSIZE_HIGH_WATER) {
+        hlogw("write len=%u enqueue, bufsize=%u over high water %u",
+            (unsigned int)len,
+            (unsigned int)io->write_bufsize,
+            (unsigned int)WRITE_BUFSIZE_HIGH_WATER);
+    }
+    if (hv_gettid() == io->loop->tid) {
+        hio_add(io, iouring_handle_events, HV_WRITE);
+    } else if (queue_empty) {
+        // NOTE: io_uring sq is not thread-safe, submit in loop thread.
+        hevent_t ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.cb = iouring_write_event_cb;
+        ev.userdata = io;
+        ev.privdata = (void*)(uintptr_t)io->id;
+        hloop_post_event(io->loop, &ev);
+    }
+    hrecursive_mutex_unlock(&io->write_mutex);
+    // NOTE: nothing is written yet, written bytes are reported by hwrite_cb
+    // when IORING_OP_SEND completed, and a failed send by hclose_cb.
+    return 0;
+}
+
+static int iouring_fill_readbuf(hio_t* io, const char* data, int len) {
+    fifo_buf_t* rb = &io->readbuf;
+    if (rb->tail + len > rb->len) {
+        hio_memmove_readbuf(io);
+    }
+    if (rb->tail + len > rb->len) {
+        if (hio_is_alloced_readbuf(io)) {
+            hio_alloc_readbuf(io, rb->tail + len);
+        } else {
+            // NOTE: loop readbuf or user readbuf, copy the remain into own readbuf.
+            char* base = rb->base;
+            hio_alloc_readbuf(io, rb->tail + len);
+            if (hio_is_alloced_readbuf(io) && rb->tail) {
+                memcpy(rb->base, base, rb->tail);
+            }
+        }
+        if (rb->tail + len > rb->len) return -1;
+    }
+    memcpy(rb->base + rb->tail, data, len);
+    return 0;
+}
+
+static void iouring_on_accept(hio_t* io, int connfd) {
+    if (connfd < 0) {
+        if (connfd != -EAGAIN && connfd != -EINTR) {
+            io->error = -connfd;
+            hloge("listenfd=%d accept error: %s:%d", io->fd, socket_strerror(io->error), io->error);
+            // NOTE: Don't close listen fd automatically anyway.
+        }
+        return;
+    }
+    hio_t* connio = hio_get(io->loop, connfd);
+    // NOTE: inherit from listenio
+    connio->accept_cb = io->accept_cb;
+    connio->userdata = io->userdata;
+    if (io->unpack_setting) {
+        hio_set_unpack(connio, io->unpack_setting);
+    }
+    hio_accept_cb(connio);
+}
+
+static void iouring_on_recv(io_uring_ctx_t* ctx, hio_t* io, iouring_op_t* op, iouring_cqe_t* cqe) {
+    int nread = cqe->res;
+    char* buf = op->buf;
+    size_t len = op->len;
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        buf = ctx->bufs + (size_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT) * ctx->bufsize;
+        len = ctx->bufsize;
+    }
+    else if (op->nobufs && nread >= 0) {
+        // NOTE: buffer ring has been refilled by now, try it again next time.
+        op->nobufs = 0;
+    }
+
+    if (nread == -EAGAIN || nread == -EINTR) {
+        return;
+    }
+    if (nread == -ENOBUFS) {
+        // NOTE: every ring buffer is lent out, recv into op->buf once.
+        op->nobufs = 1;
+        return;
+    }
+    if (nread == -EINVAL && op->multishot && ctx->multishot_recv) {
+        hlogw("io_uring multishot recv not supported, fallback to oneshot recv");
+        ctx->multishot_recv = 0;
+        return;
+    }
+    if (nread <= 0) {
+        // NOTE: 0 means disconnect
+        if (nread < 0) io->error = -nread;
+        hio_close(io);
+        return;
+    }
+    if ((size_t)nread < len) {
+        // NOTE: make string friendly
+        buf[nread] = '\0';
+    }
+    io->last_read_hrtime = io->loop->cur_hrtime;
+    if (io->unpack_setting == NULL &&
+        io->read_flags == 0 &&
+        io->readbuf.head == io->readbuf.tail) {
+        // NOTE: lend the recv buffer to hread_cb, avoid memcpy to readbuf.
+        hio_read_cb(io, buf, nread);
+    } else {
+        size_t tail = io->readbuf.tail;
+        if (iouring_fill_readbuf(io, buf, nread) == 0) {
+            io->readbuf.tail += nread;
+            hio_handle_read(io, io->readbuf.base + tail, nread);
+        }
+    }
+}
+
+static void iouring_handle_read(hio_t* io, iouring_op_t* op) {
+    io_uring_ctx_t* ctx = (io_uring_ctx_t*)io->loop->iowatcher;
+    iouring_cqe_t cqe;
+    // NOTE: cqes left after hio_read_stop are delivered by next hio_read.
+    while (!iouring_cqe_queue_empty(&op->cqes) && (io->events & HV_READ) && !io->closed) {
+        cqe = *iouring_cqe_queue_front(&op->cqes);
+        iouring_cqe_queue_pop_front(&op->cqes);
+        op->busy = 1;
+        if (op->opcode == IORING_OP_ACCEPT) {
+            iouring_on_accept(io, cqe.res);
+        } else {
+            iouring_on_recv(ctx, io, op, &cqe);
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                // NOTE: return the buffer lent to hread_cb back to the ring.
+                iouring_put_pbuf(ctx, cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            } else if (ctx->br) {
+                // NOTE: op->buf was a fallback for -ENOBUFS, do not pin it.
+                HV_FREE(op->buf);
+            }
+        }
+        op->busy = 0;
+        if (op->io == NULL) {
+            // NOTE: in-flight orphan is freed when the last cqe reaped.
+            if (!op->inflight) iouring_op_free(ctx, op);
+            return;
+        }
+    }
+    if (!op->inflight && iouring_cqe_queue_empty(&op->cqes) &&
+        (io->events & HV_READ) && !io->closed) {
+        iouring_submit_op(io, op);
+    }
+}
+
+static void iouring_handle_write(hio_t* io, iouring_op_t* op) {
+    io_uring_ctx_t* ctx = (io_uring_ctx_t*)io->loop->iowatcher;
+    iouring_cqe_t cqe = *iouring_cqe_queue_front(&op->cqes);
+    iouring_cqe_queue_pop_front(&op->cqes);
+    if (op->opcode == IORING_OP_CONNECT) {
+        io->connect = 0;
+        if (cqe.res < 0) {
+            io->error = -cqe.res;
+            hlogw("connfd=%d connect error: %s:%d", io->fd, socket_strerror(io->error), io->error);
+            hio_close(io);
+            return;
+        }
+        socklen_t addrlen = sizeof(sockaddr_u);
+        getsockname(io->fd, io->localaddr, &addrlen);
+        hio_del_connect_timer(io);
+        op->busy = 1;
+        hio_connect_cb(io);
+        op->busy = 0;
+        if (op->io == NULL) {
+            iouring_op_free(ctx, op);
+            return;
+        }
+        hrecursive_mutex_lock(&io->write_mutex);
+        goto write_continue;
+    }
+
+    hrecursive_mutex_lock(&io->write_mutex);
+    int nwrite = cqe.res;
+    if (nwrite == -EAGAIN || nwrite == -EINTR) {
+        goto write_continue;
+    }
+    if (nwrite <= 0 || write_queue_empty(&io->write_queue)) {
+        // NOTE: 0 means disconnect
+        if (nwrite < 0) io->error = -nwrite;
+        hrecursive_mutex_unlock(&io->write_mutex);
+        hio_close(io);
+        return;
+    }
+    hio_wbuf_t* pbuf = write_queue_front(&io->write_queue);
+    hio_wbuf_t wbuf = *pbuf;
+    char* buf = NULL;
+    if (hio_wbuf_is_file(pbuf)) {
+        // NOTE: write_cb(NULL, nwrite) for file segment
+        io->write_filesize -= nwrite;
+    } else {
+        buf = pbuf->base + pbuf->offset;
+        io->write_bufsize -= nwrite;
+    }
+    pbuf->offset += nwrite;
+    bool complete = pbuf->offset == pbuf->len;
+    if (complete) {
+        // NOTE: pop before write_cb, free after write_cb.
+        write_queue_pop_front(&io->write_queue);
+    }
+    io->last_write_hrtime = io->loop->cur_hrtime;
+    op->busy = 1;
+    hio_write_cb(io, buf, nwrite);
+    op->busy = 0;
+    if (complete) {
+        hio_wbuf_free(&wbuf);
+    }
+    if (op->io == NULL) {
+        hrecursive_mutex_unlock(&io->write_mutex);
+        iouring_op_free(ctx, op);
+        return;
+    }
+write_continue:
+    if (io->closed) {
+        hrecursive_mutex_unlock(&io->write_mutex);
+        return;
+    }
+    if (!write_queue_empty(&io->write_queue)) {
+        iouring_submit_op(io, op);
+        hrecursive_mutex_unlock(&io->write_mutex);
+        return;
+    }
+    hio_del(io, HV_WRITE);
+    hrecursive_mutex_unlock(&io->write_mutex);
+    if (io->close) {
+        io->close = 0;
+        hio_close(io);
+    }
+}
+
+void iouring_handle_events(hio_t* io) {
+    iouring_op_t* op = (iouring_op_t*)io->uring_rop;
+    if ((io->revents & HV_READ) && (io->events & HV_READ) && op) {
+        iouring_handle_read(io, op);
+    }
+    op = (iouring_op_t*)io->uring_wop;
+    if ((io->revents & HV_WRITE) && !io->closed && op &&
+        !iouring_cqe_queue_empty(&op->cqes)) {
+        iouring_handle_write(io, op);
+    }
+    io->revents = 0;
+}
+
+static int iouring_add_event(hloop_t* loop, hio_t* io, int events) {
+    iouring_op_t* op;
+    // NOTE: busy op is resubmitted by iouring_handle_read/iouring_handle_write.
+    if (events & HV_READ) {
+        op = iouring_op_get(io, HV_READ);
+        if (!iouring_cqe_queue_empty(&op->cqes)) {
+            // NOTE: completed after hio_read_stop, deliver it in hloop_process_pendings.
+            io->revents |= HV_READ;
+            EVENT_PENDING(io);
+        }
+        else if (!op->inflight && !op->busy) {
+            if (iouring_submit_op(io, op) != 0) return -1;
+        }
+    }
+    if (events & HV_WRITE) {
+        op = iouring_op_get(io, HV_WRITE);
+        if (!op->inflight && !op->busy && iouring_cqe_queue_empty(&op->cqes) &&
+            (io->connect || !write_queue_empty(&io->write_queue))) {
+            if (iouring_submit_op(io, op) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static void iouring_del_event(hloop_t* loop, hio_t* io, int events) {
+    iouring_op_t* op = (iouring_op_t*)io->uring_rop;
+    // NOTE: cancel multishot and buffer-select recv, a paused io should neither
+    // keep accepting connections nor hold buffers of the shared ring.
+    // Other ops are kept in flight and cancelled by iouring_cancel when hio_close.
+    if ((events & HV_READ) && op && (op->multishot || op->bufselect)) {
+        iouring_cancel_op((io_uring_ctx_t*)loop->iowatcher, op);
+    }
+}
+
+static int iouring_complete_op(hloop_t* loop, iouring_op_t* op, int res, unsigned flags) {
+    io_uring_ctx_t* ctx = (io_uring_ctx_t*)loop->iowatcher;
+    if (!(flags & IORING_CQE_F_MORE)) {
+        op->inflight = 0;
+        op->canceling = 0;
+        ctx->nops--;
+    }
+    hio_t* io = op->io;
+    if (io == NULL) {
+        // orphaned by iouring_cancel
+        iouring_drop_cqe(ctx, op->opcode, res, flags);
+        if (!op->inflight) {
+            list_del(&op->node);
+            iouring_op_free(ctx, op);
+        }
+        return 0;
+    }
+    if (res != -ECANCELED || (flags & IORING_CQE_F_BUFFER)) {
+        iouring_cqe_t cqe;
+        cqe.res = res;
+        cqe.flags = flags;
+        iouring_cqe_queue_push_back(&op->cqes, &cqe);
+    }
+    // NOTE: even a cancelled op goes pending, to resubmit if hio_read again.
+    io->revents |= op->event;
+    EVENT_PENDING(io);
+    return 1;
+}
+
+//-----------------iowatcher----------------------------------------
 int iowatcher_add_event(hloop_t* loop, int fd, int events) {
     if (loop->iowatcher == NULL) {
         int ret = iowatcher_init(loop);
@@ -59,6 +751,9 @@ int iowatcher_add_event(hloop_t* loop, int fd, int events) {
     }
     io_uring_ctx_t* ctx = (io_uring_ctx_t*)loop->iowatcher;
     hio_t* io = loop->ios.ptr[fd];
+    if (io->uring_mode) {
+        return iouring_add_event(loop, io, events);
+    }
 
     unsigned poll_mask = 0;
     // pre events
@@ -81,7 +776,7 @@ int iowatcher_add_event(hloop_t* loop, int fd, int events) {
         // Cancel the existing poll request first
         sqe = io_uring_get_sqe_safe(&ctx->ring);
         if (sqe == NULL) return -1;
-        io_uring_prep_poll_remove(sqe, (uint64_t)fd);
+        io_uring_prep_poll_remove(sqe, (uint64_t)(uintptr_t)IO_URING_POLL_TAG(fd));
         io_uring_sqe_set_data(sqe, IO_URING_CANCEL_TAG);
     } else {
         ctx->nfds++;
@@ -91,9 +786,8 @@ int iowatcher_add_event(hloop_t* loop, int fd, int events) {
     sqe = io_uring_get_sqe_safe(&ctx->ring);
     if (sqe == NULL) return -1;
     io_uring_prep_poll_add(sqe, fd, poll_mask);
-    io_uring_sqe_set_data(sqe, (void*)(uintptr_t)fd);
-
-    io_uring_submit(&ctx->ring);
+    io_uring_sqe_set_data(sqe, IO_URING_POLL_TAG(fd));
+    // NOTE: submitted in iowatcher_poll_events
     return 0;
 }
 
@@ -101,6 +795,10 @@ int iowatcher_del_event(hloop_t* loop, int fd, int events) {
     io_uring_ctx_t* ctx = (io_uring_ctx_t*)loop->iowatcher;
     if (ctx == NULL) return 0;
     hio_t* io = loop->ios.ptr[fd];
+    if (io->uring_mode) {
+        iouring_del_event(loop, io, events);
+        return 0;
+    }
 
     // Calculate remaining events
     unsigned poll_mask = 0;
@@ -122,7 +820,7 @@ int iowatcher_del_event(hloop_t* loop, int fd, int events) {
     // Cancel existing poll
     struct io_uring_sqe* sqe = io_uring_get_sqe_safe(&ctx->ring);
     if (sqe == NULL) return -1;
-    io_uring_prep_poll_remove(sqe, (uint64_t)fd);
+    io_uring_prep_poll_remove(sqe, (uint64_t)(uintptr_t)IO_URING_POLL_TAG(fd));
     io_uring_sqe_set_data(sqe, IO_URING_CANCEL_TAG);
 
     if (poll_mask == 0) {
@@ -132,17 +830,20 @@ int iowatcher_del_event(hloop_t* loop, int fd, int events) {
         sqe = io_uring_get_sqe_safe(&ctx->ring);
         if (sqe == NULL) return -1;
         io_uring_prep_poll_add(sqe, fd, poll_mask);
-        io_uring_sqe_set_data(sqe, (void*)(uintptr_t)fd);
+        io_uring_sqe_set_data(sqe, IO_URING_POLL_TAG(fd));
     }
-
-    io_uring_submit(&ctx->ring);
+    // NOTE: submitted in iowatcher_poll_events
     return 0;
 }
 
 int iowatcher_poll_events(hloop_t* loop, int timeout) {
     io_uring_ctx_t* ctx = (io_uring_ctx_t*)loop->iowatcher;
     if (ctx == NULL) return 0;
-    if (ctx->nfds == 0) return 0;
+    if (ctx->nfds == 0 && ctx->nops == 0) {
+        // flush cancel requests
+        io_uring_submit(&ctx->ring);
+        return 0;
+    }
 
     struct __kernel_timespec ts;
     struct __kernel_timespec* tp = NULL;
@@ -152,51 +853,50 @@ int iowatcher_poll_events(hloop_t* loop, int timeout) {
         tp = &ts;
     }
 
+    // NOTE: batched submission of all sqes prepared in last loop iteration, and wait in one syscall.
     struct io_uring_cqe* cqe;
-    int ret;
-    if (tp) {
-        ret = io_uring_wait_cqe_timeout(&ctx->ring, &cqe, tp);
-    } else {
-        ret = io_uring_wait_cqe(&ctx->ring, &cqe);
-    }
+    int ret = io_uring_submit_and_wait_timeout(&ctx->ring, &cqe, 1, tp, NULL);
     if (ret < 0) {
         if (ret == -ETIME || ret == -EINTR) {
             return 0;
         }
-        perror("io_uring_wait_cqe");
+        perror("io_uring_submit_and_wait_timeout");
         return ret;
     }
 
     int nevents = 0;
-    int sqe_queued = 0;
     unsigned nready = io_uring_cq_ready(&ctx->ring);
     unsigned i;
     for (i = 0; i < nready; ++i) {
         if (io_uring_peek_cqe(&ctx->ring, &cqe) != 0) break;
         void* data = io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        unsigned flags = cqe->flags;
+        io_uring_cqe_seen(&ctx->ring, cqe);
         if (data == IO_URING_CANCEL_TAG) {
-            io_uring_cqe_seen(&ctx->ring, cqe);
+            continue;
+        }
+        if (!IO_URING_IS_POLL_TAG(data)) {
+            nevents += iouring_complete_op(loop, (iouring_op_t*)data, res, flags);
             continue;
         }
 
-        int fd = (int)(uintptr_t)data;
+        int fd = IO_URING_POLL_FD(data);
         if (fd < 0 || fd >= loop->ios.maxsize) {
-            io_uring_cqe_seen(&ctx->ring, cqe);
             continue;
         }
         hio_t* io = loop->ios.ptr[fd];
-        if (io == NULL) {
-            io_uring_cqe_seen(&ctx->ring, cqe);
+        if (io == NULL || io->uring_mode) {
             continue;
         }
 
-        if (cqe->res < 0) {
+        if (res < 0) {
             // Poll request failed: notify registered events, or both if none registered
             io->revents |= (io->events ? io->events : HV_RDWR);
             EVENT_PENDING(io);
             ++nevents;
         } else {
-            int revents = cqe->res;
+            int revents = res;
             if (revents & (POLLIN | POLLHUP | POLLERR)) {
                 io->revents |= HV_READ;
             }
@@ -209,9 +909,8 @@ int iowatcher_poll_events(hloop_t* loop, int timeout) {
             }
         }
 
-        io_uring_cqe_seen(&ctx->ring, cqe);
-
         // io_uring POLL_ADD is one-shot, re-arm for the same events
+        // NOTE: submitted with others in next iowatcher_poll_events
         unsigned remask = 0;
         if (io->events & HV_READ) remask |= POLLIN;
         if (io->events & HV_WRITE) remask |= POLLOUT;
@@ -219,16 +918,11 @@ int iowatcher_poll_events(hloop_t* loop, int timeout) {
             struct io_uring_sqe* sqe = io_uring_get_sqe_safe(&ctx->ring);
             if (sqe) {
                 io_uring_prep_poll_add(sqe, fd, remask);
-                io_uring_sqe_set_data(sqe, (void*)(uintptr_t)fd);
-                sqe_queued = 1;
+                io_uring_sqe_set_data(sqe, IO_URING_POLL_TAG(fd));
             }
         }
     }
 
-    if (sqe_queued) {
-        io_uring_submit(&ctx->ring);
-    }
-
     return nevents;
 }
 #endif
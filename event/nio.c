@@ -6,15 +6,39 @@
 #include "hlog.h"
 #include "herr.h"
 #include "hthread.h"
+#include "hdns.h"
+
+#ifdef OS_LINUX
+#include <sys/sendfile.h>
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// ssl with kernel TLS offload: plain send/sendmsg/sendfile on socket, kernel makes the records.
+#define NIO_KTLS_SEND(io)   ((io)->io_type == HIO_TYPE_SSL && (io)->ktls_send)
+
+// byte streams without framing or encryption, write_queue can be gathered into one writev.
+#define NIO_CAN_WRITEV(io)  (((io)->io_type & (HIO_TYPE_TCP | HIO_TYPE_PIPE | HIO_TYPE_STDIO | HIO_TYPE_FILE)) || \
+                             NIO_KTLS_SEND(io))
+
+// file segment of hio_sendfile is written at most one chunk per syscall.
+#define NIO_SENDFILE_CHUNK      (1 << 21)   // 2M, by sendfile(2)
+#define NIO_READFILE_CHUNK      (1 << 16)   // 64K, by read + write
 
 static void __connect_timeout_cb(htimer_t* timer) {
     hio_t* io = (hio_t*)timer->privdata;
     if (io) {
         char localaddrstr[SOCKADDR_STRLEN] = {0};
         char peeraddrstr[SOCKADDR_STRLEN] = {0};
-        hlogw("connect timeout [%s] <=> [%s]",
-                SOCKADDR_STR(io->localaddr, localaddrstr),
-                SOCKADDR_STR(io->peeraddr, peeraddrstr));
+        if (io->connect_host) {
+            hlogw("connect timeout resolving %s", io->connect_host);
+        } else {
+            hlogw("connect timeout [%s] <=> [%s]",
+                    SOCKADDR_STR(io->localaddr, localaddrstr),
+                    SOCKADDR_STR(io->peeraddr, peeraddrstr));
+        }
         io->error = ETIMEDOUT;
         hio_close(io);
     }
@@ -72,6 +96,7 @@ static void ssl_server_handshake(hio_t* io) {
         // handshake finish
         hio_del(io, HV_RDWR);
         printd("ssl handshake finished.\n");
+        io->ktls_send = hssl_ktls_send(io->ssl) ? 1 : 0;
         __accept_cb(io);
     }
     else if (ret == HSSL_WANT_READ) {
@@ -104,6 +129,7 @@ static void ssl_client_handshake(hio_t* io) {
         // handshake finish
         hio_del(io, HV_RDWR);
         printd("ssl handshake finished.\n");
+        io->ktls_send = hssl_ktls_send(io->ssl) ? 1 : 0;
         __connect_cb(io);
     }
     else if (ret == HSSL_WANT_READ) {
@@ -295,8 +321,12 @@ static int __nio_write(hio_t* io, const void* buf, int len, struct sockaddr* add
     int nwrite = 0;
     switch (io->io_type) {
     case HIO_TYPE_SSL:
-        nwrite = hssl_write(io->ssl, buf, len);
-        break;
+        if (!io->ktls_send) {
+            nwrite = hssl_write(io->ssl, buf, len);
+            break;
+        }
+        // NOTE: kernel TLS, send as tcp
+        /* fallthrough */
     case HIO_TYPE_TCP:
     {
         int flag = 0;
@@ -326,6 +356,69 @@ static int __nio_write(hio_t* io, const void* buf, int len, struct sockaddr* add
     return nwrite;
 }
 
+static int __nio_writev(hio_t* io, const struct iovec* iov, int iovcnt) {
+    int nwrite = 0;
+#ifdef OS_WIN
+    // NOTE: no writev on windows, write one by one until short write.
+    int i, n;
+    for (i = 0; i < iovcnt; ++i) {
+        n = __nio_write(io, iov[i].iov_base, iov[i].iov_len, NULL);
+        if (n < 0) return nwrite > 0 ? nwrite : n;
+        nwrite += n;
+        if (n < (int)iov[i].iov_len) break;
+    }
+#else
+    if (io->io_type == HIO_TYPE_TCP || NIO_KTLS_SEND(io)) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (struct iovec*)iov;
+        msg.msg_iovlen = iovcnt;
+        int flag = 0;
+#ifdef MSG_NOSIGNAL
+        flag |= MSG_NOSIGNAL;
+#endif
+        nwrite = sendmsg(io->fd, &msg, flag);
+    } else {
+        nwrite = writev(io->fd, iov, iovcnt);
+    }
+#endif
+    // hlogd("writev retval=%d", nwrite);
+    return nwrite;
+}
+
+// write a chunk of file segment, *plen: in remaining length, out chunk length.
+static int __nio_sendfile(hio_t* io, int fd, size_t offset, int* plen) {
+#ifdef OS_LINUX
+    if (io->io_type == HIO_TYPE_TCP || NIO_KTLS_SEND(io)) {
+        if (*plen > NIO_SENDFILE_CHUNK) *plen = NIO_SENDFILE_CHUNK;
+        off_t off = offset;
+        return sendfile(io->fd, fd, &off, *plen);
+    }
+#endif
+    // NOTE: ssl retries with the same offset and length, so the same content.
+    if (*plen > NIO_READFILE_CHUNK) *plen = NIO_READFILE_CHUNK;
+    // NOTE: not on the stack of loop thread, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER allows another buffer when retry.
+    char* buf = NULL;
+    HV_ALLOC(buf, *plen);
+#ifdef OS_WIN
+    int nread = -1;
+    if (_lseeki64(fd, offset, SEEK_SET) >= 0) {
+        nread = _read(fd, buf, *plen);
+    }
+#else
+    int nread = pread(fd, buf, *plen, offset);
+#endif
+    int nwrite = -1;
+    if (nread > 0) {
+        nwrite = __nio_write(io, buf, nread, NULL);
+    } else if (nread == 0) {
+        // NOTE: file truncated
+        errno = EIO;
+    }
+    HV_FREE(buf);
+    return nwrite;
+}
+
 static void nio_read(hio_t* io) {
     // printd("nio_read fd=%d\n", io->fd);
     void* buf;
@@ -390,15 +483,42 @@ write:
         }
         return;
     }
-    offset_buf_t* pbuf = write_queue_front(&io->write_queue);
+    hio_wbuf_t* pbuf = write_queue_front(&io->write_queue);
+    hio_wbuf_t wbuf;
     char* base = pbuf->base;
-    char* buf = base + pbuf->offset;
-    int len = pbuf->len - pbuf->offset;
-    struct sockaddr* addr = NULL;
-    if (io->io_type & (HIO_TYPE_SOCK_DGRAM | HIO_TYPE_SOCK_RAW)) {
-        addr = (struct sockaddr*)base;
+    char* buf = NULL;
+    int len = 0;
+    if (hio_wbuf_is_file(pbuf)) {
+        // NOTE: file segment of hio_sendfile
+        size_t filelen = pbuf->len - pbuf->offset;
+        len = filelen > INT_MAX ? INT_MAX : (int)filelen;
+        nwrite = __nio_sendfile(io, pbuf->fd, pbuf->offset, &len);
+    } else if (NIO_CAN_WRITEV(io) && write_queue_size(&io->write_queue) > 1) {
+        // NOTE: flush the write_queue in one writev, until a file segment.
+        struct iovec iov[IOV_MAX];
+        int iovcnt = write_queue_size(&io->write_queue);
+        if (iovcnt > IOV_MAX) iovcnt = IOV_MAX;
+        len = 0;
+        int i;
+        for (i = 0; i < iovcnt; ++i) {
+            if (hio_wbuf_is_file(&pbuf[i])) {
+                iovcnt = i;
+                break;
+            }
+            iov[i].iov_base = pbuf[i].base + pbuf[i].offset;
+            iov[i].iov_len = pbuf[i].len - pbuf[i].offset;
+            len += iov[i].iov_len;
+        }
+        nwrite = __nio_writev(io, iov, iovcnt);
+    } else {
+        struct sockaddr* addr = NULL;
+        if (io->io_type & (HIO_TYPE_SOCK_DGRAM | HIO_TYPE_SOCK_RAW)) {
+            addr = (struct sockaddr*)base;
+        }
+        buf = base + pbuf->offset;
+        len = pbuf->len - pbuf->offset;
+        nwrite = __nio_write(io, buf, len, addr);
     }
-    nwrite = __nio_write(io, buf, len, addr);
     // printd("write retval=%d\n", nwrite);
     if (nwrite < 0) {
         err = socket_errno();
@@ -414,18 +534,39 @@ write:
     if (nwrite == 0 && (io->io_type & HIO_TYPE_SOCK_STREAM)) {
         goto disconnect;
     }
-    pbuf->offset += nwrite;
-    io->write_bufsize -= nwrite;
-    __write_cb(io, buf, nwrite);
-    if (nwrite == len) {
-        // NOTE: after write_cb, pbuf maybe invalid.
-        // HV_FREE(pbuf->base);
-        HV_FREE(base);
-        write_queue_pop_front(&io->write_queue);
-        if (!io->closed) {
-            // write continue
-            goto write;
+    int remain = nwrite;
+    while (remain > 0) {
+        pbuf = write_queue_front(&io->write_queue);
+        size_t left = pbuf->len - pbuf->offset;
+        int n = left > (size_t)remain ? remain : (int)left;
+        pbuf->offset += n;
+        if (hio_wbuf_is_file(pbuf)) {
+            // NOTE: write_cb(NULL, n) for file segment
+            buf = NULL;
+            io->write_filesize -= n;
+        } else {
+            buf = pbuf->base + pbuf->offset - n;
+            io->write_bufsize -= n;
         }
+        remain -= n;
+        bool complete = pbuf->offset == pbuf->len;
+        if (complete) {
+            // NOTE: pop before write_cb, free after write_cb.
+            wbuf = *pbuf;
+            write_queue_pop_front(&io->write_queue);
+        }
+        __write_cb(io, buf, n);
+        if (complete) {
+            hio_wbuf_free(&wbuf);
+        }
+        if (io->closed) {
+            hrecursive_mutex_unlock(&io->write_mutex);
+            return;
+        }
+    }
+    if (nwrite == len) {
+        // write continue
+        goto write;
     }
     hrecursive_mutex_unlock(&io->write_mutex);
     return;
@@ -437,7 +578,14 @@ disconnect:
     }
 }
 
-static void hio_handle_events(hio_t* io) {
+void hio_handle_events(hio_t* io) {
+#ifdef EVENT_IO_URING
+    if (io->uring_mode) {
+        iouring_handle_events(io);
+        return;
+    }
+#endif
+
     if ((io->events & HV_READ) && (io->revents & HV_READ)) {
         if (io->accept) {
             nio_accept(io);
@@ -471,10 +619,161 @@ static void hio_handle_events(hio_t* io) {
 
 int hio_accept(hio_t* io) {
     io->accept = 1;
+#ifdef EVENT_IO_URING
+    // NOTE: IORING_OP_ACCEPT will be submitted by iowatcher_add_event
+    iouring_enable(io);
+#endif
     return hio_add(io, hio_handle_events, HV_READ);
 }
 
+static int nio_connect_inprogress(hio_t* io) {
+    // NOTE: connect_timer added by nio_connect_resolve is kept, connect_timeout of resolve + connect
+    if (io->connect_timer == NULL) {
+        int timeout = io->connect_timeout ? io->connect_timeout : HIO_DEFAULT_CONNECT_TIMEOUT;
+        io->connect_timer = htimer_add_coarse(io->loop, __connect_timeout_cb, timeout, 1);
+        io->connect_timer->privdata = io;
+    }
+    io->connect = 1;
+    return hio_add(io, hio_handle_events, HV_WRITE);
+}
+
+#ifdef OS_UNIX
+// options may be set on the socket between hio_create_socket and hio_connect
+static const struct {
+    int level;
+    int optname;
+} s_resolve_sockopts[] = {
+    { SOL_SOCKET,   SO_REUSEADDR    },
+#ifdef SO_REUSEPORT
+    { SOL_SOCKET,   SO_REUSEPORT    },
+#endif
+    { SOL_SOCKET,   SO_KEEPALIVE    },
+    { SOL_SOCKET,   SO_LINGER       },
+    { SOL_SOCKET,   SO_SNDBUF       },
+    { SOL_SOCKET,   SO_RCVBUF       },
+    { SOL_SOCKET,   SO_SNDTIMEO     },
+    { SOL_SOCKET,   SO_RCVTIMEO     },
+    { IPPROTO_TCP,  TCP_NODELAY     },
+#ifdef TCP_KEEPALIVE
+    { IPPROTO_TCP,  TCP_KEEPALIVE   },
+#endif
+#ifdef TCP_KEEPIDLE
+    { IPPROTO_TCP,  TCP_KEEPIDLE    },
+#endif
+#ifdef TCP_KEEPINTVL
+    { IPPROTO_TCP,  TCP_KEEPINTVL   },
+#endif
+#ifdef TCP_KEEPCNT
+    { IPPROTO_TCP,  TCP_KEEPCNT     },
+#endif
+};
+
+// NOTE: only options changed from the defaults are copied,
+// the local address bound before can not be kept in another family.
+static void nio_copy_sockopts(int srcfd, int dstfd) {
+    char optval[64];
+    char defval[64];
+    for (size_t i = 0; i < ARRAY_SIZE(s_resolve_sockopts); ++i) {
+        int level = s_resolve_sockopts[i].level;
+        int optname = s_resolve_sockopts[i].optname;
+        socklen_t optlen = sizeof(optval);
+        socklen_t deflen = sizeof(defval);
+        if (getsockopt(srcfd, level, optname, optval, &optlen) != 0 ||
+            getsockopt(dstfd, level, optname, defval, &deflen) != 0) {
+            continue;
+        }
+        if (optlen == deflen && memcmp(optval, defval, optlen) == 0) continue;
+#ifdef OS_LINUX
+        // NOTE: buffer sizes are doubled by setsockopt and got doubled
+        if (level == SOL_SOCKET && (optname == SO_SNDBUF || optname == SO_RCVBUF) &&
+            optlen == sizeof(int)) {
+            *(int*)optval /= 2;
+        }
+#endif
+        setsockopt(dstfd, level, optname, optval, optlen);
+    }
+}
+
+// replace the socket with a new one of family, io and fd are the same
+static int nio_replace_socket(hio_t* io, int family) {
+    int sockfd = socket(family, SOCK_STREAM, 0);
+    if (sockfd < 0) return socket_errno();
+    nio_copy_sockopts(io->fd, sockfd);
+    // NOTE: FD_CLOEXEC is cleared by dup2
+    int fdflags = fcntl(io->fd, F_GETFD);
+    if (dup2(sockfd, io->fd) < 0) {
+        int err = socket_errno();
+        closesocket(sockfd);
+        return err;
+    }
+    closesocket(sockfd);
+    if (fdflags > 0) fcntl(io->fd, F_SETFD, fdflags);
+    nonblocking(io->fd);
+    return 0;
+}
+
+static void nio_connect_resolved(hdns_t* query, const hdns_result_t* result, void* userdata) {
+    (void)query;
+    hio_t* io = (hio_t*)userdata;
+    io->dns_query = NULL;
+    if (result->status != HDNS_STATUS_OK || result->naddrs <= 0) {
+        hlogw("resolve %s failed: %d", io->connect_host, result->status);
+        io->error = ERR_DNS_RESOLVE;
+        hio_close(io);
+        return;
+    }
+    // NOTE: IPv4 first, the socket of hio_create_socket is replaced for ipv6 only
+    const sockaddr_u* addr = &result->addrs[0];
+    if (addr->sa.sa_family != AF_INET) {
+        int err = nio_replace_socket(io, addr->sa.sa_family);
+        if (err != 0) {
+            io->error = err;
+            hio_close(io);
+            return;
+        }
+    }
+    sockaddr_u* peeraddr = (sockaddr_u*)io->peeraddr;
+    memcpy(peeraddr, addr, sizeof(sockaddr_u));
+    sockaddr_set_port(peeraddr, io->connect_port);
+    SAFE_FREE(io->connect_host);
+    hio_connect(io);
+}
+
+static int nio_connect_resolve(hio_t* io) {
+    if (io->dns_query) return 0;
+    int timeout = io->connect_timeout ? io->connect_timeout : HIO_DEFAULT_CONNECT_TIMEOUT;
+    hdns_setting_t opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.family = HDNS_QUERY_BOTH;
+    opt.timeout_ms = MIN(timeout, HDNS_DEFAULT_TIMEOUT_MS);
+    opt.retries = HDNS_DEFAULT_RETRIES;
+    opt.use_cache = 1;
+    hdns_t* query = hdns_resolve_ex(io->loop, io->connect_host, &opt, nio_connect_resolved, io);
+    if (query == NULL) {
+        io->error = ERR_DNS_RESOLVE;
+        hio_close_async(io);
+        return ERR_DNS_RESOLVE;
+    }
+    io->dns_query = query;
+    io->connect_timer = htimer_add_coarse(io->loop, __connect_timeout_cb, timeout, 1);
+    io->connect_timer->privdata = io;
+    return 0;
+}
+#endif
+
 int hio_connect(hio_t* io) {
+#ifdef OS_UNIX
+    if (io->connect_host) {
+        // NOTE: hostname of hio_create_socket, connect when resolved
+        return nio_connect_resolve(io);
+    }
+#endif
+#ifdef EVENT_IO_URING
+    if (iouring_enable(io)) {
+        // NOTE: IORING_OP_CONNECT will be submitted by iowatcher_add_event
+        return nio_connect_inprogress(io);
+    }
+#endif
     int ret = connect(io->fd, io->peeraddr, SOCKADDR_LEN(io->peeraddr));
 #ifdef OS_WIN
     if (ret < 0 && socket_errno() != WSAEWOULDBLOCK) {
@@ -491,11 +790,7 @@ int hio_connect(hio_t* io) {
         nio_connect_async(io);
         return 0;
     }
-    int timeout = io->connect_timeout ? io->connect_timeout : HIO_DEFAULT_CONNECT_TIMEOUT;
-    io->connect_timer = htimer_add(io->loop, __connect_timeout_cb, timeout, 1);
-    io->connect_timer->privdata = io;
-    io->connect = 1;
-    return hio_add(io, hio_handle_events, HV_WRITE);
+    return nio_connect_inprogress(io);
 }
 
 int hio_read (hio_t* io) {
@@ -503,6 +798,10 @@ int hio_read (hio_t* io) {
         hloge("hio_read called but fd[%d] already closed!", io->fd);
         return -1;
     }
+#ifdef EVENT_IO_URING
+    // NOTE: IORING_OP_RECV will be submitted by iowatcher_add_event
+    iouring_enable(io);
+#endif
     hio_add(io, hio_handle_events, HV_READ);
     if (io->readbuf.tail > io->readbuf.head &&
         io->unpack_setting == NULL &&
@@ -512,23 +811,67 @@ int hio_read (hio_t* io) {
     return 0;
 }
 
-static int hio_write4 (hio_t* io, const void* buf, size_t len, struct sockaddr* addr) {
-    if (io->closed) {
-        hloge("hio_write called but fd[%d] already closed!", io->fd);
-        return -1;
+static char* nio_gather_iov(const struct iovec* iov, int iovcnt, size_t* plen) {
+    size_t len = 0;
+    int i;
+    for (i = 0; i < iovcnt; ++i) {
+        len += iov[i].iov_len;
+    }
+    char* buf = NULL;
+    HV_ALLOC(buf, len);
+    char* dst = buf;
+    for (i = 0; i < iovcnt; ++i) {
+        memcpy(dst, iov[i].iov_base, iov[i].iov_len);
+        dst += iov[i].iov_len;
+    }
+    *plen = len;
+    return buf;
+}
+
+#ifdef EVENT_IO_URING
+static int nio_iouring_writev(hio_t* io, const struct iovec* iov, int iovcnt) {
+    hio_wbuf_t wbuf;
+    memset(&wbuf, 0, sizeof(wbuf));
+    wbuf.fd = -1;
+    wbuf.base = nio_gather_iov(iov, iovcnt, &wbuf.len);
+    return iouring_write(io, &wbuf);
+}
+#endif
+
+static void nio_write_cb_iov(hio_t* io, const struct iovec* iov, int iovcnt, int nwrite) {
+    int i, n;
+    for (i = 0; i < iovcnt && nwrite > 0 && !io->closed; ++i) {
+        n = iov[i].iov_len < (size_t)nwrite ? (int)iov[i].iov_len : nwrite;
+        if (n == 0) continue;
+        __write_cb(io, iov[i].iov_base, n);
+        nwrite -= n;
+    }
+}
+
+// @param owned: NULL means copy the unwritten part of iov into write_queue,
+// otherwise queue owned (iovcnt == 1) without copy, and release it once written or failed.
+static int nio_write_iov(hio_t* io, const struct iovec* iov, int iovcnt, struct sockaddr* addr, hio_wbuf_t* owned) {
+    size_t len = 0;
+    int i;
+    for (i = 0; i < iovcnt; ++i) {
+        len += iov[i].iov_len;
     }
     int nwrite = 0, err = 0;
     hrecursive_mutex_lock(&io->write_mutex);
 #if WITH_KCP
     if (io->io_type == HIO_TYPE_KCP) {
-        nwrite = hio_write_kcp(io, buf, len, addr);
+        // NOTE: iovcnt == 1, see hio_writev
+        nwrite = hio_write_kcp(io, iov->iov_base, len, addr);
         // if (nwrite < 0) goto write_error;
         goto write_done;
     }
 #endif
     if (write_queue_empty(&io->write_queue)) {
-try_write:
-        nwrite = __nio_write(io, buf, len, addr);
+        if (iovcnt == 1) {
+            nwrite = __nio_write(io, iov->iov_base, len, addr);
+        } else {
+            nwrite = __nio_writev(io, iov, iovcnt);
+        }
         // printd("write retval=%d\n", nwrite);
         if (nwrite < 0) {
             err = socket_errno();
@@ -542,16 +885,19 @@ try_write:
                 goto write_error;
             }
         }
-        if (nwrite == len) {
+        if ((size_t)nwrite == len) {
             goto write_done;
         }
         if (nwrite == 0 && (io->io_type & HIO_TYPE_SOCK_STREAM)) {
             goto disconnect;
         }
 enqueue:
-        hio_add(io, hio_handle_events, HV_WRITE);
+        // NOTE: added by hio_migrate in the new loop
+        if (!io->migrating) {
+            hio_add(io, hio_handle_events, HV_WRITE);
+        }
     }
-    if (nwrite < len) {
+    if ((size_t)nwrite < len) {
         size_t unwritten_len = len - nwrite;
         if (io->write_bufsize + unwritten_len > io->max_write_bufsize) {
             hloge("write bufsize > %u, close it!", io->max_write_bufsize);
@@ -562,15 +908,35 @@ enqueue:
         if ((io->io_type & (HIO_TYPE_SOCK_DGRAM | HIO_TYPE_SOCK_RAW)) && addr) {
             addrlen = SOCKADDR_LEN(addr);
         }
-        offset_buf_t remain;
-        remain.offset = addrlen;
-        remain.len = addrlen + unwritten_len;
-        // NOTE: free in nio_write
-        HV_ALLOC(remain.base, remain.len);
-        if (addr && addrlen > 0) {
-            memcpy(remain.base, addr, addrlen);
+        hio_wbuf_t remain;
+        if (owned) {
+            // NOTE: no copy, free in nio_write
+            remain = *owned;
+            remain.offset = nwrite;
+        } else {
+            remain.offset = addrlen;
+            remain.len = addrlen + unwritten_len;
+            remain.free_cb = NULL;
+            remain.userdata = NULL;
+            remain.fd = -1;
+            // NOTE: free in nio_write
+            HV_ALLOC(remain.base, remain.len);
+            if (addr && addrlen > 0) {
+                memcpy(remain.base, addr, addrlen);
+            }
+            // NOTE: gather the unwritten parts of iov into one buffer
+            char* dst = remain.base + remain.offset;
+            size_t skip = nwrite;
+            for (i = 0; i < iovcnt; ++i) {
+                if (skip >= iov[i].iov_len) {
+                    skip -= iov[i].iov_len;
+                    continue;
+                }
+                memcpy(dst, (char*)iov[i].iov_base + skip, iov[i].iov_len - skip);
+                dst += iov[i].iov_len - skip;
+                skip = 0;
+            }
         }
-        memcpy(remain.base + remain.offset, ((char*)buf) + nwrite, unwritten_len);
         if (io->write_queue.maxsize == 0) {
             write_queue_init(&io->write_queue, 4);
         }
@@ -585,14 +951,28 @@ enqueue:
         }
     }
 write_done:
+    if (owned && nwrite >= 0 && (size_t)nwrite < len) {
+        // NOTE: queued owned buf may be freed by nio_write once unlocked, write_cb first.
+        if (nwrite > 0) {
+            nio_write_cb_iov(io, iov, iovcnt, nwrite);
+        }
+        hrecursive_mutex_unlock(&io->write_mutex);
+        return nwrite;
+    }
     hrecursive_mutex_unlock(&io->write_mutex);
     if (nwrite > 0) {
-        __write_cb(io, buf, nwrite);
+        nio_write_cb_iov(io, iov, iovcnt, nwrite);
+    }
+    if (owned) {
+        hio_wbuf_free(owned);
     }
     return nwrite;
 write_error:
 disconnect:
     hrecursive_mutex_unlock(&io->write_mutex);
+    if (owned) {
+        hio_wbuf_free(owned);
+    }
     /* NOTE:
      * We usually free resources in hclose_cb,
      * if hio_close_sync, we have to be very careful to avoid using freed resources.
@@ -604,6 +984,22 @@ disconnect:
     return nwrite < 0 ? nwrite : -1;
 }
 
+static int hio_write4 (hio_t* io, const void* buf, size_t len, struct sockaddr* addr) {
+    if (io->closed) {
+        hloge("hio_write called but fd[%d] already closed!", io->fd);
+        return -1;
+    }
+    struct iovec iov;
+    iov.iov_base = (void*)buf;
+    iov.iov_len = len;
+#ifdef EVENT_IO_URING
+    if (iouring_enable(io)) {
+        return nio_iouring_writev(io, &iov, 1);
+    }
+#endif
+    return nio_write_iov(io, &iov, 1, addr, NULL);
+}
+
 int hio_write (hio_t* io, const void* buf, size_t len) {
     return hio_write4(io, buf, len, io->peeraddr);
 }
@@ -612,6 +1008,103 @@ int hio_sendto (hio_t* io, const void* buf, size_t len, struct sockaddr* addr) {
     return hio_write4(io, buf, len, addr ? addr : io->peeraddr);
 }
 
+int hio_writev (hio_t* io, const struct iovec* iov, int iovcnt) {
+    if (io->closed) {
+        hloge("hio_writev called but fd[%d] already closed!", io->fd);
+        return -1;
+    }
+    if (iovcnt <= 0) return 0;
+    if (iovcnt == 1) {
+        return hio_write(io, iov->iov_base, iov->iov_len);
+    }
+#ifdef EVENT_IO_URING
+    if (iouring_enable(io)) {
+        return nio_iouring_writev(io, iov, iovcnt);
+    }
+#endif
+    if (!NIO_CAN_WRITEV(io) || iovcnt > IOV_MAX) {
+        // NOTE: ssl record, datagram and kcp segment are written as a whole.
+        size_t len = 0;
+        char* buf = nio_gather_iov(iov, iovcnt, &len);
+        int nwrite = hio_write(io, buf, len);
+        HV_FREE(buf);
+        return nwrite;
+    }
+    return nio_write_iov(io, iov, iovcnt, io->peeraddr, NULL);
+}
+
+int hio_write_owned(hio_t* io, void* buf, size_t len, hfree_cb free_cb, void* userdata) {
+    hio_wbuf_t owned;
+    owned.base = (char*)buf;
+    owned.len = len;
+    owned.offset = 0;
+    owned.free_cb = free_cb;
+    owned.userdata = userdata;
+    owned.fd = -1;
+    if (io->closed) {
+        hloge("hio_write_owned called but fd[%d] already closed!", io->fd);
+        hio_wbuf_free(&owned);
+        return -1;
+    }
+#ifdef EVENT_IO_URING
+    if (iouring_enable(io)) {
+        return iouring_write(io, &owned);
+    }
+#endif
+    if (io->io_type & (HIO_TYPE_SOCK_DGRAM | HIO_TYPE_SOCK_RAW)) {
+        // NOTE: datagram is queued with its peeraddr, copy it.
+        int nwrite = hio_write(io, buf, len);
+        hio_wbuf_free(&owned);
+        return nwrite;
+    }
+    struct iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    return nio_write_iov(io, &iov, 1, io->peeraddr, &owned);
+}
+
+int hio_sendfile(hio_t* io, int fd, size_t offset, size_t length) {
+    if (io->closed) {
+        hloge("hio_sendfile called but fd[%d] already closed!", io->fd);
+        return -1;
+    }
+    if (io->io_type & (HIO_TYPE_SOCK_DGRAM | HIO_TYPE_SOCK_RAW)) {
+        hloge("hio_sendfile not supported by io_type=%d", (int)io->io_type);
+        return -1;
+    }
+    if (length == 0) return 0;
+    hio_wbuf_t seg;
+    seg.base = NULL;
+    seg.offset = offset;
+    seg.len = offset + length;
+    seg.free_cb = NULL;
+    seg.userdata = NULL;
+    seg.fd = dup(fd);
+    if (seg.fd < 0) {
+        hloge("hio_sendfile dup fd[%d] error: %s", fd, strerror(errno));
+        return -1;
+    }
+#ifdef EVENT_IO_URING
+    if (iouring_enable(io)) {
+        // NOTE: file segment is not limited by max_write_bufsize.
+        iouring_write(io, &seg);
+        return 0;
+    }
+#endif
+    hrecursive_mutex_lock(&io->write_mutex);
+    // NOTE: always queued after the pending data, sent by nio_write when writable.
+    if (io->write_queue.maxsize == 0) {
+        write_queue_init(&io->write_queue, 4);
+    }
+    write_queue_push_back(&io->write_queue, &seg);
+    io->write_filesize += length;
+    if (!io->migrating) {
+        hio_add(io, hio_handle_events, HV_WRITE);
+    }
+    hrecursive_mutex_unlock(&io->write_mutex);
+    return 0;
+}
+
 int hio_close (hio_t* io) {
     if (io->closed) return 0;
     if (io->destroy == 0 && hv_gettid() != io->loop->tid) {
@@ -628,7 +1121,7 @@ int hio_close (hio_t* io) {
         hrecursive_mutex_unlock(&io->write_mutex);
         hlogw("write_queue not empty, close later.");
         int timeout_ms = io->close_timeout ? io->close_timeout : HIO_DEFAULT_CLOSE_TIMEOUT;
-        io->close_timer = htimer_add(io->loop, __close_timeout_cb, timeout_ms, 1);
+        io->close_timer = htimer_add_coarse(io->loop, __close_timeout_cb, timeout_ms, 1);
         io->close_timer->privdata = io;
         return 0;
     }
@@ -212,7 +212,7 @@ end:
     }
 }
 
-static void hio_handle_events(hio_t* io) {
+void hio_handle_events(hio_t* io) {
     if ((io->events & HV_READ) && (io->revents & HV_READ)) {
         if (io->accept) {
             on_acceptex_complete(io);
@@ -387,6 +387,43 @@ int hio_sendto (hio_t* io, const void* buf, size_t len, struct sockaddr* addr) {
     return hio_write4(io, buf, len, addr ? addr : io->peeraddr);
 }
 
+int hio_write_owned(hio_t* io, void* buf, size_t len, hfree_cb free_cb, void* userdata) {
+    // NOTE: overlapped send copies the unsent data anyway.
+    int nwrite = hio_write4(io, buf, len, io->peeraddr);
+    if (free_cb) {
+        free_cb(buf, userdata);
+    } else {
+        hv_free(buf);
+    }
+    return nwrite;
+}
+
+int hio_writev (hio_t* io, const struct iovec* iov, int iovcnt) {
+    // NOTE: overlapped send copies the unsent data anyway, concatenate iov.
+    size_t len = 0;
+    int i;
+    for (i = 0; i < iovcnt; ++i) {
+        len += iov[i].iov_len;
+    }
+    char* buf = NULL;
+    HV_ALLOC(buf, len);
+    char* dst = buf;
+    for (i = 0; i < iovcnt; ++i) {
+        memcpy(dst, iov[i].iov_base, iov[i].iov_len);
+        dst += iov[i].iov_len;
+    }
+    int nwrite = hio_write4(io, buf, len, io->peeraddr);
+    HV_FREE(buf);
+    return nwrite;
+}
+
+int hio_sendfile(hio_t* io, int fd, size_t offset, size_t length) {
+    // NOTE: TransmitFile not supported yet, caller should fallback to hio_write.
+    (void)io; (void)fd; (void)offset; (void)length;
+    errno = ENOTSUP;
+    return -1;
+}
+
 int hio_close (hio_t* io) {
     if (io->closed) return 0;
     io->closed = 1;
@@ -164,6 +164,30 @@ public:
         return write(str.data(), str.size());
     }
 
+    // NOTE: take ownership of str, no copy even if queued.
+    int write(std::string&& str) {
+        if (!isOpened()) return -1;
+        std::string* buf = new std::string(std::move(str));
+        return hio_write_owned(io_, (void*)buf->data(), buf->size(), free_string, buf);
+    }
+
+    int writev(const struct iovec* iov, int iovcnt) {
+        if (!isOpened()) return -1;
+        return hio_writev(io_, iov, iovcnt);
+    }
+
+    // NOTE: fd can be closed after return, see hio_sendfile.
+    int sendfile(int fd, size_t offset, size_t length) {
+        if (!isOpened()) return -1;
+        return hio_sendfile(io_, fd, offset, length);
+    }
+
+    // NOTE: must be called in the loop thread of io, see hio_migrate.
+    int migrate(hloop_t* loop) {
+        if (!isOpened()) return -1;
+        return hio_migrate(io_, loop);
+    }
+
     // iobuf setting
     void setReadBuf(void* buf, size_t len) {
         if (io_ == NULL) return;
@@ -196,6 +220,12 @@ public:
         return async ? hio_close_async(io_) : hio_close(io_);
     }
 
+    // hfree_cb of hio_write_owned for a std::string* passed as userdata
+    static void free_string(void* buf, void* userdata) {
+        (void)buf;
+        delete (std::string*)userdata;
+    }
+
 public:
     hio_t*      io_;
     int         fd_;
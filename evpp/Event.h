@@ -31,10 +31,12 @@ typedef std::function<void(int status, int naddrs, const sockaddr_u* addrs)> Dns
 struct Event {
     hevent_t        event;
     EventCallback   cb;
+    Event*          next; // intrusive queue of EventLoop::postEvent
 
     Event(EventCallback cb = NULL) {
         memset(&event, 0, sizeof(hevent_t));
         this->cb = std::move(cb);
+        next = NULL;
     }
 };
 
@@ -2,6 +2,7 @@
 #define HV_EVENT_LOOP_HPP_
 
 #include <functional>
+#include <atomic>
 #include <queue>
 #include <map>
 #include <mutex>
@@ -13,6 +14,9 @@
 #include "Event.h"
 #include "ThreadLocalStorage.h"
 
+// max Event nodes kept for reuse, by the loop and by each posting thread
+#define EVENT_LOOP_EVENT_POOL_SIZE  1024
+
 namespace hv {
 
 // EventLoop is a loop-bound wrapper around hloop_t.
@@ -37,11 +41,21 @@ public:
         connectionNum = 0;
         nextTimerID = 0;
         nextDnsID = 0;
+        pendingEvents = NULL;
+        runningEvents = NULL;
+        freeEvents = NULL;
+        recycledEvents = NULL;
+        nrecycledEvents = 0;
         setStatus(kInitialized);
     }
 
     ~EventLoop() {
         stop();
+        // events posted but not handled, and free events
+        deleteEvents(pendingEvents.exchange(NULL));
+        deleteEvents(runningEvents);
+        deleteEvents(freeEvents.exchange(NULL));
+        deleteEvents(recycledEvents);
     }
 
     hloop_t* loop() {
@@ -154,6 +168,36 @@ public:
         return hloop_tid(loop_);
     }
 
+    // @return accumulated busy time in us, see hloop_busy_time
+    uint64_t busyTime() {
+        if (loop_ == NULL) return 0;
+        return hloop_busy_time(loop_);
+    }
+
+    // Stats interfaces: enableStats, stats, resetStats, see hloop_stats
+    void enableStats(bool on = true) {
+        if (loop_ == NULL) return;
+        hloop_enable_stats(loop_, on);
+    }
+
+    // stats thread-safe, but fields may be inconsistent with each other.
+    hloop_stats_t stats() {
+        hloop_stats_t st;
+        memset(&st, 0, sizeof(st));
+        st.max_cb_fd = -1;
+        if (loop_) {
+            hloop_stats(loop_, &st);
+        }
+        return st;
+    }
+
+    // resetStats thread-safe
+    void resetStats() {
+        runInLoop([this]() {
+            if (loop_) hloop_reset_stats(loop_);
+        });
+    }
+
     // DNS interfaces: resolveDns, cancelDns (mirror setTimer/killTimer).
     // resolveDns returns a use-after-free-proof DnsID: the EventLoop keeps a
     // DnsID -> DnsQuery map, and a stale id (completed/cancelled) makes
@@ -200,24 +244,30 @@ public:
     }
 
     void queueInLoop(Functor fn) {
-        postEvent([fn](Event* ev) {
-            (void)(ev);
-            if (fn) fn();
-        });
+        postEvent(std::bind(&EventLoop::invokeFunctor, std::move(fn)));
     }
 
+    // postEvent thread-safe
+    // Events are pushed to a lock-free MPSC stack, only the first one after
+    // the loop took all of them posts an hevent to wakeup the loop,
+    // then onCustomEvents handles all of them in posted order.
+    // Event nodes handled are recycled by the loop, see allocEvent.
     void postEvent(EventCallback cb) {
         if (loop_ == NULL) return;
 
-        EventPtr ev = std::make_shared<Event>(cb);
+        Event* ev = allocEvent();
+        ev->cb = std::move(cb);
+        ev->event.loop = loop_;
+        ev->event.event_type = HEVENT_TYPE_CUSTOM;
         hevent_set_userdata(&ev->event, this);
-        ev->event.cb = onCustomEvent;
 
-        mutex_.lock();
-        customEvents.push(ev);
-        mutex_.unlock();
+        Event* head = pendingEvents.load(std::memory_order_relaxed);
+        do {
+            ev->next = head;
+        } while (!pendingEvents.compare_exchange_weak(head, ev, std::memory_order_release, std::memory_order_relaxed));
+        if (head != NULL) return;
 
-        hloop_post_event(loop_, &ev->event);
+        wakeup();
     }
 
 private:
@@ -251,15 +301,106 @@ private:
         }
     }
 
-    static void onCustomEvent(hevent_t* hev) {
+    static void invokeFunctor(const Functor& fn) {
+        if (fn) fn();
+    }
+
+    void wakeup() {
+        hevent_t hev;
+        memset(&hev, 0, sizeof(hev));
+        hev.cb = onCustomEvents;
+        hevent_set_userdata(&hev, this);
+        hloop_post_event(loop_, &hev);
+    }
+
+    static void deleteEvents(Event* ev) {
+        while (ev) {
+            Event* next = ev->next;
+            delete ev;
+            ev = next;
+        }
+    }
+
+    // Event nodes free list, ABA-free without tagged pointers:
+    // the loop thread recycles nodes into recycledEvents, and publishes them to freeEvents
+    // only when it is empty, a posting thread takes all of freeEvents into its own cache.
+    struct EventCache {
+        Event*  head;
+        EventCache() : head(NULL) {}
+        ~EventCache() { deleteEvents(head); }
+    };
+
+    Event* allocEvent() {
+        static thread_local EventCache cache;
+        if (cache.head == NULL) {
+            cache.head = freeEvents.exchange(NULL, std::memory_order_acquire);
+        }
+        Event* ev = cache.head;
+        if (ev == NULL) {
+            return new Event;
+        }
+        cache.head = ev->next;
+        memset(&ev->event, 0, sizeof(hevent_t));
+        return ev;
+    }
+
+    // in loop thread
+    void recycleEvent(Event* ev) {
+        ev->cb = NULL;
+        if (nrecycledEvents >= EVENT_LOOP_EVENT_POOL_SIZE) {
+            delete ev;
+            return;
+        }
+        ev->next = recycledEvents;
+        recycledEvents = ev;
+        ++nrecycledEvents;
+    }
+
+    // in loop thread
+    void publishEvents() {
+        // NOTE: only the loop thread stores to freeEvents
+        if (recycledEvents && freeEvents.load(std::memory_order_relaxed) == NULL) {
+            freeEvents.store(recycledEvents, std::memory_order_release);
+            recycledEvents = NULL;
+            nrecycledEvents = 0;
+        }
+    }
+
+    static void onCustomEvents(hevent_t* hev) {
         EventLoop* loop = (EventLoop*)hevent_userdata(hev);
 
-        loop->mutex_.lock();
-        EventPtr ev = loop->customEvents.front();
-        loop->customEvents.pop();
-        loop->mutex_.unlock();
+        // take all, LIFO => FIFO
+        Event* ev = loop->pendingEvents.exchange(NULL, std::memory_order_acquire);
+        Event* events = NULL;
+        while (ev) {
+            Event* next = ev->next;
+            ev->next = events;
+            events = ev;
+            ev = next;
+        }
+        // after the events left by a throwing callback
+        if (loop->runningEvents == NULL) {
+            loop->runningEvents = events;
+        } else {
+            Event* tail = loop->runningEvents;
+            while (tail->next) tail = tail->next;
+            tail->next = events;
+        }
 
-        if (ev && ev->cb) ev->cb(ev.get());
+        while ((ev = loop->runningEvents) != NULL) {
+            loop->runningEvents = ev->next;
+            try {
+                if (ev->cb) ev->cb(ev);
+            } catch (...) {
+                loop->recycleEvent(ev);
+                loop->publishEvents();
+                // the rest are handled by the next wakeup
+                if (loop->runningEvents) loop->wakeup();
+                throw;
+            }
+            loop->recycleEvent(ev);
+        }
+        loop->publishEvents();
     }
 
     // C hdns completion callback (runs in loop thread). userdata == EventLoop*.
@@ -283,8 +424,11 @@ public:
 private:
     hloop_t*                    loop_;
     bool                        is_loop_owner;
-    std::mutex                  mutex_;
-    std::queue<EventPtr>        customEvents;   // GUAREDE_BY(mutex_)
+    std::atomic<Event*>         pendingEvents;  // lock-free MPSC stack, see postEvent
+    Event*                      runningEvents;  // taken from pendingEvents, in posted order
+    std::atomic<Event*>         freeEvents;     // published by the loop, taken by allocEvent
+    Event*                      recycledEvents; // to publish to freeEvents
+    int                         nrecycledEvents;
     std::map<TimerID, TimerPtr> timers;
     std::atomic<TimerID>        nextTimerID;
     std::map<DnsID, DnsQueryPtr> dns_queries;
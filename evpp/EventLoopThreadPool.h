@@ -3,6 +3,7 @@
 
 #include "EventLoopThread.h"
 #include "hbase.h"
+#include "htime.h"
 
 namespace hv {
 
@@ -12,6 +13,7 @@ public:
         setStatus(kInitializing);
         thread_num_ = thread_num;
         next_loop_idx_ = 0;
+        last_sample_hrtime_ = 0;
         setStatus(kInitialized);
     }
 
@@ -61,6 +63,26 @@ public:
         return ptr ? ptr->loop() : NULL;
     }
 
+    // @brief busy percent of each loop since the last call, see EventLoop::busyTime.
+    // NOTE: not thread-safe, call it periodically in one thread, returns all 0 for the first call.
+    std::vector<int> busyPercents() {
+        size_t numLoops = loop_threads_.size();
+        std::vector<int> percents(numLoops, 0);
+        uint64_t now = gethrtime_us();
+        uint64_t elapsed = now - last_sample_hrtime_;
+        bool sampled = last_sample_hrtime_ != 0 && last_busy_times_.size() == numLoops && elapsed != 0;
+        last_busy_times_.resize(numLoops);
+        for (size_t i = 0; i < numLoops; ++i) {
+            uint64_t busy = loop_threads_[i]->loop()->busyTime();
+            if (sampled && busy >= last_busy_times_[i]) {
+                percents[i] = MIN((busy - last_busy_times_[i]) * 100 / elapsed, 100);
+            }
+            last_busy_times_[i] = busy;
+        }
+        last_sample_hrtime_ = now;
+        return percents;
+    }
+
     // @param wait_threads_started: if ture this method will block until all loop_threads started.
     // @param pre: This functor will be executed when loop_thread started.
     // @param post:This Functor will be executed when loop_thread stopped.
@@ -131,6 +153,9 @@ private:
     int                                         thread_num_;
     std::vector<EventLoopThreadPtr>             loop_threads_;
     std::atomic<unsigned int>                   next_loop_idx_;
+    // for busyPercents
+    std::vector<uint64_t>                       last_busy_times_;
+    uint64_t                                    last_sample_hrtime_;
 };
 
 }
@@ -322,6 +322,10 @@ public:
     int send(const std::string& str) {
         return send(str.data(), str.size());
     }
+    int send(std::string&& str) {
+        if (!isConnected()) return -1;
+        return channel->write(std::move(str));
+    }
 
     int withTLS(hssl_ctx_opt_t* opt = NULL) {
         tls = true;
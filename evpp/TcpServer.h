@@ -26,6 +26,10 @@ public:
         unpack_setting = NULL;
         max_connections = 0xFFFFFFFF;
         load_balance = LB_RoundRobin;
+        rebalance_interval = 0;
+        rebalance_threshold = 0;
+        rebalance_max_migrations = 0;
+        rebalance_timer = INVALID_TIMER_ID;
     }
 
     virtual ~TcpServerEventLoopTmpl() {
@@ -70,6 +74,17 @@ public:
         load_balance = lb;
     }
 
+    // @brief Every interval_ms, if busy percent of the busiest worker loop exceeds the idlest one by threshold,
+    // migrate at most max_migrations idle channels between them, see Channel::migrate.
+    // NOTE: call before start, interval_ms <= 0 means disable.
+    // Not with io_uring, see hio_migrate. HttpServer and WebSocketServer have no rebalance,
+    // their HttpHandler is bound to the HttpMessagePool and HttpUpstreamPool of its worker loop.
+    void setRebalance(int interval_ms, int threshold = 20, int max_migrations = 64) {
+        rebalance_interval = interval_ms;
+        rebalance_threshold = threshold;
+        rebalance_max_migrations = max_migrations;
+    }
+
     // NOTE: totalThreadNum = 1 acceptor_thread + N worker_threads (N can be 0)
     void setThreadNum(int num) {
         worker_threads.setThreadNum(num);
@@ -119,10 +134,19 @@ public:
             worker_threads.start(wait_threads_started);
         }
         acceptor_loop->runInLoop(std::bind(&TcpServerEventLoopTmpl::startAccept, this));
+        if (rebalance_interval > 0 && worker_threads.threadNum() > 1 && rebalance_timer == INVALID_TIMER_ID) {
+            rebalance_timer = acceptor_loop->setInterval(rebalance_interval, [this](TimerID) {
+                rebalance();
+            });
+        }
     }
     // stop thread-safe
     // NOTE: When an external loop is supplied, this closes the listener but does not own that loop's lifetime.
     void stop(bool wait_threads_stopped = true) {
+        if (rebalance_timer != INVALID_TIMER_ID) {
+            acceptor_loop->killTimer(rebalance_timer);
+            rebalance_timer = INVALID_TIMER_ID;
+        }
         closesocket();
         if (worker_threads.threadNum() > 0) {
             worker_threads.stop(wait_threads_stopped);
@@ -251,6 +275,56 @@ private:
         }
     }
 
+    // run in acceptor_loop
+    void rebalance() {
+        if (worker_threads.status() != Status::kRunning) return;
+        std::vector<int> percents = worker_threads.busyPercents();
+        size_t numLoops = percents.size();
+        if (numLoops < 2) return;
+        size_t busiest = 0, idlest = 0;
+        for (size_t i = 1; i < numLoops; ++i) {
+            if (percents[i] > percents[busiest]) busiest = i;
+            if (percents[i] < percents[idlest]) idlest = i;
+        }
+        int diff = percents[busiest] - percents[idlest];
+        if (diff <= 0 || diff < rebalance_threshold) return;
+        EventLoopPtr from = worker_threads.loop(busiest);
+        EventLoopPtr to = worker_threads.loop(idlest);
+        // NOTE: assume load is proportional to connections, move half of the difference.
+        uint32_t num = (uint64_t)from->connectionNum * diff / percents[busiest] / 2;
+        num = MIN(num, rebalance_max_migrations);
+        if (num == 0) return;
+        hlogd("rebalance loop[%d] busy %d%% => loop[%d] busy %d%%, migrate %u connections",
+            (int)busiest, percents[busiest], (int)idlest, percents[idlest], num);
+        from->queueInLoop([this, from, to, num]() {
+            migrateChannels(from, to, num);
+        });
+    }
+
+    // run in from loop
+    void migrateChannels(const EventLoopPtr& from, const EventLoopPtr& to, uint32_t num) {
+        hloop_t* from_loop = from->loop();
+        hloop_t* to_loop = to->loop();
+        if (from_loop == NULL || to_loop == NULL) return;
+        std::vector<TSocketChannelPtr> candidates;
+        foreachChannel([from_loop, &candidates](const TSocketChannelPtr& channel) {
+            hio_t* io = channel->io();
+            if (io && hevent_loop(io) == from_loop) {
+                candidates.push_back(channel);
+            }
+        });
+        uint32_t migrated = 0;
+        for (auto& channel : candidates) {
+            if (migrated >= num) break;
+            // NOTE: skip channels with unread or unsent data, see hio_migrate
+            if (channel->migrate(to_loop) == 0) {
+                --from->connectionNum;
+                ++to->connectionNum;
+                ++migrated;
+            }
+        }
+    }
+
     static void onAccept(hio_t* connio) {
         TcpServerEventLoopTmpl* server = (TcpServerEventLoopTmpl*)hevent_userdata(connio);
         // NOTE: detach from acceptor loop
@@ -278,6 +352,11 @@ public:
 
     uint32_t                max_connections;
     load_balance_e          load_balance;
+    // for setRebalance
+    int                     rebalance_interval;
+    int                     rebalance_threshold;
+    uint32_t                rebalance_max_migrations;
+    TimerID                 rebalance_timer;
 
 private:
     // id => TSocketChannelPtr
@@ -217,33 +217,66 @@ int Handler::upload(const HttpContextPtr& ctx) {
     return response_status(ctx, status_code);
 }
 
+// userdata of recvLargeFile
+struct RecvFile {
+    HFile                   file;
+    hv::MultipartParser*    multipart;
+
+    RecvFile() : multipart(NULL) {}
+    ~RecvFile() {
+        if (multipart) delete multipart;
+    }
+};
+
 int Handler::recvLargeFile(const HttpContextPtr& ctx, http_parser_state state, const char* data, size_t size) {
     // printf("recvLargeFile state=%d\n", (int)state);
     int status_code = HTTP_STATUS_UNFINISHED;
-    HFile* file = (HFile*)ctx->userdata;
+    RecvFile* recv = (RecvFile*)ctx->userdata;
     switch (state) {
     case HP_HEADERS_COMPLETE:
         {
+            std::string save_path = "html/uploads/";
+            recv = new RecvFile;
+            ctx->userdata = recv;
             if (ctx->is(MULTIPART_FORM_DATA)) {
-                // NOTE: You can use multipart_parser if you want to use multipart/form-data.
-                ctx->close();
-                return HTTP_STATUS_BAD_REQUEST;
+                // parts are passed to callbacks as body arrives
+                std::string boundary = ctx->request->Boundary();
+                if (boundary.empty()) {
+                    ctx->close();
+                    return HTTP_STATUS_BAD_REQUEST;
+                }
+                recv->multipart = new hv::MultipartParser(boundary.c_str());
+                recv->multipart->onPartBegin = [recv, save_path](const std::string& name, const std::string& filename) {
+                    if (filename.empty()) return;
+                    std::string filepath = save_path + hv_basename(filename.c_str());
+                    recv->file.open(filepath.c_str(), "wb");
+                };
+                recv->multipart->onPartData = [recv](const char* data, size_t size) {
+                    if (recv->file.isopen()) recv->file.write(data, size);
+                };
+                recv->multipart->onPartEnd = [recv]() {
+                    recv->file.close();
+                };
+                break;
             }
-            std::string save_path = "html/uploads/";
             std::string filename = ctx->param("filename", "unnamed.txt");
             std::string filepath = save_path + filename;
-            file = new HFile;
-            if (file->open(filepath.c_str(), "wb") != 0) {
+            if (recv->file.open(filepath.c_str(), "wb") != 0) {
                 ctx->close();
                 return HTTP_STATUS_INTERNAL_SERVER_ERROR;
             }
-            ctx->userdata = file;
         }
         break;
     case HP_BODY:
         {
-            if (file && data && size) {
-                if (file->write(data, size) != size) {
+            if (recv && recv->multipart && data && size) {
+                if (recv->multipart->FeedRecvData(data, size) != size) {
+                    ctx->close();
+                    return HTTP_STATUS_BAD_REQUEST;
+                }
+            }
+            else if (recv && data && size) {
+                if (recv->file.write(data, size) != size) {
                     ctx->close();
                     return HTTP_STATUS_INTERNAL_SERVER_ERROR;
                 }
@@ -255,17 +288,17 @@ int Handler::recvLargeFile(const HttpContextPtr& ctx, http_parser_state state, c
             status_code = HTTP_STATUS_OK;
             ctx->setContentType(APPLICATION_JSON);
             response_status(ctx, status_code);
-            if (file) {
-                delete file;
+            if (recv) {
+                delete recv;
                 ctx->userdata = NULL;
             }
         }
         break;
     case HP_ERROR:
         {
-            if (file) {
-                file->remove();
-                delete file;
+            if (recv) {
+                if (recv->file.isopen()) recv->file.remove();
+                delete recv;
                 ctx->userdata = NULL;
             }
         }
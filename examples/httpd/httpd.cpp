@@ -112,6 +112,9 @@ int parse_confile(const char* confile) {
         g_http_server.worker_connections = atoi(str.c_str());
     }
 
+    // reuseport
+    g_http_server.reuseport = ini.Get<bool>("reuseport");
+
     // http_port
     int port = 0;
     const char* szPort = get_arg("p");
@@ -169,6 +172,29 @@ int parse_confile(const char* confile) {
     if (str.size() != 0) {
         g_http_service.limit_rate = atoi(str.c_str());
     }
+    // precompressed
+    str = ini.GetValue("precompressed");
+    if (str.size() != 0) {
+        g_http_service.enable_precompressed = hv_getboolean(str.c_str());
+    }
+    // compression
+    str = ini.GetValue("compression");
+    if (str.size() != 0) {
+        g_http_service.enable_compression = hv_getboolean(str.c_str());
+    }
+    str = ini.GetValue("compression_min_length");
+    if (str.size() != 0) {
+        g_http_service.compression_min_length = atoi(str.c_str());
+    }
+    // body_spill_size
+    str = ini.GetValue("body_spill_size");
+    if (str.size() != 0) {
+        g_http_service.body_spill_size = hv_parse_size(str.c_str());
+    }
+    str = ini.GetValue("upload_dir");
+    if (str.size() != 0) {
+        g_http_service.upload_dir = str;
+    }
     // access_log
     str = ini.GetValue("access_log");
     if (str.size() != 0) {
@@ -190,6 +216,7 @@ int parse_confile(const char* confile) {
         param.key_file = key_file.c_str();
         param.ca_file = ca_file.c_str();
         param.endpoint = HSSL_SERVER;
+        param.ktls = ini.Get<bool>("ssl_ktls");
         if (g_http_server.newSslCtx(&param) != 0) {
 #ifdef OS_WIN
             if (strcmp(hssl_backend(), "schannel") == 0) {
@@ -226,6 +253,12 @@ int parse_confile(const char* confile) {
         else if (strcmp(proxy_key.c_str(), "proxy_write_timeout") == 0) {
             g_http_service.proxy_write_timeout = atoi(str.c_str());
         }
+        else if (strcmp(proxy_key.c_str(), "proxy_keepalive") == 0) {
+            g_http_service.proxy_keepalive = atoi(str.c_str());
+        }
+        else if (strcmp(proxy_key.c_str(), "proxy_keepalive_timeout") == 0) {
+            g_http_service.proxy_keepalive_timeout = atoi(str.c_str());
+        }
         else if (strcmp(proxy_key.c_str(), "forward_proxy") == 0) {
             hlogi("forward_proxy = %s", str.c_str());
             if (hv_getboolean(str.c_str())) {
@@ -251,6 +284,44 @@ int parse_confile(const char* confile) {
             }
         }
     }
+    // upstream
+    // name = [round_robin|random|least_conn|ip_hash|url_hash;] host:port [weight=1] [max_fails=1] [fail_timeout=10]; ...
+    auto upstream_names = ini.GetKeys("upstream");
+    for (const auto& upstream_name : upstream_names) {
+        str = ini.GetValue(upstream_name, "upstream");
+        if (str.empty()) continue;
+        hv::HttpUpstreamGroup* group = NULL;
+        load_balance_e lb = LB_RoundRobin;
+        auto items = hv::split(str, ';');
+        for (auto item : items) {
+            item = hv::trim(item);
+            if (item.empty()) continue;
+            if (group == NULL) {
+                if      (item == "round_robin") lb = LB_RoundRobin;
+                else if (item == "random")      lb = LB_Random;
+                else if (item == "least_conn")  lb = LB_LeastConnections;
+                else if (item == "ip_hash")     lb = LB_IpHash;
+                else if (item == "url_hash")    lb = LB_UrlHash;
+                group = g_http_service.Upstream(upstream_name.c_str(), lb);
+                // NOTE: servers are in use, not reloaded
+                if (group->Size() != 0) break;
+                if (item.find(':') == std::string::npos) continue;
+            }
+            auto params = hv::split(item, ' ');
+            int weight = 1;
+            int max_fails = DEFAULT_UPSTREAM_MAX_FAILS;
+            int fail_timeout = DEFAULT_UPSTREAM_FAIL_TIMEOUT;
+            for (size_t i = 1; i < params.size(); ++i) {
+                auto kv = hv::split(params[i], '=');
+                if (kv.size() != 2) continue;
+                if      (kv[0] == "weight")         weight = atoi(kv[1].c_str());
+                else if (kv[0] == "max_fails")      max_fails = atoi(kv[1].c_str());
+                else if (kv[0] == "fail_timeout")   fail_timeout = atoi(kv[1].c_str());
+            }
+            hlogi("upstream %s server %s weight=%d", upstream_name.c_str(), params[0].c_str(), weight);
+            group->AddServer(params[0], weight, max_fails, fail_timeout);
+        }
+    }
 
     hlogi("parse_confile('%s') OK", confile);
     return 0;
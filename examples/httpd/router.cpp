@@ -141,6 +141,7 @@ void Router::Register(hv::HttpService& router) {
     // curl -v http://ip:port/upload -F 'file=@LICENSE'
     router.POST("/upload", Handler::upload);
     // curl -v http://ip:port/upload/README.md -d '@README.md'
+    // curl -v http://ip:port/upload/multipart -F 'file=@README.md'
     router.POST("/upload/{filename}", Handler::recvLargeFile);
 
     // SSE: Server Send Events
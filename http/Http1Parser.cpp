@@ -2,6 +2,9 @@
 
 #define MAX_CONTENT_LENGTH  (1 << 24)   // 16M
 
+// NOTE: body of response with http_cb is handled by http_cb, not stored, e.g. reverse proxy
+#define RESERVE_BODY(hp) ((hp)->parsed->type == HTTP_REQUEST || (hp)->parsed->http_cb == NULL)
+
 static int on_url(http_parser* parser, const char *at, size_t length);
 static int on_status(http_parser* parser, const char *at, size_t length);
 static int on_header_field(http_parser* parser, const char *at, size_t length);
@@ -122,7 +125,7 @@ int on_headers_complete(http_parser* parser) {
         size_t content_length = atoll(iter->second.c_str());
         hp->parsed->content_length = content_length;
         size_t reserve_length = MIN(content_length + 1, MAX_CONTENT_LENGTH);
-        if ((!skip_body) && reserve_length > hp->parsed->body.capacity()) {
+        if ((!skip_body) && RESERVE_BODY(hp) && reserve_length > hp->parsed->body.capacity()) {
             hp->parsed->body.reserve(reserve_length);
         }
     }
@@ -144,7 +147,7 @@ int on_chunk_header(http_parser* parser) {
     Http1Parser* hp = (Http1Parser*)parser->data;
     int chunk_size = parser->content_length;
     int reserve_size = MIN(chunk_size + 1, MAX_CONTENT_LENGTH);
-    if (reserve_size > hp->parsed->body.capacity()) {
+    if (RESERVE_BODY(hp) && reserve_size > hp->parsed->body.capacity()) {
         hp->parsed->body.reserve(reserve_size);
     }
     hp->state = HP_CHUNK_HEADER;
@@ -159,3 +162,257 @@ int on_chunk_complete(http_parser* parser) {
     hp->invokeHttpCb();
     return 0;
 }
+
+//------------------------------fast path------------------------------------
+// Complete requests with common methods, URL and headers in one read are parsed
+// here without the state machine, others are left to http_parser.
+// SIMD is selected at compile time: SSE2 is the baseline on x86_64,
+// SSE4.2 and AVX2 are used if enabled by compiler flags, e.g. -march=native.
+#ifdef __GNUC__
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#endif
+
+#define HTTP1_FAST_MAX_HEADERS  64
+
+// RFC7230: tchar = "!" / "#" / "$" / "%" / "&" / "'" / "*" / "+" / "-" / "." / "^" / "_" / "`" / "|" / "~" / DIGIT / ALPHA
+static inline bool is_tchar(unsigned char c) {
+    if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) return true;
+    switch (c) {
+    case '!': case '#': case '$': case '%': case '&': case '\'': case '*': case '+':
+    case '-': case '.': case '^': case '_': case '`': case '|': case '~':
+        return true;
+    default:
+        return false;
+    }
+}
+
+// @return first byte not tchar
+static inline const char* scan_token(const char* p, const char* end) {
+    while (p != end) {
+#if defined(__GNUC__) && defined(__SSE4_2__)
+        // ranges of not tchar, except '|' and '~' which are checked one by one
+        static const char ranges[] = "\x00 " "\"\"" "()" ",," "//" ":@" "[]" "{\xff";
+        const __m128i r = _mm_loadu_si128((const __m128i*)ranges);
+        for (; end - p >= 16; p += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)p);
+            int idx = _mm_cmpestri(r, 16, v, 16, _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+            if (idx != 16) {
+                p += idx;
+                break;
+            }
+        }
+        if (p == end) break;
+#endif
+        if (!is_tchar(*p)) break;
+        ++p;
+    }
+    return p;
+}
+
+// @return first byte of CTL or SP or non-ASCII
+static inline const char* scan_url(const char* p, const char* end) {
+#if defined(__GNUC__) && defined(__AVX2__)
+    const __m256i sp32 = _mm256_set1_epi8(0x20);
+    const __m256i del32 = _mm256_set1_epi8(0x7f);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        // signed compare, non-ASCII is negative
+        __m256i ok = _mm256_and_si256(_mm256_cmpgt_epi8(v, sp32), _mm256_cmpgt_epi8(del32, v));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(ok);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__GNUC__) && defined(__SSE2__)
+    const __m128i sp = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, sp), _mm_cmplt_epi8(v, del));
+        unsigned mask = (unsigned)_mm_movemask_epi8(ok) ^ 0xFFFF;
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p != end; ++p) {
+        unsigned char c = *p;
+        if (c <= 0x20 || c >= 0x7f) break;
+    }
+    return p;
+}
+
+// @return first byte of CTL except HTAB
+static inline const char* scan_header_value(const char* p, const char* end) {
+#if defined(__GNUC__) && defined(__AVX2__)
+    const __m256i ctl32 = _mm256_set1_epi8(0x1f);
+    const __m256i tab32 = _mm256_set1_epi8('\t');
+    const __m256i del32 = _mm256_set1_epi8(0x7f);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        // unsigned v <= 0x1f
+        __m256i m = _mm256_cmpeq_epi8(_mm256_max_epu8(v, ctl32), ctl32);
+        m = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab32), m);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, del32));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__GNUC__) && defined(__SSE2__)
+    const __m128i ctl = _mm_set1_epi8(0x1f);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i del = _mm_set1_epi8(0x7f);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i m = _mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl);
+        m = _mm_andnot_si128(_mm_cmpeq_epi8(v, tab), m);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, del));
+        unsigned mask = (unsigned)_mm_movemask_epi8(m);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p != end; ++p) {
+        unsigned char c = *p;
+        if ((c < 0x20 && c != '\t') || c == 0x7f) break;
+    }
+    return p;
+}
+
+static bool parse_content_length(const char* value, size_t len, int64_t* content_length) {
+    // up to 15 digits, no overflow
+    if (len == 0 || len > 15) return false;
+    int64_t n = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (value[i] < '0' || value[i] > '9') return false;
+        n = n * 10 + (value[i] - '0');
+    }
+    *content_length = n;
+    return true;
+}
+
+struct http1_fast_header {
+    const char* field;
+    const char* value;
+    size_t      field_len;
+    size_t      value_len;
+};
+
+int Http1Parser::parseRequest(const char* data, size_t len) {
+    static const struct {
+        const char*     str; // with SP
+        size_t          len;
+        http_method     method;
+    } methods[] = {
+        { "GET ",       4,  HTTP_GET },
+        { "POST ",      5,  HTTP_POST },
+        { "PUT ",       4,  HTTP_PUT },
+        { "DELETE ",    7,  HTTP_DELETE },
+        { "HEAD ",      5,  HTTP_HEAD },
+        { "OPTIONS ",   8,  HTTP_OPTIONS },
+        { "PATCH ",     6,  HTTP_PATCH },
+    };
+    const char* p = data;
+    const char* end = data + len;
+
+    // request-line: method SP /path SP HTTP/1.x CRLF
+    int method = -1;
+    for (size_t i = 0; i < ARRAY_SIZE(methods); ++i) {
+        if (len > methods[i].len && memcmp(p, methods[i].str, methods[i].len) == 0) {
+            method = methods[i].method;
+            p += methods[i].len;
+            break;
+        }
+    }
+    if (method < 0 || *p != '/') return -1;
+    const char* url_begin = p;
+    p = scan_url(p, end);
+    const char* url_end = p;
+    if (end - p < 11 || memcmp(p, " HTTP/1.", 8) != 0 ||
+        (p[8] != '1' && p[8] != '0') || p[9] != '\r' || p[10] != '\n') {
+        return -1;
+    }
+    int http_minor = p[8] - '0';
+    p += 11;
+
+    // headers: field-name ":" OWS field-value CRLF
+    http1_fast_header headers[HTTP1_FAST_MAX_HEADERS];
+    int nheaders = 0;
+    int64_t content_length = -1;
+    for (;;) {
+        if (end - p < 2) return -1;
+        if (*p == '\r') {
+            if (p[1] != '\n') return -1;
+            p += 2;
+            break;
+        }
+        if (nheaders == HTTP1_FAST_MAX_HEADERS) return -1;
+        http1_fast_header& header = headers[nheaders++];
+        header.field = p;
+        p = scan_token(p, end);
+        header.field_len = p - header.field;
+        if (header.field_len == 0 || p == end || *p != ':') return -1;
+        ++p;
+        while (p != end && (*p == ' ' || *p == '\t')) ++p;
+        header.value = p;
+        p = scan_header_value(p, end);
+        header.value_len = p - header.value;
+        if (end - p < 3 || p[0] != '\r' || p[1] != '\n') return -1;
+        p += 2;
+        // obs-fold
+        if (*p == ' ' || *p == '\t') return -1;
+
+        // leave framing other than Content-Length and upgrade to http_parser
+        switch (header.field_len) {
+        case 7:
+            if (strncasecmp(header.field, "Upgrade", 7) == 0) return -1;
+            break;
+        case 14:
+            if (strncasecmp(header.field, "Content-Length", 14) == 0) {
+                if (content_length >= 0) return -1;
+                if (!parse_content_length(header.value, header.value_len, &content_length)) return -1;
+            }
+            break;
+        case 17:
+            if (strncasecmp(header.field, "Transfer-Encoding", 17) == 0) return -1;
+            break;
+        default:
+            break;
+        }
+    }
+    if (p - data > HTTP_MAX_HEADER_SIZE) return -1;
+    // body: exactly Content-Length, partial or pipelined data is left to http_parser
+    size_t body_len = end - p;
+    if (body_len != (content_length < 0 ? 0 : (size_t)content_length)) return -1;
+
+    // same callbacks as http_parser
+    state = HP_MESSAGE_BEGIN;
+    invokeHttpCb();
+    state = HP_URL;
+    url.assign(url_begin, url_end - url_begin);
+    for (int i = 0; i < nheaders; ++i) {
+        header_field.assign(headers[i].field, headers[i].field_len);
+        header_value.assign(headers[i].value, headers[i].value_len);
+        state = HP_HEADER_VALUE;
+        handle_header();
+    }
+    parser.http_major = 1;
+    parser.http_minor = http_minor;
+    parser.method = method;
+    on_headers_complete(&parser);
+    if (body_len) {
+        on_body(&parser, p, body_len);
+    }
+    on_message_complete(&parser);
+    return len;
+}
+
+int Http1Parser::FeedRecvData(const char* data, size_t len) {
+    if (len != 0 && state == HP_START_REQ_OR_RES && parser.type == HTTP_REQUEST) {
+        int nparse = parseRequest(data, len);
+        if (nparse >= 0) return nparse;
+    }
+    return http_parser_execute(&parser, &cbs, data, len);
+}
@@ -52,9 +52,8 @@ public:
         return sendbuf.size();
     }
 
-    virtual int FeedRecvData(const char* data, size_t len) {
-        return http_parser_execute(&parser, &cbs, data, len);
-    }
+    // NOTE: a complete request in data is parsed by parseRequest, others by http_parser.
+    virtual int FeedRecvData(const char* data, size_t len);
 
     virtual int  GetState() {
         return (int)state;
@@ -134,6 +133,11 @@ public:
         parsed->http_cb(parsed, state, data, size);
         return 0;
     }
+
+protected:
+    // fast path of common requests, vectorized by SSE2/SSE4.2/AVX2 if enabled
+    // @retval len parsed, -1 fallback to http_parser without any callback called.
+    int parseRequest(const char* data, size_t len);
 };
 
 #endif // HV_HTTP1_PARSER_H_
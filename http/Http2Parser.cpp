@@ -36,11 +36,13 @@ static int on_data_chunk_recv_callback(nghttp2_session *session,
         size_t len, void *userdata);
 static int on_frame_recv_callback(nghttp2_session *session,
         const nghttp2_frame *frame, void *userdata);
-/*
+static int on_begin_headers_callback(nghttp2_session *session,
+        const nghttp2_frame *frame, void *userdata);
+static int on_stream_close_callback(nghttp2_session *session,
+        int32_t stream_id, uint32_t error_code, void *userdata);
 static ssize_t data_source_read_callback(nghttp2_session *session,
         int32_t stream_id, uint8_t *buf, size_t length,
         uint32_t *data_flags, nghttp2_data_source *source, void *userdata);
-*/
 
 
 Http2Parser::Http2Parser(http_session_type type) {
@@ -49,6 +51,8 @@ Http2Parser::Http2Parser(http_session_type type) {
         nghttp2_session_callbacks_set_on_header_callback(cbs, on_header_callback);
         nghttp2_session_callbacks_set_on_data_chunk_recv_callback(cbs, on_data_chunk_recv_callback);
         nghttp2_session_callbacks_set_on_frame_recv_callback(cbs, on_frame_recv_callback);
+        nghttp2_session_callbacks_set_on_begin_headers_callback(cbs, on_begin_headers_callback);
+        nghttp2_session_callbacks_set_on_stream_close_callback(cbs, on_stream_close_callback);
     }
     if (type == HTTP_CLIENT) {
         nghttp2_session_client_new(&session, cbs, this);
@@ -63,6 +67,7 @@ Http2Parser::Http2Parser(http_session_type type) {
     parsed = NULL;
     stream_id = -1;
     stream_closed = 0;
+    goaway = 0;
 
     nghttp2_settings_entry settings[] = {
         {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, 100}
@@ -79,13 +84,24 @@ Http2Parser::~Http2Parser() {
         nghttp2_session_del(session);
         session = NULL;
     }
+    for (auto& pair : streams) {
+        delete pair.second;
+    }
+    streams.clear();
 }
 
 int Http2Parser::GetSendData(char** data, size_t* len) {
     // HTTP2_MAGIC,HTTP2_SETTINGS,HTTP2_HEADERS
-    *len = nghttp2_session_mem_send(session, (const uint8_t**)data);
-    printd("nghttp2_session_mem_send %d\n", *len);
+    ssize_t nsend = nghttp2_session_mem_send(session, (const uint8_t**)data);
+    printd("nghttp2_session_mem_send %d\n", (int)nsend);
+    if (nsend < 0) {
+        error = nsend;
+        nsend = 0;
+    }
+    *len = nsend;
     if (*len != 0) return *len;
+    // NOTE: server streams are all sent by nghttp2_session_mem_send
+    if (type == HTTP_SERVER) return 0;
 
     if (submited == NULL) return 0;
     // HTTP2_DATA
@@ -181,9 +197,8 @@ int Http2Parser::FeedRecvData(const char* data, size_t len) {
     return (int)ret;
 }
 
-int Http2Parser::SubmitRequest(HttpRequest* req) {
-    submited = req;
-
+// NOTE: nvs refer to req and authority, keep them until submitted.
+static void make_request_nvs(HttpRequest* req, std::vector<nghttp2_nv>& nvs, char* authority, int authority_size) {
     req->FillContentType();
     req->FillContentLength();
     if (req->ContentType() == APPLICATION_GRPC) {
@@ -194,8 +209,6 @@ int Http2Parser::SubmitRequest(HttpRequest* req) {
         req->headers["grpc-accept-encoding"] = "identity";
     }
 
-    std::vector<nghttp2_nv> nvs;
-    char c_str[256] = {0};
     req->ParseUrl();
     nvs.push_back(make_nv(":method", http_method_str(req->method)));
     nvs.push_back(make_nv(":path", req->path.c_str()));
@@ -206,8 +219,8 @@ int Http2Parser::SubmitRequest(HttpRequest* req) {
         nvs.push_back(make_nv(":authority", req->host.c_str()));
     }
     else {
-        snprintf(c_str, sizeof(c_str), "%s:%d", req->host.c_str(), req->port);
-        nvs.push_back(make_nv(":authority", c_str));
+        snprintf(authority, authority_size, "%s:%d", req->host.c_str(), req->port);
+        nvs.push_back(make_nv(":authority", authority));
     }
     const char* name;
     const char* value;
@@ -229,6 +242,14 @@ int Http2Parser::SubmitRequest(HttpRequest* req) {
         }
         nvs.push_back(make_nv2(name, value, header.first.size(), header.second.size()));
     }
+}
+
+int Http2Parser::SubmitRequest(HttpRequest* req) {
+    submited = req;
+
+    std::vector<nghttp2_nv> nvs;
+    char c_str[256] = {0};
+    make_request_nvs(req, nvs, c_str, sizeof(c_str));
     int flags = NGHTTP2_FLAG_END_HEADERS;
     // we set EOS on DATA frame
     stream_id = nghttp2_submit_headers(session, flags, -1, NULL, &nvs[0], nvs.size(), NULL);
@@ -241,6 +262,10 @@ int Http2Parser::SubmitRequest(HttpRequest* req) {
 }
 
 int Http2Parser::SubmitResponse(HttpResponse* res) {
+    if (type == HTTP_SERVER && GetStream(stream_id)) {
+        // respond the last stream
+        return SubmitResponse(stream_id, res, true);
+    }
     submited = res;
 
     res->FillContentType();
@@ -308,6 +333,154 @@ int Http2Parser::InitRequest(HttpRequest* req) {
     return 0;
 }
 
+int Http2Parser::SubmitResponse(int32_t stream_id, HttpResponse* res, bool eof) {
+    http2_stream* stream = GetStream(stream_id);
+    if (stream == NULL || stream->submited_headers) return -1;
+    stream->submited = res;
+
+    res->FillContentType();
+    if (eof) res->FillContentLength();
+    if (stream->parsed && stream->parsed->ContentType() == APPLICATION_GRPC) {
+        // correct content_type: application/grpc
+        if (res->ContentType() != APPLICATION_GRPC) {
+            res->content_type = APPLICATION_GRPC;
+            res->headers["content-type"] = http_content_type_str(APPLICATION_GRPC);
+        }
+        stream->grpc = 1;
+    }
+
+    std::vector<nghttp2_nv> nvs;
+    char c_str[16] = {0};
+    snprintf(c_str, sizeof(c_str), "%d", res->status_code);
+    nvs.push_back(make_nv(":status", c_str));
+    const char* name;
+    const char* value;
+    for (auto& header : res->headers) {
+        name = header.first.c_str();
+        value = header.second.c_str();
+        hv_strlower((char*)name);
+        if (strcmp(name, "connection") == 0 ||
+            strcmp(name, "keep-alive") == 0 ||
+            strcmp(name, "transfer-encoding") == 0) {
+            // connection-specific headers are forbidden in HTTP2
+            continue;
+        }
+        if (stream->grpc && strcmp(name, "content-length") == 0) {
+            // grpc message is framed
+            continue;
+        }
+        nvs.push_back(make_nv2(name, value, header.first.size(), header.second.size()));
+    }
+
+    const char* content = (const char*)res->Content();
+    size_t content_length = content ? res->ContentLength() : 0;
+    if (stream->grpc) {
+        // grpc_message_hd + content
+        grpc_message_hd msghd;
+        msghd.flags = 0;
+        msghd.length = content_length;
+        unsigned char hdbuf[GRPC_MESSAGE_HDLEN];
+        grpc_message_hd_pack(&msghd, hdbuf);
+        stream->sendbuf.assign((const char*)hdbuf, GRPC_MESSAGE_HDLEN);
+        if (content_length) stream->sendbuf.append(content, content_length);
+    } else {
+        // NOTE: content is owned by res, no copy
+        stream->content = content;
+        stream->content_length = content_length;
+    }
+    stream->content_offset = 0;
+    stream->eof = eof;
+    stream->submited_headers = 1;
+
+    int ret = 0;
+    if (eof && stream->pending_bytes() == 0) {
+        ret = nghttp2_submit_response(session, stream_id, &nvs[0], nvs.size(), NULL);
+    } else {
+        nghttp2_data_provider data_prd;
+        data_prd.source.ptr = stream;
+        data_prd.read_callback = data_source_read_callback;
+        ret = nghttp2_submit_response(session, stream_id, &nvs[0], nvs.size(), &data_prd);
+    }
+    if (ret != 0) {
+        error = ret;
+        return ret;
+    }
+    return 0;
+}
+
+int Http2Parser::SubmitRequest(HttpRequest* req, HttpResponse* res) {
+    std::vector<nghttp2_nv> nvs;
+    char c_str[256] = {0};
+    make_request_nvs(req, nvs, c_str, sizeof(c_str));
+
+    http2_stream* stream = new http2_stream;
+    stream->submited = req;
+    stream->parsed = res;
+    res->Reset();
+    res->http_major = 2;
+    res->http_minor = 0;
+    const char* content = (const char*)req->Content();
+    size_t content_length = content ? req->ContentLength() : 0;
+    if (req->ContentType() == APPLICATION_GRPC) {
+        // grpc_message_hd + content
+        grpc_message_hd msghd;
+        msghd.flags = 0;
+        msghd.length = content_length;
+        unsigned char hdbuf[GRPC_MESSAGE_HDLEN];
+        grpc_message_hd_pack(&msghd, hdbuf);
+        stream->sendbuf.assign((const char*)hdbuf, GRPC_MESSAGE_HDLEN);
+        if (content_length) stream->sendbuf.append(content, content_length);
+    } else {
+        // NOTE: content is owned by req, no copy
+        stream->content = content;
+        stream->content_length = content_length;
+    }
+    stream->eof = 1;
+    stream->submited_headers = 1;
+
+    int32_t id = 0;
+    if (stream->pending_bytes() == 0) {
+        id = nghttp2_submit_request(session, NULL, &nvs[0], nvs.size(), NULL, stream);
+    } else {
+        nghttp2_data_provider data_prd;
+        data_prd.source.ptr = stream;
+        data_prd.read_callback = data_source_read_callback;
+        id = nghttp2_submit_request(session, NULL, &nvs[0], nvs.size(), &data_prd, stream);
+    }
+    if (id < 0) {
+        delete stream;
+        error = id;
+        return id;
+    }
+    stream->stream_id = id;
+    streams[id] = stream;
+    return id;
+}
+
+int Http2Parser::MaxConcurrentStreams() {
+    return MIN(nghttp2_session_get_remote_settings(session, NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS), INT_MAX);
+}
+
+int Http2Parser::SendStreamData(int32_t stream_id, const char* data, size_t len, bool eof) {
+    http2_stream* stream = GetStream(stream_id);
+    if (stream == NULL || !stream->submited_headers || stream->eof) return -1;
+    if (stream->sendbuf_offset > (1 << 16) && stream->sendbuf_offset * 2 > stream->sendbuf.size()) {
+        stream->sendbuf.erase(0, stream->sendbuf_offset);
+        stream->sendbuf_offset = 0;
+    }
+    if (data && len) stream->sendbuf.append(data, len);
+    if (eof) stream->eof = 1;
+    if (stream->deferred) {
+        stream->deferred = 0;
+        nghttp2_session_resume_data(session, stream_id);
+    }
+    return len;
+}
+
+int Http2Parser::ResetStream(int32_t stream_id, uint32_t error_code) {
+    return nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, stream_id, error_code);
+}
+
 nghttp2_session_callbacks* Http2Parser::cbs = NULL;
 
 int on_header_callback(nghttp2_session *session,
@@ -321,10 +494,17 @@ int on_header_callback(nghttp2_session *session,
     const char* value = (const char*)_value;
     printd("%s: %s\n", name, value);
     Http2Parser* hp = (Http2Parser*)userdata;
+    HttpMessage* parsed = hp->parsed;
+    http2_stream* stream = hp->GetStream(frame->hd.stream_id);
+    if (stream) {
+        parsed = stream->parsed;
+    } else if (hp->type == HTTP_SERVER || parsed == NULL) {
+        return 0;
+    }
     if (*name == ':') {
-        if (hp->parsed->type == HTTP_REQUEST) {
+        if (parsed->type == HTTP_REQUEST) {
             // :method :path :scheme :authority
-            HttpRequest* req = (HttpRequest*)hp->parsed;
+            HttpRequest* req = (HttpRequest*)parsed;
             if (strcmp(name, ":method") == 0) {
                 req->method = http_method_enum(value);
             }
@@ -338,8 +518,8 @@ int on_header_callback(nghttp2_session *session,
                 req->headers["Host"] = value;
             }
         }
-        else if (hp->parsed->type == HTTP_RESPONSE) {
-            HttpResponse* res = (HttpResponse*)hp->parsed;
+        else if (parsed->type == HTTP_RESPONSE) {
+            HttpResponse* res = (HttpResponse*)parsed;
             if (strcmp(name, ":status") == 0) {
                 res->status_code = (http_status)atoi(value);
                 if (res->http_cb) {
@@ -349,9 +529,9 @@ int on_header_callback(nghttp2_session *session,
         }
     }
     else {
-        hp->parsed->headers[name] = value;
+        parsed->headers[name] = value;
         if (strcmp(name, "content-type") == 0) {
-            hp->parsed->content_type = http_content_type_enum(value);
+            parsed->content_type = http_content_type_enum(value);
         }
     }
     return 0;
@@ -364,8 +544,15 @@ int on_data_chunk_recv_callback(nghttp2_session *session,
     printd("stream_id=%d length=%d\n", stream_id, (int)len);
     //printd("%.*s\n", (int)len, data);
     Http2Parser* hp = (Http2Parser*)userdata;
+    HttpMessage* parsed = hp->parsed;
+    http2_stream* stream = hp->GetStream(stream_id);
+    if (stream) {
+        parsed = stream->parsed;
+    } else if (hp->type == HTTP_SERVER || parsed == NULL) {
+        return 0;
+    }
 
-    if (hp->parsed->ContentType() == APPLICATION_GRPC) {
+    if (parsed->ContentType() == APPLICATION_GRPC) {
         // grpc_message_hd
         if (len >= GRPC_MESSAGE_HDLEN) {
             grpc_message_hd msghd;
@@ -376,10 +563,10 @@ int on_data_chunk_recv_callback(nghttp2_session *session,
             //printd("%.*s\n", (int)len, data);
         }
     }
-    if (hp->parsed->http_cb) {
-        hp->parsed->http_cb(hp->parsed, HP_BODY, (const char*)data, len);
+    if (parsed->http_cb) {
+        parsed->http_cb(parsed, HP_BODY, (const char*)data, len);
     } else {
-        hp->parsed->body.append((const char*)data, len);
+        parsed->body.append((const char*)data, len);
     }
     return 0;
 }
@@ -389,6 +576,30 @@ int on_frame_recv_callback(nghttp2_session *session,
     printd("on_frame_recv_callback\n");
     print_frame_hd(&frame->hd);
     Http2Parser* hp = (Http2Parser*)userdata;
+    if (frame->hd.type == NGHTTP2_GOAWAY) {
+        hp->goaway = 1;
+    }
+    http2_stream* stream = hp->GetStream(frame->hd.stream_id);
+    if (stream) {
+        HttpMessage* parsed = stream->parsed;
+        if (frame->hd.type == NGHTTP2_HEADERS &&
+            (frame->headers.cat == NGHTTP2_HCAT_REQUEST || frame->headers.cat == NGHTTP2_HCAT_RESPONSE) &&
+            parsed->http_cb) {
+            parsed->http_cb(parsed, HP_HEADERS_COMPLETE, NULL, 0);
+        }
+        if ((frame->hd.type == NGHTTP2_HEADERS || frame->hd.type == NGHTTP2_DATA) &&
+            (frame->hd.flags & NGHTTP2_FLAG_END_STREAM)) {
+            printd("on_stream_recv_complete stream_id=%d\n", frame->hd.stream_id);
+            stream->recv_complete = 1;
+            if (parsed->http_cb) {
+                parsed->http_cb(parsed, HP_MESSAGE_COMPLETE, NULL, 0);
+            }
+        }
+        return 0;
+    }
+    if (hp->type == HTTP_SERVER || hp->parsed == NULL) {
+        return 0;
+    }
     switch (frame->hd.type) {
     case NGHTTP2_DATA:
         hp->state = H2_RECV_DATA;
@@ -430,4 +641,77 @@ int on_frame_recv_callback(nghttp2_session *session,
     return 0;
 }
 
+int on_begin_headers_callback(nghttp2_session *session,
+    const nghttp2_frame *frame, void *userdata) {
+    Http2Parser* hp = (Http2Parser*)userdata;
+    if (hp->type != HTTP_SERVER ||
+        frame->hd.type != NGHTTP2_HEADERS ||
+        frame->headers.cat != NGHTTP2_HCAT_REQUEST) {
+        return 0;
+    }
+    int32_t stream_id = frame->hd.stream_id;
+    printd("on_stream_open stream_id=%d\n", stream_id);
+    HttpRequest* req = hp->onStreamOpen ? hp->onStreamOpen(stream_id) : NULL;
+    if (req == NULL) {
+        // NOTE: frames of this stream are ignored without http2_stream
+        nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, stream_id, NGHTTP2_REFUSED_STREAM);
+        return 0;
+    }
+    http2_stream* stream = new http2_stream(stream_id);
+    stream->parsed = req;
+    hp->streams[stream_id] = stream;
+    if (stream_id > hp->stream_id) hp->stream_id = stream_id;
+    return 0;
+}
+
+int on_stream_close_callback(nghttp2_session *session,
+    int32_t stream_id, uint32_t error_code, void *userdata) {
+    Http2Parser* hp = (Http2Parser*)userdata;
+    auto iter = hp->streams.find(stream_id);
+    if (iter == hp->streams.end()) return 0;
+    printd("on_stream_close stream_id=%d error_code=%u\n", stream_id, error_code);
+    http2_stream* stream = iter->second;
+    if (hp->onStreamClose) {
+        hp->onStreamClose(stream_id, error_code);
+    }
+    hp->streams.erase(stream_id);
+    delete stream;
+    return 0;
+}
+
+ssize_t data_source_read_callback(nghttp2_session *session,
+    int32_t stream_id, uint8_t *buf, size_t length,
+    uint32_t *data_flags, nghttp2_data_source *source, void *userdata) {
+    http2_stream* stream = (http2_stream*)source->ptr;
+    size_t nread = 0;
+    if (stream->content_offset < stream->content_length) {
+        nread = MIN(length, stream->content_length - stream->content_offset);
+        memcpy(buf, stream->content + stream->content_offset, nread);
+        stream->content_offset += nread;
+    }
+    if (nread < length && stream->sendbuf_offset < stream->sendbuf.size()) {
+        size_t n = MIN(length - nread, stream->sendbuf.size() - stream->sendbuf_offset);
+        memcpy(buf + nread, stream->sendbuf.data() + stream->sendbuf_offset, n);
+        stream->sendbuf_offset += n;
+        nread += n;
+    }
+    if (stream->pending_bytes() == 0) {
+        stream->sendbuf.clear();
+        stream->sendbuf_offset = 0;
+        if (stream->eof) {
+            *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+            if (stream->grpc) {
+                // grpc HEADERS grpc-status
+                *data_flags |= NGHTTP2_DATA_FLAG_NO_END_STREAM;
+                nghttp2_nv nv = make_nv("grpc-status", "0");
+                nghttp2_submit_trailer(session, stream_id, &nv, 1);
+            }
+        } else if (nread == 0) {
+            stream->deferred = 1;
+            return NGHTTP2_ERR_DEFERRED;
+        }
+    }
+    return nread;
+}
+
 #endif
@@ -8,6 +8,9 @@
 
 #include "nghttp2/nghttp2.h"
 
+#include <map>
+#include <functional>
+
 enum http2_session_state {
     H2_SEND_MAGIC,
     H2_SEND_SETTINGS,
@@ -26,6 +29,37 @@ enum http2_session_state {
     H2_RECV_DATA,
 };
 
+// server stream
+struct http2_stream {
+    int32_t         stream_id;
+    HttpMessage*    parsed;     // request
+    HttpMessage*    submited;   // response
+    // body to send: content, then sendbuf
+    const char*     content;
+    size_t          content_length;
+    size_t          content_offset;
+    std::string     sendbuf;
+    size_t          sendbuf_offset;
+    unsigned        recv_complete   :1;
+    unsigned        submited_headers:1;
+    unsigned        eof             :1; // no more body to append
+    unsigned        deferred        :1; // data provider is waiting for body
+    unsigned        grpc            :1; // send grpc-status in trailer
+
+    http2_stream(int32_t id = 0) {
+        stream_id = id;
+        parsed = submited = NULL;
+        content = NULL;
+        content_length = content_offset = 0;
+        sendbuf_offset = 0;
+        recv_complete = submited_headers = eof = deferred = grpc = 0;
+    }
+
+    size_t pending_bytes() {
+        return (content_length - content_offset) + (sendbuf.size() - sendbuf_offset);
+    }
+};
+
 class Http2Parser : public HttpParser {
 public:
     static nghttp2_session_callbacks* cbs;
@@ -36,6 +70,7 @@ public:
     int error;
     int stream_id;
     int stream_closed;
+    int goaway;
     int frame_type_when_stream_closed;
     // http2_frame_hd + grpc_message_hd
     // at least HTTP2_FRAME_HDLEN + GRPC_MESSAGE_HDLEN = 9 + 5 = 14
@@ -82,6 +117,39 @@ public:
     virtual int InitRequest(HttpRequest* req);
     virtual int SubmitResponse(HttpResponse* res);
 
+    /*
+     * server streams
+     * FeedRecvData -> onStreamOpen -> HttpRequest::http_cb -> SubmitResponse(stream_id) -> SendStreamData ->
+     * while(GetSendData) {send} -> onStreamClose
+     *
+     * NOTE: DATA frames of all streams are interleaved and sent within flow control window by nghttp2,
+     * so responses can be submitted in any order.
+     */
+    // @return request to parse into, NULL to refuse stream
+    std::function<HttpRequest*(int32_t stream_id)>              onStreamOpen;
+    // NOTE: stream is freed after onStreamClose
+    std::function<void(int32_t stream_id, uint32_t error_code)> onStreamClose;
+    std::map<int32_t, http2_stream*>                            streams;
+
+    http2_stream* GetStream(int32_t stream_id) {
+        auto iter = streams.find(stream_id);
+        return iter == streams.end() ? NULL : iter->second;
+    }
+    // submit headers of res, content of res is body, more body could be appended by SendStreamData if !eof.
+    int SubmitResponse(int32_t stream_id, HttpResponse* res, bool eof = true);
+    int SendStreamData(int32_t stream_id, const char* data, size_t len, bool eof = false);
+    int ResetStream(int32_t stream_id, uint32_t error_code = NGHTTP2_CANCEL);
+
+    /*
+     * client streams
+     * SubmitRequest(req, res) -> while(GetSendData) {send} -> recv -> FeedRecvData -> res->http_cb -> onStreamClose
+     *
+     * NOTE: many requests are multiplexed in one session, stream->recv_complete tells res is complete in onStreamClose.
+     */
+    // @return stream_id > 0, < 0 on error
+    int SubmitRequest(HttpRequest* req, HttpResponse* res);
+    // SETTINGS_MAX_CONCURRENT_STREAMS of peer
+    int MaxConcurrentStreams();
 };
 
 #endif
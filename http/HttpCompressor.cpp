@@ -0,0 +1,215 @@
+#include "HttpCompressor.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "hbase.h" // import hv_strstartswith
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+
+static const struct {
+    int         encoding;
+    const char* str;
+    const char* suffix;
+} s_encodings[HTTP_ENCODINGS_NUM] = {
+    { HTTP_ENCODING_BR,     "br",   ".br"  },
+    { HTTP_ENCODING_ZSTD,   "zstd", ".zst" },
+    { HTTP_ENCODING_GZIP,   "gzip", ".gz"  },
+};
+
+int http_accept_encodings(const char* accept_encoding) {
+    if (accept_encoding == NULL) return 0;
+    int encodings = 0;
+    // refused with q=0, not covered by *
+    int excluded = 0;
+    bool any = false;
+    const char* p = accept_encoding;
+    while (*p) {
+        // token [; q=value] [, ...]
+        while (*p == ' ' || *p == '\t' || *p == ',') ++p;
+        const char* token = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') ++p;
+        size_t token_len = p - token;
+        bool acceptable = true;
+        while (*p && *p != ',') {
+            if (*p == 'q' && p[1] == '=') {
+                // q=0, q=0.0, q=0.000
+                const char* q = p + 2;
+                acceptable = !(*q == '0' && strspn(q + 1, ".0") == strcspn(q + 1, ", \t;"));
+            }
+            ++p;
+        }
+        if (token_len == 0) continue;
+        if (token_len == 1 && *token == '*') {
+            if (acceptable) any = true;
+            continue;
+        }
+        int encoding = 0;
+        for (int i = 0; i < HTTP_ENCODINGS_NUM; ++i) {
+            if (strlen(s_encodings[i].str) == token_len &&
+                strncasecmp(token, s_encodings[i].str, token_len) == 0) {
+                encoding = s_encodings[i].encoding;
+            }
+        }
+        if (token_len == 6 && strncasecmp(token, "x-gzip", 6) == 0) {
+            encoding = HTTP_ENCODING_GZIP;
+        }
+        if (acceptable) {
+            encodings |= encoding;
+        } else {
+            excluded |= encoding;
+        }
+    }
+    // RFC 9110 12.5.3: * matches any coding not listed elsewhere
+    if (any) {
+        encodings |= (HTTP_ENCODING_BR | HTTP_ENCODING_ZSTD | HTTP_ENCODING_GZIP) & ~excluded;
+    }
+    return encodings & ~excluded;
+}
+
+int http_encoding_index(int encoding) {
+    for (int i = 0; i < HTTP_ENCODINGS_NUM; ++i) {
+        if (s_encodings[i].encoding == encoding) return i;
+    }
+    return -1;
+}
+
+const char* http_encoding_str(int encoding) {
+    int i = http_encoding_index(encoding);
+    return i < 0 ? "identity" : s_encodings[i].str;
+}
+
+const char* http_encoding_suffix(int encoding) {
+    int i = http_encoding_index(encoding);
+    return i < 0 ? "" : s_encodings[i].suffix;
+}
+
+bool http_content_compressible(const char* content_type) {
+    if (content_type == NULL || *content_type == '\0') return false;
+    if (hv_strstartswith(content_type, "text/")) return true;
+    static const char* s_compressible[] = {
+        "json",
+        "javascript",
+        "ecmascript",
+        "xml",
+        "svg",
+        "wasm",
+        "x-www-form-urlencoded",
+        "vnd.ms-fontobject",
+        "font/ttf",
+        "font/otf",
+    };
+    for (size_t i = 0; i < sizeof(s_compressible) / sizeof(s_compressible[0]); ++i) {
+        if (strstr(content_type, s_compressible[i])) return true;
+    }
+    return false;
+}
+
+namespace hv {
+
+HttpCompressor::HttpCompressor() {
+    encoding_ = HTTP_ENCODING_IDENTITY;
+    stream_ = NULL;
+}
+
+HttpCompressor::~HttpCompressor() {
+#ifdef WITH_ZLIB
+    if (stream_) {
+        z_stream* zs = (z_stream*)stream_;
+        deflateEnd(zs);
+        delete zs;
+        stream_ = NULL;
+    }
+#endif
+}
+
+int HttpCompressor::Supported() {
+#ifdef WITH_ZLIB
+    return HTTP_ENCODING_GZIP;
+#else
+    return 0;
+#endif
+}
+
+int HttpCompressor::Init(int encoding, int level) {
+    if (stream_ || (encoding & Supported()) == 0) return -1;
+#ifdef WITH_ZLIB
+    z_stream* zs = new z_stream;
+    memset(zs, 0, sizeof(z_stream));
+    // windowBits 15 + 16 => gzip wrapper
+    if (deflateInit2(zs, level < 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        delete zs;
+        return -1;
+    }
+    stream_ = zs;
+    encoding_ = encoding;
+    return 0;
+#else
+    (void)level;
+    return -1;
+#endif
+}
+
+int HttpCompressor::Compress(const char* data, size_t len, std::string& out, bool flush) {
+#ifdef WITH_ZLIB
+    z_stream* zs = (z_stream*)stream_;
+    if (zs == NULL) return -1;
+    int mode = flush ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+    zs->next_in = (Bytef*)data;
+    zs->avail_in = len;
+    size_t offset = out.size();
+    do {
+        size_t bound = deflateBound(zs, zs->avail_in) + 16;
+        out.resize(offset + bound);
+        zs->next_out = (Bytef*)&out[offset];
+        zs->avail_out = bound;
+        int ret = deflate(zs, mode);
+        if (ret == Z_STREAM_ERROR) {
+            out.resize(offset);
+            return -1;
+        }
+        offset += bound - zs->avail_out;
+    } while (zs->avail_in != 0 || zs->avail_out == 0);
+    out.resize(offset);
+    return 0;
+#else
+    (void)data; (void)len; (void)out; (void)flush;
+    return -1;
+#endif
+}
+
+int HttpCompressor::Finish(std::string& out) {
+#ifdef WITH_ZLIB
+    z_stream* zs = (z_stream*)stream_;
+    if (zs == NULL) return -1;
+    zs->next_in = NULL;
+    zs->avail_in = 0;
+    size_t offset = out.size();
+    int ret = Z_OK;
+    do {
+        size_t bound = 4096;
+        out.resize(offset + bound);
+        zs->next_out = (Bytef*)&out[offset];
+        zs->avail_out = bound;
+        ret = deflate(zs, Z_FINISH);
+        offset += bound - zs->avail_out;
+    } while (ret == Z_OK);
+    out.resize(offset);
+    return ret == Z_STREAM_END ? 0 : -1;
+#else
+    (void)out;
+    return -1;
+#endif
+}
+
+int HttpCompressor::Compress(int encoding, const char* data, size_t len, std::string& out) {
+    HttpCompressor compressor;
+    if (compressor.Init(encoding) != 0) return -1;
+    out.reserve(out.size() + len / 4 + 64);
+    if (compressor.Compress(data, len, out) != 0) return -1;
+    return compressor.Finish(out);
+}
+
+}
@@ -0,0 +1,281 @@
+#ifndef HV_HTTP_HEADERS_H_
+#define HV_HTTP_HEADERS_H_
+
+/*
+ * HttpHeaders: flat list of headers with case-insensitive keys,
+ * the container of http_headers instead of std::map<std::string, std::string, StringCaseLess>
+ * if USE_FLAT_HEADERS, headers are dumped in insertion order instead of sorted by name.
+ *
+ * Entries are kept in insertion order and found by linear scan, comparing a
+ * case-insensitive hash computed on insert before the key itself, which is
+ * faster than a tree for the 10-30 headers of a typical message.
+ * clear() keeps entries and capacity of their strings, a message reset and
+ * refilled (see HttpMessagePool) allocates nothing for its headers.
+ *
+ * Compatible with the std::map interface used for http_headers:
+ * operator[], at, find, count, insert, emplace, erase, begin, end, size, empty, clear.
+ * NOTE: insert keeps references of entries, erase moves entries after it forward.
+ * NOTE: iterators are positions, valid until an entry before them is erased.
+ * NOTE: modify iter->second, iter->first is the key indexed by hash.
+ */
+
+#include <string.h>
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <utility>
+#include <iterator>
+#include <stdexcept>
+#include <initializer_list>
+
+#include "hplatform.h" // import strncasecmp
+
+namespace hv {
+
+class HttpHeaders {
+public:
+    typedef std::string                             key_type;
+    typedef std::string                             mapped_type;
+    typedef std::pair<std::string, std::string>     value_type;
+    typedef size_t                                  size_type;
+
+    template<class Headers, class Value>
+    class basic_iterator {
+    public:
+        typedef std::bidirectional_iterator_tag     iterator_category;
+        typedef HttpHeaders::value_type             value_type;
+        typedef ptrdiff_t                           difference_type;
+        typedef Value*                              pointer;
+        typedef Value&                              reference;
+
+        basic_iterator() : headers_(NULL), pos_(0) {}
+        basic_iterator(Headers* headers, size_t pos) : headers_(headers), pos_(pos) {}
+        // iterator => const_iterator
+        template<class H, class V>
+        basic_iterator(const basic_iterator<H, V>& rhs) : headers_(rhs.headers_), pos_(rhs.pos_) {}
+
+        reference operator*()  const { return headers_->entries_[pos_]; }
+        pointer   operator->() const { return &headers_->entries_[pos_]; }
+
+        basic_iterator& operator++() { ++pos_; return *this; }
+        basic_iterator& operator--() { --pos_; return *this; }
+        basic_iterator  operator++(int) { basic_iterator tmp(*this); ++pos_; return tmp; }
+        basic_iterator  operator--(int) { basic_iterator tmp(*this); --pos_; return tmp; }
+
+        template<class H, class V>
+        bool operator==(const basic_iterator<H, V>& rhs) const { return headers_ == rhs.headers_ && pos_ == rhs.pos_; }
+        template<class H, class V>
+        bool operator!=(const basic_iterator<H, V>& rhs) const { return !(*this == rhs); }
+
+    private:
+        template<class H, class V> friend class basic_iterator;
+        friend class HttpHeaders;
+        Headers*    headers_;
+        size_t      pos_;
+    };
+    typedef basic_iterator<HttpHeaders, value_type>                 iterator;
+    typedef basic_iterator<const HttpHeaders, const value_type>     const_iterator;
+
+    HttpHeaders() : size_(0) {}
+    HttpHeaders(std::initializer_list<value_type> il) : size_(0) {
+        insert(il.begin(), il.end());
+    }
+    template<class InputIt>
+    HttpHeaders(InputIt first, InputIt last) : size_(0) {
+        insert(first, last);
+    }
+    HttpHeaders(const HttpHeaders& rhs) : size_(0) {
+        *this = rhs;
+    }
+    HttpHeaders(HttpHeaders&& rhs) : size_(0) {
+        swap(rhs);
+    }
+
+    HttpHeaders& operator=(const HttpHeaders& rhs) {
+        if (this == &rhs) return *this;
+        clear();
+        for (size_t i = 0; i < rhs.size_; ++i) {
+            const value_type& kv = rhs.entries_[i];
+            append(kv.first.c_str(), kv.first.size(), kv.second.c_str(), kv.second.size(), rhs.hashes_[i]);
+        }
+        return *this;
+    }
+    HttpHeaders& operator=(HttpHeaders&& rhs) {
+        swap(rhs);
+        rhs.clear();
+        return *this;
+    }
+    HttpHeaders& operator=(std::initializer_list<value_type> il) {
+        clear();
+        insert(il.begin(), il.end());
+        return *this;
+    }
+
+    void swap(HttpHeaders& rhs) {
+        entries_.swap(rhs.entries_);
+        hashes_.swap(rhs.hashes_);
+        std::swap(size_, rhs.size_);
+    }
+
+    // iterators
+    iterator        begin()         { return iterator(this, 0); }
+    iterator        end()           { return iterator(this, size_); }
+    const_iterator  begin()  const  { return const_iterator(this, 0); }
+    const_iterator  end()    const  { return const_iterator(this, size_); }
+    const_iterator  cbegin() const  { return begin(); }
+    const_iterator  cend()   const  { return end(); }
+
+    // capacity
+    bool    empty() const { return size_ == 0; }
+    size_t  size()  const { return size_; }
+
+    // lookup
+    iterator find(const char* key) {
+        return iterator(this, index(key, strlen(key)));
+    }
+    iterator find(const std::string& key) {
+        return iterator(this, index(key.c_str(), key.size()));
+    }
+    const_iterator find(const char* key) const {
+        return const_iterator(this, index(key, strlen(key)));
+    }
+    const_iterator find(const std::string& key) const {
+        return const_iterator(this, index(key.c_str(), key.size()));
+    }
+    size_t count(const char* key) const {
+        return index(key, strlen(key)) != size_ ? 1 : 0;
+    }
+    size_t count(const std::string& key) const {
+        return index(key.c_str(), key.size()) != size_ ? 1 : 0;
+    }
+
+    // access
+    std::string& operator[](const char* key) {
+        return get(key, strlen(key));
+    }
+    std::string& operator[](const std::string& key) {
+        return get(key.c_str(), key.size());
+    }
+    std::string& at(const std::string& key) {
+        size_t pos = index(key.c_str(), key.size());
+        if (pos == size_) throw std::out_of_range("HttpHeaders::at");
+        return entries_[pos].second;
+    }
+    const std::string& at(const std::string& key) const {
+        size_t pos = index(key.c_str(), key.size());
+        if (pos == size_) throw std::out_of_range("HttpHeaders::at");
+        return entries_[pos].second;
+    }
+
+    // modifiers
+    // NOTE: same as std::map, existing key is not overwritten
+    std::pair<iterator, bool> insert(const value_type& kv) {
+        uint32_t h = hash(kv.first.c_str(), kv.first.size());
+        size_t pos = index(kv.first.c_str(), kv.first.size(), h);
+        if (pos != size_) return std::make_pair(iterator(this, pos), false);
+        append(kv.first.c_str(), kv.first.size(), kv.second.c_str(), kv.second.size(), h);
+        return std::make_pair(iterator(this, size_ - 1), true);
+    }
+    iterator insert(const_iterator hint, const value_type& kv) {
+        (void)hint;
+        return insert(kv).first;
+    }
+    template<class InputIt>
+    void insert(InputIt first, InputIt last) {
+        for (; first != last; ++first) {
+            insert(value_type(first->first, first->second));
+        }
+    }
+    std::pair<iterator, bool> emplace(const std::string& key, const std::string& value) {
+        return insert(value_type(key, value));
+    }
+
+    iterator erase(const_iterator iter) {
+        size_t pos = iter.pos_;
+        if (pos >= size_) return end();
+        // NOTE: move erased entry to the tail, its strings are reused
+        for (size_t i = pos + 1; i < size_; ++i) {
+            entries_[i - 1].swap(entries_[i]);
+            std::swap(hashes_[i - 1], hashes_[i]);
+        }
+        --size_;
+        return iterator(this, pos);
+    }
+    iterator erase(iterator iter) {
+        return erase(const_iterator(iter));
+    }
+    size_t erase(const char* key) {
+        size_t pos = index(key, strlen(key));
+        if (pos == size_) return 0;
+        erase(const_iterator(this, pos));
+        return 1;
+    }
+    size_t erase(const std::string& key) {
+        return erase(key.c_str());
+    }
+
+    // NOTE: keep entries for reuse, see shrink_to_fit
+    void clear() { size_ = 0; }
+    void shrink_to_fit() {
+        entries_.resize(size_);
+        entries_.shrink_to_fit();
+        hashes_.resize(size_);
+        hashes_.shrink_to_fit();
+    }
+
+    // case-insensitive FNV-1a
+    static uint32_t hash(const char* key, size_t len) {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; ++i) {
+            unsigned char c = key[i];
+            if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+            h = (h ^ c) * 16777619u;
+        }
+        return h;
+    }
+
+private:
+    size_t index(const char* key, size_t len) const {
+        return index(key, len, hash(key, len));
+    }
+    size_t index(const char* key, size_t len, uint32_t h) const {
+        for (size_t i = 0; i < size_; ++i) {
+            if (hashes_[i] == h &&
+                entries_[i].first.size() == len &&
+                strncasecmp(entries_[i].first.c_str(), key, len) == 0) {
+                return i;
+            }
+        }
+        return size_;
+    }
+
+    std::string& get(const char* key, size_t len) {
+        uint32_t h = hash(key, len);
+        size_t pos = index(key, len, h);
+        if (pos != size_) return entries_[pos].second;
+        return append(key, len, "", 0, h).second;
+    }
+
+    value_type& append(const char* key, size_t klen, const char* value, size_t vlen, uint32_t h) {
+        if (size_ == entries_.size()) {
+            entries_.emplace_back();
+            hashes_.push_back(0);
+        }
+        value_type& kv = entries_[size_];
+        kv.first.assign(key, klen);
+        kv.second.assign(value, vlen);
+        hashes_[size_] = h;
+        ++size_;
+        return kv;
+    }
+
+    // NOTE: std::deque keeps references on push_back, headers["a"] = headers["b"] is safe.
+    std::deque<value_type>  entries_;
+    std::vector<uint32_t>   hashes_;
+    size_t                  size_; // entries_[size_, entries_.size()) are free
+};
+
+}
+
+#endif // HV_HTTP_HEADERS_H_
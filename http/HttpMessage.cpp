@@ -167,7 +167,7 @@ HttpMessage::HttpMessage() {
 }
 
 HttpMessage::~HttpMessage() {
-
+    RemoveSpilledFiles();
 }
 
 void HttpMessage::Init() {
@@ -180,9 +180,15 @@ void HttpMessage::Init() {
 
 void HttpMessage::Reset() {
     Init();
+    RemoveSpilledFiles();
     headers.clear();
     cookies.clear();
-    body.clear();
+    // NOTE: retain capacity of body for next message, but not a large one
+    if (body.capacity() > HTTP_MESSAGE_RETAIN_BODY_MAX) {
+        http_body().swap(body);
+    } else {
+        body.clear();
+    }
 #ifndef WITHOUT_HTTP_CONTENT
     json.clear();
     form.clear();
@@ -604,18 +610,11 @@ int HttpMessage::ParseBody() {
     }
     case MULTIPART_FORM_DATA:
     {
-        auto iter = headers.find("Content-Type");
-        if (iter == headers.end()) {
-            return -1;
-        }
-        const char* boundary = strstr(iter->second.c_str(), "boundary=");
-        if (boundary == NULL) {
+        std::string boundary = Boundary();
+        if (boundary.empty()) {
             return -1;
         }
-        boundary += strlen("boundary=");
-        std::string strBoundary(boundary);
-        strBoundary = trim_pairs(strBoundary, "\"\"\'\'");
-        return parse_multipart(body, form, strBoundary.c_str());
+        return parse_multipart(body, form, boundary.c_str());
     }
     case X_WWW_FORM_URLENCODED:
         return parse_query_params(body.c_str(), kv);
@@ -627,6 +626,54 @@ int HttpMessage::ParseBody() {
     return 0;
 }
 
+std::string HttpMessage::Boundary() {
+    auto iter = headers.find("Content-Type");
+    if (iter == headers.end()) {
+        return "";
+    }
+    const char* boundary = strstr(iter->second.c_str(), "boundary=");
+    if (boundary == NULL) {
+        return "";
+    }
+    boundary += strlen("boundary=");
+    std::string strBoundary(boundary);
+    return trim_pairs(strBoundary, "\"\"\'\'");
+}
+
+int HttpMessage::MoveFile(const char* from, const char* to) {
+    if (rename(from, to) == 0) return 0;
+    // EXDEV
+    HFile src, dst;
+    if (src.open(from, "rb") != 0 || dst.open(to, "wb") != 0) {
+        return -1;
+    }
+    char buf[40960];
+    size_t nread;
+    while ((nread = src.read(buf, sizeof(buf))) > 0) {
+        if (dst.write(buf, nread) != nread) {
+            dst.remove();
+            return -1;
+        }
+    }
+    src.remove();
+    return 0;
+}
+
+void HttpMessage::RemoveSpilledFiles() {
+    if (!body_file.empty()) {
+        remove(body_file.c_str());
+        body_file.clear();
+    }
+#ifndef WITHOUT_HTTP_CONTENT
+    for (auto& pair : form) {
+        if (!pair.second.filepath.empty()) {
+            remove(pair.second.filepath.c_str());
+            pair.second.filepath.clear();
+        }
+    }
+#endif
+}
+
 std::string HttpMessage::Dump(bool is_dump_headers, bool is_dump_body) {
     std::string str;
     if (is_dump_headers) {
@@ -45,6 +45,7 @@
 
 #include "httpdef.h"
 #include "http_content.h"
+#include "HttpHeaders.h"
 
 // https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/Set-Cookie
 // Cookie: sessionid=1; domain=.example.com; path=/; max-age=86400; secure; httponly
@@ -80,10 +81,17 @@ struct HV_EXPORT HttpCookie {
     std::string dump() const;
 };
 
+#ifdef USE_FLAT_HEADERS
+typedef hv::HttpHeaders                                         http_headers;
+#else
 typedef std::map<std::string, std::string, hv::StringCaseLess>  http_headers;
+#endif
 typedef std::vector<HttpCookie>                                 http_cookies;
 typedef std::string                                             http_body;
 
+// capacity of body retained by Reset
+#define HTTP_MESSAGE_RETAIN_BODY_MAX    (1 << 16) // 64K
+
 HV_EXPORT extern http_headers DefaultHeaders;
 HV_EXPORT extern http_body    NoBody;
 HV_EXPORT extern HttpCookie   NoCookie;
@@ -98,6 +106,9 @@ public:
     http_headers        headers;
     http_cookies        cookies;
     http_body           body;
+    // server: body spilled to this temporary file, see HttpService::body_spill_size
+    // NOTE: removed by Reset, SaveFile or rename it to keep.
+    std::string         body_file;
 
     // http_cb
     std::function<void(HttpMessage*, http_parser_state state, const char* data, size_t size)> http_cb;
@@ -207,14 +218,21 @@ public:
         if (iter == form.end()) {
             return HTTP_STATUS_BAD_REQUEST;
         }
-        const auto& formdata = iter->second;
-        if (formdata.content.empty()) {
+        auto& formdata = iter->second;
+        if (formdata.content.empty() && formdata.filepath.empty()) {
             return HTTP_STATUS_BAD_REQUEST;
         }
         std::string filepath(path);
         if (HPath::isdir(path)) {
             filepath = HPath::join(filepath, formdata.filename);
         }
+        if (!formdata.filepath.empty()) {
+            if (MoveFile(formdata.filepath.c_str(), filepath.c_str()) != 0) {
+                return HTTP_STATUS_INTERNAL_SERVER_ERROR;
+            }
+            formdata.filepath.clear();
+            return 200;
+        }
         HFile file;
         if (file.open(filepath.c_str(), "wb") != 0) {
             return HTTP_STATUS_INTERNAL_SERVER_ERROR;
@@ -284,6 +302,13 @@ public:
 
     virtual std::string Dump(bool is_dump_headers, bool is_dump_body);
 
+    // Content-Type: multipart/form-data; boundary=xxx
+    std::string Boundary();
+    // rename, or copy if across filesystems
+    static int MoveFile(const char* from, const char* to);
+    // remove body_file and form[*].filepath
+    void RemoveSpilledFiles();
+
     void* Content() {
         if (content == NULL && body.size() != 0) {
             content = (void*)body.data();
@@ -352,6 +377,13 @@ public:
     }
 
     int SaveFile(const char* filepath) {
+        if (!body_file.empty()) {
+            if (MoveFile(body_file.c_str(), filepath) != 0) {
+                return HTTP_STATUS_NOT_FOUND;
+            }
+            body_file.clear();
+            return 200;
+        }
         HFile file;
         if (file.open(filepath, "wb") != 0) {
             return HTTP_STATUS_NOT_FOUND;
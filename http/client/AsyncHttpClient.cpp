@@ -1,5 +1,17 @@
 #include "AsyncHttpClient.h"
 
+#ifdef WITH_NGHTTP2
+#include "Http2Parser.h"
+#endif
+
+// NOTE: HTTP/2 over TLS is negotiated by ALPN, supported with OpenSSL only,
+// https requests of HTTP/2 are sent by HTTP/1.1 with other SSL backends.
+#ifdef WITH_OPENSSL
+#define HTTP2_OVER_TLS  1
+#else
+#define HTTP2_OVER_TLS  0
+#endif
+
 namespace hv {
 
 int AsyncHttpClient::send(const HttpRequestPtr& req, HttpResponseCallback resp_cb) {
@@ -93,10 +105,22 @@ int AsyncHttpClient::doTaskWithAddr(const HttpClientTaskPtr& task, const sockadd
     const char* host = req->host.c_str();
     sockaddr_u peeraddr = *paddr;
 
-    int connfd = -1;
-    // first get from conn_pools
     char strAddr[SOCKADDR_STRLEN] = {0};
     SOCKADDR_STR(&peeraddr, strAddr);
+    if (req->http_major == 2) {
+#ifdef WITH_NGHTTP2
+        if (!req->IsProxy() && (HTTP2_OVER_TLS || !req->IsHttps()) &&
+            h1_peers.find(strAddr) == h1_peers.end()) {
+            return doHttp2Task(task, &peeraddr, timeout_ms > 0 ? timeout_ms - elapsed_ms : 0);
+        }
+#endif
+        // fallback to HTTP/1.1
+        req->http_major = 1;
+        req->http_minor = 1;
+    }
+
+    int connfd = -1;
+    // first get from conn_pools
     auto iter = conn_pools.find(strAddr);
     if (iter != conn_pools.end()) {
         // hlogd("get from conn_pools");
@@ -146,24 +170,8 @@ int AsyncHttpClient::doTaskWithAddr(const HttpClientTaskPtr& task, const sockadd
             return;
         }
         if (ctx->parser->IsComplete()) {
-            auto& req = ctx->task->req;
-            auto& resp = ctx->resp;
-            bool keepalive = req->IsKeepAlive() && resp->IsKeepAlive();
-            if (req->redirect && HTTP_STATUS_IS_REDIRECT(resp->status_code)) {
-                std::string location = resp->headers["Location"];
-                if (!location.empty()) {
-                    hlogi("redirect %s => %s", req->url.c_str(), location.c_str());
-                    req->url = location;
-                    req->ParseUrl();
-                    req->headers["Host"] = req->host;
-                    resp->Reset();
-                    send(ctx->task);
-                    // NOTE: detatch from original channel->context
-                    ctx->cancelTask();
-                }
-            } else {
-                ctx->successCallback();
-            }
+            bool keepalive = ctx->task->req->IsKeepAlive() && ctx->resp->IsKeepAlive();
+            onResponse(ctx);
             if (keepalive) {
                 // NOTE: add into conn_pools to reuse
                 // hlogd("add into conn_pools");
@@ -188,20 +196,7 @@ int AsyncHttpClient::doTaskWithAddr(const HttpClientTaskPtr& task, const sockadd
                 ctx->parser->IsEof()) {
                 ctx->successCallback();
             }
-            else if (task->req &&
-                     task->req->cancel == 0 &&
-                     task->req->retry_count-- > 0) {
-                if (task->req->retry_delay > 0) {
-                    // try again after delay
-                    setTimeout(task->req->retry_delay, [this, task](TimerID timerID){
-                        hlogi("retry %s %s", http_method_str(task->req->method), task->req->url.c_str());
-                        sendInLoop(task);
-                    });
-                } else {
-                    send(task);
-                }
-            }
-            else {
+            else if (!retryTask(task)) {
                 ctx->errorCallback();
             }
         }
@@ -272,4 +267,272 @@ int AsyncHttpClient::sendRequest(const SocketChannelPtr& channel) {
     return 0;
 }
 
+void AsyncHttpClient::onResponse(HttpClientContext* ctx) {
+    auto& req = ctx->task->req;
+    auto& resp = ctx->resp;
+    if (req->redirect && HTTP_STATUS_IS_REDIRECT(resp->status_code)) {
+        std::string location = resp->headers["Location"];
+        if (!location.empty()) {
+            hlogi("redirect %s => %s", req->url.c_str(), location.c_str());
+            req->url = location;
+            req->ParseUrl();
+            req->headers["Host"] = req->host;
+            resp->Reset();
+            send(ctx->task);
+            // NOTE: detatch from original channel->context
+            ctx->cancelTask();
+        }
+    } else {
+        ctx->successCallback();
+    }
+}
+
+bool AsyncHttpClient::retryTask(const HttpClientTaskPtr& task) {
+    if (task->req == NULL ||
+        task->req->cancel != 0 ||
+        task->req->retry_count-- <= 0) {
+        return false;
+    }
+    if (task->req->retry_delay > 0) {
+        // try again after delay
+        setTimeout(task->req->retry_delay, [this, task](TimerID timerID){
+            (void)timerID;
+            hlogi("retry %s %s", http_method_str(task->req->method), task->req->url.c_str());
+            sendInLoop(task);
+        });
+    } else {
+        send(task);
+    }
+    return true;
+}
+
+// get or create connection => SubmitRequest as a stream => flushHttp2 =>
+// onread => Http2Parser => onStreamClose => resp_cb
+int AsyncHttpClient::doHttp2Task(const HttpClientTaskPtr& task, const sockaddr_u* peeraddr, int timeout_ms) {
+#ifdef WITH_NGHTTP2
+    const HttpRequestPtr& req = task->req;
+    const char* host = req->host.c_str();
+    char strAddr[SOCKADDR_STRLEN] = {0};
+    SOCKADDR_STR(peeraddr, strAddr);
+
+    // first get a connection with free streams from h2_conns
+    int connfd = -1;
+    std::list<int>& conns = h2_conns[strAddr];
+    for (int fd : conns) {
+        Http2ClientContext* ctx = getChannel(fd)->getContext<Http2ClientContext>();
+        Http2Parser* parser = (Http2Parser*)ctx->parser.get();
+        if (!parser->goaway && (int)ctx->streams.size() < parser->MaxConcurrentStreams()) {
+            connfd = fd;
+            break;
+        }
+    }
+
+    if (connfd < 0) {
+        // create socket
+        connfd = socket(peeraddr->sa.sa_family, SOCK_STREAM, 0);
+        if (connfd < 0) {
+            perror("socket");
+            return -30;
+        }
+        // NOTE: small WINDOW_UPDATE frames must not wait for delayed ACK
+        tcp_nodelay(connfd, 1);
+        hio_t* connio = hio_get(EventLoopThread::hloop(), connfd);
+        assert(connio != NULL);
+        hio_set_peeraddr(connio, (struct sockaddr*)&peeraddr->sa, sockaddr_len((sockaddr_u*)peeraddr));
+        const SocketChannelPtr& channel = addHttp2Channel(connio);
+        // https
+        if (req->IsHttps()) {
+            hio_enable_ssl(connio);
+            if (!is_ipaddr(host)) {
+                hio_set_hostname(connio, host);
+            }
+#if HTTP2_OVER_TLS
+            // NOTE: offer h2 by ALPN, checked on connected
+            hssl_t ssl = hssl_new(hssl_ctx_instance(), connfd);
+            if (ssl) {
+                static unsigned char s_alpn_protos[] = "\x02h2\x08http/1.1";
+                hssl_set_alpn_protos(ssl, s_alpn_protos, sizeof(s_alpn_protos) - 1);
+                hio_set_ssl(connio, ssl);
+            }
+#endif
+        }
+        Http2ClientContext* ctx = channel->getContext<Http2ClientContext>();
+        Http2Parser* parser = new Http2Parser(HTTP_CLIENT);
+        ctx->parser.reset(parser);
+        parser->onStreamClose = [this, &channel](int32_t stream_id, uint32_t error_code) {
+            Http2ClientContext* ctx = channel->getContext<Http2ClientContext>();
+            auto iter = ctx->streams.find(stream_id);
+            if (iter == ctx->streams.end()) return;
+            HttpClientContextPtr stream = iter->second;
+            ctx->streams.erase(iter);
+            if (stream->task == NULL) return;
+            http2_stream* s = ((Http2Parser*)ctx->parser.get())->GetStream(stream_id);
+            if (s && s->recv_complete) {
+                onResponse(stream.get());
+            } else if (!retryTask(stream->task)) {
+                hlogw("%s stream closed error_code=%u", stream->task->req->url.c_str(), error_code);
+                stream->errorCallback();
+            } else {
+                stream->cancelTask();
+            }
+        };
+        channel->onconnect = [&channel]() {
+            Http2ClientContext* ctx = channel->getContext<Http2ClientContext>();
+#if HTTP2_OVER_TLS
+            hssl_t ssl = hio_get_ssl(channel->io());
+            if (ssl) {
+                const unsigned char* proto = NULL;
+                int len = hssl_get_alpn_selected(ssl, &proto);
+                if (len != 2 || memcmp(proto, "h2", 2) != 0) {
+                    // NOTE: requests of this connection are sent again by HTTP/1.1 on close
+                    ctx->fallback = true;
+                    channel->close();
+                    return;
+                }
+            }
+#endif
+            ctx->connected = true;
+            flushHttp2(channel);
+            channel->startRead();
+        };
+        channel->onread = [this, &channel](Buffer* buf) {
+            Http2ClientContext* ctx = channel->getContext<Http2ClientContext>();
+            const char* data = (const char*)buf->data();
+            int len = buf->size();
+            // NOTE: HTTP/2 server must send SETTINGS frame first
+            if (ctx->recvbytes == 0 && len >= HTTP2_FRAME_HDLEN && data[3] != HTTP2_SETTINGS) {
+                // NOTE: requests of this connection are sent again by HTTP/1.1 on close
+                ctx->fallback = true;
+                channel->close();
+                return;
+            }
+            ctx->recvbytes += len;
+            int nparse = ctx->parser->FeedRecvData(data, len);
+            if (nparse != len) {
+                channel->close();
+                return;
+            }
+            // cancel
+            Http2Parser* parser = (Http2Parser*)ctx->parser.get();
+            for (auto& pair : ctx->streams) {
+                if (pair.second->task && pair.second->task->req->cancel) {
+                    parser->ResetStream(pair.first);
+                }
+            }
+            flushHttp2(channel);
+        };
+        channel->onclose = [this, &channel]() {
+            Http2ClientContext* ctx = channel->getContext<Http2ClientContext>();
+            // NOTE: remove from h2_conns
+            auto iter = h2_conns.find(channel->peeraddr());
+            if (iter != h2_conns.end()) {
+                iter->second.remove(channel->fd());
+                if (iter->second.empty()) h2_conns.erase(iter);
+            }
+
+            // NOTE: closed without any response to the preface
+            if (ctx->connected && ctx->recvbytes == 0 && !ctx->streams.empty()) {
+                ctx->fallback = true;
+            }
+            if (ctx->fallback) {
+                hlogw("%s does not support HTTP/2, fallback to HTTP/1.1", channel->peeraddr().c_str());
+                h1_peers.insert(channel->peeraddr());
+            }
+
+            std::map<int, HttpClientContextPtr> streams;
+            streams.swap(ctx->streams);
+            for (auto& pair : streams) {
+                HttpClientContextPtr& stream = pair.second;
+                if (stream->task == NULL) continue;
+                if (ctx->fallback) {
+                    stream->task->req->http_major = 1;
+                    stream->task->req->http_minor = 1;
+                    send(stream->task);
+                    stream->cancelTask();
+                } else if (retryTask(stream->task)) {
+                    stream->cancelTask();
+                } else {
+                    stream->errorCallback();
+                }
+            }
+
+            ((Http2Parser*)ctx->parser.get())->onStreamClose = NULL;
+            removeHttp2Channel(channel);
+        };
+        conns.push_back(connfd);
+        if (req->connect_timeout > 0) {
+            channel->setConnectTimeout(req->connect_timeout * 1000);
+        }
+        channel->startConnect();
+    }
+
+    const SocketChannelPtr& channel = getChannel(connfd);
+    Http2ClientContext* ctx = channel->getContext<Http2ClientContext>();
+    Http2Parser* parser = (Http2Parser*)ctx->parser.get();
+    HttpClientContextPtr stream = std::make_shared<HttpClientContext>();
+    stream->task = task;
+    stream->resp = std::make_shared<HttpResponse>();
+    if (req->http_cb) stream->resp->http_cb = std::move(req->http_cb);
+    int stream_id = parser->SubmitRequest(req.get(), stream->resp.get());
+    if (stream_id < 0) {
+        hloge("%s submit request failed: %s", req->url.c_str(), parser->StrError(stream_id));
+        req->http_cb = std::move(stream->resp->http_cb);
+        // NOTE: channel is removed on close, do not touch it after.
+        if (ctx->streams.empty()) {
+            channel->close();
+        }
+        // send by HTTP/1.1 instead
+        req->http_major = 1;
+        req->http_minor = 1;
+        return doTaskWithAddr(task, peeraddr);
+    }
+    ctx->streams[stream_id] = stream;
+
+    // timer
+    if (timeout_ms > 0) {
+        stream->timerID = setTimeout(timeout_ms, [&channel, stream_id](TimerID timerID){
+            (void)timerID;
+            Http2ClientContext* ctx = channel->getContext<Http2ClientContext>();
+            auto iter = ctx->streams.find(stream_id);
+            if (iter != ctx->streams.end() && iter->second->task) {
+                hlogw("%s timeout!", iter->second->task->req->url.c_str());
+            }
+            if (!channel->isConnected()) {
+                // connect timeout
+                channel->close();
+                return;
+            }
+            ((Http2Parser*)ctx->parser.get())->ResetStream(stream_id);
+            flushHttp2(channel);
+        });
+    }
+
+    flushHttp2(channel);
+    return 0;
+#else
+    (void)task; (void)peeraddr; (void)timeout_ms;
+    return -1;
+#endif
+}
+
+// NOTE: frames of all streams are gathered into one write
+void AsyncHttpClient::flushHttp2(const SocketChannelPtr& channel) {
+    // NOTE: flush on connected
+    if (!channel->isConnected()) return;
+    Http2ClientContext* ctx = channel->getContext<Http2ClientContext>();
+    char* data = NULL;
+    size_t len = 0;
+    std::string buf;
+    while (ctx->parser->GetSendData(&data, &len)) {
+        buf.append(data, len);
+        if (buf.size() >= (1 << 16) /* 64K */) {
+            channel->write(std::move(buf));
+            buf.clear();
+        }
+    }
+    if (!buf.empty()) {
+        channel->write(buf);
+    }
+}
+
 }
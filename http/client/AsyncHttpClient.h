@@ -3,6 +3,7 @@
 
 #include <map>
 #include <list>
+#include <set>
 
 #include "EventLoopThread.h"
 #include "Channel.h"
@@ -102,6 +103,26 @@ struct HttpClientContext {
     }
 };
 
+typedef std::shared_ptr<HttpClientContext> HttpClientContextPtr;
+
+// HTTP/2 connection, requests are multiplexed as streams
+struct Http2ClientContext {
+    // stream_id => HttpClientContext
+    std::map<int, HttpClientContextPtr> streams;
+    // NOTE: parser is deleted before streams
+    HttpParserPtr       parser;
+    uint64_t            recvbytes;
+    bool                connected;
+    // peer does not speak HTTP/2
+    bool                fallback;
+
+    Http2ClientContext() {
+        recvbytes = 0;
+        connected = false;
+        fallback = false;
+    }
+};
+
 class HV_EXPORT AsyncHttpClient : private EventLoopThread {
 public:
     AsyncHttpClient(EventLoopPtr loop = NULL) : EventLoopThread(loop) {
@@ -137,6 +158,16 @@ protected:
 
     static int sendRequest(const SocketChannelPtr& channel);
 
+    // redirect or callback
+    void onResponse(HttpClientContext* ctx);
+    // @return true if task is sent again
+    bool retryTask(const HttpClientTaskPtr& task);
+
+    // HTTP/2: request is sent as a stream of a connection to peeraddr,
+    // a new connection is made if all are busy with SETTINGS_MAX_CONCURRENT_STREAMS.
+    int doHttp2Task(const HttpClientTaskPtr& task, const sockaddr_u* peeraddr, int timeout_ms);
+    static void flushHttp2(const SocketChannelPtr& channel);
+
     // channel
     const SocketChannelPtr& getChannel(int fd) {
         return channels[fd];
@@ -157,12 +188,30 @@ protected:
         channels.erase(fd);
     }
 
+    const SocketChannelPtr& addHttp2Channel(hio_t* io) {
+        auto channel = std::make_shared<SocketChannel>(io);
+        channel->newContext<Http2ClientContext>();
+        int fd = channel->fd();
+        channels[fd] = channel;
+        return channels[fd];
+    }
+
+    void removeHttp2Channel(const SocketChannelPtr& channel) {
+        channel->deleteContext<Http2ClientContext>();
+        int fd = channel->fd();
+        channels.erase(fd);
+    }
+
 private:
     // NOTE: just one loop thread, no need mutex.
     // fd => SocketChannelPtr
     std::map<int, SocketChannelPtr>         channels;
     // peeraddr => ConnPool
     std::map<std::string, ConnPool<int>>    conn_pools;
+    // peeraddr => HTTP/2 connections, shared by requests
+    std::map<std::string, std::list<int>>   h2_conns;
+    // peeraddr not speaking HTTP/2, requests fallback to HTTP/1.1
+    std::set<std::string>                   h1_peers;
 };
 
 }
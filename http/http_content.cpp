@@ -109,128 +109,134 @@ std::string dump_multipart(MultiPart& mp, const char* boundary) {
 }
 
 #include "multipart_parser.h"
-enum multipart_parser_state_e {
-    MP_START,
-    MP_PART_DATA_BEGIN,
-    MP_HEADER_FIELD,
-    MP_HEADER_VALUE,
-    MP_HEADERS_COMPLETE,
-    MP_PART_DATA,
-    MP_PART_DATA_END,
-    MP_BODY_END
-};
-struct multipart_parser_userdata {
-    MultiPart* mp;
-    // tmp
-    multipart_parser_state_e state;
-    std::string header_field;
-    std::string header_value;
-    std::string part_data;
-    std::string name;
-    std::string filename;
-
-    void handle_header() {
-        if (header_field.size() == 0 || header_value.size() == 0) return;
-        if (stricmp(header_field.c_str(), "Content-Disposition") == 0) {
-            StringList strlist = split(header_value, ';');
-            for (auto& str : strlist) {
-                StringList kv = split(trim(str, " "), '=');
-                if (kv.size() == 2) {
-                    const char* key = kv.begin()->c_str();
-                    std::string value = *(kv.begin() + 1);
-                    value = trim_pairs(value, "\"\"\'\'");
-                    if (strcmp(key, "name") == 0) {
-                        name = value;
-                    }
-                    else if (strcmp(key, "filename") == 0) {
-                        filename = value;
-                    }
+
+MultipartParser::MultipartParser(const char* boundary) {
+    static multipart_parser_settings settings = {
+        on_header_field,
+        on_header_value,
+        on_part_data,
+        on_part_data_begin,
+        on_headers_complete,
+        on_part_data_end,
+        on_body_end
+    };
+    std::string __boundary("--");
+    __boundary += boundary;
+    parser = multipart_parser_init(__boundary.c_str(), &settings);
+    multipart_parser_set_data(parser, this);
+    complete = false;
+}
+
+MultipartParser::~MultipartParser() {
+    multipart_parser_free(parser);
+}
+
+size_t MultipartParser::FeedRecvData(const char* data, size_t len) {
+    return multipart_parser_execute(parser, data, len);
+}
+
+void MultipartParser::handle_header() {
+    if (header_field.size() == 0 || header_value.size() == 0) return;
+    if (stricmp(header_field.c_str(), "Content-Disposition") == 0) {
+        StringList strlist = split(header_value, ';');
+        for (auto& str : strlist) {
+            StringList kv = split(trim(str, " "), '=');
+            if (kv.size() == 2) {
+                const char* key = kv.begin()->c_str();
+                std::string value = *(kv.begin() + 1);
+                value = trim_pairs(value, "\"\"\'\'");
+                if (strcmp(key, "name") == 0) {
+                    name = value;
+                }
+                else if (strcmp(key, "filename") == 0) {
+                    filename = value;
                 }
             }
         }
-        header_field.clear();
-        header_value.clear();
     }
+    header_field.clear();
+    header_value.clear();
+}
 
-    void handle_data() {
-        if (name.size() != 0) {
-            FormData formdata;
-            formdata.content = part_data;
-            formdata.filename = filename;
-            (*mp)[name] = formdata;
-        }
-        name.clear();
-        filename.clear();
-        part_data.clear();
-    }
-};
-static int on_header_field(multipart_parser* parser, const char *at, size_t length) {
+int MultipartParser::on_header_field(multipart_parser* parser, const char *at, size_t length) {
     //printf("on_header_field:%.*s\n", (int)length, at);
-    multipart_parser_userdata* userdata = (multipart_parser_userdata*)multipart_parser_get_data(parser);
-    userdata->handle_header();
-    userdata->state = MP_HEADER_FIELD;
-    userdata->header_field.append(at, length);
+    MultipartParser* mp = (MultipartParser*)multipart_parser_get_data(parser);
+    if (mp->header_value.size() != 0) {
+        mp->handle_header();
+    }
+    mp->header_field.append(at, length);
     return 0;
 }
-static int on_header_value(multipart_parser* parser, const char *at, size_t length) {
+
+int MultipartParser::on_header_value(multipart_parser* parser, const char *at, size_t length) {
     //printf("on_header_value:%.*s\n", (int)length, at);
-    multipart_parser_userdata* userdata = (multipart_parser_userdata*)multipart_parser_get_data(parser);
-    userdata->state = MP_HEADER_VALUE;
-    userdata->header_value.append(at, length);
+    MultipartParser* mp = (MultipartParser*)multipart_parser_get_data(parser);
+    mp->header_value.append(at, length);
     return 0;
 }
-static int on_part_data(multipart_parser* parser, const char *at, size_t length) {
+
+int MultipartParser::on_part_data(multipart_parser* parser, const char *at, size_t length) {
     //printf("on_part_data:%.*s\n", (int)length, at);
-    multipart_parser_userdata* userdata = (multipart_parser_userdata*)multipart_parser_get_data(parser);
-    userdata->state = MP_PART_DATA;
-    userdata->part_data.append(at, length);
+    MultipartParser* mp = (MultipartParser*)multipart_parser_get_data(parser);
+    if (length && mp->onPartData) {
+        mp->onPartData(at, length);
+    }
     return 0;
 }
-static int on_part_data_begin(multipart_parser* parser) {
+
+int MultipartParser::on_part_data_begin(multipart_parser* parser) {
     //printf("on_part_data_begin\n");
-    multipart_parser_userdata* userdata = (multipart_parser_userdata*)multipart_parser_get_data(parser);
-    userdata->state = MP_PART_DATA_BEGIN;
+    MultipartParser* mp = (MultipartParser*)multipart_parser_get_data(parser);
+    mp->header_field.clear();
+    mp->header_value.clear();
+    mp->name.clear();
+    mp->filename.clear();
     return 0;
 }
-static int on_headers_complete(multipart_parser* parser) {
+
+int MultipartParser::on_headers_complete(multipart_parser* parser) {
     //printf("on_headers_complete\n");
-    multipart_parser_userdata* userdata = (multipart_parser_userdata*)multipart_parser_get_data(parser);
-    userdata->handle_header();
-    userdata->state = MP_HEADERS_COMPLETE;
+    MultipartParser* mp = (MultipartParser*)multipart_parser_get_data(parser);
+    mp->handle_header();
+    if (mp->onPartBegin) {
+        mp->onPartBegin(mp->name, mp->filename);
+    }
     return 0;
 }
-static int on_part_data_end(multipart_parser* parser) {
+
+int MultipartParser::on_part_data_end(multipart_parser* parser) {
     //printf("on_part_data_end\n");
-    multipart_parser_userdata* userdata = (multipart_parser_userdata*)multipart_parser_get_data(parser);
-    userdata->state = MP_PART_DATA_END;
-    userdata->handle_data();
+    MultipartParser* mp = (MultipartParser*)multipart_parser_get_data(parser);
+    if (mp->onPartEnd) {
+        mp->onPartEnd();
+    }
     return 0;
 }
-static int on_body_end(multipart_parser* parser) {
+
+int MultipartParser::on_body_end(multipart_parser* parser) {
     //printf("on_body_end\n");
-    multipart_parser_userdata* userdata = (multipart_parser_userdata*)multipart_parser_get_data(parser);
-    userdata->state = MP_BODY_END;
+    MultipartParser* mp = (MultipartParser*)multipart_parser_get_data(parser);
+    mp->complete = true;
     return 0;
 }
+
 int parse_multipart(const std::string& str, MultiPart& mp, const char* boundary) {
     //printf("boundary=%s\n", boundary);
-    std::string __boundary("--");
-    __boundary += boundary;
-    multipart_parser_settings settings;
-    settings.on_header_field = on_header_field;
-    settings.on_header_value = on_header_value;
-    settings.on_part_data    = on_part_data;
-    settings.on_part_data_begin  = on_part_data_begin;
-    settings.on_headers_complete = on_headers_complete;
-    settings.on_part_data_end    = on_part_data_end;
-    settings.on_body_end         = on_body_end;
-    multipart_parser* parser = multipart_parser_init(__boundary.c_str(), &settings);
-    multipart_parser_userdata userdata;
-    userdata.state = MP_START;
-    userdata.mp = &mp;
-    multipart_parser_set_data(parser, &userdata);
-    size_t nparse = multipart_parser_execute(parser, str.c_str(), str.size());
-    multipart_parser_free(parser);
+    MultipartParser parser(boundary);
+    FormData* formdata = NULL;
+    parser.onPartBegin = [&mp, &formdata](const std::string& name, const std::string& filename) {
+        if (name.size() == 0) return;
+        formdata = &mp[name];
+        *formdata = FormData();
+        formdata->filename = filename;
+    };
+    parser.onPartData = [&formdata](const char* data, size_t size) {
+        if (formdata) formdata->content.append(data, size);
+    };
+    parser.onPartEnd = [&formdata]() {
+        formdata = NULL;
+    };
+    size_t nparse = parser.FeedRecvData(str.c_str(), str.size());
     return nparse == str.size() ? 0 : -1;
 }
 
@@ -1,6 +1,8 @@
 #ifndef HV_HTTP_CONTENT_H_
 #define HV_HTTP_CONTENT_H_
 
+#include <functional>
+
 #include "hexport.h"
 #include "hstring.h"
 
@@ -8,6 +10,8 @@
 // ndk-r10e no std::to_string and can't compile modern json.hpp
 #ifndef WITHOUT_HTTP_CONTENT
 #include "json.hpp" // https://github.com/nlohmann/json
+// multipart_parser.h
+struct multipart_parser;
 #endif
 
 BEGIN_NAMESPACE_HV
@@ -35,6 +39,8 @@ content
 struct FormData {
     std::string     filename;
     std::string     content;
+    // server: content spilled to this temporary file, see HttpService::body_spill_size
+    std::string     filepath;
 
     FormData(const char* content = NULL, const char* filename = NULL) {
         if (content) {
@@ -65,6 +71,44 @@ typedef HV_MAP<std::string, FormData>          MultiPart;
 HV_EXPORT std::string dump_multipart(MultiPart& mp, const char* boundary = DEFAULT_MULTIPART_BOUNDARY);
 HV_EXPORT int         parse_multipart(const std::string& str, MultiPart& mp, const char* boundary);
 
+// MultipartParser: streaming parser of multipart/form-data,
+// part data is passed to onPartData as it arrives, pointing into the fed data.
+// @usage http_state_handler: HP_HEADERS_COMPLETE => new MultipartParser(boundary),
+//                            HP_BODY => FeedRecvData(data, size)
+class HV_EXPORT MultipartParser {
+public:
+    // Content-Disposition: form-data; name="avatar"; filename="user.jpg"
+    std::function<void(const std::string& name, const std::string& filename)> onPartBegin;
+    std::function<void(const char* data, size_t size)>                          onPartData;
+    std::function<void()>                                                       onPartEnd;
+
+    MultipartParser(const char* boundary);
+    ~MultipartParser();
+
+    // @retval len on success, the error position otherwise
+    size_t FeedRecvData(const char* data, size_t len);
+    // closing boundary parsed
+    bool IsComplete() { return complete; }
+
+private:
+    static int on_header_field(multipart_parser* parser, const char* at, size_t length);
+    static int on_header_value(multipart_parser* parser, const char* at, size_t length);
+    static int on_part_data(multipart_parser* parser, const char* at, size_t length);
+    static int on_part_data_begin(multipart_parser* parser);
+    static int on_headers_complete(multipart_parser* parser);
+    static int on_part_data_end(multipart_parser* parser);
+    static int on_body_end(multipart_parser* parser);
+    void handle_header();
+
+    multipart_parser*           parser;
+    bool                        complete;
+    // tmp
+    std::string header_field;
+    std::string header_value;
+    std::string name;
+    std::string filename;
+};
+
 // Json
 using Json = nlohmann::json;
 // using Json = nlohmann::ordered_json;
@@ -12,148 +12,507 @@
 #include "hstring.h" // import hv::utf8_to_wchar
 #endif
 
-#define ETAG_FMT    "\"%zx-%zx\""
+#ifdef OS_LINUX
+#include <sys/inotify.h>
+#define FILE_CACHE_INOTIFY_MASK (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | \
+                                 IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+#endif
+
+#define ETAG_FMT            "\"%zx-%zx\""
+#define ETAG_ENCODED_FMT    "\"%zx-%zx-%s\""
 
-FileCache::FileCache(size_t capacity) : hv::LRUCache<std::string, file_cache_ptr>(capacity) {
+FileCache::FileCache(size_t capacity) {
     stat_interval = 10; // s
     expired_time  = 60; // s
+    this->capacity = capacity;
+    inotify_fd_ = -1;
+    invalid_seq_ = 0;
 }
 
-file_cache_ptr FileCache::Open(const char* filepath, OpenParam* param) {
-    file_cache_ptr fc = Get(filepath);
-#ifdef OS_WIN
-    std::wstring wfilepath;
-#endif
-    bool modified = false;
-    if (fc) {
-        time_t now = time(NULL);
-        if (now - fc->stat_time > stat_interval) {
-            fc->stat_time = now;
-            fc->stat_cnt++;
+FileCache::~FileCache() {
+    if (inotify_fd_ >= 0) {
+        close(inotify_fd_);
+        inotify_fd_ = -1;
+    }
+}
+
+static int stat_file(const char* filepath, struct stat* st) {
 #ifdef OS_WIN
-            wfilepath = hv::utf8_to_wchar(filepath);
-            now = fc->st.st_mtime;
-            _wstat(wfilepath.c_str(), (struct _stat*)&fc->st);
-            modified = now != fc->st.st_mtime;
+    std::wstring wfilepath = hv::utf8_to_wchar(filepath);
+    return _wstat(wfilepath.c_str(), (struct _stat*)st);
 #else
-            modified = fc->is_modified();
+    return stat(filepath, st);
 #endif
+}
+
+// NOTE: read into heap instead of mmap, truncating a mmaped file in place raises SIGBUS
+static bool read_file(file_cache_t* fc, int fd, size_t filesize) {
+    fc->buf.resize(filesize);
+    fc->filebuf.base = fc->buf.base;
+    fc->filebuf.len = filesize;
+    size_t nread = 0;
+    while (nread < filesize) {
+        int n = read(fd, fc->filebuf.base + nread, filesize - nread);
+        if (n <= 0) return false;
+        nread += n;
+    }
+    return true;
+}
+
+file_cache_ptr FileCache::Open(const char* filepath, OpenParam* param) {
+    bool need_stat = false;
+    file_cache_ptr fc = Get(filepath, &need_stat);
+    if (fc) {
+        bool modified = false;
+        if (need_stat) {
+            struct stat st;
+            modified = stat_file(filepath, &st) != 0 ||
+                       st.st_mtime != fc->st.st_mtime ||
+                       st.st_size != fc->st.st_size;
         }
-        if (param->need_read) {
-            if (!modified && fc->is_complete()) {
-                param->need_read = false;
+        if (!modified && (!param->need_read || fc->is_complete())) {
+            param->need_read = false;
+            if (S_ISREG(fc->st.st_mode)) {
+                param->filesize = fc->st.st_size;
             }
+            return fc;
         }
+        // NOTE: entry is immutable, load into a new one.
+        fc = NULL;
     }
-    if (fc == NULL || modified || param->need_read) {
-        struct stat st;
-        int flags = O_RDONLY;
+    // NOTE: watch before load, events between load and Put are checked by seq
+    uint64_t seq = invalid_seq_;
+    bool watched = Watch(filepath);
+
+    struct stat st;
+    int flags = O_RDONLY;
 #ifdef O_BINARY
-        flags |= O_BINARY;
+    flags |= O_BINARY;
 #endif
-        int fd = -1;
+    int fd = -1;
 #ifdef OS_WIN
-        if(wfilepath.empty()) wfilepath = hv::utf8_to_wchar(filepath);
-        if(_wstat(wfilepath.c_str(), (struct _stat*)&st) != 0) {
-            param->error = ERR_OPEN_FILE;
-            return NULL;
-        }
-        if(S_ISREG(st.st_mode)) {
-            fd = _wopen(wfilepath.c_str(), flags);
-        }else if (S_ISDIR(st.st_mode)) {
-            // NOTE: open(dir) return -1 on windows
-            fd = 0;
-        }
+    std::wstring wfilepath = hv::utf8_to_wchar(filepath);
+    if(_wstat(wfilepath.c_str(), (struct _stat*)&st) != 0) {
+        param->error = ERR_OPEN_FILE;
+        return NULL;
+    }
+    if(S_ISREG(st.st_mode)) {
+        fd = _wopen(wfilepath.c_str(), flags);
+    }else if (S_ISDIR(st.st_mode)) {
+        // NOTE: open(dir) return -1 on windows
+        fd = 0;
+    }
 #else
-        if(stat(filepath, &st) != 0) {
-            param->error = ERR_OPEN_FILE;
-            return NULL;
-        }
-        fd = open(filepath, flags);
+    if(stat(filepath, &st) != 0) {
+        param->error = ERR_OPEN_FILE;
+        return NULL;
+    }
+    fd = open(filepath, flags);
 #endif
-        if (fd < 0) {
-            param->error = ERR_OPEN_FILE;
-            return NULL;
-        }
-        defer(if (fd > 0) { close(fd); })
-        if (fc == NULL) {
-            if (S_ISREG(st.st_mode) ||
-                (S_ISDIR(st.st_mode) &&
-                 filepath[strlen(filepath)-1] == '/')) {
-                fc = std::make_shared<file_cache_t>();
-                fc->filepath = filepath;
-                fc->st = st;
-                time(&fc->open_time);
-                fc->stat_time = fc->open_time;
-                fc->stat_cnt = 1;
-                put(filepath, fc);
+    if (fd < 0) {
+        param->error = ERR_OPEN_FILE;
+        return NULL;
+    }
+    defer(if (fd > 0) { close(fd); })
+    if (!(S_ISREG(st.st_mode) ||
+          (S_ISDIR(st.st_mode) &&
+           filepath[strlen(filepath)-1] == '/'))) {
+        param->error = ERR_MISMATCH;
+        return NULL;
+    }
+    fc = std::make_shared<file_cache_t>();
+    fc->filepath = filepath;
+    fc->st = st;
+    time(&fc->open_time);
+    fc->stat_time = fc->open_time;
+    fc->access_time = fc->open_time;
+    fc->stat_cnt = 1;
+    if (S_ISREG(st.st_mode)) {
+        param->filesize = st.st_size;
+        // FILE
+        if (param->need_read) {
+            if (st.st_size > param->max_read) {
+                param->error = ERR_OVER_LIMIT;
+                return NULL;
             }
-            else {
-                param->error = ERR_MISMATCH;
+            if (!read_file(fc.get(), fd, st.st_size)) {
+                hloge("Failed to read file: %s", filepath);
+                param->error = ERR_READ_FILE;
                 return NULL;
             }
         }
-        if (S_ISREG(fc->st.st_mode)) {
-            param->filesize = fc->st.st_size;
-            // FILE
-            if (param->need_read) {
-                if (fc->st.st_size > param->max_read) {
-                    param->error = ERR_OVER_LIMIT;
-                    return NULL;
-                }
-                fc->resize_buf(fc->st.st_size);
-                int nread = read(fd, fc->filebuf.base, fc->filebuf.len);
-                if (nread != fc->filebuf.len) {
-                    hloge("Failed to read file: %s", filepath);
-                    param->error = ERR_READ_FILE;
-                    return NULL;
-                }
+        const char* suffix = strrchr(filepath, '.');
+        if (suffix) {
+            http_content_type content_type = http_content_type_enum_by_suffix(suffix+1);
+            if (content_type == TEXT_HTML) {
+                fc->content_type = "text/html; charset=utf-8";
+            } else if (content_type == TEXT_PLAIN) {
+                fc->content_type = "text/plain; charset=utf-8";
+            } else {
+                fc->content_type = http_content_type_str_by_suffix(suffix+1);
             }
-            const char* suffix = strrchr(filepath, '.');
-            if (suffix) {
-                http_content_type content_type = http_content_type_enum_by_suffix(suffix+1);
-                if (content_type == TEXT_HTML) {
-                    fc->content_type = "text/html; charset=utf-8";
-                } else if (content_type == TEXT_PLAIN) {
-                    fc->content_type = "text/plain; charset=utf-8";
-                } else {
-                    fc->content_type = http_content_type_str_by_suffix(suffix+1);
+        }
+    }
+    else if (S_ISDIR(st.st_mode)) {
+        // DIR
+        std::string page;
+        make_index_of_page(filepath, page, param->path);
+        fc->buf.resize(page.size());
+        memcpy(fc->buf.base, page.c_str(), page.size());
+        fc->filebuf.base = fc->buf.base;
+        fc->filebuf.len = page.size();
+        fc->content_type = "text/html; charset=utf-8";
+    }
+    gmtime_fmt(fc->st.st_mtime, fc->last_modified);
+    snprintf(fc->etag, sizeof(fc->etag), ETAG_FMT, (size_t)fc->st.st_mtime, (size_t)fc->st.st_size);
+    if (watched && seq == invalid_seq_) {
+        fc->watched = true;
+    } else if (watched) {
+        // NOTE: maybe modified while loading, stat next time
+        fc->stat_time = 0;
+    }
+    Put(fc);
+    return fc;
+}
+
+file_cache_ptr FileCache::openSidecar(const file_cache_ptr& fc, int encoding) {
+    std::string filepath = fc->filepath + http_encoding_suffix(encoding);
+    struct stat st;
+    int flags = O_RDONLY;
+#ifdef O_BINARY
+    flags |= O_BINARY;
+#endif
+    if (stat_file(filepath.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return NULL;
+#ifdef OS_WIN
+    int fd = _wopen(hv::utf8_to_wchar(filepath.c_str()).c_str(), flags);
+#else
+    int fd = open(filepath.c_str(), flags);
+#endif
+    if (fd < 0) return NULL;
+    defer(close(fd);)
+    file_cache_ptr encoded = std::make_shared<file_cache_t>();
+    if (!read_file(encoded.get(), fd, st.st_size)) {
+        hloge("Failed to read file: %s", filepath.c_str());
+        return NULL;
+    }
+    encoded->st = st;
+    return encoded;
+}
+
+file_cache_ptr FileCache::Encode(const file_cache_ptr& fc, int encodings, bool precompressed, int compress_min_length) {
+    if (!S_ISREG(fc->st.st_mode) || encodings == 0) return NULL;
+    bool compress = compress_min_length >= 0 && fc->filebuf.len >= (size_t)compress_min_length &&
+                    (encodings & hv::HttpCompressor::Supported()) && http_content_compressible(fc->content_type.c_str());
+    if (!precompressed && !compress) return NULL;
+    int encoding = 0;
+    int idx = 0;
+    bool sidecar = false;
+    {
+        // NOTE: lock entry for variants only, read or compress out of lock
+        std::lock_guard<std::mutex> locker(fc->mutex);
+        if (precompressed && fc->sidecars < 0) {
+            fc->sidecars = 0;
+            std::string filepath;
+            struct stat st;
+            for (int i = 0; i < HTTP_ENCODINGS_NUM; ++i) {
+                int sidecar_encoding = 1 << i;
+                filepath = fc->filepath + http_encoding_suffix(sidecar_encoding);
+                if (stat_file(filepath.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+                    fc->sidecars |= sidecar_encoding;
                 }
             }
         }
-        else if (S_ISDIR(fc->st.st_mode)) {
-            // DIR
-            std::string page;
-            make_index_of_page(filepath, page, param->path);
-            fc->resize_buf(page.size());
-            memcpy(fc->filebuf.base, page.c_str(), page.size());
-            fc->content_type = "text/html; charset=utf-8";
+        encoding = precompressed ? (encodings & fc->sidecars) : 0;
+        if (encoding == 0) {
+            // on the fly
+            if (!compress || !fc->is_complete()) return NULL;
+            encoding = encodings & hv::HttpCompressor::Supported() & ~fc->incompressible;
+            if (encoding == 0) return NULL;
         }
-        gmtime_fmt(fc->st.st_mtime, fc->last_modified);
-        snprintf(fc->etag, sizeof(fc->etag), ETAG_FMT, (size_t)fc->st.st_mtime, (size_t)fc->st.st_size);
+        // preferred
+        encoding &= -encoding;
+        idx = http_encoding_index(encoding);
+        if (fc->encoded[idx]) return fc->encoded[idx];
+        sidecar = fc->sidecars > 0 && (fc->sidecars & encoding);
     }
-    return fc;
+
+    // NOTE: same variant may be made by workers at the same time, the first one is kept
+    file_cache_ptr encoded;
+    if (sidecar) {
+        encoded = openSidecar(fc, encoding);
+    } else {
+        std::string out;
+        if (hv::HttpCompressor::Compress(encoding, fc->filebuf.base, fc->filebuf.len, out) != 0 ||
+            out.size() >= fc->filebuf.len) {
+            std::lock_guard<std::mutex> locker(fc->mutex);
+            fc->incompressible |= encoding;
+            return NULL;
+        }
+        encoded = std::make_shared<file_cache_t>();
+        encoded->st = fc->st;
+        encoded->st.st_size = out.size();
+        encoded->buf.resize(out.size());
+        memcpy(encoded->buf.base, out.data(), out.size());
+        encoded->filebuf.base = encoded->buf.base;
+        encoded->filebuf.len = out.size();
+    }
+    if (encoded == NULL) return NULL;
+    // NOTE: Close(filepath) removes original with variants
+    encoded->filepath = fc->filepath;
+    encoded->open_time = fc->open_time;
+    encoded->stat_time = fc->stat_time;
+    encoded->access_time = fc->access_time;
+    encoded->content_type = fc->content_type;
+    encoded->content_encoding = http_encoding_str(encoding);
+    memcpy(encoded->last_modified, fc->last_modified, sizeof(fc->last_modified));
+    snprintf(encoded->etag, sizeof(encoded->etag), ETAG_ENCODED_FMT,
+             (size_t)fc->st.st_mtime, (size_t)fc->st.st_size, encoded->content_encoding.c_str());
+    {
+        std::lock_guard<std::mutex> locker(fc->mutex);
+        if (fc->encoded[idx]) return fc->encoded[idx];
+        fc->encoded[idx] = encoded;
+    }
+    Charge(fc, sizeof(file_cache_t) + encoded->filebuf.len);
+    return encoded;
 }
 
-bool FileCache::Exists(const char* filepath) const {
-    return contains(filepath);
+void FileCache::Charge(const file_cache_ptr& fc, size_t bytes) {
+    Shard& shard = shardOf(fc->filepath);
+    std::lock_guard<std::mutex> locker(shard.mutex);
+    auto iter = shard.map.find(fc->filepath);
+    if (iter != shard.map.end() && *iter->second == fc) {
+        shard.bytes += bytes;
+        fc->charged += bytes;
+    }
 }
 
-bool FileCache::Close(const char* filepath) {
-    return remove(filepath);
+bool FileCache::Exists(const char* filepath) {
+    std::string key(filepath);
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> locker(shard.mutex);
+    return shard.map.find(key) != shard.map.end();
 }
 
-file_cache_ptr FileCache::Get(const char* filepath) {
+bool FileCache::Close(const char* filepath) {
+    std::string key(filepath);
+    Shard& shard = shardOf(key);
     file_cache_ptr fc;
-    if (get(filepath, fc)) {
-        return fc;
+    {
+        std::lock_guard<std::mutex> locker(shard.mutex);
+        auto iter = shard.map.find(key);
+        if (iter == shard.map.end()) return false;
+        fc = *iter->second;
+        shard.bytes -= fc->charged;
+        shard.lru.erase(iter->second);
+        shard.map.erase(iter);
+    }
+    // NOTE: free out of lock if last reference
+    return true;
+}
+
+file_cache_ptr FileCache::Get(const char* filepath, bool* need_stat) {
+    std::string key(filepath);
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> locker(shard.mutex);
+    auto iter = shard.map.find(key);
+    if (iter == shard.map.end()) {
+        return NULL;
+    }
+    // move to front
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+    file_cache_ptr fc = *iter->second;
+    time_t now = time(NULL);
+    fc->access_time = now;
+    if (need_stat && !fc->watched && now - fc->stat_time > stat_interval) {
+        fc->stat_time = now;
+        fc->stat_cnt++;
+        *need_stat = true;
+    }
+    return fc;
+}
+
+void FileCache::Put(const file_cache_ptr& fc) {
+    Shard& shard = shardOf(fc->filepath);
+    size_t shard_capacity = capacity / FILE_CACHE_SHARDS;
+    std::vector<file_cache_ptr> evicted;
+    std::lock_guard<std::mutex> locker(shard.mutex);
+    auto iter = shard.map.find(fc->filepath);
+    if (iter != shard.map.end()) {
+        evicted.push_back(*iter->second);
+        shard.bytes -= (*iter->second)->charged;
+        shard.lru.erase(iter->second);
+        shard.map.erase(iter);
+    }
+    // evict by bytes, keep the new one even if over capacity
+    size_t charge = sizeof(file_cache_t) + fc->filepath.size() + fc->filebuf.len;
+    fc->charged = charge;
+    while (!shard.lru.empty() && shard.bytes + charge > shard_capacity) {
+        const file_cache_ptr& lru = shard.lru.back();
+        evicted.push_back(lru);
+        shard.bytes -= lru->charged;
+        shard.map.erase(lru->filepath);
+        shard.lru.pop_back();
     }
-    return NULL;
+    shard.lru.push_front(fc);
+    shard.map[fc->filepath] = shard.lru.begin();
+    shard.bytes += charge;
 }
 
 void FileCache::RemoveExpiredFileCache() {
     time_t now = time(NULL);
-    remove_if([this, now](const std::string& filepath, const file_cache_ptr& fc) {
-        return (now - fc->stat_time > expired_time);
-    });
+    for (int i = 0; i < FILE_CACHE_SHARDS; ++i) {
+        Shard& shard = shards_[i];
+        std::vector<file_cache_ptr> expired;
+        std::lock_guard<std::mutex> locker(shard.mutex);
+        // from least recently used
+        while (!shard.lru.empty() && now - shard.lru.back()->access_time > expired_time) {
+            const file_cache_ptr& fc = shard.lru.back();
+            expired.push_back(fc);
+            shard.bytes -= fc->charged;
+            shard.map.erase(fc->filepath);
+            shard.lru.pop_back();
+        }
+    }
+}
+
+void FileCache::Clear() {
+    for (int i = 0; i < FILE_CACHE_SHARDS; ++i) {
+        Shard& shard = shards_[i];
+        lru_list_t lru;
+        std::lock_guard<std::mutex> locker(shard.mutex);
+        lru.swap(shard.lru);
+        shard.map.clear();
+        shard.bytes = 0;
+    }
+}
+
+size_t FileCache::Size() {
+    size_t size = 0;
+    for (int i = 0; i < FILE_CACHE_SHARDS; ++i) {
+        std::lock_guard<std::mutex> locker(shards_[i].mutex);
+        size += shards_[i].map.size();
+    }
+    return size;
+}
+
+size_t FileCache::Bytes() {
+    size_t bytes = 0;
+    for (int i = 0; i < FILE_CACHE_SHARDS; ++i) {
+        std::lock_guard<std::mutex> locker(shards_[i].mutex);
+        bytes += shards_[i].bytes;
+    }
+    return bytes;
+}
+
+int FileCache::OpenInotify() {
+#ifdef OS_LINUX
+    std::lock_guard<std::mutex> locker(watch_mutex_);
+    if (inotify_fd_ < 0) {
+        inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd_ < 0) {
+            hlogw("inotify_init1 failed: %s, stat file per %ds", strerror(errno), stat_interval);
+        }
+    }
+    return inotify_fd_;
+#else
+    return -1;
+#endif
+}
+
+bool FileCache::Watch(const char* filepath) {
+#ifdef OS_LINUX
+    std::lock_guard<std::mutex> locker(watch_mutex_);
+    if (inotify_fd_ < 0) return false;
+    // watch the dir of file, or the dir itself for index page
+    std::string dir(filepath);
+    size_t len = dir.size();
+    if (len > 1 && dir.back() == '/') dir.pop_back();
+    size_t pos = dir.rfind('/');
+    if (pos == std::string::npos) return false;
+    if (dir.size() != len) pos = dir.size();
+    dir.resize(pos);
+    if (dir_wds_.find(dir) == dir_wds_.end()) {
+        int wd = inotify_add_watch(inotify_fd_, dir.empty() ? "/" : dir.c_str(), FILE_CACHE_INOTIFY_MASK);
+        if (wd < 0) {
+            hlogd("inotify_add_watch %s failed: %s", dir.c_str(), strerror(errno));
+            return false;
+        }
+        dir_wds_[dir] = wd;
+        watch_dirs_[wd].push_back(dir);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FileCache::OnInotifyEvents(const char* buf, int len) {
+#ifdef OS_LINUX
+    ++invalid_seq_;
+    std::vector<std::string> invalid;
+    std::vector<std::string> invalid_dirs;
+    const char* end = buf + len;
+    while (buf + sizeof(struct inotify_event) <= end) {
+        const struct inotify_event* ev = (const struct inotify_event*)buf;
+        buf += sizeof(struct inotify_event) + ev->len;
+        if (ev->mask & IN_Q_OVERFLOW) {
+            hlogw("inotify queue overflow, clear FileCache");
+            Clear();
+            continue;
+        }
+        std::lock_guard<std::mutex> locker(watch_mutex_);
+        auto iter = watch_dirs_.find(ev->wd);
+        if (iter == watch_dirs_.end()) continue;
+        for (const auto& dir : iter->second) {
+            // index page of dir
+            invalid.push_back(dir + '/');
+            if (ev->len && ev->name[0]) {
+                invalid.push_back(dir + '/' + ev->name);
+                // index page if name is a dir
+                invalid.push_back(invalid.back() + '/');
+                // original of precompressed sidecar
+                for (int i = 0; i < HTTP_ENCODINGS_NUM; ++i) {
+                    const char* suffix = http_encoding_suffix(1 << i);
+                    size_t name_len = strlen(ev->name);
+                    size_t suffix_len = strlen(suffix);
+                    if (name_len > suffix_len && strcmp(ev->name + name_len - suffix_len, suffix) == 0) {
+                        invalid.push_back(dir + '/' + std::string(ev->name, name_len - suffix_len));
+                    }
+                }
+            }
+        }
+        if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+            // dir is gone, drop all entries under it
+            if (!(ev->mask & IN_IGNORED)) {
+                inotify_rm_watch(inotify_fd_, ev->wd);
+            }
+            for (const auto& dir : iter->second) {
+                dir_wds_.erase(dir);
+                invalid_dirs.push_back(dir + '/');
+            }
+            watch_dirs_.erase(iter);
+        }
+    }
+    for (const auto& filepath : invalid) {
+        Close(filepath.c_str());
+    }
+    for (const auto& dir : invalid_dirs) {
+        for (int i = 0; i < FILE_CACHE_SHARDS; ++i) {
+            Shard& shard = shards_[i];
+            std::vector<file_cache_ptr> removed;
+            std::lock_guard<std::mutex> locker(shard.mutex);
+            for (auto iter = shard.lru.begin(); iter != shard.lru.end();) {
+                const file_cache_ptr& fc = *iter;
+                if (fc->filepath.compare(0, dir.size(), dir) == 0) {
+                    removed.push_back(fc);
+                    shard.bytes -= fc->charged;
+                    shard.map.erase(fc->filepath);
+                    iter = shard.lru.erase(iter);
+                } else {
+                    ++iter;
+                }
+            }
+        }
+    }
+#endif
 }
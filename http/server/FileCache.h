@@ -1,69 +1,81 @@
 #ifndef HV_FILE_CACHE_H_
 #define HV_FILE_CACHE_H_
 
+/*
+ * FileCache: sharded LRU of static files, evicted by bytes.
+ *
+ * Entries are immutable after published, a modified file is loaded into a new entry,
+ * so workers can send filebuf without lock while the old entry is still referenced.
+ * Files are read into heap, a file truncated in place does not affect sending entries.
+ *
+ * Invalidation: inotify on linux if OpenInotify, else stat per stat_interval.
+ * Encoded variants (precompressed sidecar files or compressed on the fly) are kept
+ * in the entry of original file, and removed with it.
+ * NOTE: sidecar files not watched by inotify are not checked until original is modified.
+ */
+
+#include <atomic>
 #include <memory>
-#include <map>
+#include <list>
 #include <string>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "hbuf.h"
 #include "hstring.h"
-#include "LRUCache.h"
+#include "HttpCompressor.h"
 
 #define HTTP_HEADER_MAX_LENGTH      1024        // 1K
-#define FILE_CACHE_MAX_NUM          100
 #define FILE_CACHE_MAX_SIZE         (1 << 22)   // 4M
+#define FILE_CACHE_DEFAULT_CAPACITY (1 << 28)   // 256M
+#define FILE_CACHE_SHARDS           16
 
 typedef struct file_cache_s {
     std::string filepath;
     struct stat st;
     time_t      open_time;
     time_t      stat_time;
+    time_t      access_time;
     uint32_t    stat_cnt;
-    HBuf        buf; // http_header + file_content
+    bool        watched; // by inotify
+    HBuf        buf;     // file_content
     hbuf_t      filebuf;
-    hbuf_t      httpbuf;
     char        last_modified[64];
     char        etag[64];
     std::string content_type;
+    std::string content_encoding; // of encoded variant
+    size_t      charged; // bytes charged to cache capacity
+    // encoded variants
+    std::mutex  mutex;
+    int         sidecars;   // encodings of precompressed files, -1 unknown
+    int         incompressible; // encodings not smaller on the fly
+    std::shared_ptr<file_cache_s> encoded[HTTP_ENCODINGS_NUM];
 
     file_cache_s() {
         stat_cnt = 0;
-    }
-
-    bool is_modified() {
-        time_t mtime = st.st_mtime;
-        stat(filepath.c_str(), &st);
-        return mtime != st.st_mtime;
+        watched = false;
+        charged = 0;
+        sidecars = -1;
+        incompressible = 0;
     }
 
     bool is_complete() {
         if(S_ISDIR(st.st_mode)) return filebuf.len > 0;
-        return filebuf.len == st.st_size;
-    }
-
-    void resize_buf(int filesize) {
-        buf.resize(HTTP_HEADER_MAX_LENGTH + filesize);
-        filebuf.base = buf.base + HTTP_HEADER_MAX_LENGTH;
-        filebuf.len = filesize;
-    }
-
-    void prepend_header(const char* header, int len) {
-        if (len > HTTP_HEADER_MAX_LENGTH) return;
-        httpbuf.base = filebuf.base - len;
-        httpbuf.len = len + filebuf.len;
-        memcpy(httpbuf.base, header, len);
+        return filebuf.len == (size_t)st.st_size;
     }
 } file_cache_t;
 
 typedef std::shared_ptr<file_cache_t>           file_cache_ptr;
 
-class FileCache : public hv::LRUCache<std::string, file_cache_ptr> {
+class FileCache {
 public:
-    int             stat_interval;
-    int             expired_time;
+    int             stat_interval;  // s, for entries not watched by inotify
+    int             expired_time;   // s, since last access
+    size_t          capacity;       // bytes of all entries
 
-    FileCache(size_t capacity = FILE_CACHE_MAX_NUM);
+    FileCache(size_t capacity = FILE_CACHE_DEFAULT_CAPACITY);
+    ~FileCache();
 
     struct OpenParam {
         bool need_read;
@@ -81,12 +93,55 @@ public:
         }
     };
     file_cache_ptr Open(const char* filepath, OpenParam* param);
-    bool Exists(const char* filepath) const;
+    bool Exists(const char* filepath);
     bool Close(const char* filepath);
+    // @param encodings: accepted by client
+    // @param precompressed: serve filepath.br .zst .gz
+    // @param compress_min_length: compress on the fly if >= 0
+    // @return encoded variant of fc, NULL if fc is sent as is.
+    file_cache_ptr Encode(const file_cache_ptr& fc, int encodings, bool precompressed, int compress_min_length = -1);
     void RemoveExpiredFileCache();
+    void Clear();
+    size_t Size();
+    size_t Bytes();
+
+    // @return inotify fd to read by event loop, -1 if unsupported.
+    // NOTE: fd is owned by FileCache
+    int  OpenInotify();
+    // @param buf: inotify events read from OpenInotify fd
+    void OnInotifyEvents(const char* buf, int len);
 
 protected:
-    file_cache_ptr Get(const char* filepath);
+    // @param[out] need_stat: stat_interval elapsed
+    file_cache_ptr Get(const char* filepath, bool* need_stat = NULL);
+    void Put(const file_cache_ptr& fc);
+    void Charge(const file_cache_ptr& fc, size_t bytes);
+    file_cache_ptr openSidecar(const file_cache_ptr& fc, int encoding);
+    // @return true if watched by inotify
+    bool Watch(const char* filepath);
+
+private:
+    typedef std::list<file_cache_ptr>       lru_list_t;
+    struct Shard {
+        std::mutex                                              mutex;
+        lru_list_t                                              lru;  // front is most recently used
+        std::unordered_map<std::string, lru_list_t::iterator>   map;
+        size_t                                                  bytes;
+
+        Shard() : bytes(0) {}
+    };
+    Shard& shardOf(const std::string& filepath) {
+        return shards_[std::hash<std::string>()(filepath) % FILE_CACHE_SHARDS];
+    }
+    Shard           shards_[FILE_CACHE_SHARDS];
+
+    // inotify
+    int             inotify_fd_;
+    std::atomic<uint64_t> invalid_seq_; // increased by inotify events
+    std::mutex      watch_mutex_;
+    // wd => dirs, same dir may be spelled differently
+    std::unordered_map<int, std::vector<std::string>>  watch_dirs_;
+    std::unordered_map<std::string, int>               dir_wds_;
 };
 
 #endif // HV_FILE_CACHE_H_
@@ -12,6 +12,11 @@
 #include "wsdef.h"
 
 #include "http_page.h"
+#include "HttpCompressor.h"
+
+#ifdef WITH_NGHTTP2
+#include "Http2Parser.h"
+#endif
 
 #include "EventLoop.h" // import hv::setInterval
 using namespace hv;
@@ -24,6 +29,23 @@ using namespace hv;
 #define HTTP_200_CONNECT_RESPONSE       "HTTP/1.1 200 Connection established\r\n\r\n"
 #define HTTP_200_CONNECT_RESPONSE_LEN   39
 
+// NOTE: body larger than this is queued by hio_write_owned without copy
+#define HTTP_OWNED_BODY_MIN_SIZE        (1 << 16) // 64K
+
+// NOTE: stop pulling frames from nghttp2 when so much queued, continue on write complete.
+#define HTTP2_MAX_WRITE_BUFSIZE         (1 << 20) // 1M
+// NOTE: read more of large file into stream when less than this pending.
+#define HTTP2_STREAM_PUMP_SIZE          (1 << 16) // 64K
+
+// NOTE: requests failed before any response are resent to another upstream if not larger than this.
+#define PROXY_RESEND_MAX_SIZE           (1 << 16) // 64K
+
+// hfree_cb of hio_write_owned, release the response holding the body
+static void free_response(void* buf, void* userdata) {
+    (void)buf;
+    delete (std::shared_ptr<HttpResponsePtr>*)userdata;
+}
+
 HttpHandler::HttpHandler(hio_t* io) :
     protocol(HttpHandler::UNKNOWN),
     state(WANT_RECV),
@@ -36,6 +58,11 @@ HttpHandler::HttpHandler(hio_t* io) :
     proxy_connected(0),
     forward_proxy(0),
     reverse_proxy(0),
+    h2_recving(0),
+    h2_flushing(0),
+    h2_flush_again(0),
+    h2_pump_again(0),
+    h2_reap_posted(0),
     ip{'\0'},
     port(0),
     pid(0),
@@ -43,6 +70,7 @@ HttpHandler::HttpHandler(hio_t* io) :
     // for http
     io(io),
     service(NULL),
+    pool(NULL),
     api_handler(NULL),
     // for websocket
     ws_service(NULL),
@@ -51,14 +79,42 @@ HttpHandler::HttpHandler(hio_t* io) :
     // for sendfile
     files(NULL),
     file(NULL),
+    spill(NULL),
     // for proxy
-    proxy_port(0)
+    proxy_port(0),
+    proxy_group(NULL),
+    proxy_server(NULL),
+    upstreams(NULL),
+    upstream(NULL),
+    // for HTTP2 streams
+    parent(NULL),
+    stream_id(0)
 {
     // Init();
 }
 
 HttpHandler::~HttpHandler() {
+    for (auto& pair : streams) {
+        delete pair.second;
+    }
+    streams.clear();
+    reapHttp2Streams();
     Close();
+    if (upstream) {
+        if (upstream->io) {
+            releaseUpstreamServer(false);
+            detachUpstream(false);
+        }
+        delete upstream;
+        upstream = NULL;
+    }
+    if (pool) {
+        // NOTE: drop references to messages before put back to pool
+        ctx = NULL;
+        writer = NULL;
+        pool->Free(req);
+        pool->Free(resp);
+    }
 }
 
 bool HttpHandler::Init(int http_version) {
@@ -66,8 +122,8 @@ bool HttpHandler::Init(int http_version) {
     if (parser == NULL) {
         return false;
     }
-    req  = std::make_shared<HttpRequest>();
-    resp = std::make_shared<HttpResponse>();
+    req  = pool ? pool->NewRequest()  : std::make_shared<HttpRequest>();
+    resp = pool ? pool->NewResponse() : std::make_shared<HttpResponse>();
     if(http_version == 1) {
         protocol = HTTP_V1;
     } else if (http_version == 2) {
@@ -86,6 +142,14 @@ bool HttpHandler::Init(int http_version) {
         tid = hv_gettid();
     }
     parser->InitRequest(req.get());
+    hookHttpCb();
+    if (protocol == HTTP_V2) {
+        initHttp2();
+    }
+    return true;
+}
+
+void HttpHandler::hookHttpCb() {
     // NOTE: hook http_cb
     req->http_cb = [this](HttpMessage* msg, http_parser_state state, const char* data, size_t size) {
         if (this->state == WANT_CLOSE) return;
@@ -104,21 +168,42 @@ bool HttpHandler::Init(int http_version) {
         default:
             break;
         }
+        if (this->state == WANT_CLOSE && parent) {
+            // NOTE: HTTP_STATUS_CLOSE of a stream resets the stream only
+            resetHttp2Stream();
+        }
     };
-    return true;
 }
 
 void HttpHandler::Reset() {
     state = WANT_RECV;
     error = 0;
-    req->Reset();
-    resp->Reset();
-    ctx = NULL;
+    // NOTE: req is reset by parser->InitRequest
+    if (sending_resp.expired()) {
+        resp->Reset();
+    } else {
+        // NOTE: body still queued, take another response for the next request
+        sending_resp.reset();
+        resp = pool ? pool->NewResponse() : std::make_shared<HttpResponse>();
+        if (writer) writer->response = resp;
+    }
+    // reuse ctx if not held by handler
+    if (ctx && ctx.use_count() == 1) {
+        ctx->userdata = NULL;
+        ctx->response = resp;
+    } else {
+        ctx = NULL;
+    }
     api_handler = NULL;
     closeFile();
-    if (writer) {
+    closeSpill();
+    // NOTE: writer of HTTP2 connection is shared by all streams
+    if (writer && protocol != HTTP_V2) {
         writer->Begin();
-        writer->onwrite = NULL;
+        // NOTE: keep onwrite of response still proxied, see attachUpstream
+        if (upstream == NULL || upstream->io == NULL) {
+            writer->onwrite = NULL;
+        }
         writer->onclose = NULL;
     }
     parser->InitRequest(req.get());
@@ -141,6 +226,7 @@ void HttpHandler::Close() {
 
     // close file
     closeFile();
+    closeSpill();
 
     // onclose
     if (protocol == HttpHandler::WEBSOCKET) {
@@ -162,6 +248,7 @@ bool HttpHandler::SwitchHTTP2() {
     resp->http_major = req->http_major = 2;
     resp->http_minor = req->http_minor = 0;
     parser->InitRequest(req.get());
+    initHttp2();
     return true;
 }
 
@@ -252,6 +339,13 @@ int HttpHandler::invokeHttpHandler(const http_handler* handler) {
 void HttpHandler::onHeadersComplete() {
     // printf("onHeadersComplete\n");
     handleRequestHeaders();
+    // NOTE: pipelined request behind a proxied one is proxied to the same upstream only,
+    // others would be responded before it, see connectUpstream
+    if (upstream && upstream->io && !(reverse_proxy && !upgrade)) {
+        hlogw("[%s:%d] pipelined request behind proxy %s", ip, port, upstream->addr.c_str());
+        closeAfterUpstream();
+        return;
+    }
     if (service->headerHandler) {
         const int status_code = customHttpHandler(service->headerHandler);
         if (status_code == HTTP_STATUS_CLOSE) {
@@ -294,10 +388,22 @@ void HttpHandler::onHeadersComplete() {
     }
 
     if (proxy) {
+        if (parent) {
+            // NOTE: proxy is not supported for HTTP2 streams, answered with 502.
+            hlogw("[%s:%d] proxy over HTTP2 is not supported: %s", ip, port, req->path.c_str());
+            SetError(ERR_INVALID_PROTOCOL, HTTP_STATUS_BAD_GATEWAY);
+            return;
+        }
         handleProxy();
         return;
     }
 
+    if (service->body_spill_size > 0 && req->content_length > service->body_spill_size) {
+        if (openSpill() != 0) return;
+        // NOTE: release body reserved by parser for content_length
+        http_body().swap(req->body);
+    }
+
     // Expect: 100-continue
     handleExpect100();
 }
@@ -308,11 +414,37 @@ void HttpHandler::onBody(const char* data, size_t size) {
         return;
     }
 
+    if (proxy && reverse_proxy && !upgrade) {
+        if (upstream && upstream->io && upstream->sending) {
+            if (upstream->chunked) {
+                char chunk_size[16];
+                int len = snprintf(chunk_size, sizeof(chunk_size), "%x\r\n", (unsigned int)size);
+                writeUpstream(chunk_size, len);
+                writeUpstream(data, size);
+                writeUpstream("\r\n", 2);
+            } else {
+                writeUpstream(data, size);
+            }
+        }
+        return;
+    }
+
     if (proxy && proxy_connected) {
         if (io) hio_write_upstream(io, (void*)data, size);
         return;
     }
 
+    if (spill == NULL && service->body_spill_size > 0 &&
+        req->body.size() + size > service->body_spill_size) {
+        // Transfer-Encoding: chunked, Content-Length was checked by onHeadersComplete
+        if (openSpill() != 0 || writeSpill(req->body.data(), req->body.size()) != 0) return;
+        http_body().swap(req->body);
+    }
+    if (spill) {
+        writeSpill(data, size);
+        return;
+    }
+
     req->body.append(data, size);
     return;
 }
@@ -327,10 +459,23 @@ void HttpHandler::onMessageComplete() {
     }
 
     if (proxy) {
-        if (proxy_connected) Reset();
+        if (reverse_proxy && !upgrade) {
+            // NOTE: request sent, response is proxied by onUpstreamRead
+            if (upstream && upstream->io && upstream->sending && upstream->chunked) {
+                writeUpstream("0\r\n\r\n", 5);
+            }
+            if (upstream) upstream->sending = 0;
+            Reset();
+        }
+        else if (proxy_connected) {
+            Reset();
+        }
         return;
     }
 
+    // NOTE: spilled files are complete and owned by req
+    closeSpill();
+
     addResponseHeaders();
 
     // upgrade ? handleUpgrade : HandleHttpRequest
@@ -360,6 +505,8 @@ void HttpHandler::onMessageComplete() {
     }
 
     if (status_code != HTTP_STATUS_NEXT) {
+        // NOTE: stream handler is deleted on stream closed.
+        if (parent) return;
         // keepalive ? Reset : Close
         if (keepalive) {
             Reset();
@@ -427,6 +574,8 @@ void HttpHandler::handleRequestHeaders() {
 }
 
 void HttpHandler::handleExpect100() {
+    // NOTE: HTTP2 client does not wait for 100-continue
+    if (protocol != HTTP_V1) return;
     // Expect: 100-continue
     auto iter = req->headers.find("Expect");
     if (iter != req->headers.end() &&
@@ -507,6 +656,9 @@ postprocessor:
         pResp->headers["Content-Type"] = fc->content_type;
         pResp->headers["Last-Modified"] = fc->last_modified;
         pResp->headers["Etag"] = fc->etag;
+        if (!fc->content_encoding.empty()) {
+            pResp->headers["Content-Encoding"] = fc->content_encoding;
+        }
     }
     if (service->postprocessor) {
         int post_status_code = customHttpHandler(service->postprocessor);
@@ -515,6 +667,10 @@ postprocessor:
             return HTTP_STATUS_CLOSE;
         }
     }
+    if (service->enable_compression && fc == NULL && status_code != HTTP_STATUS_NEXT &&
+        !(writer && writer->state != hv::HttpResponseWriter::SEND_BEGIN)) {
+        compressResponse();
+    }
 
     if (writer && writer->state != hv::HttpResponseWriter::SEND_BEGIN) {
         status_code = HTTP_STATUS_NEXT;
@@ -637,6 +793,15 @@ int HttpHandler::defaultStaticHandler() {
         }
     }
     else {
+        // Content-Encoding
+        if ((service->enable_precompressed || service->enable_compression) && S_ISREG(fc->st.st_mode)) {
+            int encodings = http_accept_encodings(req->GetHeader("Accept-Encoding").c_str());
+            file_cache_ptr encoded = files->Encode(fc, encodings, service->enable_precompressed,
+                                                   service->enable_compression ? service->compression_min_length : -1);
+            if (encoded) fc = encoded;
+            resp->headers["Vary"] = "Accept-Encoding";
+        }
+
         // Not Modified
         auto iter = req->headers.find("if-none-match");
         if (iter != req->headers.end() &&
@@ -655,6 +820,40 @@ int HttpHandler::defaultStaticHandler() {
     return status_code;
 }
 
+int HttpHandler::compressResponse() {
+    if (req->method == HTTP_HEAD) return 0;
+    if (resp->status_code < HTTP_STATUS_OK ||
+        resp->status_code == HTTP_STATUS_NO_CONTENT ||
+        resp->status_code == HTTP_STATUS_PARTIAL_CONTENT ||
+        resp->status_code == HTTP_STATUS_NOT_MODIFIED) {
+        return 0;
+    }
+    // NOTE: no compress data not owned by body
+    if (resp->content && resp->content != resp->body.data()) return 0;
+    if (resp->headers.find("Content-Encoding") != resp->headers.end()) return 0;
+    resp->DumpBody();
+    if (resp->body.size() < (size_t)service->compression_min_length) return 0;
+    std::string content_type = resp->GetHeader("Content-Type");
+    if (content_type.empty()) content_type = http_content_type_str(resp->ContentType());
+    if (!http_content_compressible(content_type.c_str())) return 0;
+    resp->headers["Vary"] = "Accept-Encoding";
+    int encoding = http_accept_encodings(req->GetHeader("Accept-Encoding").c_str()) & hv::HttpCompressor::Supported();
+    if (encoding == 0) return 0;
+    // preferred
+    encoding &= -encoding;
+    std::string out;
+    if (hv::HttpCompressor::Compress(encoding, resp->body.data(), resp->body.size(), out) != 0 ||
+        out.size() >= resp->body.size()) {
+        return 0;
+    }
+    resp->body.swap(out);
+    resp->content = NULL;
+    resp->content_length = 0;
+    resp->headers.erase("Content-Length");
+    resp->headers["Content-Encoding"] = http_encoding_str(encoding);
+    return encoding;
+}
+
 int HttpHandler::defaultLargeFileHandler(const std::string &filepath) {
     if (!writer) return HTTP_STATUS_NOT_IMPLEMENTED;
     if (!isFileOpened()) {
@@ -668,13 +867,35 @@ int HttpHandler::defaultLargeFileHandler(const std::string &filepath) {
         // forbidden to send large file
         resp->content_length = 0;
         resp->status_code = HTTP_STATUS_FORBIDDEN;
+    } else if (service->limit_rate < 0 && protocol == HttpHandler::HTTP_V1) {
+        writer->EndHeaders();
+        // unlimited: queue the rest of file after headers, sent by sendfile
+        if (writer->SendFile(fileno(file->fp), ftell(file->fp), resp->content_length) == 0) {
+            closeFile();
+            writer->onwrite = [this](HBuf* buf) {
+                if (writer->isWriteComplete()) {
+                    writer->End();
+                }
+            };
+            return HTTP_STATUS_UNFINISHED;
+        }
+        // fallback: sendFile when writable
+        file->buf.resize(40960); // 40K
+        writer->onwrite = [this](HBuf* buf) {
+            if (writer->isWriteComplete()) {
+                sendFile();
+            }
+        };
+        sendFile();
+        return HTTP_STATUS_UNFINISHED;
     } else {
         size_t bufsize = 40960; // 40K
         file->buf.resize(bufsize);
         if (service->limit_rate < 0) {
             // unlimited: sendFile when writable
+            // NOTE: HTTP2 stream is pumped by connection, see pumpHttp2Streams
             writer->onwrite = [this](HBuf* buf) {
-                if (writer->isWriteComplete()) {
+                if (parent || writer->isWriteComplete()) {
                     sendFile();
                 }
             };
@@ -741,8 +962,20 @@ int HttpHandler::FeedRecvData(const char* data, size_t len) {
 
     int nfeed = 0;
     switch (protocol) {
-    case HttpHandler::HTTP_V1:
     case HttpHandler::HTTP_V2:
+        // NOTE: requests are handled by stream handlers, see onHttp2StreamOpen
+        h2_recving = 1;
+        nfeed = parser->FeedRecvData(data, len);
+        h2_recving = 0;
+        if (nfeed != len) {
+            hloge("[%s:%d] http2 parse error: %s", ip, port, parser->StrError(parser->GetError()));
+            error = ERR_PARSE;
+            return -1;
+        }
+        flushHttp2();
+        reapHttp2Streams();
+        break;
+    case HttpHandler::HTTP_V1:
         if (state != WANT_RECV) {
             Reset();
         }
@@ -768,7 +1001,10 @@ int HttpHandler::FeedRecvData(const char* data, size_t len) {
         return -1;
     }
 
-    if (state == WANT_CLOSE) return 0;
+    if (state == WANT_CLOSE) {
+        // NOTE: closed after proxied responses, see closeAfterUpstream
+        return upstream && upstream->io && upstream->client_close ? nfeed : 0;
+    }
     return error ? -1 : nfeed;
 }
 
@@ -791,7 +1027,6 @@ int HttpHandler::GetSendData(char** data, size_t* len) {
             state = SEND_HEADER;
         case SEND_HEADER:
         {
-            size_t content_length = 0;
             const char* content = NULL;
             // HEAD
             if (pReq->method == HTTP_HEAD) {
@@ -805,31 +1040,12 @@ int HttpHandler::GetSendData(char** data, size_t* len) {
                 state = SEND_DONE;
                 goto return_nobody;
             }
-            // File service
-            if (fc) {
-                // FileCache
-                // NOTE: no copy filebuf, more efficient
-                header = pResp->Dump(true, false);
-                fc->prepend_header(header.c_str(), header.size());
-                *data = fc->httpbuf.base;
-                *len = fc->httpbuf.len;
-                state = SEND_DONE;
-                return *len;
-            }
-            // API service
-            content_length = pResp->ContentLength();
+            // File service and API service
+            // NOTE: no copy of filebuf or body, header and content are sent by one writev
             content = (const char*)pResp->Content();
             if (content) {
-                if (content_length > (1 << 20)) {
-                    state = SEND_BODY;
-                    goto return_header;
-                } else {
-                    // NOTE: header+body in one package if <= 1M
-                    header = pResp->Dump(true, false);
-                    header.append(content, content_length);
-                    state = SEND_DONE;
-                    goto return_header;
-                }
+                state = SEND_BODY;
+                goto return_header;
             } else {
                 state = SEND_DONE;
                 goto return_header;
@@ -871,16 +1087,56 @@ return_header:
 }
 
 int HttpHandler::SendHttpResponse(bool submit) {
+    if (parent) {
+        if (req->method == HTTP_HEAD) {
+            if (fc) resp->headers["Content-Length"] = hv::to_string(fc->st.st_size);
+            resp->content = NULL;
+            resp->content_length = 0;
+            resp->body.clear();
+        }
+        state = SEND_DONE;
+        return parent->Http2StreamWrite(stream_id, resp.get(), NULL, 0, true);
+    }
     if (!io || !parser) return -1;
     char* data = NULL;
     size_t len = 0, total_len = 0;
+    struct iovec iov[2];
+    int iovcnt = 0;
     if (submit) parser->SubmitResponse(resp.get());
+    if (protocol == HTTP_V2) {
+        flushHttp2();
+        return 0;
+    }
     while (GetSendData(&data, &len)) {
         // printf("GetSendData %d\n", (int)len);
+        if (data && len && protocol == HTTP_V1 &&
+            data == resp->body.data() && len >= HTTP_OWNED_BODY_MIN_SIZE) {
+            // NOTE: no copy of big body even if queued under backpressure,
+            // the response is kept as it is until written, see Reset.
+            if (iovcnt) {
+                hio_writev(io, iov, iovcnt);
+                iovcnt = 0;
+            }
+            std::shared_ptr<HttpResponsePtr> holder = std::make_shared<HttpResponsePtr>(resp);
+            sending_resp = holder;
+            hio_write_owned(io, data, len, free_response, new std::shared_ptr<HttpResponsePtr>(std::move(holder)));
+            total_len += len;
+            continue;
+        }
         if (data && len) {
-            hio_write(io, data, len);
+            iov[iovcnt].iov_base = data;
+            iov[iovcnt].iov_len = len;
+            ++iovcnt;
             total_len += len;
         }
+        // NOTE: HTTP/1 header and body stay valid until SEND_DONE, gather them into one writev.
+        if (iovcnt == (int)ARRAY_SIZE(iov) || (iovcnt && (protocol != HTTP_V1 || state == SEND_DONE))) {
+            hio_writev(io, iov, iovcnt);
+            iovcnt = 0;
+        }
+    }
+    if (iovcnt) {
+        hio_writev(io, iov, iovcnt);
     }
     return total_len;
 }
@@ -894,6 +1150,211 @@ int HttpHandler::SendHttpStatusResponse(http_status status_code) {
     return SendHttpResponse();
 }
 
+//------------------HTTP2 streams--------------------------------------
+#ifdef WITH_NGHTTP2
+static int http2_stream_write(hio_t* io, uint32_t id, int stream_id, HttpResponse* resp,
+                              const char* data, int len, bool end) {
+    // NOTE: connection may be closed before posted write
+    if (!hio_is_opened(io) || hio_id(io) != id) return -1;
+    HttpHandler* handler = (HttpHandler*)hevent_userdata(io);
+    if (handler == NULL) return -1;
+    return handler->Http2StreamWrite(stream_id, resp, data, len, end);
+}
+#endif
+
+void HttpHandler::initHttp2() {
+#ifdef WITH_NGHTTP2
+    Http2Parser* h2 = (Http2Parser*)parser.get();
+    h2->onStreamOpen = [this](int32_t stream_id) {
+        return onHttp2StreamOpen(stream_id);
+    };
+    h2->onStreamClose = [this](int32_t stream_id, uint32_t error_code) {
+        onHttp2StreamClose(stream_id, error_code);
+    };
+    if (writer) {
+        // NOTE: pull more frames when write queue drained
+        writer->onwrite = [this](HBuf* buf) {
+            h2_pump_again = 1;
+            if (h2_flushing) return;
+            flushHttp2();
+            reapHttp2Streams();
+        };
+    }
+#endif
+}
+
+HttpRequest* HttpHandler::onHttp2StreamOpen(int sid) {
+#ifdef WITH_NGHTTP2
+    HttpHandler* stream = new HttpHandler(io);
+    stream->parent = this;
+    stream->stream_id = sid;
+    stream->protocol = HTTP_V2;
+    stream->ssl = ssl;
+    memcpy(stream->ip, ip, sizeof(ip));
+    stream->port = port;
+    stream->pid = pid;
+    stream->tid = tid;
+    stream->service = service;
+    stream->ws_service = ws_service;
+    stream->files = files;
+    stream->pool = pool;
+    stream->req  = pool ? pool->NewRequest()  : std::make_shared<HttpRequest>();
+    stream->resp = pool ? pool->NewResponse() : std::make_shared<HttpResponse>();
+    stream->resp->http_major = stream->req->http_major = 2;
+    stream->resp->http_minor = stream->req->http_minor = 0;
+    if (io) {
+        stream->writer = std::make_shared<HttpResponseWriter>(io, stream->resp);
+        stream->writer->status = hv::SocketChannel::CONNECTED;
+        // NOTE: Channel takes over io context, give it back to writer of connection.
+        hio_set_context(io, writer.get());
+        hio_t* io = this->io;
+        uint32_t id = hio_id(io);
+        EventLoop* loop = currentThreadEventLoop;
+        HttpResponsePtr resp = stream->resp;
+        stream->writer->stream_write = [loop, io, id, sid, resp](const char* buf, int len, bool end) {
+            if (loop && !loop->isInLoopThread()) {
+                // NOTE: async_handler writes on other thread, post to loop thread.
+                // copy buf once, the posted functor is copied by reference count.
+                std::shared_ptr<std::string> data;
+                if (buf && len > 0) data = std::make_shared<std::string>(buf, len);
+                loop->queueInLoop([io, id, sid, resp, data, end]() {
+                    http2_stream_write(io, id, sid, resp.get(),
+                                       data ? data->data() : NULL, data ? (int)data->size() : 0, end);
+                });
+                return len;
+            }
+            return http2_stream_write(io, id, sid, resp.get(), buf, len, end);
+        };
+    }
+    stream->hookHttpCb();
+    streams[sid] = stream;
+    return stream->req.get();
+#else
+    return NULL;
+#endif
+}
+
+void HttpHandler::onHttp2StreamClose(int sid, uint32_t error_code) {
+    auto iter = streams.find(sid);
+    if (iter == streams.end()) return;
+    HttpHandler* stream = iter->second;
+    streams.erase(iter);
+    if (stream->writer) {
+        stream->writer->status = hv::SocketChannel::DISCONNECTED;
+    }
+    // NOTE: stream handler may be in call stack, delete it later, see reapHttp2Streams
+    closed_streams.push_back(stream);
+}
+
+int HttpHandler::Http2StreamWrite(int sid, HttpResponse* resp, const char* data, int len, bool end) {
+#ifdef WITH_NGHTTP2
+    if (protocol != HTTP_V2 || !parser) return -1;
+    Http2Parser* h2 = (Http2Parser*)parser.get();
+    http2_stream* stream = h2->GetStream(sid);
+    if (stream == NULL) return -1;
+    if (len < 0) len = 0;
+    int ret = 0;
+    if (!stream->submited_headers) {
+        bool eof = end && len == 0;
+        ret = h2->SubmitResponse(sid, resp, eof);
+        if (ret == 0 && !eof) {
+            ret = h2->SendStreamData(sid, data, len, end);
+        }
+    } else {
+        ret = h2->SendStreamData(sid, data, len, end);
+    }
+    if (ret < 0) return ret;
+    flushHttp2();
+    postReapHttp2Streams();
+    return len;
+#else
+    return -1;
+#endif
+}
+
+void HttpHandler::resetHttp2Stream() {
+#ifdef WITH_NGHTTP2
+    if (parent == NULL || !parent->parser) return;
+    ((Http2Parser*)parent->parser.get())->ResetStream(stream_id);
+    parent->flushHttp2();
+    parent->postReapHttp2Streams();
+#endif
+}
+
+void HttpHandler::flushHttp2() {
+    // NOTE: nghttp2 session is not reentrant, flush after FeedRecvData
+    if (h2_recving || !io || !parser || protocol != HTTP_V2) return;
+    if (h2_flushing) {
+        h2_flush_again = 1;
+        return;
+    }
+    h2_flushing = 1;
+    char* data = NULL;
+    size_t len = 0;
+    do {
+        h2_flush_again = 0;
+        // gather small frames into one write
+        std::string* buf = NULL;
+        while (hio_write_bufsize(io) + (buf ? buf->size() : 0) < HTTP2_MAX_WRITE_BUFSIZE &&
+               parser->GetSendData(&data, &len) > 0) {
+            if (buf == NULL) buf = new std::string;
+            buf->append(data, len);
+            if (buf->size() >= HTTP_OWNED_BODY_MIN_SIZE) {
+                hio_write_owned(io, (void*)buf->data(), buf->size(), Channel::free_string, buf);
+                buf = NULL;
+            }
+        }
+        if (buf) {
+            hio_write(io, buf->data(), buf->size());
+            delete buf;
+        }
+        if (h2_pump_again) {
+            h2_pump_again = 0;
+            pumpHttp2Streams();
+        }
+    } while ((h2_flush_again || h2_pump_again) && hio_is_opened(io));
+    h2_flushing = 0;
+}
+
+void HttpHandler::pumpHttp2Streams() {
+#ifdef WITH_NGHTTP2
+    // NOTE: large file of stream is read by sendFile when its pending body is low
+    Http2Parser* h2 = (Http2Parser*)parser.get();
+    for (auto& pair : streams) {
+        HttpHandler* stream = pair.second;
+        if (stream->file == NULL || !stream->writer || !stream->writer->onwrite) continue;
+        http2_stream* s = h2->GetStream(pair.first);
+        if (s && s->pending_bytes() < HTTP2_STREAM_PUMP_SIZE) {
+            stream->writer->onwrite(NULL);
+        }
+    }
+#endif
+}
+
+void HttpHandler::postReapHttp2Streams() {
+    if (closed_streams.empty() || h2_reap_posted || !io) return;
+    EventLoop* loop = currentThreadEventLoop;
+    if (loop == NULL) return;
+    h2_reap_posted = 1;
+    hio_t* io = this->io;
+    uint32_t id = hio_id(io);
+    loop->queueInLoop([io, id]() {
+        if (!hio_is_opened(io) || hio_id(io) != id) return;
+        HttpHandler* handler = (HttpHandler*)hevent_userdata(io);
+        if (handler) handler->reapHttp2Streams();
+    });
+}
+
+void HttpHandler::reapHttp2Streams() {
+    h2_reap_posted = 0;
+    if (closed_streams.empty()) return;
+    std::vector<HttpHandler*> closed;
+    closed.swap(closed_streams);
+    for (auto stream : closed) {
+        delete stream;
+    }
+}
+
 //------------------sendfile--------------------------------------
 int HttpHandler::openFile(const char* filepath) {
     closeFile();
@@ -911,7 +1372,7 @@ bool HttpHandler::isFileOpened() {
 }
 
 int HttpHandler::sendFile() {
-    if (!writer || !writer->isWriteComplete() ||
+    if (!writer || (!parent && !writer->isWriteComplete()) ||
         !isFileOpened() ||
         file->buf.len == 0 ||
         resp->content_length == 0) {
@@ -923,13 +1384,15 @@ int HttpHandler::sendFile() {
     if (nread <= 0) {
         hloge("read file: %s error!", file->filepath);
         error = ERR_READ_FILE;
-        writer->close(true);
+        if (parent) resetHttp2Stream();
+        else writer->close(true);
         return nread;
     }
     int nwrite = writer->WriteBody(file->buf.base, nread);
     if (nwrite < 0) {
         // disconnectd
-        writer->close(true);
+        if (parent) resetHttp2Stream();
+        else writer->close(true);
         return nwrite;
     }
     resp->content_length -= nread;
@@ -951,6 +1414,100 @@ void HttpHandler::closeFile() {
     }
 }
 
+//------------------spill request body---------------------------
+static int open_spill_file(HFile& file, const std::string& dir) {
+    char filename[32] = "hv-upload-";
+    for (int i = 0; i < 3; ++i) {
+        hv_random_string(filename + 10, 16);
+        std::string filepath = HPath::join(dir, filename);
+        // NOTE: x: fail if exists
+        if (file.open(filepath.c_str(), "wbx") == 0) return 0;
+    }
+    return -1;
+}
+
+int HttpHandler::openSpill() {
+    closeSpill();
+    spill = new SpilledBody;
+#ifndef WITHOUT_HTTP_CONTENT
+    spill->multipart = NULL;
+    spill->formdata = NULL;
+    std::string boundary;
+    if (req->ContentType() == MULTIPART_FORM_DATA && !(boundary = req->Boundary()).empty()) {
+        // parts without filename are kept in req->form, files are spilled
+        spill->multipart = new hv::MultipartParser(boundary.c_str());
+        spill->multipart->onPartBegin = [this](const std::string& name, const std::string& filename) {
+            if (name.empty() || error) return;
+            hv::FormData& formdata = req->form[name];
+            if (!formdata.filepath.empty()) {
+                remove(formdata.filepath.c_str());
+            }
+            formdata = hv::FormData();
+            formdata.filename = filename;
+            if (!filename.empty()) {
+                if (open_spill_file(spill->file, service->upload_dir) != 0) {
+                    hloge("[%s:%d] open spill file in %s failed!", ip, port, service->upload_dir.c_str());
+                    SetError(ERR_OPEN_FILE, HTTP_STATUS_INTERNAL_SERVER_ERROR);
+                    return;
+                }
+                formdata.filepath = spill->file.filepath;
+            }
+            spill->formdata = &formdata;
+        };
+        spill->multipart->onPartData = [this](const char* data, size_t size) {
+            if (spill->formdata == NULL || error) return;
+            if (!spill->file.isopen()) {
+                spill->formdata->content.append(data, size);
+            } else if (spill->file.write(data, size) != size) {
+                hloge("[%s:%d] write %s failed!", ip, port, spill->file.filepath);
+                SetError(ERR_WRITE_FILE, HTTP_STATUS_INTERNAL_SERVER_ERROR);
+            }
+        };
+        spill->multipart->onPartEnd = [this]() {
+            spill->file.close();
+            spill->formdata = NULL;
+        };
+        return 0;
+    }
+#endif
+    if (open_spill_file(spill->file, service->upload_dir) != 0) {
+        hloge("[%s:%d] open spill file in %s failed!", ip, port, service->upload_dir.c_str());
+        return SetError(ERR_OPEN_FILE, HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    }
+    req->body_file = spill->file.filepath;
+    return 0;
+}
+
+int HttpHandler::writeSpill(const char* data, size_t size) {
+    if (spill == NULL || size == 0) return 0;
+#ifndef WITHOUT_HTTP_CONTENT
+    if (spill->multipart) {
+        if (spill->multipart->FeedRecvData(data, size) != size) {
+            hloge("[%s:%d] multipart parse error!", ip, port);
+            return SetError(ERR_REQUEST);
+        }
+        return error;
+    }
+#endif
+    if (spill->file.write(data, size) != size) {
+        hloge("[%s:%d] write %s failed!", ip, port, spill->file.filepath);
+        return SetError(ERR_WRITE_FILE, HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    }
+    return 0;
+}
+
+void HttpHandler::closeSpill() {
+    if (spill) {
+#ifndef WITHOUT_HTTP_CONTENT
+        if (spill->multipart) {
+            delete spill->multipart;
+        }
+#endif
+        delete spill;
+        spill = NULL;
+    }
+}
+
 //------------------upgrade--------------------------------------
 int HttpHandler::handleUpgrade(const char* upgrade_protocol) {
     hlogi("[%s:%d] Upgrade: %s", ip, port, upgrade_protocol);
@@ -1056,7 +1613,11 @@ int HttpHandler::handleForwardProxy() {
 }
 
 int HttpHandler::handleReverseProxy() {
-    return connectProxy(req->url);
+    // NOTE: upgrade is tunneled to upstream, others are proxied by upstreams
+    if (upgrade) {
+        return connectProxy(req->url);
+    }
+    return connectUpstream();
 }
 
 int HttpHandler::connectProxy(const std::string& strUrl) {
@@ -1090,11 +1651,26 @@ int HttpHandler::connectProxy(const std::string& strUrl) {
     proxy = 1;
     proxy_host = url.host;
     proxy_port = url.port;
-    hio_t* upstream_io = hio_create_socket(loop, proxy_host.c_str(), proxy_port, HIO_TYPE_TCP, HIO_CLIENT_SIDE);
+    std::string upstream_host = url.host;
+    int upstream_port = url.port;
+    bool https = url.scheme == "https";
+    proxy_group = reverse_proxy ? service->GetUpstream(url.host) : NULL;
+    if (proxy_group) {
+        proxy_server = proxy_group->Select(proxy_group->lb == LB_UrlHash ? req->path.c_str() : ip);
+        if (proxy_server == NULL) {
+            hlogw("[%s:%d] upstream %s has no server", ip, port, proxy_host.c_str());
+            return SetError(ERR_CONNECT, HTTP_STATUS_BAD_GATEWAY);
+        }
+        upstream_host = proxy_server->host;
+        upstream_port = proxy_server->port;
+        https = proxy_server->https;
+    }
+    hio_t* upstream_io = hio_create_socket(loop, upstream_host.c_str(), upstream_port, HIO_TYPE_TCP, HIO_CLIENT_SIDE);
     if (upstream_io == NULL) {
+        releaseUpstreamServer(true);
         return SetError(ERR_SOCKET, HTTP_STATUS_BAD_GATEWAY);
     }
-    if (url.scheme == "https") {
+    if (https) {
         hio_enable_ssl(upstream_io);
     }
     hevent_set_userdata(upstream_io, this);
@@ -1117,26 +1693,51 @@ int HttpHandler::connectProxy(const std::string& strUrl) {
 }
 
 int HttpHandler::closeProxy() {
+    if (upstream && upstream->io) {
+        releaseUpstreamServer(false);
+        detachUpstream(false);
+    }
     if (proxy && proxy_connected) {
         proxy_connected = 0;
+        releaseUpstreamServer(false);
         if (io) hio_close_upstream(io);
     }
     return 0;
 }
 
 int HttpHandler::sendProxyRequest() {
-    if (!io || !proxy_connected) return -1;
+    bool by_upstreams = reverse_proxy && !upgrade && upstream;
+    if (!io || (!by_upstreams && !proxy_connected)) return -1;
 
     req->headers.erase("Host");
     req->FillHost(proxy_host.c_str(), proxy_port);
     req->headers.erase("Proxy-Connection");
-    req->headers["Connection"] = keepalive ? "keep-alive" : "close";
+    if (by_upstreams) {
+        // NOTE: upstream connection is kept alive for others, client connection by response
+        req->headers["Connection"] = upstreams && upstreams->max_idle > 0 ? "keep-alive" : "close";
+    } else {
+        req->headers["Connection"] = keepalive ? "keep-alive" : "close";
+    }
     req->headers["X-Real-IP"] = ip;
     // NOTE: send head + received body
     std::string msg = req->Dump(true, false) + req->body;
     // printf("%s\n", msg.c_str());
+    http_method method = req->method;
+    bool chunked = req->IsChunked();
     req->Reset();
 
+    if (by_upstreams) {
+        ProxyUpstream::Pending pending;
+        pending.method = method;
+        pending.keepalive = keepalive;
+        upstream->pendings.push_back(pending);
+        upstream->sending = 1;
+        // NOTE: body is dechunked by parser
+        upstream->chunked = chunked;
+        writeUpstream(msg.data(), msg.size());
+        return msg.size();
+    }
+
     hio_write_upstream(io, (void*)msg.c_str(), msg.size());
     if (parser->IsComplete()) state = WANT_SEND;
     return msg.size();
@@ -1172,11 +1773,13 @@ void HttpHandler::onProxyClose(hio_t* upstream_io) {
     // printf("onProxyClose\n");
     HttpHandler* handler = (HttpHandler*)hevent_userdata(upstream_io);
     if (handler == NULL) return;
+    bool connected = handler->proxy_connected;
     handler->proxy_connected = 0;
 
     hevent_set_userdata(upstream_io, NULL);
 
     int error = hio_error(upstream_io);
+    handler->releaseUpstreamServer(error != 0 && (!connected || error == ETIMEDOUT));
     if (error == ETIMEDOUT) {
         handler->SendHttpStatusResponse(HTTP_STATUS_GATEWAY_TIMEOUT);
     }
@@ -1184,3 +1787,392 @@ void HttpHandler::onProxyClose(hio_t* upstream_io) {
     handler->error = error;
     hio_close_upstream(upstream_io);
 }
+
+void HttpHandler::releaseUpstreamServer(bool failed) {
+    if (proxy_group && proxy_server) {
+        proxy_group->Release(proxy_server, failed);
+    }
+    proxy_server = NULL;
+}
+
+//------------------reverse proxy by upstreams-------------------------
+/* @workflow:
+ * connectUpstream -> sendProxyRequest -> writeUpstream (sendbuf until connected) ->
+ * openUpstream -> proxy_group->Select -> upstreams->Get ? attachUpstream : hio_connect ->
+ * onUpstreamConnected -> flush sendbuf ->
+ * onUpstreamRead -> hio_write(io) + parse response -> onUpstreamResponse ->
+ * onUpstreamDone -> detachUpstream -> upstreams->Put
+ *
+ * NOTE: pipelined requests are sent to the same upstream, responses in order.
+ */
+static void init_upstream_response(HttpHandler::ProxyUpstream* up) {
+    up->req.method = up->pendings.front().method;
+    // NOTE: response of HEAD has no body
+    up->parser->SubmitRequest(&up->req);
+    up->parser->InitResponse(&up->resp);
+}
+
+int HttpHandler::connectUpstream() {
+    if (!io) return ERR_NULL_POINTER;
+
+    HUrl url;
+    url.parse(req->url);
+    hlogi("[%s:%d] proxy_pass %s", ip, port, req->url.c_str());
+
+    if (upstream == NULL) {
+        upstream = new ProxyUpstream;
+        upstream->parser.reset(HttpParser::New(HTTP_CLIENT, ::HTTP_V1));
+        upstream->resp.http_cb = [this](HttpMessage* msg, http_parser_state state, const char* data, size_t size) {
+            onUpstreamResponse(state);
+        };
+    }
+
+    if (upstream->io) {
+        if (url.host != proxy_host || url.port != proxy_port) {
+            hlogw("[%s:%d] pipelined request to another upstream %s", ip, port, url.host.c_str());
+            closeAfterUpstream();
+            return ERR_INVALID_PROTOCOL;
+        }
+        return sendProxyRequest();
+    }
+
+    proxy = 1;
+    proxy_host = url.host;
+    proxy_port = url.port;
+    proxy_group = service->GetUpstream(url.host);
+    ProxyUpstream* up = upstream;
+    up->https = url.scheme == "https";
+    up->hash_key = proxy_group && proxy_group->lb == LB_UrlHash ? req->path : ip;
+    up->tried.clear();
+    up->pendings.clear();
+    up->sendbuf.clear();
+    up->fresh = 0;
+    up->resend = 1;
+    up->recved = up->done = up->extra = 0;
+    up->upstream_close = up->client_close = 0;
+    // NOTE: kept in sendbuf until connected
+    sendProxyRequest();
+    return openUpstream();
+}
+
+int HttpHandler::openUpstream() {
+    ProxyUpstream* up = upstream;
+    std::string host = proxy_host;
+    int upstream_port = proxy_port;
+    bool https = up->https;
+    if (proxy_group) {
+        proxy_server = proxy_group->Select(up->hash_key.c_str(), &up->tried);
+        if (proxy_server == NULL) {
+            hlogw("[%s:%d] upstream %s has no server", ip, port, proxy_host.c_str());
+            up->resend = 0;
+            onUpstreamFailed(ERR_CONNECT, false);
+            return ERR_CONNECT;
+        }
+        host = proxy_server->host;
+        upstream_port = proxy_server->port;
+        https = proxy_server->https;
+        up->addr = proxy_server->addr;
+    } else {
+        up->addr = https ? "https://" : "http://";
+        up->addr += host + ":" + std::to_string(upstream_port);
+    }
+
+    hio_t* upstream_io = upstreams && !up->fresh ? upstreams->Get(up->addr) : NULL;
+    if (upstream_io) {
+        up->reused = 1;
+        attachUpstream(upstream_io);
+        onUpstreamConnected();
+        return 0;
+    }
+
+    up->reused = 0;
+    upstream_io = hio_create_socket(hevent_loop(io), host.c_str(), upstream_port, HIO_TYPE_TCP, HIO_CLIENT_SIDE);
+    if (upstream_io == NULL) {
+        onUpstreamFailed(ERR_SOCKET, false);
+        return ERR_SOCKET;
+    }
+    if (https) {
+        hio_enable_ssl(upstream_io);
+    }
+    attachUpstream(upstream_io);
+    hio_setcb_connect(upstream_io, HttpHandler::onUpstreamConnect);
+    if (service->proxy_connect_timeout > 0) {
+        hio_set_connect_timeout(upstream_io, service->proxy_connect_timeout);
+    }
+    // NOTE: stop recv request until connected
+    if (!up->client_paused) {
+        hio_read_stop(io);
+        up->client_paused = 1;
+    }
+    hio_connect(upstream_io);
+    return 0;
+}
+
+void HttpHandler::attachUpstream(hio_t* upstream_io) {
+    ProxyUpstream* up = upstream;
+    up->io = upstream_io;
+    up->connected = 0;
+    up->upstream_paused = 0;
+    hevent_set_userdata(upstream_io, this);
+    hio_setcb_read(upstream_io, HttpHandler::onUpstreamRead);
+    hio_setcb_write(upstream_io, HttpHandler::onUpstreamWrite);
+    hio_setcb_close(upstream_io, HttpHandler::onUpstreamClose);
+    if (writer) {
+        // NOTE: continue recv response when client writable
+        writer->onwrite = [this](HBuf* buf) {
+            ProxyUpstream* up = upstream;
+            if (up && up->io && up->upstream_paused && hio_write_is_complete(io)) {
+                up->upstream_paused = 0;
+                hio_read(up->io);
+            }
+        };
+    }
+}
+
+void HttpHandler::detachUpstream(bool keepalive) {
+    ProxyUpstream* up = upstream;
+    hio_t* upstream_io = up->io;
+    if (upstream_io == NULL) return;
+    up->io = NULL;
+    up->connected = 0;
+    up->upstream_paused = 0;
+    if (writer) writer->onwrite = NULL;
+    hevent_set_userdata(upstream_io, NULL);
+    hio_setcb_read(upstream_io, NULL);
+    hio_setcb_write(upstream_io, NULL);
+    hio_setcb_close(upstream_io, NULL);
+    if (!keepalive || upstreams == NULL || !upstreams->Put(up->addr, upstream_io)) {
+        hio_close(upstream_io);
+    }
+    if (up->client_paused) {
+        up->client_paused = 0;
+        if (hio_is_opened(io)) hio_read(io);
+    }
+}
+
+void HttpHandler::onUpstreamConnected() {
+    ProxyUpstream* up = upstream;
+    hio_t* upstream_io = up->io;
+    up->connected = 1;
+    if (service->proxy_read_timeout > 0) {
+        hio_set_read_timeout(upstream_io, service->proxy_read_timeout);
+    }
+    if (service->proxy_write_timeout > 0) {
+        hio_set_write_timeout(upstream_io, service->proxy_write_timeout);
+    }
+    init_upstream_response(up);
+    hio_read_start(upstream_io);
+    if (!up->sendbuf.empty()) {
+        hio_write(upstream_io, up->sendbuf.data(), up->sendbuf.size());
+        if (!up->resend) std::string().swap(up->sendbuf);
+    }
+    if (up->client_paused && hio_write_is_complete(upstream_io)) {
+        up->client_paused = 0;
+        hio_read(io);
+    }
+}
+
+int HttpHandler::writeUpstream(const char* data, size_t size) {
+    ProxyUpstream* up = upstream;
+    if (!up->connected) {
+        up->sendbuf.append(data, size);
+        if (up->sendbuf.size() > PROXY_RESEND_MAX_SIZE) up->resend = 0;
+        return 0;
+    }
+    if (up->resend) {
+        if (up->sendbuf.size() + size <= PROXY_RESEND_MAX_SIZE) {
+            up->sendbuf.append(data, size);
+        } else {
+            up->resend = 0;
+            std::string().swap(up->sendbuf);
+        }
+    }
+    int nwrite = hio_write(up->io, data, size);
+    if (nwrite >= 0 && !up->client_paused && !hio_write_is_complete(up->io)) {
+        // NOTE: stop recv request until upstream writable, see onUpstreamWrite
+        hio_read_stop(io);
+        up->client_paused = 1;
+    }
+    return nwrite;
+}
+
+void HttpHandler::onUpstreamResponse(http_parser_state state) {
+    ProxyUpstream* up = upstream;
+    if (state == HP_MESSAGE_BEGIN) {
+        if (up->done) up->extra = 1;
+        return;
+    }
+    if (state != HP_MESSAGE_COMPLETE || up->done || up->pendings.empty()) return;
+    // 1xx informational, the final response follows
+    if (up->resp.status_code < HTTP_STATUS_OK) {
+        init_upstream_response(up);
+        return;
+    }
+    bool keepalive = up->resp.IsKeepAlive();
+    if (!keepalive) up->upstream_close = 1;
+    if (!keepalive || !up->pendings.front().keepalive) up->client_close = 1;
+    up->pendings.pop_front();
+    up->recved = 0;
+    if (up->pendings.empty()) {
+        up->done = 1;
+    } else {
+        init_upstream_response(up);
+    }
+}
+
+void HttpHandler::onUpstreamDone() {
+    ProxyUpstream* up = upstream;
+    // NOTE: responded before request sent, close both
+    bool sending = up->sending;
+    up->sending = 0;
+    releaseUpstreamServer(false);
+    detachUpstream(!up->upstream_close && !up->extra && !sending);
+    if (up->client_close || sending) {
+        hio_close(io);
+    }
+}
+
+void HttpHandler::onUpstreamFailed(int error, bool sent) {
+    ProxyUpstream* up = upstream;
+    // NOTE: keepalive connection may be closed by upstream when reused
+    bool stale = up->reused && sent && error != ETIMEDOUT;
+    if (proxy_server && !stale) up->tried.push_back(proxy_server);
+    releaseUpstreamServer(!stale);
+
+    bool retry = up->resend && !up->pendings.empty();
+    if (retry && sent) {
+        // NOTE: like nginx, POST, PATCH sent are not resent
+        for (const auto& pending : up->pendings) {
+            if (pending.method == HTTP_POST || pending.method == HTTP_PATCH) {
+                retry = false;
+                break;
+            }
+        }
+        if (!stale) retry = false;
+    }
+    if (retry && !stale) {
+        retry = proxy_group && up->tried.size() < proxy_group->Size();
+    }
+    if (retry) {
+        hlogi("[%s:%d] retry upstream %s", ip, port, proxy_host.c_str());
+        if (stale) up->fresh = 1;
+        openUpstream();
+        return;
+    }
+
+    hlogw("[%s:%d] upstream %s failed: %d", ip, port, up->addr.c_str(), error);
+    size_t npendings = up->pendings.size();
+    up->pendings.clear();
+    up->resend = 0;
+    std::string().swap(up->sendbuf);
+    if (up->client_paused) {
+        up->client_paused = 0;
+        hio_read(io);
+    }
+    if (npendings > 1 || state == WANT_CLOSE) {
+        // NOTE: responses of pipelined requests lost
+        hio_close(io);
+        return;
+    }
+    http_status status_code = error == ETIMEDOUT ? HTTP_STATUS_GATEWAY_TIMEOUT : HTTP_STATUS_BAD_GATEWAY;
+    if (up->sending) {
+        up->sending = 0;
+        // NOTE: responded by onMessageComplete
+        SetError(error ? error : ERR_CONNECT, status_code);
+    } else {
+        SendHttpStatusResponse(status_code);
+    }
+}
+
+void HttpHandler::closeAfterUpstream() {
+    // NOTE: stop recv requests, closed by onUpstreamDone
+    upstream->client_close = 1;
+    upstream->client_paused = 0;
+    hio_read_stop(io);
+    state = WANT_CLOSE;
+}
+
+void HttpHandler::onUpstreamConnect(hio_t* upstream_io) {
+    HttpHandler* handler = (HttpHandler*)hevent_userdata(upstream_io);
+    if (handler == NULL || handler->upstream == NULL || handler->upstream->io != upstream_io) {
+        hio_close(upstream_io);
+        return;
+    }
+    handler->onUpstreamConnected();
+}
+
+void HttpHandler::onUpstreamRead(hio_t* upstream_io, void* buf, int readbytes) {
+    HttpHandler* handler = (HttpHandler*)hevent_userdata(upstream_io);
+    if (handler == NULL || handler->upstream == NULL || handler->upstream->io != upstream_io) {
+        hio_close(upstream_io);
+        return;
+    }
+    ProxyUpstream* up = handler->upstream;
+    if (up->pendings.empty()) {
+        // NOTE: response without request
+        handler->releaseUpstreamServer(false);
+        handler->detachUpstream(false);
+        return;
+    }
+    if (!up->recved) {
+        up->recved = 1;
+        if (up->resend) {
+            up->resend = 0;
+            up->sendbuf.clear();
+        }
+    }
+
+    hio_t* io = handler->io;
+    hio_write(io, buf, readbytes);
+    if (!up->upstream_paused && !hio_write_is_complete(io)) {
+        // NOTE: stop recv response until client writable, see attachUpstream
+        hio_read_stop(upstream_io);
+        up->upstream_paused = 1;
+    }
+
+    int nparse = up->parser->FeedRecvData((const char*)buf, readbytes);
+    if (nparse != readbytes) {
+        hloge("[%s:%d] upstream %s response parse error: %s", handler->ip, handler->port,
+            up->addr.c_str(), up->parser->StrError(up->parser->GetError()));
+        handler->releaseUpstreamServer(true);
+        handler->detachUpstream(false);
+        hio_close(io);
+        return;
+    }
+    if (up->done) {
+        handler->onUpstreamDone();
+    }
+}
+
+void HttpHandler::onUpstreamWrite(hio_t* upstream_io, const void* buf, int writebytes) {
+    HttpHandler* handler = (HttpHandler*)hevent_userdata(upstream_io);
+    if (handler == NULL || handler->upstream == NULL || handler->upstream->io != upstream_io) return;
+    ProxyUpstream* up = handler->upstream;
+    if (up->client_paused && up->connected && hio_write_is_complete(upstream_io)) {
+        up->client_paused = 0;
+        hio_read(handler->io);
+    }
+}
+
+void HttpHandler::onUpstreamClose(hio_t* upstream_io) {
+    HttpHandler* handler = (HttpHandler*)hevent_userdata(upstream_io);
+    if (handler == NULL || handler->upstream == NULL || handler->upstream->io != upstream_io) return;
+    hevent_set_userdata(upstream_io, NULL);
+    ProxyUpstream* up = handler->upstream;
+    int error = hio_error(upstream_io);
+    bool connected = up->connected;
+    up->io = NULL;
+    up->connected = 0;
+    up->upstream_paused = 0;
+    if (handler->writer) handler->writer->onwrite = NULL;
+
+    if (up->recved) {
+        // NOTE: response until closed, or truncated, client knows it by close too
+        bool complete = up->parser->IsEof();
+        handler->releaseUpstreamServer(!complete);
+        up->pendings.clear();
+        hio_close(handler->io);
+        return;
+    }
+    handler->onUpstreamFailed(error, connected);
+}
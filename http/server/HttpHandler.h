@@ -4,10 +4,15 @@
 #include "HttpService.h"
 #include "HttpParser.h"
 #include "FileCache.h"
+#include "HttpMessagePool.h"
 
 #include "WebSocketServer.h"
 #include "WebSocketParser.h"
 
+#include <deque>
+#include <map>
+#include <vector>
+
 class HttpHandler {
 public:
     enum ProtocolType {
@@ -40,6 +45,11 @@ public:
     unsigned proxy_connected    :1;
     unsigned forward_proxy      :1;
     unsigned reverse_proxy      :1;
+    unsigned h2_recving         :1;
+    unsigned h2_flushing        :1;
+    unsigned h2_flush_again     :1;
+    unsigned h2_pump_again      :1;
+    unsigned h2_reap_posted     :1;
 
     // peeraddr
     char                    ip[64];
@@ -52,6 +62,7 @@ public:
     // for http
     hio_t                   *io;
     HttpService             *service;
+    HttpMessagePool         *pool;  // of loop, NULL to allocate
     HttpRequestPtr          req;
     HttpResponsePtr         resp;
     HttpResponseWriterPtr   writer;
@@ -62,6 +73,8 @@ public:
     // for GetSendData
     std::string             header;
     // std::string          body;
+    // the response whose body is queued by hio_write_owned, see SendHttpResponse
+    std::weak_ptr<HttpResponsePtr> sending_resp;
 
     // for websocket
     WebSocketService*       ws_service;
@@ -77,10 +90,63 @@ public:
         HBuf        buf;
         uint64_t    timer;
     }                       *file;  // for large file
+    // for large request body, see HttpService::body_spill_size
+    struct SpilledBody {
+        HFile                   file;       // body_file or filepath of current part
+#ifndef WITHOUT_HTTP_CONTENT
+        hv::MultipartParser*    multipart;  // MULTIPART_FORM_DATA
+        hv::FormData*           formdata;   // current part
+#endif
+    }                       *spill;
 
     // for proxy
-    std::string             proxy_host;
+    std::string             proxy_host;     // of url, name of upstream group
     int                     proxy_port;
+    hv::HttpUpstreamGroup   *proxy_group;   // see HttpService::upstreams
+    hv::HttpUpstreamServer  *proxy_server;  // selected of proxy_group
+    hv::HttpUpstreamPool    *upstreams;     // of loop, NULL to close upstream after response
+    // for reverse proxy of HTTP/1.x requests, see connectUpstream
+    struct ProxyUpstream {
+        struct Pending {
+            http_method method;
+            bool        keepalive;          // of client
+        };
+        hio_t*                  io;
+        std::string             addr;       // key of upstreams
+        std::string             hash_key;   // of proxy_group
+        std::vector<hv::HttpUpstreamServer*> tried;
+        HttpParserPtr           parser;     // of responses
+        HttpRequest             req;        // method for parser->SubmitRequest
+        HttpResponse            resp;
+        std::deque<Pending>     pendings;   // requests sent, waiting for responses
+        std::string             sendbuf;    // sent before connected, or kept to resend
+        unsigned https          :1;
+        unsigned connected      :1;
+        unsigned reused         :1; // got from upstreams
+        unsigned fresh          :1; // do not get from upstreams
+        unsigned sending        :1; // body of last request
+        unsigned chunked        :1; // body of last request is chunked again
+        unsigned resend         :1; // sendbuf has all of pendings
+        unsigned recved         :1; // response of pendings.front()
+        unsigned done           :1; // all of pendings responded
+        unsigned extra          :1; // data after responses
+        unsigned upstream_close :1; // not keepalive
+        unsigned client_close   :1; // not keepalive
+        unsigned upstream_paused:1; // read of upstream stopped until client writable
+        unsigned client_paused  :1; // read of client stopped until upstream writable
+
+        ProxyUpstream() : io(NULL), https(0), connected(0), reused(0), fresh(0), sending(0),
+            chunked(0), resend(0), recved(0), done(0), extra(0), upstream_close(0), client_close(0),
+            upstream_paused(0), client_paused(0) {}
+    }                       *upstream;
+
+    // for HTTP2 streams
+    // connection handler owns a stream handler per stream,
+    // stream handler has its own req/resp/writer and no parser.
+    HttpHandler*                    parent;
+    int                             stream_id;
+    std::map<int, HttpHandler*>     streams;
+    std::vector<HttpHandler*>       closed_streams;
 
     HttpHandler(hio_t* io = NULL);
     ~HttpHandler();
@@ -91,7 +157,7 @@ public:
 
     /* @workflow:
      * HttpServer::on_recv -> HttpHandler::FeedRecvData -> Init -> HttpParser::InitRequest -> HttpRequest::http_cb ->
-     * onHeadersComplete -> proxy ? handleProxy -> connectProxy :
+     * onHeadersComplete -> proxy ? handleProxy -> connectProxy / connectUpstream :
      * onMessageComplete -> upgrade ? handleUpgrade : HandleHttpRequest -> HttpParser::SubmitResponse ->
      * SendHttpResponse -> while(GetSendData) hio_write ->
      * keepalive ? Reset : Close -> hio_close
@@ -119,6 +185,15 @@ public:
 
     // HTTP2
     bool SwitchHTTP2();
+    /* @workflow:
+     * FeedRecvData -> Http2Parser::onStreamOpen -> new stream handler -> HttpRequest::http_cb ->
+     * onMessageComplete -> HandleHttpRequest -> SendHttpResponse / HttpResponseWriter::stream_write ->
+     * Http2StreamWrite -> Http2Parser::SubmitResponse,SendStreamData -> flushHttp2 ->
+     * Http2Parser::onStreamClose -> delete stream handler
+     *
+     * NOTE: run in loop thread
+     */
+    int Http2StreamWrite(int stream_id, HttpResponse* resp, const char* data, int len, bool end);
 
     // websocket
     bool SwitchWebSocket();
@@ -159,6 +234,8 @@ private:
     int defaultLargeFileHandler(const std::string &filepath);
     int defaultErrorHandler();
     int customHttpHandler(const http_handler& handler);
+    // Content-Encoding: gzip if enable_compression
+    int compressResponse();
     int invokeHttpHandler(const http_handler* handler);
 
     // sendfile
@@ -167,11 +244,27 @@ private:
     void closeFile();
     bool isFileOpened();
 
+    // spill request body
+    int  openSpill();
+    int  writeSpill(const char* data, size_t size);
+    void closeSpill();
+
     // upgrade
     int handleUpgrade(const char* upgrade_protocol);
     int upgradeWebSocket();
     int upgradeHTTP2();
 
+    // HTTP2 streams
+    void initHttp2();
+    void hookHttpCb();
+    HttpRequest* onHttp2StreamOpen(int stream_id);
+    void onHttp2StreamClose(int stream_id, uint32_t error_code);
+    void flushHttp2();
+    void pumpHttp2Streams();
+    void resetHttp2Stream();
+    void postReapHttp2Streams();
+    void reapHttp2Streams();
+
     // proxy
     int handleProxy();
     int handleForwardProxy();
@@ -179,8 +272,24 @@ private:
     int connectProxy(const std::string& url);
     int closeProxy();
     int sendProxyRequest();
+    void releaseUpstreamServer(bool failed);
     static void onProxyConnect(hio_t* upstream_io);
     static void onProxyClose(hio_t* upstream_io);
+    // reverse proxy by upstreams
+    int  connectUpstream();
+    int  openUpstream();
+    void attachUpstream(hio_t* upstream_io);
+    void detachUpstream(bool keepalive);
+    void onUpstreamConnected();
+    int  writeUpstream(const char* data, size_t size);
+    void onUpstreamResponse(http_parser_state state);
+    void onUpstreamDone();
+    void onUpstreamFailed(int error, bool sent);
+    void closeAfterUpstream();
+    static void onUpstreamConnect(hio_t* upstream_io);
+    static void onUpstreamRead(hio_t* upstream_io, void* buf, int readbytes);
+    static void onUpstreamWrite(hio_t* upstream_io, const void* buf, int writebytes);
+    static void onUpstreamClose(hio_t* upstream_io);
 };
 
 #endif // HV_HTTP_HANDLER_H_
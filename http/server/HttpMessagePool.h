@@ -0,0 +1,63 @@
+#ifndef HV_HTTP_MESSAGE_POOL_H_
+#define HV_HTTP_MESSAGE_POOL_H_
+
+/*
+ * HttpMessagePool: free lists of HttpRequest/HttpResponse per event loop,
+ * new connections and HTTP/2 streams reuse messages of closed ones,
+ * with capacity of strings and containers retained by Reset.
+ *
+ * A message is put back only if the owner holds the last reference,
+ * messages still referenced by async handlers are released as usual.
+ *
+ * NOTE: not thread-safe, used in loop thread only.
+ */
+
+#include <memory>
+#include <vector>
+
+#include "HttpMessage.h"
+
+#define HTTP_MESSAGE_POOL_MAX_NUM   1024
+
+class HttpMessagePool {
+public:
+    size_t  max_num; // of each kind
+
+    HttpMessagePool(size_t max_num = HTTP_MESSAGE_POOL_MAX_NUM) : max_num(max_num) {}
+
+    HttpRequestPtr  NewRequest()    { return get(requests_); }
+    HttpResponsePtr NewResponse()   { return get(responses_); }
+
+    // NOTE: msg is always set NULL
+    void Free(HttpRequestPtr& req)      { put(requests_, req); }
+    void Free(HttpResponsePtr& resp)    { put(responses_, resp); }
+
+    size_t IdleNum() { return requests_.size() + responses_.size(); }
+
+private:
+    template<class T>
+    std::shared_ptr<T> get(std::vector<std::shared_ptr<T>>& free_list) {
+        if (free_list.empty()) {
+            return std::make_shared<T>();
+        }
+        std::shared_ptr<T> msg = std::move(free_list.back());
+        free_list.pop_back();
+        return msg;
+    }
+
+    template<class T>
+    void put(std::vector<std::shared_ptr<T>>& free_list, std::shared_ptr<T>& msg) {
+        if (msg && msg.use_count() == 1 && free_list.size() < max_num) {
+            msg->Reset();
+            // NOTE: http_cb captures the handler freed
+            msg->http_cb = NULL;
+            free_list.push_back(std::move(msg));
+        }
+        msg = NULL;
+    }
+
+    std::vector<HttpRequestPtr>     requests_;
+    std::vector<HttpResponsePtr>    responses_;
+};
+
+#endif // HV_HTTP_MESSAGE_POOL_H_
@@ -1,12 +1,38 @@
 #include "HttpResponseWriter.h"
 
+#include "HttpCompressor.h"
+
 namespace hv {
 
+int HttpResponseWriter::EnableCompression(const char* accept_encoding, int level /* = -1 */) {
+    // NOTE: body written before is not compressed
+    if (state != SEND_BEGIN || compressor || response->body.size() != 0) return -1;
+    int encodings = http_accept_encodings(accept_encoding) & HttpCompressor::Supported();
+    if (encodings == 0) return -1;
+    // preferred
+    int encoding = encodings & -encodings;
+    std::shared_ptr<HttpCompressor> c = std::make_shared<HttpCompressor>();
+    if (c->Init(encoding, level) != 0) return -1;
+    compressor = c;
+    response->headers.erase("Content-Length");
+    response->content_length = 0;
+    response->SetHeader("Content-Encoding", http_encoding_str(encoding));
+    response->SetHeader("Vary", "Accept-Encoding");
+    if (!stream_write) {
+        response->SetHeader("Transfer-Encoding", "chunked");
+    }
+    return 0;
+}
+
 int HttpResponseWriter::EndHeaders(const char* key /* = NULL */, const char* value /* = NULL */) {
     if (state != SEND_BEGIN) return -1;
     if (key && value) {
         response->SetHeader(key, value);
     }
+    if (stream_write) {
+        state = SEND_HEADER;
+        return stream_write(NULL, 0, false);
+    }
     std::string headers = response->Dump(true, false);
     // erase Content-Length: 0\r\n
     std::string content_length_0("Content-Length: 0\r\n");
@@ -15,30 +41,72 @@ int HttpResponseWriter::EndHeaders(const char* key /* = NULL */, const char* val
         headers.erase(pos, content_length_0.size());
     }
     state = SEND_HEADER;
-    return write(headers);
+    return write(std::move(headers));
 }
 
 int HttpResponseWriter::WriteChunked(const char* buf, int len /* = -1 */) {
-    int ret = 0;
     if (len == -1) len = strlen(buf);
+    if (compressor == NULL) {
+        return writeChunked(buf, len);
+    }
+    std::string out;
+    if (buf && len) {
+        // NOTE: sync flush, every write is decodable by peer at once
+        if (compressor->Compress(buf, len, out, true) != 0) return -1;
+        int ret = out.empty() ? 0 : writeChunked(out.data(), out.size());
+        return ret < 0 ? ret : len;
+    }
+    compressor->Finish(out);
+    if (out.size()) {
+        writeChunked(out.data(), out.size());
+    }
+    return writeChunked(NULL, 0);
+}
+
+int HttpResponseWriter::writeChunked(const char* buf, int len) {
+    int ret = 0;
+    if (stream_write) {
+        // HTTP/2 DATA frames, no chunked framing
+        if (state == SEND_BEGIN) {
+            EndHeaders();
+        }
+        if (buf && len) {
+            state = SEND_CHUNKED;
+            ret = stream_write(buf, len, false);
+            return ret < 0 ? ret : len;
+        }
+        state = SEND_CHUNKED_END;
+        return stream_write(NULL, 0, true);
+    }
     if (state == SEND_BEGIN) {
         EndHeaders("Transfer-Encoding", "chunked");
     }
     char chunked_header[64];
     int chunked_header_len = snprintf(chunked_header, sizeof(chunked_header), "%x\r\n", len);
-    write(chunked_header, chunked_header_len);
+    // NOTE: chunk-size + chunk-data + CRLF in one writev
+    struct iovec iov[3];
+    int iovcnt = 0;
+    iov[iovcnt].iov_base = chunked_header;
+    iov[iovcnt].iov_len = chunked_header_len;
+    ++iovcnt;
     if (buf && len) {
         state = SEND_CHUNKED;
-        ret = write(buf, len);
+        iov[iovcnt].iov_base = (void*)buf;
+        iov[iovcnt].iov_len = len;
+        ++iovcnt;
+        ret = len;
     } else {
         state = SEND_CHUNKED_END;
     }
-    write("\r\n", 2);
-    return ret;
+    iov[iovcnt].iov_base = (void*)"\r\n";
+    iov[iovcnt].iov_len = 2;
+    ++iovcnt;
+    int nwrite = writev(iov, iovcnt);
+    return nwrite < 0 ? nwrite : ret;
 }
 
 int HttpResponseWriter::WriteBody(const char* buf, int len /* = -1 */) {
-    if (response->IsChunked()) {
+    if (response->IsChunked() || compressor) {
         return WriteChunked(buf, len);
     }
 
@@ -48,8 +116,19 @@ int HttpResponseWriter::WriteBody(const char* buf, int len /* = -1 */) {
         return len;
     } else {
         state = SEND_BODY;
-        return write(buf, len);
+        return stream_write ? stream_write(buf, len, false) : write(buf, len);
+    }
+}
+
+int HttpResponseWriter::SendFile(int fd, size_t offset, size_t length) {
+    // NOTE: file is sent as is, no chunked framing.
+    if (response->IsChunked() || stream_write) return -1;
+    if (state == SEND_BEGIN) {
+        EndHeaders();
     }
+    if (sendfile(fd, offset, length) != 0) return -1;
+    state = SEND_BODY;
+    return 0;
 }
 
 int HttpResponseWriter::WriteResponse(HttpResponse* resp) {
@@ -57,10 +136,20 @@ int HttpResponseWriter::WriteResponse(HttpResponse* resp) {
         response->status_code = HTTP_STATUS_INTERNAL_SERVER_ERROR;
         return 0;
     }
+    if (stream_write) {
+        if (state == SEND_BEGIN) {
+            response->status_code = resp->status_code;
+            response->content_type = resp->content_type;
+            response->headers = resp->headers;
+            EndHeaders();
+        }
+        state = SEND_BODY;
+        return stream_write((const char*)resp->Content(), resp->ContentLength(), false);
+    }
     bool is_dump_headers = state == SEND_BEGIN ? true : false;
     std::string msg = resp->Dump(is_dump_headers, true);
     state = SEND_BODY;
-    return write(msg);
+    return write(std::move(msg));
 }
 
 int HttpResponseWriter::SSEvent(const std::string& data, const char* event /* = "message" */) {
@@ -72,8 +161,14 @@ int HttpResponseWriter::SSEvent(const std::string& data, const char* event /* =
         msg = "event: "; msg += event; msg += "\n";
     }
     msg += "data: ";  msg += data;  msg += "\n\n";
+    if (compressor) {
+        return WriteChunked(msg);
+    }
     state = SEND_BODY;
-    return write(msg);
+    if (stream_write) {
+        return stream_write(msg.data(), msg.size(), false);
+    }
+    return write(std::move(msg));
 }
 
 int HttpResponseWriter::End(const char* buf /* = NULL */, int len /* = -1 */) {
@@ -85,6 +180,33 @@ int HttpResponseWriter::End(const char* buf /* = NULL */, int len /* = -1 */) {
     }
 
     int ret = 0;
+    if (compressor) {
+        if (buf) {
+            ret = WriteChunked(buf, len);
+        }
+        if (state != SEND_CHUNKED_END) {
+            EndChunked();
+        }
+        if (!stream_write && !response->IsKeepAlive()) {
+            close(true);
+        }
+        return ret;
+    }
+
+    if (stream_write) {
+        // NOTE: body written before headers is in response->body
+        if (buf) {
+            ret = WriteBody(buf, len);
+        }
+        if (state != SEND_CHUNKED_END) {
+            stream_write(NULL, 0, true);
+        }
+        if (state == SEND_BEGIN) {
+            state = SEND_BODY;
+        }
+        return ret;
+    }
+
     bool keepAlive = response->IsKeepAlive();
     if (state == SEND_CHUNKED) {
         if (buf) {
@@ -108,7 +230,7 @@ int HttpResponseWriter::End(const char* buf /* = NULL */, int len /* = -1 */) {
         if (is_dump_body) {
             std::string msg = response->Dump(is_dump_headers, is_dump_body);
             state = SEND_BODY;
-            ret = write(msg);
+            ret = write(std::move(msg));
         }
     }
 
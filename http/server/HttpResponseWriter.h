@@ -6,6 +6,8 @@
 
 namespace hv {
 
+class HttpCompressor;
+
 class HV_EXPORT HttpResponseWriter : public SocketChannel {
 public:
     HttpResponsePtr response;
@@ -17,6 +19,11 @@ public:
         SEND_CHUNKED_END,
         SEND_END,
     } state: 8, end: 8;
+    // NOTE: HTTP/2 stream writes through Http2Parser instead of io, see HttpHandler.
+    // headers of response are submitted at the first call, with response->body if any.
+    std::function<int(const char* buf, int len, bool end)> stream_write;
+    // streaming compression, see EnableCompression
+    std::shared_ptr<HttpCompressor> compressor;
     HttpResponseWriter(hio_t* io, const HttpResponsePtr& resp)
         : SocketChannel(io)
         , response(resp)
@@ -34,6 +41,7 @@ public:
 
     int Begin() {
         state = end = SEND_BEGIN;
+        compressor.reset();
         return 0;
     }
 
@@ -58,6 +66,11 @@ public:
         return 0;
     }
 
+    // NOTE: call before EndHeaders, body is compressed by Content-Encoding negotiated with
+    // Accept-Encoding and flushed per write, HTTP/1 body is sent chunked without Content-Length.
+    // @retval 0 OK, -1 not acceptable or unsupported, send as is.
+    int EnableCompression(const char* accept_encoding, int level = -1);
+
     int EndHeaders(const char* key = NULL, const char* value = NULL);
 
     template<typename T>
@@ -82,6 +95,9 @@ public:
         return WriteBody(str.c_str(), str.size());
     }
 
+    // NOTE: send [offset, offset + length) of file fd as body, headers first if not sent.
+    int SendFile(int fd, size_t offset, size_t length);
+
     int WriteResponse(HttpResponse* resp);
 
     int SSEvent(const std::string& data, const char* event = "message");
@@ -91,6 +107,9 @@ public:
     int End(const std::string& str) {
         return End(str.c_str(), str.size());
     }
+
+private:
+    int writeChunked(const char* buf, int len);
 };
 
 }
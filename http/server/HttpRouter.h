@@ -1,68 +1,67 @@
 #ifndef HV_HTTP_ROUTER_H_
 #define HV_HTTP_ROUTER_H_
 
+// Literal > Param > Wildcard
+// literal route:   /hello, exact path
+// param route:     /users/:id or /orders/{orderId}, matched by segments, empty segments are ignored
+// wildcard route:  /static/* or /www.*.html, prefix*suffix, first inserted first matched
+//
+// Literal and param routes are inserted into a compressed radix tree,
+// which is compiled into flat arrays by Freeze, so Match walks contiguous nodes
+// on (path, len) without heap allocation and writes params into RouteParams inline.
+//
+// NOTE: routes are frozen by Freeze or the first Match, Insert after that is rejected,
+// so Match of a frozen router is lock-free and thread-safe. Clear to insert again.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+// NOTE: routes with more params are rejected by Insert
+#define HTTP_ROUTE_MAX_PARAMS   16
+
 namespace hv {
 
-template<typename Handler>
-struct RouteNode {
-    std::unordered_map<std::string, std::unique_ptr<RouteNode<Handler>>> children;
-    std::unique_ptr<RouteNode<Handler>> param_child;
-    std::string param_name;
-    Handler handler;
-    bool has_handler;
-
-    RouteNode() : has_handler(false) {}
+// NOTE: name refers to router, value refers to path
+struct RouteParams {
+    struct Param {
+        const std::string*  name;
+        const char*         value;
+        size_t              len;
+    };
+    Param   params[HTTP_ROUTE_MAX_PARAMS];
+    int     size;
+
+    RouteParams() : size(0) {}
 };
 
-template<typename Handler>
 struct WildcardRoute {
     std::string pattern;
     std::string prefix;
     std::string suffix;
-    Handler     handler;
+    int         handler; // index of handlers
 
-    bool Match(const std::string& path) const {
-        if (!prefix.empty() && path.compare(0, prefix.size(), prefix) != 0) {
+    bool Match(const char* path, size_t len) const {
+        if (len < prefix.size() || memcmp(path, prefix.data(), prefix.size()) != 0) {
             return false;
         }
         if (suffix.empty()) {
             return true;
         }
-        return path.size() >= prefix.size() + suffix.size() &&
-               path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+        return len >= prefix.size() + suffix.size() &&
+               memcmp(path + len - suffix.size(), suffix.data(), suffix.size()) == 0;
     }
 };
 
 namespace detail {
 
-inline std::vector<std::string> splitPathSegments(const std::string& path) {
-    std::vector<std::string> segments;
-    const char* p = path.c_str();
-    const char* segment = NULL;
-    while (*p != '\0') {
-        if (*p == '/') {
-            if (segment != NULL) {
-                segments.push_back(std::string(segment, p - segment));
-                segment = NULL;
-            }
-        }
-        else if (segment == NULL) {
-            segment = p;
-        }
-        ++p;
-    }
-    if (segment != NULL) {
-        segments.push_back(std::string(segment, p - segment));
-    }
-    return segments;
-}
-
 inline bool isParamSegment(const std::string& segment) {
     // RESTful style 1 /user/:id
     // RESTful style 2 /user/{id}
@@ -80,89 +79,223 @@ inline std::string paramNameOf(const std::string& segment) {
     return std::string();
 }
 
-template<typename Handler>
-inline bool matchNode(const RouteNode<Handler>* node, const std::vector<std::string>& segments, size_t index, Handler& handler, std::map<std::string, std::string>& params) {
-    if (index == segments.size()) {
-        if (!node->has_handler) {
-            return false;
+// radix tree node to build
+struct RadixNode {
+    std::string                             prefix;
+    // NOTE: first bytes of children are different
+    std::vector<std::unique_ptr<RadixNode>> children;
+    std::unique_ptr<RadixNode>              param_child; // one segment
+    std::string                             param_name;
+    int                                     exact; // handler of literal route
+    int                                     param; // handler of param route
+
+    RadixNode() : exact(-1), param(-1) {}
+};
+
+// @return node at the end of s, split nodes if need
+inline RadixNode* insertBytes(RadixNode* node, const char* s, size_t n) {
+    while (n > 0) {
+        std::unique_ptr<RadixNode>* next = NULL;
+        for (auto& child : node->children) {
+            if (child->prefix[0] == *s) {
+                next = &child;
+                break;
+            }
         }
-        handler = node->handler;
-        return true;
+        if (next == NULL) {
+            RadixNode* child = new RadixNode;
+            child->prefix.assign(s, n);
+            node->children.emplace_back(child);
+            return child;
+        }
+        RadixNode* child = next->get();
+        size_t common = 0;
+        while (common < n && common < child->prefix.size() && child->prefix[common] == s[common]) {
+            ++common;
+        }
+        if (common < child->prefix.size()) {
+            // split child => mid + child
+            RadixNode* mid = new RadixNode;
+            mid->prefix = child->prefix.substr(0, common);
+            child->prefix.erase(0, common);
+            next->release();
+            mid->children.emplace_back(child);
+            next->reset(mid);
+            child = mid;
+        }
+        node = child;
+        s += common;
+        n -= common;
     }
+    return node;
+}
 
-    auto literal_iter = node->children.find(segments[index]);
-    if (literal_iter != node->children.end() && matchNode(literal_iter->second.get(), segments, index + 1, handler, params)) {
-        return true;
+inline int paramCountOf(const std::string& path) {
+    int count = 0;
+    const char* p = path.c_str();
+    const char* end = p + path.size();
+    while (p < end) {
+        while (p < end && *p == '/') ++p;
+        const char* segment = p;
+        while (p < end && *p != '/') ++p;
+        if (p > segment && isParamSegment(std::string(segment, p - segment))) {
+            ++count;
+        }
     }
+    return count;
+}
 
-    if (node->param_child && matchNode(node->param_child.get(), segments, index + 1, handler, params)) {
-        params[node->param_name] = segments[index];
-        return true;
+// /users//:id/ => "/users/" + param(id)
+inline RadixNode* insertParamRoute(RadixNode* node, const std::string& path) {
+    std::string literal;
+    const char* p = path.c_str();
+    const char* end = p + path.size();
+    while (p < end) {
+        while (p < end && *p == '/') ++p;
+        if (p == end) break;
+        const char* segment = p;
+        while (p < end && *p != '/') ++p;
+        std::string strSegment(segment, p - segment);
+        literal += '/';
+        if (isParamSegment(strSegment)) {
+            node = insertBytes(node, literal.data(), literal.size());
+            literal.clear();
+            if (!node->param_child) {
+                node->param_child.reset(new RadixNode);
+            }
+            node->param_child->param_name = paramNameOf(strSegment);
+            node = node->param_child.get();
+        } else {
+            literal += strSegment;
+        }
     }
-
-    return false;
+    return insertBytes(node, literal.data(), literal.size());
 }
 
+// compiled node, children are contiguous in nodes
+struct CompiledNode {
+    uint32_t    prefix;         // offset of chars
+    uint32_t    prefix_len;
+    uint32_t    indices;        // offset of chars, first bytes of children
+    uint32_t    children;       // index of first child
+    uint32_t    nchildren;
+    int32_t     param_child;    // -1 if none
+    int32_t     param_name;     // index of names
+    int32_t     exact;
+    int32_t     param;
+};
+
 } // namespace detail
 
 template<typename Handler>
 class HttpRouter {
 public:
-    HttpRouter() : has_param_routes_(false) {}
+    HttpRouter() : has_param_routes_(false), frozen_(false) {}
 
+    // NOTE: not thread-safe with Match
     void Clear() {
+        std::lock_guard<std::mutex> locker(mutex_);
         routes_.clear();
-        param_root_ = RouteNode<Handler>();
+        handlers_.clear();
+        root_ = detail::RadixNode();
         has_param_routes_ = false;
         wildcard_routes_.clear();
+        nodes_.clear();
+        chars_.clear();
+        names_.clear();
+        frozen_.store(false, std::memory_order_release);
     }
 
-    void Insert(const std::string& path, const Handler& handler) {
+    // @retval false if frozen, or too many params
+    bool Insert(const std::string& path, const Handler& handler) {
+        std::lock_guard<std::mutex> locker(mutex_);
+        if (frozen_.load(std::memory_order_relaxed)) {
+            return false;
+        }
         // all routes
-        routes_[path] = handler;
+        auto iter = routes_.find(path);
+        if (iter != routes_.end()) {
+            handlers_[iter->second] = handler;
+            return true;
+        }
+        bool is_wildcard = path.find('*') != std::string::npos;
+        if (!is_wildcard && detail::paramCountOf(path) > HTTP_ROUTE_MAX_PARAMS) {
+            return false;
+        }
+        int index = handlers_.size();
+        handlers_.push_back(handler);
+        routes_[path] = index;
 
         // wildcard routes
-        size_t wildcard_pos = path.find('*');
-        if (wildcard_pos != std::string::npos) {
-            for (auto& route : wildcard_routes_) {
-                if (route.pattern == path) {
-                    route.handler = handler;
-                    return;
-                }
-            }
-            WildcardRoute<Handler> route;
+        if (is_wildcard) {
+            size_t wildcard_pos = path.find('*');
+            WildcardRoute route;
             route.pattern = path;
             route.prefix = path.substr(0, wildcard_pos);
             route.suffix = path.substr(wildcard_pos + 1);
-            route.handler = handler;
+            route.handler = index;
             wildcard_routes_.push_back(route);
-            return;
+            return true;
         }
 
         // param routes
         if (path.find("/:") != std::string::npos || path.find("/{") != std::string::npos) {
-            std::vector<std::string> segments = detail::splitPathSegments(path);
-            RouteNode<Handler>* node = &param_root_;
-            for (const auto& segment : segments) {
-                if (detail::isParamSegment(segment)) {
-                    if (!node->param_child) {
-                        node->param_child.reset(new RouteNode<Handler>());
-                    }
-                    node->param_name = detail::paramNameOf(segment);
-                    node = node->param_child.get();
-                    continue;
-                }
+            detail::insertParamRoute(&root_, path)->param = index;
+            has_param_routes_ = true;
+            return true;
+        }
 
-                std::unique_ptr<RouteNode<Handler>>& child = node->children[segment];
-                if (!child) {
-                    child.reset(new RouteNode<Handler>());
-                }
-                node = child.get();
+        // literal routes
+        detail::insertBytes(&root_, path.data(), path.size())->exact = index;
+        return true;
+    }
+
+    // compile radix tree into flat arrays, called once before Match
+    void Freeze() const {
+        if (frozen_.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> locker(mutex_);
+        if (frozen_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        nodes_.clear();
+        chars_.clear();
+        names_.clear();
+        std::vector<const detail::RadixNode*> queue;
+        queue.push_back(&root_);
+        for (size_t i = 0; i < queue.size(); ++i) {
+            const detail::RadixNode* src = queue[i];
+            detail::CompiledNode node;
+            node.prefix = chars_.size();
+            node.prefix_len = src->prefix.size();
+            chars_ += src->prefix;
+            node.indices = chars_.size();
+            for (const auto& child : src->children) {
+                chars_ += child->prefix[0];
             }
-            node->handler = handler;
-            node->has_handler = true;
-            has_param_routes_ = true;
+            node.children = queue.size();
+            node.nchildren = src->children.size();
+            for (const auto& child : src->children) {
+                queue.push_back(child.get());
+            }
+            node.param_child = -1;
+            node.param_name = -1;
+            if (src->param_child) {
+                node.param_child = queue.size();
+                queue.push_back(src->param_child.get());
+            }
+            if (i != 0 && src->prefix.empty()) {
+                // param node
+                node.param_name = names_.size();
+                names_.push_back(src->param_name);
+            }
+            node.exact = src->exact;
+            node.param = src->param;
+            nodes_.push_back(node);
         }
+        nodes_.shrink_to_fit();
+        frozen_.store(true, std::memory_order_release);
     }
 
     bool Find(const std::string& path, Handler& handler) const {
@@ -170,7 +303,26 @@ public:
         if (route_iter == routes_.end()) {
             return false;
         }
-        handler = route_iter->second;
+        handler = handlers_[route_iter->second];
+        return true;
+    }
+
+    // @param[out] handler: refers to router
+    bool Match(const char* path, size_t len, const Handler*& handler, RouteParams& params) const {
+        Freeze();
+        // Literal > Param > Wildcard
+        int index = matchExact(path, len);
+        if (index < 0 && has_param_routes_) {
+            params.size = 0;
+            matchParam(0, path, len, 0, index, params);
+        }
+        if (index < 0) {
+            index = matchWildcard(path, len);
+        }
+        if (index < 0) {
+            return false;
+        }
+        handler = &handlers_[index];
         return true;
     }
 
@@ -178,25 +330,45 @@ public:
         if (!has_param_routes_) {
             return false;
         }
-        std::vector<std::string> segments = detail::splitPathSegments(path);
-        return detail::matchNode(&param_root_, segments, 0, handler, params);
+        Freeze();
+        int index = -1;
+        RouteParams route_params;
+        if (!matchParam(0, path.data(), path.size(), 0, index, route_params)) {
+            return false;
+        }
+        handler = handlers_[index];
+        for (int i = 0; i < route_params.size; ++i) {
+            const RouteParams::Param& param = route_params.params[i];
+            params[*param.name] = std::string(param.value, param.len);
+        }
+        return true;
     }
 
     bool MatchWildcard(const std::string& path, Handler& handler) const {
-        for (const auto& wildcard_route : wildcard_routes_) {
-            if (wildcard_route.Match(path)) {
-                handler = wildcard_route.handler;
-                return true;
-            }
+        int index = matchWildcard(path.data(), path.size());
+        if (index < 0) {
+            return false;
         }
-        return false;
+        handler = handlers_[index];
+        return true;
     }
 
     bool Match(const std::string& path, Handler& handler, std::map<std::string, std::string>& params) const {
-        // Literal > Param > Wildcard
-        return Find(path, handler) ||
-               MatchParam(path, handler, params) ||
-               MatchWildcard(path, handler);
+        const Handler* matched = NULL;
+        RouteParams route_params;
+        if (!Match(path.data(), path.size(), matched, route_params)) {
+            return false;
+        }
+        handler = *matched;
+        for (int i = 0; i < route_params.size; ++i) {
+            const RouteParams::Param& param = route_params.params[i];
+            params[*param.name] = std::string(param.value, param.len);
+        }
+        return true;
+    }
+
+    bool Frozen() const {
+        return frozen_.load(std::memory_order_acquire);
     }
 
     bool Empty() const {
@@ -213,10 +385,110 @@ public:
     }
 
 private:
-    std::unordered_map<std::string, Handler> routes_;
-    RouteNode<Handler> param_root_;
-    bool has_param_routes_;
-    std::vector<WildcardRoute<Handler>> wildcard_routes_;
+    const detail::CompiledNode* findChild(const detail::CompiledNode& node, char c) const {
+        const char* indices = chars_.data() + node.indices;
+        const char* hit = (const char*)memchr(indices, c, node.nchildren);
+        return hit ? &nodes_[node.children + (hit - indices)] : NULL;
+    }
+
+    int matchExact(const char* path, size_t len) const {
+        const detail::CompiledNode* node = &nodes_[0];
+        size_t pos = 0;
+        while (pos < len) {
+            node = findChild(*node, path[pos]);
+            if (node == NULL ||
+                len - pos < node->prefix_len ||
+                memcmp(path + pos, chars_.data() + node->prefix, node->prefix_len) != 0) {
+                return -1;
+            }
+            pos += node->prefix_len;
+        }
+        return node->exact;
+    }
+
+    // '/' of prefix matches one or more '/' of path, or none at the beginning.
+    bool consumeSegments(const detail::CompiledNode& node, const char* path, size_t len, size_t& pos) const {
+        const char* prefix = chars_.data() + node.prefix;
+        for (uint32_t i = 0; i < node.prefix_len; ++i) {
+            if (prefix[i] == '/') {
+                if (pos < len && path[pos] == '/') {
+                    while (pos < len && path[pos] == '/') ++pos;
+                } else if (pos != 0) {
+                    return false;
+                }
+            } else {
+                if (pos >= len || path[pos] != prefix[i]) return false;
+                ++pos;
+            }
+        }
+        return true;
+    }
+
+    bool matchParam(uint32_t idx, const char* path, size_t len, size_t pos, int& handler, RouteParams& params) const {
+        const detail::CompiledNode& node = nodes_[idx];
+        // NOTE: trailing slashes are ignored
+        size_t end = pos;
+        while (end < len && path[end] == '/') ++end;
+        if (end == len && node.param >= 0) {
+            handler = node.param;
+            return true;
+        }
+
+        // literal child first
+        if (pos < len) {
+            const detail::CompiledNode* child = findChild(node, pos == 0 ? '/' : path[pos]);
+            size_t next = pos;
+            if (child && consumeSegments(*child, path, len, next) &&
+                matchParam(child - &nodes_[0], path, len, next, handler, params)) {
+                return true;
+            }
+        }
+
+        // then param child
+        if (node.param_child >= 0 && pos < len && path[pos] != '/') {
+            end = pos;
+            while (end < len && path[end] != '/') ++end;
+            const detail::CompiledNode& child = nodes_[node.param_child];
+            int size = params.size;
+            // NOTE: unreachable, routes with more params are rejected by Insert
+            if (size >= HTTP_ROUTE_MAX_PARAMS) {
+                return false;
+            }
+            RouteParams::Param& param = params.params[size];
+            param.name = &names_[child.param_name];
+            param.value = path + pos;
+            param.len = end - pos;
+            params.size = size + 1;
+            if (matchParam(node.param_child, path, len, end, handler, params)) {
+                return true;
+            }
+            params.size = size;
+        }
+        return false;
+    }
+
+    int matchWildcard(const char* path, size_t len) const {
+        for (const auto& wildcard_route : wildcard_routes_) {
+            if (wildcard_route.Match(path, len)) {
+                return wildcard_route.handler;
+            }
+        }
+        return -1;
+    }
+
+private:
+    // path => index of handlers
+    std::unordered_map<std::string, int>    routes_;
+    std::vector<Handler>                    handlers_;
+    detail::RadixNode                       root_;
+    bool                                    has_param_routes_;
+    std::vector<WildcardRoute>              wildcard_routes_;
+    // compiled by Freeze
+    mutable std::mutex                      mutex_;
+    mutable std::atomic<bool>               frozen_;
+    mutable std::vector<detail::CompiledNode> nodes_;
+    mutable std::string                     chars_;
+    mutable std::vector<std::string>        names_;
 };
 
 }
@@ -4,6 +4,8 @@
 #include "herr.h"
 #include "hlog.h"
 #include "htime.h"
+#include "hsocket.h"
+#include "hsysinfo.h"
 
 #include "EventLoop.h"
 using namespace hv;
@@ -20,6 +22,14 @@ struct HttpServerPrivdata {
     std::mutex                      mutex_;
     std::shared_ptr<HttpService>    service;
     FileCache                       filecache;
+    int                             nworkers; // started loop_thread in this process
+};
+
+// userdata of listenio per loop
+struct HttpServerWorker {
+    http_server_t*                  server;
+    HttpMessagePool                 pool;
+    hv::HttpUpstreamPool            upstreams;
 };
 
 static void on_recv(hio_t* io, void* buf, int readbytes) {
@@ -48,7 +58,8 @@ static void on_close(hio_t* io) {
 }
 
 static void on_accept(hio_t* io) {
-    http_server_t* server = (http_server_t*)hevent_userdata(io);
+    HttpServerWorker* worker = (HttpServerWorker*)hevent_userdata(io);
+    http_server_t* server = worker->server;
     HttpService* service = server->service;
     /*
     printf("on_accept connfd=%d\n", hio_fd(io));
@@ -84,6 +95,8 @@ static void on_accept(hio_t* io) {
     handler->port = sockaddr_port(peeraddr);
     // http service
     handler->service = service;
+    handler->pool = &worker->pool;
+    handler->upstreams = &worker->upstreams;
     // websocket service
     handler->ws_service = server->ws;
     // FileCache
@@ -92,28 +105,73 @@ static void on_accept(hio_t* io) {
     hevent_set_userdata(io, handler);
 }
 
+// SO_REUSEPORT: the first worker takes listenfd of http_server_run, others listen on their own.
+// NOTE: listenfd is closed with its listenio by hloop_free when loop->run returns,
+// so none is left after http_server_stop joined the workers, see http_reuseport_test.
+static int worker_listen(http_server_t* server, int idx, int port, int listenfd, int cpu) {
+    if (idx != 0) {
+        listenfd = ListenReusePort(port, server->host);
+        if (listenfd < 0) {
+            hloge("worker listen on %s:%d failed: %d", server->host, port, listenfd);
+            return listenfd;
+        }
+    }
+    if (cpu >= 0) {
+        so_incoming_cpu(listenfd, cpu);
+    }
+    return listenfd;
+}
+
 static void loop_thread(void* userdata) {
     http_server_t* server = (http_server_t*)userdata;
     HttpService* service = server->service;
+    HttpServerPrivdata* privdata = (HttpServerPrivdata*)server->privdata;
+
+    int listenfd[2] = { server->listenfd[0], server->listenfd[1] };
+    if (server->reuseport) {
+        privdata->mutex_.lock();
+        int idx = privdata->nworkers++;
+        privdata->mutex_.unlock();
+        int cpu = -1;
+#ifdef OS_LINUX
+        if (server->incoming_cpu && server->worker_processes == 0) {
+            cpu = idx % get_ncpu();
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(cpu, &cpuset);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+        }
+#endif
+        int port[2] = { server->port, server->https_port };
+        for (int i = 0; i < 2; ++i) {
+            // NOTE: listenfd set by setListenFD without port is shared by all workers.
+            if (listenfd[i] < 0 || port[i] <= 0) continue;
+            listenfd[i] = worker_listen(server, idx, port[i], listenfd[i], cpu);
+        }
+    }
 
+    // NOTE: outlives loop, handlers put messages back on close
+    HttpServerWorker worker;
+    worker.server = server;
+    worker.upstreams.max_idle = service->proxy_keepalive > 0 ? service->proxy_keepalive : 0;
+    worker.upstreams.idle_timeout = service->proxy_keepalive_timeout;
     auto loop = std::make_shared<EventLoop>();
     hloop_t* hloop = loop->loop();
     // http
-    if (server->listenfd[0] >= 0) {
-        hio_t* listenio = haccept(hloop, server->listenfd[0], on_accept);
-        hevent_set_userdata(listenio, server);
+    if (listenfd[0] >= 0) {
+        hio_t* listenio = haccept(hloop, listenfd[0], on_accept);
+        hevent_set_userdata(listenio, &worker);
     }
     // https
-    if (server->listenfd[1] >= 0) {
-        hio_t* listenio = haccept(hloop, server->listenfd[1], on_accept);
-        hevent_set_userdata(listenio, server);
+    if (listenfd[1] >= 0) {
+        hio_t* listenio = haccept(hloop, listenfd[1], on_accept);
+        hevent_set_userdata(listenio, &worker);
         hio_enable_ssl(listenio);
         if (server->ssl_ctx) {
             hio_set_ssl_ctx(listenio, server->ssl_ctx);
         }
     }
 
-    HttpServerPrivdata* privdata = (HttpServerPrivdata*)server->privdata;
     privdata->mutex_.lock();
     if (privdata->loops.size() == 0) {
         // NOTE: fsync logfile when idle
@@ -136,6 +194,23 @@ static void loop_thread(void* userdata) {
         FileCache* filecache = &privdata->filecache;
         filecache->stat_interval = service->file_cache_stat_interval;
         filecache->expired_time = service->file_cache_expired_time;
+        filecache->capacity = service->file_cache_capacity;
+#ifdef OS_LINUX
+        // NOTE: invalidate file cache by inotify instead of stat
+        int inotify_fd = filecache->OpenInotify();
+        if (inotify_fd >= 0) {
+            // NOTE: read a dup fd, inotify_fd is closed by FileCache,
+            // the dup fd is not a socket or pipe, so close it by hclose_cb.
+            hio_t* io = hread(hloop, dup(inotify_fd), NULL, 0, [](hio_t* io, void* buf, int readbytes) {
+                FileCache* filecache = (FileCache*)hevent_userdata(io);
+                filecache->OnInotifyEvents((const char*)buf, readbytes);
+            });
+            hevent_set_userdata(io, filecache);
+            hio_setcb_close(io, [](hio_t* io) {
+                close(hio_fd(io));
+            });
+        }
+#endif
         if (filecache->expired_time > 0) {
             // NOTE: add timer to remove expired file cache
             htimer_t* timer = htimer_add(hloop, [](htimer_t* timer) {
@@ -177,15 +252,18 @@ static void WINAPI loop_thread_stdcall(void* userdata) {
  * on_close -> delete HttpHandler
  */
 int http_server_run(http_server_t* server, int wait) {
+#ifndef SO_REUSEPORT
+    server->reuseport = 0;
+#endif
     // http_port
     if (server->port > 0) {
-        server->listenfd[0] = Listen(server->port, server->host);
+        server->listenfd[0] = server->reuseport ? ListenReusePort(server->port, server->host) : Listen(server->port, server->host);
         if (server->listenfd[0] < 0) return server->listenfd[0];
         hlogi("http server listening on %s:%d", server->host, server->port);
     }
     // https_port
     if (server->https_port > 0 && HV_WITH_SSL) {
-        server->listenfd[1] = Listen(server->https_port, server->host);
+        server->listenfd[1] = server->reuseport ? ListenReusePort(server->https_port, server->host) : Listen(server->https_port, server->host);
         if (server->listenfd[1] < 0) return server->listenfd[1];
         hlogi("https server listening on %s:%d", server->host, server->https_port);
     }
@@ -207,11 +285,13 @@ int http_server_run(http_server_t* server, int wait) {
     }
 
     HttpServerPrivdata* privdata = new HttpServerPrivdata;
+    privdata->nworkers = 0;
     server->privdata = privdata;
     if (server->service == NULL) {
         privdata->service = std::make_shared<HttpService>();
         server->service = privdata->service.get();
     }
+    server->service->FreezeRoutes();
 
     if (server->worker_processes) {
         // multi-processes
@@ -254,7 +334,7 @@ int http_server_stop(http_server_t* server) {
         hv_delay(1);
         std::lock_guard<std::mutex> locker(privdata->mutex_);
         // wait for all loops created
-        if (privdata->loops.size() < server->worker_threads) {
+        if (privdata->loops.size() < (size_t)server->worker_threads) {
             continue;
         }
         // wait for all loops running
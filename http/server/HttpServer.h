@@ -21,6 +21,11 @@ typedef struct http_server_s {
     int worker_processes;
     int worker_threads;
     uint32_t worker_connections; // max_connections = workers * worker_connections
+    // SO_REUSEPORT: each worker loop listens on its own socket, kernel spreads accept.
+    unsigned reuseport: 1;
+    // with reuseport in multi-threads mode: pin worker i to cpu i and set SO_INCOMING_CPU,
+    // so connections are accepted on the cpu handling their packets (linux 6.2+).
+    unsigned incoming_cpu: 1;
     HttpService* service; // http service
     WebSocketService* ws; // websocket service
     void* userdata;
@@ -45,6 +50,8 @@ typedef struct http_server_s {
         worker_processes = 0;
         worker_threads = 0;
         worker_connections = 1024;
+        reuseport = 0;
+        incoming_cpu = 0;
         service = NULL;
         ws = NULL;
         listenfd[0] = listenfd[1] = -1;
@@ -122,6 +129,11 @@ public:
     void setMaxWorkerConnectionNum(uint32_t num) {
         this->worker_connections = num;
     }
+
+    void setReusePort(bool on = true, bool incoming_cpu = false) {
+        this->reuseport = on;
+        this->incoming_cpu = incoming_cpu;
+    }
     size_t connectionNum();
 
     // SSL/TLS
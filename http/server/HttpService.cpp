@@ -1,6 +1,7 @@
 #include "HttpService.h"
 #include "HttpMiddleware.h"
 #include "HttpRouter.h"
+#include "hlog.h"
 
 namespace hv {
 
@@ -8,13 +9,21 @@ void HttpService::AddRoute(const char* path, http_method method, const http_hand
     if (!router) {
         router = std::make_shared<http_router>();
     }
+    // NOTE: routes are frozen by http_server_run, matched by workers without lock
+    if (router->Frozen()) {
+        hlogw("AddRoute %s after routes frozen is ignored", path);
+        return;
+    }
 
     std::string route_path(path);
     http_method_handlers_ptr method_handlers;
     if (!router->Find(route_path, method_handlers)) {
         // new http_method_handlers
         method_handlers = std::make_shared<http_method_handlers>();
-        router->Insert(route_path, method_handlers);
+        if (!router->Insert(route_path, method_handlers)) {
+            hloge("AddRoute %s failed: more than %d params", path, HTTP_ROUTE_MAX_PARAMS);
+            return;
+        }
     }
 
     // insert handler into http_method_handlers
@@ -33,6 +42,12 @@ bool HttpService::HasRoutes() const {
     return router && !router->Empty();
 }
 
+void HttpService::FreezeRoutes() {
+    if (router) {
+        router->Freeze();
+    }
+}
+
 hv::StringList HttpService::Paths() const {
     if (!HasRoutes()) {
         return hv::StringList();
@@ -56,15 +71,20 @@ int HttpService::GetRoute(const char* full_path, http_method method, http_handle
     const char* e = s;
     while (*e && *e != '?') ++e;
 
-    std::string path = std::string(s, e);
-    if (path.empty()) {
+    if (e == s) {
         return HTTP_STATUS_NOT_FOUND;
     }
 
-    http_method_handlers_ptr method_handlers;
-    if (!router->Match(path, method_handlers, params)) {
+    const http_method_handlers_ptr* matched = NULL;
+    RouteParams route_params;
+    if (!router->Match(s, e - s, matched, route_params)) {
         return HTTP_STATUS_NOT_FOUND;
     }
+    for (int i = 0; i < route_params.size; ++i) {
+        const RouteParams::Param& param = route_params.params[i];
+        params[*param.name] = std::string(param.value, param.len);
+    }
+    const http_method_handlers_ptr& method_handlers = *matched;
     for (auto iter = method_handlers->begin(); iter != method_handlers->end(); ++iter) {
         if (iter->method == method) {
             if (handler) *handler = &iter->handler;
@@ -123,6 +143,22 @@ std::string HttpService::GetProxyUrl(const char* path) {
     return url;
 }
 
+HttpUpstreamGroup* HttpService::Upstream(const char* name, load_balance_e lb) {
+    HttpUpstreamGroupPtr& group = upstreams[name];
+    if (group == NULL) {
+        group = std::make_shared<HttpUpstreamGroup>(name, lb);
+    } else {
+        group->lb = lb;
+    }
+    return group.get();
+}
+
+HttpUpstreamGroup* HttpService::GetUpstream(const std::string& host) {
+    if (upstreams.empty()) return NULL;
+    auto iter = upstreams.find(host);
+    return iter == upstreams.end() ? NULL : iter->second.get();
+}
+
 void HttpService::AddTrustProxy(const char* host) {
     trustProxies.emplace_back(host);
 }
@@ -13,6 +13,7 @@
 #include "HttpMessage.h"
 #include "HttpResponseWriter.h"
 #include "HttpContext.h"
+#include "HttpUpstream.h"
 
 #define DEFAULT_BASE_URL        "/api/v1"
 #define DEFAULT_DOCUMENT_ROOT   "/var/www/html"
@@ -25,6 +26,12 @@
 #define MAX_FILE_CACHE_SIZE                 (1 << 22)   // 4M
 #define DEFAULT_FILE_CACHE_STAT_INTERVAL    10          // s
 #define DEFAULT_FILE_CACHE_EXPIRED_TIME     60          // s
+#define DEFAULT_FILE_CACHE_CAPACITY         (1 << 28)   // 256M
+#define DEFAULT_COMPRESSION_MIN_LENGTH      1024        // 1K
+
+// for proxy
+#define DEFAULT_PROXY_KEEPALIVE             32          // idle connections per upstream server per worker
+#define DEFAULT_PROXY_KEEPALIVE_TIMEOUT     60000       // ms
 
 /*
  * @param[in]  req:  parsed structured http request
@@ -144,18 +151,29 @@ struct HV_EXPORT HttpService {
     /* Reverse proxy service */
     // nginx: location => proxy_pass
     std::map<std::string, std::string, std::greater<std::string>> proxies;
+    // nginx: upstream name { server ...; } => proxy_pass http://name/
+    std::map<std::string, HttpUpstreamGroupPtr> upstreams;
     /* Forward proxy service */
     StringList  trustProxies;
     StringList  noProxies;
     int proxy_connect_timeout;
     int proxy_read_timeout;
     int proxy_write_timeout;
+    /*
+     * Reverse proxy connections to upstream servers are kept alive and shared
+     * by all client connections of a worker, at most proxy_keepalive idle ones
+     * per upstream server, closed after idle proxy_keepalive_timeout.
+     * 0 to close upstream connections after each response.
+     */
+    int proxy_keepalive;
+    int proxy_keepalive_timeout;
 
     // options
     int keepalive_timeout;
     int max_file_cache_size;        // cache small file
     int file_cache_stat_interval;   // stat file is modified
     int file_cache_expired_time;    // remove expired file cache
+    size_t file_cache_capacity;     // bytes of all cached files
     /*
      * @test    limit_rate
      * @build   make examples
@@ -163,9 +181,23 @@ struct HV_EXPORT HttpService {
      * @client  bin/wget http://127.0.0.1:8080/downloads/test.zip
      */
     int limit_rate; // limit send rate, unit: KB/s
+    int compression_min_length; // compress body if >= min length
+    /*
+     * Request body larger than body_spill_size is written to a temporary file in upload_dir
+     * instead of req->body, see HttpMessage::body_file, multipart/form-data files to
+     * a temporary file per part, see FormData::filepath, 0 to keep all in memory.
+     * NOTE: http_state_handler receives body as it arrives, nothing is spilled.
+     */
+    size_t body_spill_size;
+    std::string upload_dir; // default: get_temp_dir
 
     unsigned enable_access_log      :1;
     unsigned enable_forward_proxy   :1;
+    // serve precompressed filepath.br .zst .gz by Accept-Encoding
+    unsigned enable_precompressed   :1;
+    // gzip static files and responses on the fly, need WITH_ZLIB
+    // NOTE: responses sent by writer are compressed only if writer->EnableCompression
+    unsigned enable_compression     :1;
 
     HttpService() {
         // base_url = DEFAULT_BASE_URL;
@@ -178,15 +210,26 @@ struct HV_EXPORT HttpService {
         proxy_connect_timeout = DEFAULT_CONNECT_TIMEOUT;
         proxy_read_timeout = 0;
         proxy_write_timeout = 0;
+        proxy_keepalive = DEFAULT_PROXY_KEEPALIVE;
+        proxy_keepalive_timeout = DEFAULT_PROXY_KEEPALIVE_TIMEOUT;
 
         keepalive_timeout = DEFAULT_KEEPALIVE_TIMEOUT;
         max_file_cache_size = MAX_FILE_CACHE_SIZE;
         file_cache_stat_interval = DEFAULT_FILE_CACHE_STAT_INTERVAL;
         file_cache_expired_time = DEFAULT_FILE_CACHE_EXPIRED_TIME;
+        file_cache_capacity = DEFAULT_FILE_CACHE_CAPACITY;
         limit_rate = -1; // unlimited
+        compression_min_length = DEFAULT_COMPRESSION_MIN_LENGTH;
+        body_spill_size = 0;
+        char temp_dir[MAX_PATH] = {0};
+        if (get_temp_dir(temp_dir, sizeof(temp_dir))) {
+            upload_dir = temp_dir;
+        }
 
         enable_access_log = 1;
         enable_forward_proxy = 0;
+        enable_precompressed = 0;
+        enable_compression = 0;
     }
 
     // router interface
@@ -198,6 +241,8 @@ struct HV_EXPORT HttpService {
     // @override GetRoute(req->path.c_str(), req->method, handler, req->query_params);
     int  GetRoute(HttpRequest* req, http_handler** handler);
     bool HasRoutes() const;
+    // compile routes, called by http_server_run before workers start
+    void FreezeRoutes();
     hv::StringList Paths() const;
 
     // Static("/", "/var/www/html")
@@ -216,9 +261,15 @@ struct HV_EXPORT HttpService {
     bool IsTrustProxy(const char* host);
     // reverse proxy
     // Proxy("/api/v1/", "http://www.httpbin.org/");
+    // NOTE: HTTP2 requests of proxy routes are answered with 502 Bad Gateway.
     void Proxy(const char* path, const char* url);
     // @retval /api/v1/test => http://www.httpbin.org/test
     std::string GetProxyUrl(const char* path);
+    // Upstream("backend", LB_LeastConnections)->AddServer("127.0.0.1:8001");
+    // Proxy("/api/v1/", "http://backend/");
+    HttpUpstreamGroup* Upstream(const char* name, load_balance_e lb = LB_RoundRobin);
+    // @retval NULL if host is not an upstream group
+    HttpUpstreamGroup* GetUpstream(const std::string& host);
 
     // Handler = [ http_sync_handler, http_ctx_handler ]
     template<typename Handler>
@@ -0,0 +1,279 @@
+#include "HttpUpstream.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "hbase.h"
+#include "hlog.h"
+#include "hurl.h"
+#include "httpdef.h"
+
+namespace hv {
+
+// FNV-1a with murmur3 finalizer, spreads similar keys like host:port#i over the ring
+static uint32_t upstream_hash(const char* key, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h = (h ^ (unsigned char)key[i]) * 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+void HttpUpstreamGroup::AddServer(const std::string& url, int weight, int max_fails, int fail_timeout) {
+    HUrl hurl;
+    if (!hurl.parse(url) || hurl.host.empty()) {
+        hloge("upstream %s: invalid server %s", name.c_str(), url.c_str());
+        return;
+    }
+    std::lock_guard<std::mutex> locker(mutex_);
+    servers_.emplace_back();
+    HttpUpstreamServer& server = servers_.back();
+    server.host = hurl.host;
+    server.https = hurl.scheme == "https" ? 1 : 0;
+    server.port = hurl.port > 0 ? hurl.port : (server.https ? DEFAULT_HTTPS_PORT : DEFAULT_HTTP_PORT);
+    server.weight = weight > 0 ? weight : 1;
+    server.max_fails = max_fails;
+    server.fail_timeout = fail_timeout;
+    server.current_weight = 0;
+    server.conns = 0;
+    server.fails = 0;
+    server.fail_time = 0;
+    server.addr = server.https ? "https://" : "http://";
+    server.addr += server.host + ":" + std::to_string(server.port);
+
+    // ring of LB_IpHash, LB_UrlHash
+    std::string point = server.host + ":" + std::to_string(server.port) + "#";
+    size_t prefix_len = point.size();
+    for (int i = 0; i < server.weight * UPSTREAM_HASH_POINTS; ++i) {
+        point.resize(prefix_len);
+        point += std::to_string(i);
+        ring_.emplace_back(upstream_hash(point.c_str(), point.size()), &server);
+    }
+    std::sort(ring_.begin(), ring_.end(),
+        [](const std::pair<uint32_t, HttpUpstreamServer*>& lhs, const std::pair<uint32_t, HttpUpstreamServer*>& rhs) {
+            return lhs.first < rhs.first;
+        });
+}
+
+size_t HttpUpstreamGroup::Size() {
+    std::lock_guard<std::mutex> locker(mutex_);
+    return servers_.size();
+}
+
+bool HttpUpstreamGroup::available(HttpUpstreamServer* server, time_t now, const std::vector<HttpUpstreamServer*>* tried) {
+    if (tried && std::find(tried->begin(), tried->end(), server) != tried->end()) {
+        return false;
+    }
+    // passive health check
+    if (server->max_fails > 0 && server->fails >= server->max_fails &&
+        now - server->fail_time < server->fail_timeout) {
+        return false;
+    }
+    return true;
+}
+
+HttpUpstreamServer* HttpUpstreamGroup::Select(const char* key, const std::vector<HttpUpstreamServer*>* tried) {
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (servers_.empty()) return NULL;
+    time_t now = time(NULL);
+    HttpUpstreamServer* server = NULL;
+    switch (lb) {
+    case LB_Random:
+        server = selectRandom(now, tried);
+        break;
+    case LB_LeastConnections:
+        server = selectLeastConnections(now, tried);
+        break;
+    case LB_IpHash:
+    case LB_UrlHash:
+        server = selectHash(key, now, tried);
+        break;
+    case LB_RoundRobin:
+    default:
+        server = selectRoundRobin(now, tried);
+        break;
+    }
+    if (server == NULL) {
+        // all down: try any server not tried, like all of them come back
+        for (auto& s : servers_) {
+            if (tried == NULL || std::find(tried->begin(), tried->end(), &s) == tried->end()) {
+                server = &s;
+                break;
+            }
+        }
+    }
+    if (server) ++server->conns;
+    return server;
+}
+
+void HttpUpstreamGroup::Release(HttpUpstreamServer* server, bool failed) {
+    if (server == NULL) return;
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (server->conns > 0) --server->conns;
+    if (failed) {
+        time_t now = time(NULL);
+        // a new window of fail_timeout
+        if (now - server->fail_time >= server->fail_timeout) {
+            server->fails = 0;
+        }
+        ++server->fails;
+        server->fail_time = now;
+        if (server->max_fails > 0 && server->fails == server->max_fails) {
+            hlogw("upstream %s: server %s:%d is down for %ds", name.c_str(),
+                server->host.c_str(), server->port, server->fail_timeout);
+        }
+    } else {
+        server->fails = 0;
+    }
+}
+
+HttpUpstreamServer* HttpUpstreamGroup::selectRoundRobin(time_t now, const std::vector<HttpUpstreamServer*>* tried) {
+    // nginx smooth weighted round-robin
+    HttpUpstreamServer* best = NULL;
+    int total = 0;
+    for (auto& server : servers_) {
+        if (!available(&server, now, tried)) continue;
+        server.current_weight += server.weight;
+        total += server.weight;
+        if (best == NULL || server.current_weight > best->current_weight) {
+            best = &server;
+        }
+    }
+    if (best) best->current_weight -= total;
+    return best;
+}
+
+HttpUpstreamServer* HttpUpstreamGroup::selectRandom(time_t now, const std::vector<HttpUpstreamServer*>* tried) {
+    int total = 0;
+    for (auto& server : servers_) {
+        if (available(&server, now, tried)) total += server.weight;
+    }
+    if (total == 0) return NULL;
+    int r = hv_rand(0, total - 1);
+    for (auto& server : servers_) {
+        if (!available(&server, now, tried)) continue;
+        r -= server.weight;
+        if (r < 0) return &server;
+    }
+    return NULL;
+}
+
+HttpUpstreamServer* HttpUpstreamGroup::selectLeastConnections(time_t now, const std::vector<HttpUpstreamServer*>* tried) {
+    // start from the next one each time, spread ties
+    HttpUpstreamServer* best = NULL;
+    size_t n = servers_.size();
+    size_t start = rr_index_++ % n;
+    for (size_t i = 0; i < n; ++i) {
+        HttpUpstreamServer* server = &servers_[(start + i) % n];
+        if (!available(server, now, tried)) continue;
+        // conns / weight < best->conns / best->weight
+        if (best == NULL || (int64_t)server->conns * best->weight < (int64_t)best->conns * server->weight) {
+            best = server;
+        }
+    }
+    return best;
+}
+
+HttpUpstreamServer* HttpUpstreamGroup::selectHash(const char* key, time_t now, const std::vector<HttpUpstreamServer*>* tried) {
+    if (key == NULL) key = "";
+    uint32_t h = upstream_hash(key, strlen(key));
+    auto iter = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(h, (HttpUpstreamServer*)NULL),
+        [](const std::pair<uint32_t, HttpUpstreamServer*>& lhs, const std::pair<uint32_t, HttpUpstreamServer*>& rhs) {
+            return lhs.first < rhs.first;
+        });
+    // clockwise to the next server available
+    size_t start = iter - ring_.begin();
+    for (size_t i = 0; i < ring_.size(); ++i) {
+        HttpUpstreamServer* server = ring_[(start + i) % ring_.size()].second;
+        if (available(server, now, tried)) return server;
+    }
+    return NULL;
+}
+
+//-----------------HttpUpstreamPool-----------------------------------
+HttpUpstreamPool::~HttpUpstreamPool() {
+    for (auto& pair : idles_) {
+        for (hio_t* io : pair.second) {
+            hio_setcb_close(io, NULL);
+            hevent_set_userdata(io, NULL);
+            hio_close(io);
+        }
+    }
+    idles_.clear();
+}
+
+hio_t* HttpUpstreamPool::Get(const std::string& addr) {
+    auto iter = idles_.find(addr);
+    if (iter == idles_.end()) return NULL;
+    std::deque<hio_t*>& ios = iter->second;
+    while (!ios.empty()) {
+        // the most recently used, least likely closed by peer
+        hio_t* io = ios.back();
+        ios.pop_back();
+        hio_setcb_read(io, NULL);
+        hio_setcb_close(io, NULL);
+        hevent_set_userdata(io, NULL);
+        hio_set_keepalive_timeout(io, 0);
+        if (hio_is_connected(io)) return io;
+        hio_close(io);
+    }
+    return NULL;
+}
+
+bool HttpUpstreamPool::Put(const std::string& addr, hio_t* io) {
+    std::deque<hio_t*>& ios = idles_[addr];
+    if (ios.size() >= max_idle || !hio_is_connected(io) || !hio_write_is_complete(io)) return false;
+    hevent_set_userdata(io, this);
+    hio_setcb_read(io, onIdleRead);
+    hio_setcb_write(io, NULL);
+    hio_setcb_close(io, onIdleClose);
+    hio_set_read_timeout(io, 0);
+    hio_set_write_timeout(io, 0);
+    if (idle_timeout > 0) {
+        hio_set_keepalive_timeout(io, idle_timeout);
+    }
+    // NOTE: read to know closed by peer
+    hio_read_start(io);
+    ios.push_back(io);
+    return true;
+}
+
+size_t HttpUpstreamPool::IdleNum() {
+    size_t num = 0;
+    for (auto& pair : idles_) {
+        num += pair.second.size();
+    }
+    return num;
+}
+
+void HttpUpstreamPool::remove(hio_t* io) {
+    for (auto iter = idles_.begin(); iter != idles_.end(); ++iter) {
+        std::deque<hio_t*>& ios = iter->second;
+        auto found = std::find(ios.begin(), ios.end(), io);
+        if (found != ios.end()) {
+            ios.erase(found);
+            return;
+        }
+    }
+}
+
+void HttpUpstreamPool::onIdleRead(hio_t* io, void* buf, int readbytes) {
+    // NOTE: no request, no response
+    (void)buf; (void)readbytes;
+    hio_close(io);
+}
+
+void HttpUpstreamPool::onIdleClose(hio_t* io) {
+    HttpUpstreamPool* pool = (HttpUpstreamPool*)hevent_userdata(io);
+    if (pool == NULL) return;
+    hevent_set_userdata(io, NULL);
+    pool->remove(io);
+}
+
+}
@@ -0,0 +1,219 @@
+#ifndef HV_ASYNC_HTTP_CLIENT_H_
+#define HV_ASYNC_HTTP_CLIENT_H_
+
+#include <map>
+#include <list>
+#include <set>
+
+#include "EventLoopThread.h"
+#include "Channel.h"
+
+#include "HttpMessage.h"
+#include "HttpParser.h"
+
+namespace hv {
+
+template<typename Conn>
+class ConnPool {
+public:
+    int size() {
+        return conns_.size();
+    }
+
+    bool get(Conn& conn) {
+        if (conns_.empty()) return false;
+        conn = conns_.front();
+        conns_.pop_front();
+        return true;
+    }
+
+    bool add(const Conn& conn) {
+        conns_.push_back(conn);
+        return true;
+    }
+
+    bool remove(const Conn& conn) {
+        auto iter = conns_.begin();
+        while (iter != conns_.end()) {
+            if (*iter == conn) {
+                iter = conns_.erase(iter);
+                return true;
+            } else {
+                ++iter;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::list<Conn>  conns_;
+};
+
+struct HttpClientTask {
+    HttpRequestPtr          req;
+    HttpResponseCallback    cb;
+    uint64_t                start_time;
+};
+typedef std::shared_ptr<HttpClientTask> HttpClientTaskPtr;
+
+struct HttpClientContext {
+    HttpClientTaskPtr   task;
+
+    HttpResponsePtr     resp;
+    HttpParserPtr       parser;
+    TimerID             timerID;
+
+    HttpClientContext() {
+        timerID = INVALID_TIMER_ID;
+    }
+
+    ~HttpClientContext() {
+        cancelTimer();
+    }
+
+    void cancelTimer() {
+        if (timerID != INVALID_TIMER_ID) {
+            killTimer(timerID);
+            timerID = INVALID_TIMER_ID;
+        }
+    }
+
+    void cancelTask() {
+        cancelTimer();
+        task = NULL;
+    }
+
+    void callback() {
+        cancelTimer();
+        if (task && task->cb) {
+            task->cb(resp);
+        }
+        // NOTE: task done
+        task = NULL;
+    }
+
+    void successCallback() {
+        callback();
+        resp = NULL;
+    }
+
+    void errorCallback() {
+        resp = NULL;
+        callback();
+    }
+};
+
+typedef std::shared_ptr<HttpClientContext> HttpClientContextPtr;
+
+// HTTP/2 connection, requests are multiplexed as streams
+struct Http2ClientContext {
+    // stream_id => HttpClientContext
+    std::map<int, HttpClientContextPtr> streams;
+    // NOTE: parser is deleted before streams
+    HttpParserPtr       parser;
+    uint64_t            recvbytes;
+    bool                connected;
+    // peer does not speak HTTP/2
+    bool                fallback;
+
+    Http2ClientContext() {
+        recvbytes = 0;
+        connected = false;
+        fallback = false;
+    }
+};
+
+class HV_EXPORT AsyncHttpClient : private EventLoopThread {
+public:
+    AsyncHttpClient(EventLoopPtr loop = NULL) : EventLoopThread(loop) {
+        if (loop == NULL) {
+            EventLoopThread::start(true);
+        }
+    }
+    ~AsyncHttpClient() {
+        // Stop (and, for an owned loop, free) the event loop. Any in-flight
+        // async DNS queries are owned by EventLoop::resolveDns and the C
+        // resolver, which are torn down with the loop; nothing to clean here.
+        EventLoopThread::stop(true);
+    }
+
+    // thread-safe
+    int send(const HttpRequestPtr& req, HttpResponseCallback resp_cb);
+    int send(const HttpClientTaskPtr& task) {
+        EventLoopThread::loop()->queueInLoop(std::bind(&AsyncHttpClient::sendInLoop, this, task));
+        return 0;
+    }
+
+protected:
+    void sendInLoop(HttpClientTaskPtr task) {
+        int err = doTask(task);
+        if (err != 0 && task->cb) {
+            task->cb(NULL);
+        }
+    }
+    int doTask(const HttpClientTaskPtr& task);
+
+    // @internal: continue doTask after the peer address is known.
+    int doTaskWithAddr(const HttpClientTaskPtr& task, const sockaddr_u* peeraddr);
+
+    static int sendRequest(const SocketChannelPtr& channel);
+
+    // redirect or callback
+    void onResponse(HttpClientContext* ctx);
+    // @return true if task is sent again
+    bool retryTask(const HttpClientTaskPtr& task);
+
+    // HTTP/2: request is sent as a stream of a connection to peeraddr,
+    // a new connection is made if all are busy with SETTINGS_MAX_CONCURRENT_STREAMS.
+    int doHttp2Task(const HttpClientTaskPtr& task, const sockaddr_u* peeraddr, int timeout_ms);
+    static void flushHttp2(const SocketChannelPtr& channel);
+
+    // channel
+    const SocketChannelPtr& getChannel(int fd) {
+        return channels[fd];
+        // return fd < channels.capacity() ? channels[fd] : NULL;
+    }
+
+    const SocketChannelPtr& addChannel(hio_t* io) {
+        auto channel = std::make_shared<SocketChannel>(io);
+        channel->newContext<HttpClientContext>();
+        int fd = channel->fd();
+        channels[fd] = channel;
+        return channels[fd];
+    }
+
+    void removeChannel(const SocketChannelPtr& channel) {
+        channel->deleteContext<HttpClientContext>();
+        int fd = channel->fd();
+        channels.erase(fd);
+    }
+
+    const SocketChannelPtr& addHttp2Channel(hio_t* io) {
+        auto channel = std::make_shared<SocketChannel>(io);
+        channel->newContext<Http2ClientContext>();
+        int fd = channel->fd();
+        channels[fd] = channel;
+        return channels[fd];
+    }
+
+    void removeHttp2Channel(const SocketChannelPtr& channel) {
+        channel->deleteContext<Http2ClientContext>();
+        int fd = channel->fd();
+        channels.erase(fd);
+    }
+
+private:
+    // NOTE: just one loop thread, no need mutex.
+    // fd => SocketChannelPtr
+    std::map<int, SocketChannelPtr>         channels;
+    // peeraddr => ConnPool
+    std::map<std::string, ConnPool<int>>    conn_pools;
+    // peeraddr => HTTP/2 connections, shared by requests
+    std::map<std::string, std::list<int>>   h2_conns;
+    // peeraddr not speaking HTTP/2, requests fallback to HTTP/1.1
+    std::set<std::string>                   h1_peers;
+};
+
+}
+
+#endif // HV_ASYNC_HTTP_CLIENT_H_
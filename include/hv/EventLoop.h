@@ -0,0 +1,477 @@
+#ifndef HV_EVENT_LOOP_HPP_
+#define HV_EVENT_LOOP_HPP_
+
+#include <functional>
+#include <atomic>
+#include <queue>
+#include <map>
+#include <mutex>
+
+#include "hloop.h"
+#include "hthread.h"
+
+#include "Status.h"
+#include "Event.h"
+#include "ThreadLocalStorage.h"
+
+// max Event nodes kept for reuse, by the loop and by each posting thread
+#define EVENT_LOOP_EVENT_POOL_SIZE  1024
+
+namespace hv {
+
+// EventLoop is a loop-bound wrapper around hloop_t.
+// When constructed with an external hloop_t, the caller remains responsible for that loop's lifetime.
+class EventLoop : public Status {
+public:
+
+    typedef std::function<void()> Functor;
+
+    // New an EventLoop using an existing hloop_t object,
+    // so we can embed an EventLoop object into the old application based on hloop.
+    // NOTE: Be careful to deal with destroy of hloop_t.
+    EventLoop(hloop_t* loop = NULL) {
+        setStatus(kInitializing);
+        if (loop) {
+            loop_ = loop;
+            is_loop_owner = false;
+        } else {
+            loop_ = hloop_new(HLOOP_FLAG_AUTO_FREE);
+            is_loop_owner = true;
+        }
+        connectionNum = 0;
+        nextTimerID = 0;
+        nextDnsID = 0;
+        pendingEvents = NULL;
+        runningEvents = NULL;
+        freeEvents = NULL;
+        recycledEvents = NULL;
+        nrecycledEvents = 0;
+        setStatus(kInitialized);
+    }
+
+    ~EventLoop() {
+        stop();
+        // events posted but not handled, and free events
+        deleteEvents(pendingEvents.exchange(NULL));
+        deleteEvents(runningEvents);
+        deleteEvents(freeEvents.exchange(NULL));
+        deleteEvents(recycledEvents);
+    }
+
+    hloop_t* loop() {
+        return loop_;
+    }
+
+    // @brief Run loop forever
+    void run() {
+        if (loop_ == NULL) return;
+        if (status() == kRunning) return;
+        ThreadLocalStorage::set(ThreadLocalStorage::EVENT_LOOP, this);
+        setStatus(kRunning);
+        hloop_run(loop_);
+        setStatus(kStopped);
+    }
+
+    // stop thread-safe
+    void stop() {
+        if (loop_ == NULL) return;
+        if (status() < kRunning) {
+            if (is_loop_owner) {
+                hloop_free(&loop_);
+            }
+            loop_ = NULL;
+            return;
+        }
+        setStatus(kStopping);
+        hloop_stop(loop_);
+        loop_ = NULL;
+    }
+
+    void pause() {
+        if (loop_ == NULL) return;
+        if (isRunning()) {
+            hloop_pause(loop_);
+            setStatus(kPause);
+        }
+    }
+
+    void resume() {
+        if (loop_ == NULL) return;
+        if (isPause()) {
+            hloop_resume(loop_);
+            setStatus(kRunning);
+        }
+    }
+
+    // Timer interfaces: setTimer, killTimer, resetTimer
+    TimerID setTimer(int timeout_ms, TimerCallback cb, uint32_t repeat = INFINITE, TimerID timerID = INVALID_TIMER_ID) {
+        if (loop_ == NULL) return INVALID_TIMER_ID;
+        assertInLoopThread();
+        htimer_t* htimer = htimer_add(loop_, onTimer, timeout_ms, repeat);
+        assert(htimer != NULL);
+        if (timerID == INVALID_TIMER_ID) {
+            timerID = generateTimerID();
+        }
+        hevent_set_id(htimer, timerID);
+        hevent_set_userdata(htimer, this);
+
+        timers[timerID] = std::make_shared<Timer>(htimer, cb, repeat);
+        return timerID;
+    }
+
+    // setTimerInLoop thread-safe
+    TimerID setTimerInLoop(int timeout_ms, TimerCallback cb, uint32_t repeat = INFINITE, TimerID timerID = INVALID_TIMER_ID) {
+        if (loop_ == NULL) return INVALID_TIMER_ID;
+        if (timerID == INVALID_TIMER_ID) {
+            timerID = generateTimerID();
+        }
+        runInLoop(std::bind(&EventLoop::setTimer, this, timeout_ms, cb, repeat, timerID));
+        return timerID;
+    }
+
+    // alias javascript setTimeout, setInterval
+    // setTimeout thread-safe
+    TimerID setTimeout(int timeout_ms, TimerCallback cb) {
+        return setTimerInLoop(timeout_ms, cb, 1);
+    }
+    // setInterval thread-safe
+    TimerID setInterval(int interval_ms, TimerCallback cb) {
+        return setTimerInLoop(interval_ms, cb, INFINITE);
+    }
+
+    // killTimer thread-safe
+    void killTimer(TimerID timerID) {
+        runInLoop([timerID, this](){
+            auto iter = timers.find(timerID);
+            if (iter != timers.end()) {
+                htimer_del(iter->second->timer);
+                timers.erase(iter);
+            }
+        });
+    }
+
+    // resetTimer thread-safe
+    void resetTimer(TimerID timerID, int timeout_ms = 0) {
+        runInLoop([timerID, timeout_ms, this](){
+            auto iter = timers.find(timerID);
+            if (iter != timers.end()) {
+                htimer_reset(iter->second->timer, timeout_ms);
+                if (iter->second->repeat == 0) {
+                    iter->second->repeat = 1;
+                }
+            }
+        });
+    }
+
+    long tid() {
+        if (loop_ == NULL) return hv_gettid();
+        return hloop_tid(loop_);
+    }
+
+    // @return accumulated busy time in us, see hloop_busy_time
+    uint64_t busyTime() {
+        if (loop_ == NULL) return 0;
+        return hloop_busy_time(loop_);
+    }
+
+    // Stats interfaces: enableStats, stats, resetStats, see hloop_stats
+    void enableStats(bool on = true) {
+        if (loop_ == NULL) return;
+        hloop_enable_stats(loop_, on);
+    }
+
+    // stats thread-safe, but fields may be inconsistent with each other.
+    hloop_stats_t stats() {
+        hloop_stats_t st;
+        memset(&st, 0, sizeof(st));
+        st.max_cb_fd = -1;
+        if (loop_) {
+            hloop_stats(loop_, &st);
+        }
+        return st;
+    }
+
+    // resetStats thread-safe
+    void resetStats() {
+        runInLoop([this]() {
+            if (loop_) hloop_reset_stats(loop_);
+        });
+    }
+
+    // DNS interfaces: resolveDns, cancelDns (mirror setTimer/killTimer).
+    // resolveDns returns a use-after-free-proof DnsID: the EventLoop keeps a
+    // DnsID -> DnsQuery map, and a stale id (completed/cancelled) makes
+    // cancelDns() a safe no-op. @cb runs in the loop thread.
+    // NOTE: must be called from the loop thread.
+    DnsID resolveDns(const char* host, DnsCallback cb, const hdns_setting_t* opt = NULL) {
+        if (loop_ == NULL) return INVALID_DNS_ID;
+        assertInLoopThread();
+        DnsID dnsID = generateDnsID();
+        hdns_t* q = hdns_resolve_ex(loop_, host, opt, onDnsResolved, this);
+        if (q == NULL) return INVALID_DNS_ID;
+        // stash the DnsID in the query's event_id so completion can find us.
+        hevent_set_id(q, dnsID);
+        dns_queries[dnsID] = std::make_shared<DnsQuery>(q, std::move(cb));
+        return dnsID;
+    }
+
+    // cancelDns thread-safe
+    void cancelDns(DnsID dnsID) {
+        runInLoop([dnsID, this]() {
+            auto iter = dns_queries.find(dnsID);
+            if (iter != dns_queries.end()) {
+                if (iter->second->query) hdns_cancel(iter->second->query);
+                dns_queries.erase(iter);
+            }
+        });
+    }
+
+    bool isInLoopThread() {
+        if (loop_ == NULL) return false;
+        return hv_gettid() == hloop_tid(loop_);
+    }
+
+    void assertInLoopThread() {
+        assert(isInLoopThread());
+    }
+
+    void runInLoop(Functor fn) {
+        if (isRunning() && isInLoopThread()) {
+            if (fn) fn();
+        } else {
+            queueInLoop(std::move(fn));
+        }
+    }
+
+    void queueInLoop(Functor fn) {
+        postEvent(std::bind(&EventLoop::invokeFunctor, std::move(fn)));
+    }
+
+    // postEvent thread-safe
+    // Events are pushed to a lock-free MPSC stack, only the first one after
+    // the loop took all of them posts an hevent to wakeup the loop,
+    // then onCustomEvents handles all of them in posted order.
+    // Event nodes handled are recycled by the loop, see allocEvent.
+    void postEvent(EventCallback cb) {
+        if (loop_ == NULL) return;
+
+        Event* ev = allocEvent();
+        ev->cb = std::move(cb);
+        ev->event.loop = loop_;
+        ev->event.event_type = HEVENT_TYPE_CUSTOM;
+        hevent_set_userdata(&ev->event, this);
+
+        Event* head = pendingEvents.load(std::memory_order_relaxed);
+        do {
+            ev->next = head;
+        } while (!pendingEvents.compare_exchange_weak(head, ev, std::memory_order_release, std::memory_order_relaxed));
+        if (head != NULL) return;
+
+        wakeup();
+    }
+
+private:
+    TimerID generateTimerID() {
+        return (((TimerID)tid() & 0xFFFFFFFF) << 32) | ++nextTimerID;
+    }
+
+    DnsID generateDnsID() {
+        // start at 1; 0 == INVALID_DNS_ID. 64-bit monotonic, never reused.
+        return ++nextDnsID;
+    }
+
+    static void onTimer(htimer_t* htimer) {
+        EventLoop* loop = (EventLoop*)hevent_userdata(htimer);
+
+        TimerID timerID = hevent_id(htimer);
+        TimerPtr timer = NULL;
+
+        auto iter = loop->timers.find(timerID);
+        if (iter != loop->timers.end()) {
+            timer = iter->second;
+            if (timer->repeat != INFINITE) --timer->repeat;
+        }
+
+        if (timer) {
+            if (timer->cb) timer->cb(timerID);
+            if (timer->repeat == 0) {
+                // htimer_t alloc and free by hloop, but timers[timerID] managed by EventLoop.
+                loop->timers.erase(timerID);
+            }
+        }
+    }
+
+    static void invokeFunctor(const Functor& fn) {
+        if (fn) fn();
+    }
+
+    void wakeup() {
+        hevent_t hev;
+        memset(&hev, 0, sizeof(hev));
+        hev.cb = onCustomEvents;
+        hevent_set_userdata(&hev, this);
+        hloop_post_event(loop_, &hev);
+    }
+
+    static void deleteEvents(Event* ev) {
+        while (ev) {
+            Event* next = ev->next;
+            delete ev;
+            ev = next;
+        }
+    }
+
+    // Event nodes free list, ABA-free without tagged pointers:
+    // the loop thread recycles nodes into recycledEvents, and publishes them to freeEvents
+    // only when it is empty, a posting thread takes all of freeEvents into its own cache.
+    struct EventCache {
+        Event*  head;
+        EventCache() : head(NULL) {}
+        ~EventCache() { deleteEvents(head); }
+    };
+
+    Event* allocEvent() {
+        static thread_local EventCache cache;
+        if (cache.head == NULL) {
+            cache.head = freeEvents.exchange(NULL, std::memory_order_acquire);
+        }
+        Event* ev = cache.head;
+        if (ev == NULL) {
+            return new Event;
+        }
+        cache.head = ev->next;
+        memset(&ev->event, 0, sizeof(hevent_t));
+        return ev;
+    }
+
+    // in loop thread
+    void recycleEvent(Event* ev) {
+        ev->cb = NULL;
+        if (nrecycledEvents >= EVENT_LOOP_EVENT_POOL_SIZE) {
+            delete ev;
+            return;
+        }
+        ev->next = recycledEvents;
+        recycledEvents = ev;
+        ++nrecycledEvents;
+    }
+
+    // in loop thread
+    void publishEvents() {
+        // NOTE: only the loop thread stores to freeEvents
+        if (recycledEvents && freeEvents.load(std::memory_order_relaxed) == NULL) {
+            freeEvents.store(recycledEvents, std::memory_order_release);
+            recycledEvents = NULL;
+            nrecycledEvents = 0;
+        }
+    }
+
+    static void onCustomEvents(hevent_t* hev) {
+        EventLoop* loop = (EventLoop*)hevent_userdata(hev);
+
+        // take all, LIFO => FIFO
+        Event* ev = loop->pendingEvents.exchange(NULL, std::memory_order_acquire);
+        Event* events = NULL;
+        while (ev) {
+            Event* next = ev->next;
+            ev->next = events;
+            events = ev;
+            ev = next;
+        }
+        // after the events left by a throwing callback
+        if (loop->runningEvents == NULL) {
+            loop->runningEvents = events;
+        } else {
+            Event* tail = loop->runningEvents;
+            while (tail->next) tail = tail->next;
+            tail->next = events;
+        }
+
+        while ((ev = loop->runningEvents) != NULL) {
+            loop->runningEvents = ev->next;
+            try {
+                if (ev->cb) ev->cb(ev);
+            } catch (...) {
+                loop->recycleEvent(ev);
+                loop->publishEvents();
+                // the rest are handled by the next wakeup
+                if (loop->runningEvents) loop->wakeup();
+                throw;
+            }
+            loop->recycleEvent(ev);
+        }
+        loop->publishEvents();
+    }
+
+    // C hdns completion callback (runs in loop thread). userdata == EventLoop*.
+    // The DnsID rode along in the query's event_id (set in resolveDns), so we
+    // recover it from the handle, deliver to the C++ callback, and erase the
+    // map entry. Erase BEFORE invoking the user callback so a re-entrant
+    // cancelDns() for this id safely no-ops. The hdns_t is freed by the C
+    // resolver right after this returns; we never touch it afterwards.
+    static void onDnsResolved(hdns_t* query, const hdns_result_t* result, void* userdata) {
+        EventLoop* loop = (EventLoop*)userdata;
+        DnsID dnsID = (DnsID)hevent_id(query);
+        auto iter = loop->dns_queries.find(dnsID);
+        if (iter == loop->dns_queries.end()) return;
+        DnsCallback cb = std::move(iter->second->cb);
+        loop->dns_queries.erase(iter);
+        if (cb) cb(result->status, result->naddrs, result->addrs);
+    }
+
+public:
+    std::atomic<uint32_t>       connectionNum;  // for LB_LeastConnections
+private:
+    hloop_t*                    loop_;
+    bool                        is_loop_owner;
+    std::atomic<Event*>         pendingEvents;  // lock-free MPSC stack, see postEvent
+    Event*                      runningEvents;  // taken from pendingEvents, in posted order
+    std::atomic<Event*>         freeEvents;     // published by the loop, taken by allocEvent
+    Event*                      recycledEvents; // to publish to freeEvents
+    int                         nrecycledEvents;
+    std::map<TimerID, TimerPtr> timers;
+    std::atomic<TimerID>        nextTimerID;
+    std::map<DnsID, DnsQueryPtr> dns_queries;
+    std::atomic<DnsID>          nextDnsID;
+};
+
+typedef std::shared_ptr<EventLoop> EventLoopPtr;
+
+// ThreadLocalStorage
+static inline EventLoop* tlsEventLoop() {
+    return (EventLoop*)ThreadLocalStorage::get(ThreadLocalStorage::EVENT_LOOP);
+}
+#define currentThreadEventLoop ::hv::tlsEventLoop()
+
+static inline TimerID setTimer(int timeout_ms, TimerCallback cb, uint32_t repeat = INFINITE) {
+    EventLoop* loop = tlsEventLoop();
+    assert(loop != NULL);
+    if (loop == NULL) return INVALID_TIMER_ID;
+    return loop->setTimer(timeout_ms, cb, repeat);
+}
+
+static inline void killTimer(TimerID timerID) {
+    EventLoop* loop = tlsEventLoop();
+    assert(loop != NULL);
+    if (loop == NULL) return;
+    loop->killTimer(timerID);
+}
+
+static inline void resetTimer(TimerID timerID, int timeout_ms) {
+    EventLoop* loop = tlsEventLoop();
+    assert(loop != NULL);
+    if (loop == NULL) return;
+    loop->resetTimer(timerID, timeout_ms);
+}
+
+static inline TimerID setTimeout(int timeout_ms, TimerCallback cb) {
+    return setTimer(timeout_ms, cb, 1);
+}
+
+static inline TimerID setInterval(int interval_ms, TimerCallback cb) {
+    return setTimer(interval_ms, cb, INFINITE);
+}
+
+}
+
+#endif // HV_EVENT_LOOP_HPP_
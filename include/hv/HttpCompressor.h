@@ -0,0 +1,64 @@
+#ifndef HV_HTTP_COMPRESSOR_H_
+#define HV_HTTP_COMPRESSOR_H_
+
+/*
+ * Content-Encoding negotiation and streaming compression.
+ * precompressed: .br .zst .gz files are served as is, no library needed.
+ * on the fly:    gzip if WITH_ZLIB.
+ */
+
+#include <string>
+
+#include "hexport.h"
+
+// NOTE: bits, ordered by preference
+enum http_content_encoding {
+    HTTP_ENCODING_IDENTITY  = 0,
+    HTTP_ENCODING_BR        = 0x01,
+    HTTP_ENCODING_ZSTD      = 0x02,
+    HTTP_ENCODING_GZIP      = 0x04,
+};
+#define HTTP_ENCODINGS_NUM  3
+
+// @return bits of encodings accepted by Accept-Encoding
+HV_EXPORT int http_accept_encodings(const char* accept_encoding);
+// br, zstd, gzip
+HV_EXPORT const char* http_encoding_str(int encoding);
+// .br, .zst, .gz
+HV_EXPORT const char* http_encoding_suffix(int encoding);
+// 0, 1, 2
+HV_EXPORT int http_encoding_index(int encoding);
+// text/*, json, javascript, xml, svg ...
+HV_EXPORT bool http_content_compressible(const char* content_type);
+
+namespace hv {
+
+class HV_EXPORT HttpCompressor {
+public:
+    HttpCompressor();
+    ~HttpCompressor();
+
+    // @return bits of encodings can be compressed on the fly
+    static int Supported();
+
+    // @param level: -1 default
+    // @retval 0 OK, -1 unsupported
+    int Init(int encoding, int level = -1);
+    // @param flush: output all compressed so far, for streaming
+    // @retval 0 OK, <0 error
+    int Compress(const char* data, size_t len, std::string& out, bool flush = false);
+    int Finish(std::string& out);
+
+    int Encoding() { return encoding_; }
+
+    // @retval 0 OK, -1 unsupported or error
+    static int Compress(int encoding, const char* data, size_t len, std::string& out);
+
+private:
+    int     encoding_;
+    void*   stream_;
+};
+
+}
+
+#endif // HV_HTTP_COMPRESSOR_H_
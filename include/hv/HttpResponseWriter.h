@@ -0,0 +1,119 @@
+#ifndef HV_HTTP_RESPONSE_WRITER_H_
+#define HV_HTTP_RESPONSE_WRITER_H_
+
+#include "Channel.h"
+#include "HttpMessage.h"
+
+namespace hv {
+
+class HttpCompressor;
+
+class HV_EXPORT HttpResponseWriter : public SocketChannel {
+public:
+    HttpResponsePtr response;
+    enum State {
+        SEND_BEGIN = 0,
+        SEND_HEADER,
+        SEND_BODY,
+        SEND_CHUNKED,
+        SEND_CHUNKED_END,
+        SEND_END,
+    } state: 8, end: 8;
+    // NOTE: HTTP/2 stream writes through Http2Parser instead of io, see HttpHandler.
+    // headers of response are submitted at the first call, with response->body if any.
+    std::function<int(const char* buf, int len, bool end)> stream_write;
+    // streaming compression, see EnableCompression
+    std::shared_ptr<HttpCompressor> compressor;
+    HttpResponseWriter(hio_t* io, const HttpResponsePtr& resp)
+        : SocketChannel(io)
+        , response(resp)
+        , state(SEND_BEGIN)
+        , end(SEND_BEGIN)
+    {}
+    ~HttpResponseWriter() {}
+
+    // Begin -> End
+    // Begin -> WriteResponse -> End
+    // Begin -> WriteStatus -> WriteHeader -> WriteBody -> End
+    // Begin -> EndHeaders("Content-Type", "text/event-stream") -> write -> write -> ... -> close
+    // Begin -> EndHeaders("Content-Length", content_length) -> WriteBody -> WriteBody -> ... -> End
+    // Begin -> EndHeaders("Transfer-Encoding", "chunked") -> WriteChunked -> WriteChunked -> ... -> End
+
+    int Begin() {
+        state = end = SEND_BEGIN;
+        compressor.reset();
+        return 0;
+    }
+
+    int WriteStatus(http_status status_codes) {
+        response->status_code = status_codes;
+        return 0;
+    }
+
+    int WriteHeader(const char* key, const char* value) {
+        response->SetHeader(key, value);
+        return 0;
+    }
+
+    template<typename T>
+    int WriteHeader(const char* key, T num) {
+        response->SetHeader(key, hv::to_string(num));
+        return 0;
+    }
+
+    int WriteCookie(const HttpCookie& cookie) {
+        response->cookies.push_back(cookie);
+        return 0;
+    }
+
+    // NOTE: call before EndHeaders, body is compressed by Content-Encoding negotiated with
+    // Accept-Encoding and flushed per write, HTTP/1 body is sent chunked without Content-Length.
+    // @retval 0 OK, -1 not acceptable or unsupported, send as is.
+    int EnableCompression(const char* accept_encoding, int level = -1);
+
+    int EndHeaders(const char* key = NULL, const char* value = NULL);
+
+    template<typename T>
+    int EndHeaders(const char* key, T num) {
+        std::string value = hv::to_string(num);
+        return EndHeaders(key, value.c_str());
+    }
+
+    int WriteChunked(const char* buf, int len = -1);
+
+    int WriteChunked(const std::string& str) {
+        return WriteChunked(str.c_str(), str.size());
+    }
+
+    int EndChunked() {
+        return WriteChunked(NULL, 0);
+    }
+
+    int WriteBody(const char* buf, int len = -1);
+
+    int WriteBody(const std::string& str) {
+        return WriteBody(str.c_str(), str.size());
+    }
+
+    // NOTE: send [offset, offset + length) of file fd as body, headers first if not sent.
+    int SendFile(int fd, size_t offset, size_t length);
+
+    int WriteResponse(HttpResponse* resp);
+
+    int SSEvent(const std::string& data, const char* event = "message");
+
+    int End(const char* buf = NULL, int len = -1);
+
+    int End(const std::string& str) {
+        return End(str.c_str(), str.size());
+    }
+
+private:
+    int writeChunked(const char* buf, int len);
+};
+
+}
+
+typedef std::shared_ptr<hv::HttpResponseWriter> HttpResponseWriterPtr;
+
+#endif // HV_HTTP_RESPONSE_WRITER_H_
@@ -0,0 +1,338 @@
+#ifndef HV_HTTP_SERVICE_H_
+#define HV_HTTP_SERVICE_H_
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <list>
+#include <memory>
+#include <functional>
+
+#include "hexport.h"
+#include "HttpMessage.h"
+#include "HttpResponseWriter.h"
+#include "HttpContext.h"
+#include "HttpUpstream.h"
+
+#define DEFAULT_BASE_URL        "/api/v1"
+#define DEFAULT_DOCUMENT_ROOT   "/var/www/html"
+#define DEFAULT_HOME_PAGE       "index.html"
+#define DEFAULT_ERROR_PAGE      "error.html"
+#define DEFAULT_INDEXOF_DIR     "/downloads/"
+#define DEFAULT_KEEPALIVE_TIMEOUT   75000   // ms
+
+// for FileCache
+#define MAX_FILE_CACHE_SIZE                 (1 << 22)   // 4M
+#define DEFAULT_FILE_CACHE_STAT_INTERVAL    10          // s
+#define DEFAULT_FILE_CACHE_EXPIRED_TIME     60          // s
+#define DEFAULT_FILE_CACHE_CAPACITY         (1 << 28)   // 256M
+#define DEFAULT_COMPRESSION_MIN_LENGTH      1024        // 1K
+
+// for proxy
+#define DEFAULT_PROXY_KEEPALIVE             32          // idle connections per upstream server per worker
+#define DEFAULT_PROXY_KEEPALIVE_TIMEOUT     60000       // ms
+
+/*
+ * @param[in]  req:  parsed structured http request
+ * @param[out] resp: structured http response
+ * @return  HTTP_STATUS_NEXT:       handle next
+ *          HTTP_STATUS_CLOSE:      close connection
+ *          http_status_code:       handle done
+ */
+#define HTTP_STATUS_NEXT        0
+#define HTTP_STATUS_UNFINISHED  0
+#define HTTP_STATUS_CLOSE       -100
+// NOTE: http_sync_handler run on IO thread
+typedef std::function<int(HttpRequest* req, HttpResponse* resp)>                            http_sync_handler;
+// NOTE: http_async_handler run on hv::async threadpool
+typedef std::function<void(const HttpRequestPtr& req, const HttpResponseWriterPtr& writer)> http_async_handler;
+// NOTE: http_ctx_handler run on IO thread, you can easily post HttpContextPtr to your consumer thread for processing.
+typedef std::function<int(const HttpContextPtr& ctx)>                                       http_ctx_handler;
+// NOTE: http_state_handler run on IO thread
+typedef std::function<int(const HttpContextPtr& ctx, http_parser_state state, const char* data, size_t size)> http_state_handler;
+
+struct http_handler {
+    http_sync_handler   sync_handler;
+    http_async_handler  async_handler;
+    http_ctx_handler    ctx_handler;
+    http_state_handler  state_handler;
+
+    http_handler()  {}
+    http_handler(http_sync_handler fn)  : sync_handler(std::move(fn))   {}
+    http_handler(http_async_handler fn) : async_handler(std::move(fn))  {}
+    http_handler(http_ctx_handler fn)   : ctx_handler(std::move(fn))    {}
+    http_handler(http_state_handler fn) : state_handler(std::move(fn))  {}
+    http_handler(const http_handler& rhs)
+        : sync_handler(std::move(const_cast<http_handler&>(rhs).sync_handler))
+        , async_handler(std::move(const_cast<http_handler&>(rhs).async_handler))
+        , ctx_handler(std::move(const_cast<http_handler&>(rhs).ctx_handler))
+        , state_handler(std::move(const_cast<http_handler&>(rhs).state_handler))
+    {}
+
+    const http_handler& operator=(http_sync_handler fn) {
+        sync_handler = std::move(fn);
+        return *this;
+    }
+    const http_handler& operator=(http_async_handler fn) {
+        async_handler = std::move(fn);
+        return *this;
+    }
+    const http_handler& operator=(http_ctx_handler fn) {
+        ctx_handler = std::move(fn);
+        return *this;
+    }
+    const http_handler& operator=(http_state_handler fn) {
+        state_handler = std::move(fn);
+        return *this;
+    }
+
+    bool isNull() {
+        return  sync_handler == NULL &&
+                async_handler == NULL &&
+                ctx_handler == NULL;
+    }
+
+    operator bool() {
+        return !isNull();
+    }
+};
+
+typedef std::vector<http_handler>   http_handlers;
+
+struct http_method_handler {
+    http_method         method;
+    http_handler        handler;
+
+    http_method_handler()   {}
+    http_method_handler(http_method m, const http_handler& h) : method(m), handler(h) {}
+};
+
+// method => http_method_handler
+typedef std::list<http_method_handler>                              http_method_handlers;
+typedef std::shared_ptr<http_method_handlers>                       http_method_handlers_ptr;
+// path   => http_method_handlers
+typedef std::unordered_map<std::string, http_method_handlers_ptr>   http_path_handlers;
+
+namespace hv {
+
+template<typename Handler>
+class HttpRouter;
+
+typedef HttpRouter<http_method_handlers_ptr> http_router;
+
+struct HV_EXPORT HttpService {
+    /* handler chain */
+    // headerHandler -> preprocessor -> middleware -> processor -> postprocessor
+    http_handler        headerHandler;
+    http_handler        preprocessor;
+    http_handlers       middleware;
+    // processor: router -> staticHandler -> errorHandler
+    http_handler        processor;
+    http_handler        postprocessor;
+
+    /* API handlers */
+    std::string                     base_url;
+    std::shared_ptr<http_router>    router;
+
+    /* Static file service */
+    http_handler    staticHandler;
+    http_handler    largeFileHandler;
+    std::string     document_root;
+    std::string     home_page;
+    std::string     error_page;
+    // nginx: location => root
+    std::map<std::string, std::string, std::greater<std::string>> staticDirs;
+    /* Indexof directory service */
+    std::string     index_of;
+    http_handler    errorHandler;
+
+    /* Proxy service */
+    /* Reverse proxy service */
+    // nginx: location => proxy_pass
+    std::map<std::string, std::string, std::greater<std::string>> proxies;
+    // nginx: upstream name { server ...; } => proxy_pass http://name/
+    std::map<std::string, HttpUpstreamGroupPtr> upstreams;
+    /* Forward proxy service */
+    StringList  trustProxies;
+    StringList  noProxies;
+    int proxy_connect_timeout;
+    int proxy_read_timeout;
+    int proxy_write_timeout;
+    /*
+     * Reverse proxy connections to upstream servers are kept alive and shared
+     * by all client connections of a worker, at most proxy_keepalive idle ones
+     * per upstream server, closed after idle proxy_keepalive_timeout.
+     * 0 to close upstream connections after each response.
+     */
+    int proxy_keepalive;
+    int proxy_keepalive_timeout;
+
+    // options
+    int keepalive_timeout;
+    int max_file_cache_size;        // cache small file
+    int file_cache_stat_interval;   // stat file is modified
+    int file_cache_expired_time;    // remove expired file cache
+    size_t file_cache_capacity;     // bytes of all cached files
+    /*
+     * @test    limit_rate
+     * @build   make examples
+     * @server  bin/httpd -c etc/httpd.conf -s restart -d
+     * @client  bin/wget http://127.0.0.1:8080/downloads/test.zip
+     */
+    int limit_rate; // limit send rate, unit: KB/s
+    int compression_min_length; // compress body if >= min length
+    /*
+     * Request body larger than body_spill_size is written to a temporary file in upload_dir
+     * instead of req->body, see HttpMessage::body_file, multipart/form-data files to
+     * a temporary file per part, see FormData::filepath, 0 to keep all in memory.
+     * NOTE: http_state_handler receives body as it arrives, nothing is spilled.
+     */
+    size_t body_spill_size;
+    std::string upload_dir; // default: get_temp_dir
+
+    unsigned enable_access_log      :1;
+    unsigned enable_forward_proxy   :1;
+    // serve precompressed filepath.br .zst .gz by Accept-Encoding
+    unsigned enable_precompressed   :1;
+    // gzip static files and responses on the fly, need WITH_ZLIB
+    // NOTE: responses sent by writer are compressed only if writer->EnableCompression
+    unsigned enable_compression     :1;
+
+    HttpService() {
+        // base_url = DEFAULT_BASE_URL;
+
+        document_root = DEFAULT_DOCUMENT_ROOT;
+        home_page = DEFAULT_HOME_PAGE;
+        // error_page = DEFAULT_ERROR_PAGE;
+        // index_of = DEFAULT_INDEXOF_DIR;
+
+        proxy_connect_timeout = DEFAULT_CONNECT_TIMEOUT;
+        proxy_read_timeout = 0;
+        proxy_write_timeout = 0;
+        proxy_keepalive = DEFAULT_PROXY_KEEPALIVE;
+        proxy_keepalive_timeout = DEFAULT_PROXY_KEEPALIVE_TIMEOUT;
+
+        keepalive_timeout = DEFAULT_KEEPALIVE_TIMEOUT;
+        max_file_cache_size = MAX_FILE_CACHE_SIZE;
+        file_cache_stat_interval = DEFAULT_FILE_CACHE_STAT_INTERVAL;
+        file_cache_expired_time = DEFAULT_FILE_CACHE_EXPIRED_TIME;
+        file_cache_capacity = DEFAULT_FILE_CACHE_CAPACITY;
+        limit_rate = -1; // unlimited
+        compression_min_length = DEFAULT_COMPRESSION_MIN_LENGTH;
+        body_spill_size = 0;
+        char temp_dir[MAX_PATH] = {0};
+        if (get_temp_dir(temp_dir, sizeof(temp_dir))) {
+            upload_dir = temp_dir;
+        }
+
+        enable_access_log = 1;
+        enable_forward_proxy = 0;
+        enable_precompressed = 0;
+        enable_compression = 0;
+    }
+
+    // router interface
+    void AddRoute(const char* path, http_method method, const http_handler& handler);
+    // @param[in] full_path: {base_url}/path?query
+    // @param[out] params: RESTful API /:field/ => params["field"]
+    // @retval 0 OK, else HTTP_STATUS_NOT_FOUND, HTTP_STATUS_METHOD_NOT_ALLOWED
+    int  GetRoute(const char* full_path, http_method method, http_handler** handler, std::map<std::string, std::string>& params);
+    // @override GetRoute(req->path.c_str(), req->method, handler, req->query_params);
+    int  GetRoute(HttpRequest* req, http_handler** handler);
+    bool HasRoutes() const;
+    // compile routes, called by http_server_run before workers start
+    void FreezeRoutes();
+    hv::StringList Paths() const;
+
+    // Static("/", "/var/www/html")
+    void Static(const char* path, const char* dir);
+    // @retval / => /var/www/html/index.html
+    std::string GetStaticFilepath(const char* path);
+
+    // https://developer.mozilla.org/en-US/docs/Web/HTTP/CORS
+    void AllowCORS();
+
+    // proxy
+    // forward proxy
+    void EnableForwardProxy() { enable_forward_proxy = 1; }
+    void AddTrustProxy(const char* host);
+    void AddNoProxy(const char* host);
+    bool IsTrustProxy(const char* host);
+    // reverse proxy
+    // Proxy("/api/v1/", "http://www.httpbin.org/");
+    // NOTE: HTTP2 requests of proxy routes are answered with 502 Bad Gateway.
+    void Proxy(const char* path, const char* url);
+    // @retval /api/v1/test => http://www.httpbin.org/test
+    std::string GetProxyUrl(const char* path);
+    // Upstream("backend", LB_LeastConnections)->AddServer("127.0.0.1:8001");
+    // Proxy("/api/v1/", "http://backend/");
+    HttpUpstreamGroup* Upstream(const char* name, load_balance_e lb = LB_RoundRobin);
+    // @retval NULL if host is not an upstream group
+    HttpUpstreamGroup* GetUpstream(const std::string& host);
+
+    // Handler = [ http_sync_handler, http_ctx_handler ]
+    template<typename Handler>
+    void Use(Handler handlerFunc) {
+        middleware.emplace_back(handlerFunc);
+    }
+
+    // Inspired by github.com/gin-gonic/gin
+    // Handler = [ http_sync_handler, http_async_handler, http_ctx_handler, http_state_handler ]
+    template<typename Handler>
+    void Handle(const char* httpMethod, const char* relativePath, Handler handlerFunc) {
+        AddRoute(relativePath, http_method_enum(httpMethod), http_handler(handlerFunc));
+    }
+
+    // HEAD
+    template<typename Handler>
+    void HEAD(const char* relativePath, Handler handlerFunc) {
+        Handle("HEAD", relativePath, handlerFunc);
+    }
+
+    // GET
+    template<typename Handler>
+    void GET(const char* relativePath, Handler handlerFunc) {
+        Handle("GET", relativePath, handlerFunc);
+    }
+
+    // POST
+    template<typename Handler>
+    void POST(const char* relativePath, Handler handlerFunc) {
+        Handle("POST", relativePath, handlerFunc);
+    }
+
+    // PUT
+    template<typename Handler>
+    void PUT(const char* relativePath, Handler handlerFunc) {
+        Handle("PUT", relativePath, handlerFunc);
+    }
+
+    // DELETE
+    // NOTE: Windows <winnt.h> #define DELETE as a macro, we have to replace DELETE with Delete.
+    template<typename Handler>
+    void Delete(const char* relativePath, Handler handlerFunc) {
+        Handle("DELETE", relativePath, handlerFunc);
+    }
+
+    // PATCH
+    template<typename Handler>
+    void PATCH(const char* relativePath, Handler handlerFunc) {
+        Handle("PATCH", relativePath, handlerFunc);
+    }
+
+    // Any
+    template<typename Handler>
+    void Any(const char* relativePath, Handler handlerFunc) {
+        Handle("HEAD", relativePath, handlerFunc);
+        Handle("GET", relativePath, handlerFunc);
+        Handle("POST", relativePath, handlerFunc);
+        Handle("PUT", relativePath, handlerFunc);
+        Handle("DELETE", relativePath, handlerFunc);
+        Handle("PATCH", relativePath, handlerFunc);
+    }
+};
+
+}
+
+#endif // HV_HTTP_SERVICE_H_
@@ -0,0 +1,128 @@
+#ifndef HV_HTTP_UPSTREAM_H_
+#define HV_HTTP_UPSTREAM_H_
+
+/*
+ * Upstream groups of reverse proxy,
+ * nginx: upstream name { server host:port weight=1 max_fails=1 fail_timeout=10s; }
+ *
+ * HttpUpstreamGroup: servers shared by all workers, selected by load_balance_e:
+ * LB_RoundRobin:           smooth weighted round-robin
+ * LB_Random:               weighted random
+ * LB_LeastConnections:     least requests in progress per weight
+ * LB_IpHash, LB_UrlHash:   consistent hash of client ip, url path
+ * A server failed max_fails times in fail_timeout is not selected for fail_timeout,
+ * unless all servers of the group are.
+ *
+ * HttpUpstreamPool: idle keepalive connections to upstream servers per event loop,
+ * shared by all client connections of the loop.
+ */
+
+#include <time.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "hexport.h"
+#include "hloop.h"
+
+#define DEFAULT_UPSTREAM_MAX_FAILS      1
+#define DEFAULT_UPSTREAM_FAIL_TIMEOUT   10  // s
+// virtual nodes per weight on the hash ring
+#define UPSTREAM_HASH_POINTS            160
+
+namespace hv {
+
+struct HV_EXPORT HttpUpstreamServer {
+    std::string     host;
+    int             port;
+    int             https;
+    int             weight;
+    int             max_fails;      // 0 to never mark down
+    int             fail_timeout;   // unit: s
+
+    // GUARDED_BY(HttpUpstreamGroup::mutex_)
+    int             current_weight; // LB_RoundRobin
+    int             conns;          // LB_LeastConnections
+    int             fails;
+    time_t          fail_time;      // of last fail
+
+    // key of HttpUpstreamPool: http[s]://host:port
+    std::string     addr;
+};
+
+class HV_EXPORT HttpUpstreamGroup {
+public:
+    std::string     name;
+    load_balance_e  lb;
+
+    HttpUpstreamGroup(const std::string& name = "", load_balance_e lb = LB_RoundRobin)
+        : name(name), lb(lb), rr_index_(0) {}
+
+    // AddServer("127.0.0.1:8080"), AddServer("https://www.example.com", 2)
+    // NOTE: add servers before server started
+    void AddServer(const std::string& url, int weight = 1,
+                   int max_fails = DEFAULT_UPSTREAM_MAX_FAILS,
+                   int fail_timeout = DEFAULT_UPSTREAM_FAIL_TIMEOUT);
+    size_t Size();
+
+    /*
+     * @param key: client ip of LB_IpHash, url path of LB_UrlHash
+     * @param tried: servers failed for this request, not selected again
+     * @retval NULL if no server available
+     * NOTE: Release the selected server when the request is done.
+     */
+    HttpUpstreamServer* Select(const char* key, const std::vector<HttpUpstreamServer*>* tried = NULL);
+    // @param failed: connect/read failed or timed out
+    void Release(HttpUpstreamServer* server, bool failed);
+
+private:
+    bool available(HttpUpstreamServer* server, time_t now, const std::vector<HttpUpstreamServer*>* tried);
+    HttpUpstreamServer* selectRoundRobin(time_t now, const std::vector<HttpUpstreamServer*>* tried);
+    HttpUpstreamServer* selectRandom(time_t now, const std::vector<HttpUpstreamServer*>* tried);
+    HttpUpstreamServer* selectLeastConnections(time_t now, const std::vector<HttpUpstreamServer*>* tried);
+    HttpUpstreamServer* selectHash(const char* key, time_t now, const std::vector<HttpUpstreamServer*>* tried);
+
+    std::mutex                          mutex_;
+    // NOTE: std::deque keeps references on push_back
+    std::deque<HttpUpstreamServer>      servers_;
+    // sorted (hash, server) of LB_IpHash, LB_UrlHash
+    std::vector<std::pair<uint32_t, HttpUpstreamServer*>> ring_;
+    size_t                              rr_index_;
+};
+
+typedef std::shared_ptr<HttpUpstreamGroup> HttpUpstreamGroupPtr;
+
+/*
+ * NOTE: not thread-safe, used in loop thread only.
+ * Idle connections are closed on data received, peer closed, idle_timeout.
+ */
+class HV_EXPORT HttpUpstreamPool {
+public:
+    size_t  max_idle;       // per server, 0 to close connections after response
+    int     idle_timeout;   // unit: ms
+
+    HttpUpstreamPool() : max_idle(0), idle_timeout(0) {}
+    ~HttpUpstreamPool();
+
+    // @retval connected io of addr, callbacks and timeouts cleared, NULL if none
+    hio_t* Get(const std::string& addr);
+    // @retval false if full, caller closes io
+    bool   Put(const std::string& addr, hio_t* io);
+
+    size_t IdleNum();
+
+private:
+    void remove(hio_t* io);
+    static void onIdleRead(hio_t* io, void* buf, int readbytes);
+    static void onIdleClose(hio_t* io);
+
+    std::map<std::string, std::deque<hio_t*>> idles_;
+};
+
+}
+
+#endif // HV_HTTP_UPSTREAM_H_
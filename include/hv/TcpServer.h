@@ -0,0 +1,410 @@
+#ifndef HV_TCP_SERVER_HPP_
+#define HV_TCP_SERVER_HPP_
+
+#include "hsocket.h"
+#include "hssl.h"
+#include "hlog.h"
+
+#include "EventLoopThreadPool.h"
+#include "Channel.h"
+
+namespace hv {
+
+template<class TSocketChannel = SocketChannel>
+// TcpServerEventLoopTmpl is a loop-bound wrapper around one listening socket and its accepted channels.
+// When an external EventLoopPtr is supplied, the caller remains responsible for owner-loop shutdown and destruction ordering.
+class TcpServerEventLoopTmpl {
+public:
+    typedef std::shared_ptr<TSocketChannel> TSocketChannelPtr;
+
+    TcpServerEventLoopTmpl(EventLoopPtr loop = NULL) {
+        acceptor_loop = loop ? loop : std::make_shared<EventLoop>();
+        port = 0;
+        listenfd = -1;
+        tls = false;
+        tls_setting = NULL;
+        unpack_setting = NULL;
+        max_connections = 0xFFFFFFFF;
+        load_balance = LB_RoundRobin;
+        rebalance_interval = 0;
+        rebalance_threshold = 0;
+        rebalance_max_migrations = 0;
+        rebalance_timer = INVALID_TIMER_ID;
+    }
+
+    virtual ~TcpServerEventLoopTmpl() {
+        HV_FREE(tls_setting);
+        HV_FREE(unpack_setting);
+    }
+
+    EventLoopPtr loop(int idx = -1) {
+        EventLoopPtr worker_loop = worker_threads.loop(idx);
+        if (worker_loop == NULL) {
+            worker_loop = acceptor_loop;
+        }
+        return worker_loop;
+    }
+
+    //@retval >=0 listenfd, <0 error
+    int createsocket(int port, const char* host = "0.0.0.0") {
+        listenfd = Listen(port, host);
+        if (listenfd < 0) return listenfd;
+        this->host = host;
+        this->port = port;
+        return listenfd;
+    }
+    // closesocket thread-safe
+    void closesocket() {
+        if (listenfd >= 0) {
+            hloop_t* loop = acceptor_loop->loop();
+            if (loop) {
+                hio_t* listenio = hio_get(loop, listenfd);
+                assert(listenio != NULL);
+                hio_close_async(listenio);
+            }
+            listenfd = -1;
+        }
+    }
+
+    void setMaxConnectionNum(uint32_t num) {
+        max_connections = num;
+    }
+
+    void setLoadBalance(load_balance_e lb) {
+        load_balance = lb;
+    }
+
+    // @brief Every interval_ms, if busy percent of the busiest worker loop exceeds the idlest one by threshold,
+    // migrate at most max_migrations idle channels between them, see Channel::migrate.
+    // NOTE: call before start, interval_ms <= 0 means disable.
+    // Not with io_uring, see hio_migrate. HttpServer and WebSocketServer have no rebalance,
+    // their HttpHandler is bound to the HttpMessagePool and HttpUpstreamPool of its worker loop.
+    void setRebalance(int interval_ms, int threshold = 20, int max_migrations = 64) {
+        rebalance_interval = interval_ms;
+        rebalance_threshold = threshold;
+        rebalance_max_migrations = max_migrations;
+    }
+
+    // NOTE: totalThreadNum = 1 acceptor_thread + N worker_threads (N can be 0)
+    void setThreadNum(int num) {
+        worker_threads.setThreadNum(num);
+    }
+
+    int startAccept() {
+        acceptor_loop->assertInLoopThread();
+        if (listenfd < 0) {
+            listenfd = createsocket(port, host.c_str());
+            if (listenfd < 0) {
+                hloge("createsocket %s:%d return %d!\n", host.c_str(), port, listenfd);
+                return listenfd;
+            }
+        }
+        hloop_t* loop = acceptor_loop->loop();
+        if (loop == NULL) return -2;
+        hio_t* listenio = haccept(loop, listenfd, onAccept);
+        assert(listenio != NULL);
+        hevent_set_userdata(listenio, this);
+        if (tls) {
+            hio_enable_ssl(listenio);
+            if (tls_setting) {
+                int ret = hio_new_ssl_ctx(listenio, tls_setting);
+                if (ret != 0) {
+                    hloge("new SSL_CTX failed: %d", ret);
+                    closesocket();
+                    return ret;
+                }
+            }
+        }
+        return 0;
+    }
+
+    int stopAccept() {
+        acceptor_loop->assertInLoopThread();
+        if (listenfd < 0) return -1;
+        hloop_t* loop = acceptor_loop->loop();
+        if (loop == NULL) return -2;
+        hio_t* listenio = hio_get(loop, listenfd);
+        assert(listenio != NULL);
+        return hio_del(listenio, HV_READ);
+    }
+
+    // start thread-safe
+    void start(bool wait_threads_started = true) {
+        if (worker_threads.threadNum() > 0) {
+            worker_threads.start(wait_threads_started);
+        }
+        acceptor_loop->runInLoop(std::bind(&TcpServerEventLoopTmpl::startAccept, this));
+        if (rebalance_interval > 0 && worker_threads.threadNum() > 1 && rebalance_timer == INVALID_TIMER_ID) {
+            rebalance_timer = acceptor_loop->setInterval(rebalance_interval, [this](TimerID) {
+                rebalance();
+            });
+        }
+    }
+    // stop thread-safe
+    // NOTE: When an external loop is supplied, this closes the listener but does not own that loop's lifetime.
+    void stop(bool wait_threads_stopped = true) {
+        if (rebalance_timer != INVALID_TIMER_ID) {
+            acceptor_loop->killTimer(rebalance_timer);
+            rebalance_timer = INVALID_TIMER_ID;
+        }
+        closesocket();
+        if (worker_threads.threadNum() > 0) {
+            worker_threads.stop(wait_threads_stopped);
+        }
+    }
+
+    int withTLS(hssl_ctx_opt_t* opt = NULL) {
+        tls = true;
+        if (opt) {
+            if (tls_setting == NULL) {
+                HV_ALLOC_SIZEOF(tls_setting);
+            }
+            opt->endpoint = HSSL_SERVER;
+            *tls_setting = *opt;
+        }
+        return 0;
+    }
+
+    void setUnpack(unpack_setting_t* setting) {
+        if (setting == NULL) {
+            HV_FREE(unpack_setting);
+            return;
+        }
+        if (unpack_setting == NULL) {
+            HV_ALLOC_SIZEOF(unpack_setting);
+        }
+        *unpack_setting = *setting;
+    }
+
+    // channel
+    const TSocketChannelPtr& addChannel(hio_t* io) {
+        uint32_t id = hio_id(io);
+        auto channel = std::make_shared<TSocketChannel>(io);
+        std::lock_guard<std::mutex> locker(mutex_);
+        channels[id] = channel;
+        return channels[id];
+    }
+
+    TSocketChannelPtr getChannelById(uint32_t id) {
+        std::lock_guard<std::mutex> locker(mutex_);
+        auto iter = channels.find(id);
+        return iter != channels.end() ? iter->second : NULL;
+    }
+
+    void removeChannel(const TSocketChannelPtr& channel) {
+        uint32_t id = channel->id();
+        std::lock_guard<std::mutex> locker(mutex_);
+        channels.erase(id);
+    }
+
+    size_t connectionNum() {
+        std::lock_guard<std::mutex> locker(mutex_);
+        return channels.size();
+    }
+
+    // NOTE: fn is executed while holding mutex_, so it must stay short and must not call server APIs that may lock channels again.
+    int foreachChannel(std::function<void(const TSocketChannelPtr& channel)> fn) {
+        std::lock_guard<std::mutex> locker(mutex_);
+        for (auto& pair : channels) {
+            fn(pair.second);
+        }
+        return channels.size();
+    }
+
+    // broadcast thread-safe
+    int broadcast(const void* data, int size) {
+        return foreachChannel([data, size](const TSocketChannelPtr& channel) {
+            channel->write(data, size);
+        });
+    }
+
+    int broadcast(const std::string& str) {
+        return broadcast(str.data(), str.size());
+    }
+
+private:
+    static void newConnEvent(hio_t* connio) {
+        assert(connio != NULL);
+        TcpServerEventLoopTmpl* server = (TcpServerEventLoopTmpl*)hevent_userdata(connio);
+        assert(server != NULL);
+        EventLoop* worker_loop = currentThreadEventLoop;
+        assert(worker_loop != NULL);
+        if (server->connectionNum() >= server->max_connections) {
+            --worker_loop->connectionNum;
+            hlogw("over max_connections");
+            hio_close(connio);
+            return;
+        }
+
+        // NOTE: attach to worker loop
+        hio_attach(worker_loop->loop(), connio);
+
+        const TSocketChannelPtr& channel = server->addChannel(connio);
+        channel->status = SocketChannel::CONNECTED;
+
+        channel->onread = [server, &channel](Buffer* buf) {
+            if (server->onMessage) {
+                server->onMessage(channel, buf);
+            }
+        };
+        channel->onwrite = [server, &channel](Buffer* buf) {
+            if (server->onWriteComplete) {
+                server->onWriteComplete(channel, buf);
+            }
+        };
+        channel->onclose = [server, &channel]() {
+            EventLoop* worker_loop = currentThreadEventLoop;
+            assert(worker_loop != NULL);
+            --worker_loop->connectionNum;
+
+            channel->status = SocketChannel::CLOSED;
+            if (server->onConnection) {
+                server->onConnection(channel);
+            }
+            server->removeChannel(channel);
+            // NOTE: After removeChannel, channel may be destroyed immediately,
+            // so in this lambda function, no code should be added below.
+        };
+
+        if (server->unpack_setting) {
+            channel->setUnpack(server->unpack_setting);
+        }
+        channel->startRead();
+        if (server->onConnection) {
+            server->onConnection(channel);
+        }
+    }
+
+    // run in acceptor_loop
+    void rebalance() {
+        if (worker_threads.status() != Status::kRunning) return;
+        std::vector<int> percents = worker_threads.busyPercents();
+        size_t numLoops = percents.size();
+        if (numLoops < 2) return;
+        size_t busiest = 0, idlest = 0;
+        for (size_t i = 1; i < numLoops; ++i) {
+            if (percents[i] > percents[busiest]) busiest = i;
+            if (percents[i] < percents[idlest]) idlest = i;
+        }
+        int diff = percents[busiest] - percents[idlest];
+        if (diff <= 0 || diff < rebalance_threshold) return;
+        EventLoopPtr from = worker_threads.loop(busiest);
+        EventLoopPtr to = worker_threads.loop(idlest);
+        // NOTE: assume load is proportional to connections, move half of the difference.
+        uint32_t num = (uint64_t)from->connectionNum * diff / percents[busiest] / 2;
+        num = MIN(num, rebalance_max_migrations);
+        if (num == 0) return;
+        hlogd("rebalance loop[%d] busy %d%% => loop[%d] busy %d%%, migrate %u connections",
+            (int)busiest, percents[busiest], (int)idlest, percents[idlest], num);
+        from->queueInLoop([this, from, to, num]() {
+            migrateChannels(from, to, num);
+        });
+    }
+
+    // run in from loop
+    void migrateChannels(const EventLoopPtr& from, const EventLoopPtr& to, uint32_t num) {
+        hloop_t* from_loop = from->loop();
+        hloop_t* to_loop = to->loop();
+        if (from_loop == NULL || to_loop == NULL) return;
+        std::vector<TSocketChannelPtr> candidates;
+        foreachChannel([from_loop, &candidates](const TSocketChannelPtr& channel) {
+            hio_t* io = channel->io();
+            if (io && hevent_loop(io) == from_loop) {
+                candidates.push_back(channel);
+            }
+        });
+        uint32_t migrated = 0;
+        for (auto& channel : candidates) {
+            if (migrated >= num) break;
+            // NOTE: skip channels with unread or unsent data, see hio_migrate
+            if (channel->migrate(to_loop) == 0) {
+                --from->connectionNum;
+                ++to->connectionNum;
+                ++migrated;
+            }
+        }
+    }
+
+    static void onAccept(hio_t* connio) {
+        TcpServerEventLoopTmpl* server = (TcpServerEventLoopTmpl*)hevent_userdata(connio);
+        // NOTE: detach from acceptor loop
+        hio_detach(connio);
+        EventLoopPtr worker_loop = server->worker_threads.nextLoop(server->load_balance);
+        if (worker_loop == NULL) {
+            worker_loop = server->acceptor_loop;
+        }
+        ++worker_loop->connectionNum;
+        worker_loop->runInLoop(std::bind(&TcpServerEventLoopTmpl::newConnEvent, connio));
+    }
+
+public:
+    std::string             host;
+    int                     port;
+    int                     listenfd;
+    bool                    tls;
+    hssl_ctx_opt_t*         tls_setting;
+    unpack_setting_t*       unpack_setting;
+    // Callback
+    std::function<void(const TSocketChannelPtr&)>           onConnection;
+    std::function<void(const TSocketChannelPtr&, Buffer*)>  onMessage;
+    // NOTE: Use Channel::isWriteComplete in onWriteComplete callback to determine whether all data has been written.
+    std::function<void(const TSocketChannelPtr&, Buffer*)>  onWriteComplete;
+
+    uint32_t                max_connections;
+    load_balance_e          load_balance;
+    // for setRebalance
+    int                     rebalance_interval;
+    int                     rebalance_threshold;
+    uint32_t                rebalance_max_migrations;
+    TimerID                 rebalance_timer;
+
+private:
+    // id => TSocketChannelPtr
+    std::map<uint32_t, TSocketChannelPtr>   channels; // GUAREDE_BY(mutex_)
+    std::mutex                              mutex_;
+
+    EventLoopPtr            acceptor_loop;
+    EventLoopThreadPool     worker_threads;
+};
+
+template<class TSocketChannel = SocketChannel>
+class TcpServerTmpl : private EventLoopThread, public TcpServerEventLoopTmpl<TSocketChannel> {
+public:
+    TcpServerTmpl(EventLoopPtr loop = NULL)
+        : EventLoopThread(loop)
+        , TcpServerEventLoopTmpl<TSocketChannel>(EventLoopThread::loop())
+        , is_loop_owner(loop == NULL)
+    {}
+    virtual ~TcpServerTmpl() {
+        stop(true);
+    }
+
+    EventLoopPtr loop(int idx = -1) {
+        return TcpServerEventLoopTmpl<TSocketChannel>::loop(idx);
+    }
+
+    // start thread-safe
+    void start(bool wait_threads_started = true) {
+        TcpServerEventLoopTmpl<TSocketChannel>::start(wait_threads_started);
+        if (!isRunning()) {
+            EventLoopThread::start(wait_threads_started);
+        }
+    }
+
+    // stop thread-safe
+    void stop(bool wait_threads_stopped = true) {
+        if (is_loop_owner) {
+            EventLoopThread::stop(wait_threads_stopped);
+        }
+        TcpServerEventLoopTmpl<TSocketChannel>::stop(wait_threads_stopped);
+    }
+
+private:
+    bool is_loop_owner;
+};
+
+typedef TcpServerTmpl<SocketChannel> TcpServer;
+
+}
+
+#endif // HV_TCP_SERVER_HPP_
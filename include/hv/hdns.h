@@ -0,0 +1,179 @@
+#ifndef HV_DNS_ASYNC_H_
+#define HV_DNS_ASYNC_H_
+
+/*
+ * Asynchronous DNS resolver.
+ *
+ * A self-contained, non-blocking, native DNS resolver that runs entirely
+ * inside the hloop event loop. Unlike the blocking getaddrinfo() used by
+ * ResolveAddr(), hdns_resolve() never stalls the event loop: DNS queries are
+ * sent over a non-blocking UDP socket (TCP for truncated answers) and results
+ * are delivered through a callback in the loop thread.
+ *
+ * NOTE: This is independent from protocol/dns.h (which is a synchronous demo).
+ *
+ * Features:
+ *   - Async A (IPv4) / AAAA (IPv6) queries, SRV queries (hdns_resolve_srv).
+ *   - EDNS0 with a UDP payload size of 1232; a truncated (TC) answer is asked
+ *     again over TCP to the same nameserver, a FORMERR again without EDNS0.
+ *   - Reads nameservers from /etc/resolv.conf (Unix) or GetAdaptersAddresses (Windows),
+ *     falling back to 8.8.8.8.
+ *   - Loads /etc/hosts and answers from it before querying the network.
+ *   - Numeric-IP fast path (no query for literal IPv4/IPv6).
+ *   - Per-query timeout, retry and multi-nameserver rotation.
+ *   - DNS name compression parsing. Collects the A/AAAA address records from
+ *     the answer section; CNAMEs are not chased client-side, relying on the
+ *     recursive nameserver to include the final A/AAAA records (as recursive
+ *     resolvers do). Non-recursive / CNAME-only responses are not followed.
+ *   - TTL-respecting cache (positive + negative), shared by all loops of the
+ *     process, refreshed in the background before it expires.
+ *   - Identical queries in flight on a loop are sent once.
+ *   - Cancelable query handle.
+ *
+ * @see examples/host.c
+ */
+
+#include "hexport.h"
+#include "hplatform.h"
+#include "hsocket.h" // sockaddr_u
+#include "hloop.h"   // hloop_t
+
+#define HDNS_DEFAULT_PORT           53
+#define HDNS_DEFAULT_TIMEOUT_MS     5000
+#define HDNS_DEFAULT_RETRIES        2       // total attempts = retries + 1
+#define HDNS_FALLBACK_NAMESERVER    "8.8.8.8"
+#define HDNS_MAX_ADDRS              64
+#define HDNS_MAX_SRVS               1024
+#define HDNS_NAME_MAXLEN           256
+
+// hdns_result_t.status codes (0 = success, negative = failure)
+#define HDNS_STATUS_OK              0
+#define HDNS_STATUS_TIMEOUT       (-1)   // all attempts timed out
+#define HDNS_STATUS_NXDOMAIN      (-2)   // no such domain / no address record
+#define HDNS_STATUS_SERVFAIL      (-3)   // server failure / bad response
+#define HDNS_STATUS_BADNAME       (-4)   // invalid host name
+#define HDNS_STATUS_NONAMESERVER  (-5)   // no usable nameserver
+#define HDNS_STATUS_NOMEM         (-6)   // out of memory
+#define HDNS_STATUS_CANCELLED     (-7)   // query cancelled (not delivered to cb)
+#define HDNS_STATUS_ERROR         (-8)   // other error
+
+typedef enum {
+    HDNS_QUERY_A    = 0x01,     // IPv4 only
+    HDNS_QUERY_AAAA = 0x02,     // IPv6 only
+    HDNS_QUERY_BOTH = 0x03,     // A + AAAA (default)
+} hdns_family_e;
+
+typedef struct hdns_setting_s {
+    hdns_family_e   family;     // default HDNS_QUERY_BOTH
+    int             timeout_ms; // per-attempt timeout, default HDNS_DEFAULT_TIMEOUT_MS
+    int             retries;    // default HDNS_DEFAULT_RETRIES
+    int             use_cache;  // default 1
+    const char*     nameserver; // optional override "ip" or "ip:port", NULL = auto
+
+#ifdef __cplusplus
+    hdns_setting_s() {
+        family = HDNS_QUERY_BOTH;
+        timeout_ms = HDNS_DEFAULT_TIMEOUT_MS;
+        retries = HDNS_DEFAULT_RETRIES;
+        use_cache = 1;
+        nameserver = NULL;
+    }
+#endif
+} hdns_setting_t;
+
+typedef struct hdns_cache_stats_s {
+    uint64_t    hits;           // including stale_hits
+    uint64_t    stale_hits;     // served while refreshing, before expiry
+    uint64_t    misses;
+    uint64_t    coalesced;      // waited for the same query in flight
+    int         entries;
+} hdns_cache_stats_t;
+
+typedef struct hdns_result_s {
+    int         status;                     // 0:ok  <0:herr code
+    char        host[HDNS_NAME_MAXLEN];     // queried name
+    int         naddrs;                     // number of resolved addresses
+    sockaddr_u  addrs[HDNS_MAX_ADDRS];      // A/AAAA merged (IPv4 first), port = 0
+} hdns_result_t;
+
+typedef struct hdns_srv_s {
+    uint16_t    priority;
+    uint16_t    weight;
+    uint16_t    port;
+    char        target[HDNS_NAME_MAXLEN];   // "" if the service is not available
+} hdns_srv_t;
+
+typedef struct hdns_srv_result_s {
+    int         status;                     // 0:ok  <0:herr code
+    char        name[HDNS_NAME_MAXLEN];     // queried name, e.g. _http._tcp.example.com
+    int         nsrvs;
+    hdns_srv_t* srvs;                       // sorted by priority, then weight descending
+} hdns_srv_result_t;
+
+// Cancelable query handle.
+//
+// hdns_t is an event object (subclass of hevent_t, like htimer_t / hio_t), so
+// it can carry an event_id and integrate with the loop's conventions.
+//
+// C API lifetime contract (same as htimer_t): the handle is valid until the
+// query completes (its callback fires) or it is cancelled via hdns_cancel().
+// Do NOT keep or use the pointer after that. For a use-after-free-proof handle,
+// use the C++ EventLoop::resolveDns()/cancelDns() which manage an id -> hdns_t
+// map (mirrors TimerID), just like htimer_t vs EventLoop TimerID.
+typedef struct hdns_s hdns_t;
+
+/*
+ * result callback, invoked in the loop thread.
+ * @query:    the handle returned by hdns_resolve*(); it is freed immediately
+ *            after this callback returns, so do NOT retain it. Its event_id
+ *            (hevent_id) can be read here to correlate with a caller-side map.
+ * @result:   only valid during the callback.
+ */
+typedef void (*hdns_cb)(hdns_t* query, const hdns_result_t* result, void* userdata);
+typedef void (*hdns_srv_cb)(hdns_t* query, const hdns_srv_result_t* result, void* userdata);
+
+BEGIN_EXTERN_C
+
+/*
+ * Start an asynchronous resolve bound to @loop. @cb runs in the loop thread.
+ *
+ * The callback is NEVER invoked re-entrantly inside this call: even for
+ * numeric-IP / hosts / cache hits, completion is posted to the next loop
+ * iteration. Therefore the returned handle is always valid to pass to
+ * hdns_cancel() until the callback fires.
+ *
+ * @return a query handle, or NULL on immediate failure (invalid params / OOM).
+ */
+HV_EXPORT hdns_t* hdns_resolve(hloop_t* loop, const char* host,
+                               hdns_cb cb, void* userdata);
+
+HV_EXPORT hdns_t* hdns_resolve_ex(hloop_t* loop, const char* host,
+                                  const hdns_setting_t* opt,
+                                  hdns_cb cb, void* userdata);
+
+/*
+ * Start an asynchronous SRV query of @name, like hdns_resolve_ex.
+ * The targets are not resolved, use hdns_resolve for them.
+ * NOTE: opt->family and opt->use_cache are ignored, SRV answers are not cached.
+ */
+HV_EXPORT hdns_t* hdns_resolve_srv(hloop_t* loop, const char* name,
+                                   const hdns_setting_t* opt,
+                                   hdns_srv_cb cb, void* userdata);
+
+/*
+ * Cancel an in-flight query and free it immediately. After this returns, @cb
+ * will NOT be called and @query is invalid. MUST be called from the loop
+ * thread, and MUST NOT be called from within that query's own callback.
+ */
+HV_EXPORT void hdns_cancel(hdns_t* query);
+
+// Clear the process-wide DNS cache (e.g. on a network change).
+// Thread-safe, @loop is unused.
+HV_EXPORT void hdns_clear_cache(hloop_t* loop);
+
+// Counters of the process-wide DNS cache since start. Thread-safe.
+HV_EXPORT void hdns_cache_stats(hdns_cache_stats_t* stats);
+
+END_EXTERN_C
+
+#endif // HV_DNS_ASYNC_H_
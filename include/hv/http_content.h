@@ -0,0 +1,122 @@
+#ifndef HV_HTTP_CONTENT_H_
+#define HV_HTTP_CONTENT_H_
+
+#include <functional>
+
+#include "hexport.h"
+#include "hstring.h"
+
+// NOTE: WITHOUT_HTTP_CONTENT
+// ndk-r10e no std::to_string and can't compile modern json.hpp
+#ifndef WITHOUT_HTTP_CONTENT
+#include "json.hpp" // https://github.com/nlohmann/json
+// multipart_parser.h
+struct multipart_parser;
+#endif
+
+BEGIN_NAMESPACE_HV
+
+// QueryParams
+using QueryParams = hv::KeyValue;
+HV_EXPORT std::string dump_query_params(const QueryParams& query_params);
+HV_EXPORT int         parse_query_params(const char* query_string, QueryParams& query_params);
+
+#ifndef WITHOUT_HTTP_CONTENT
+
+/**************multipart/form-data*************************************
+--boundary
+Content-Disposition: form-data; name="user"
+
+content
+--boundary
+Content-Disposition: form-data; name="avatar"; filename="user.jpg"
+Content-Type: image/jpeg
+
+content
+--boundary--
+***********************************************************************/
+// FormData
+struct FormData {
+    std::string     filename;
+    std::string     content;
+    // server: content spilled to this temporary file, see HttpService::body_spill_size
+    std::string     filepath;
+
+    FormData(const char* content = NULL, const char* filename = NULL) {
+        if (content) {
+            this->content = content;
+        }
+        if (filename) {
+            this->filename = filename;
+        }
+    }
+    template<typename T>
+    FormData(T num) {
+        content = hv::to_string(num);
+    }
+};
+// FormFile
+struct FormFile : public FormData {
+    FormFile(const char* filename = NULL) {
+        if (filename) {
+            this->filename = filename;
+        }
+    }
+};
+
+// MultiPart
+// name => FormData
+typedef HV_MAP<std::string, FormData>          MultiPart;
+#define DEFAULT_MULTIPART_BOUNDARY  "----WebKitFormBoundary7MA4YWxkTrZu0gW"
+HV_EXPORT std::string dump_multipart(MultiPart& mp, const char* boundary = DEFAULT_MULTIPART_BOUNDARY);
+HV_EXPORT int         parse_multipart(const std::string& str, MultiPart& mp, const char* boundary);
+
+// MultipartParser: streaming parser of multipart/form-data,
+// part data is passed to onPartData as it arrives, pointing into the fed data.
+// @usage http_state_handler: HP_HEADERS_COMPLETE => new MultipartParser(boundary),
+//                            HP_BODY => FeedRecvData(data, size)
+class HV_EXPORT MultipartParser {
+public:
+    // Content-Disposition: form-data; name="avatar"; filename="user.jpg"
+    std::function<void(const std::string& name, const std::string& filename)> onPartBegin;
+    std::function<void(const char* data, size_t size)>                          onPartData;
+    std::function<void()>                                                       onPartEnd;
+
+    MultipartParser(const char* boundary);
+    ~MultipartParser();
+
+    // @retval len on success, the error position otherwise
+    size_t FeedRecvData(const char* data, size_t len);
+    // closing boundary parsed
+    bool IsComplete() { return complete; }
+
+private:
+    static int on_header_field(multipart_parser* parser, const char* at, size_t length);
+    static int on_header_value(multipart_parser* parser, const char* at, size_t length);
+    static int on_part_data(multipart_parser* parser, const char* at, size_t length);
+    static int on_part_data_begin(multipart_parser* parser);
+    static int on_headers_complete(multipart_parser* parser);
+    static int on_part_data_end(multipart_parser* parser);
+    static int on_body_end(multipart_parser* parser);
+    void handle_header();
+
+    multipart_parser*           parser;
+    bool                        complete;
+    // tmp
+    std::string header_field;
+    std::string header_value;
+    std::string name;
+    std::string filename;
+};
+
+// Json
+using Json = nlohmann::json;
+// using Json = nlohmann::ordered_json;
+
+HV_EXPORT std::string dump_json(const hv::Json& json, int indent = -1);
+HV_EXPORT int         parse_json(const char* str, hv::Json& json, std::string& errmsg);
+#endif
+
+END_NAMESPACE_HV
+
+#endif // HV_HTTP_CONTENT_H_
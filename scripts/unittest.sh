@@ -14,6 +14,7 @@ bin/mkdir_p 123/456
 bin/ls
 bin/rmdir_p 123/456
 bin/hlog_test
+bin/timewheel_test
 
 bin/base64
 bin/md5
@@ -32,12 +33,38 @@ bin/socketpair_test
 # bin/objectpool_test
 bin/sizeof_test
 bin/http_router_test
+bin/http_headers_test
+bin/http_parser_test
+bin/multipart_test
+bin/http_upstream_test
+bin/file_cache_test
+bin/http_compress_test
+bin/http_reuseport_test
+bin/hloop_stats_test
 if [ -x bin/hdns_test ]; then
     bin/hdns_test
 fi
+if [ -x bin/io_uring_test ]; then
+    bin/io_uring_test
+fi
+if [ -x bin/ktls_test ]; then
+    bin/ktls_test
+fi
+if [ -x bin/http2_server_test ]; then
+    bin/http2_server_test
+fi
+if [ -x bin/http2_client_test ]; then
+    bin/http2_client_test
+fi
 if [ -x bin/tcpclient_dns_test ]; then
     bin/tcpclient_dns_test
 fi
+if [ -x bin/hio_migrate_test ]; then
+    bin/hio_migrate_test
+fi
+if [ -x bin/eventloop_post_test ]; then
+    bin/eventloop_post_test
+fi
 for redis_test in redis_async_client_test redis_client_test redis_batch_test redis_subscriber_test; do
     if [ -x bin/${redis_test} ]; then
         bin/${redis_test}
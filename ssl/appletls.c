@@ -1111,4 +1111,8 @@ int hssl_set_sni_hostname(hssl_t ssl, const char* hostname) {
     return 0;
 }
 
+int hssl_ktls_send(hssl_t ssl) {
+    return 0;
+}
+
 #endif // WITH_APPLETLS
@@ -43,6 +43,9 @@ typedef struct {
     const char* ca_path;
     short       verify_peer;
     short       endpoint; // HSSL_SERVER / HSSL_CLIENT
+    // kernel TLS offload: openssl 3.0+ built with ktls, linux tls module loaded.
+    // records are encrypted by kernel after handshake, so nio can send/sendfile on socket.
+    short       ktls;
 } hssl_ctx_opt_t, hssl_ctx_init_param_t;
 
 BEGIN_EXTERN_C
@@ -82,8 +85,16 @@ HV_EXPORT int hssl_close(hssl_t ssl);
 
 HV_EXPORT int hssl_set_sni_hostname(hssl_t ssl, const char* hostname);
 
+// @return 1 if records are encrypted by kernel on send, 0 otherwise.
+HV_EXPORT int hssl_ktls_send(hssl_t ssl);
+
 #ifdef WITH_OPENSSL
+// for HSSL_SERVER: select one of protos offered by client
 HV_EXPORT int hssl_ctx_set_alpn_protos(hssl_ctx_t ssl_ctx, const unsigned char* protos, unsigned int protos_len);
+// for HSSL_CLIENT: offer protos before hssl_connect, e.g. "\x02h2\x08http/1.1"
+HV_EXPORT int hssl_set_alpn_protos(hssl_t ssl, const unsigned char* protos, unsigned int protos_len);
+// @return length of the proto selected by server after handshake, 0 if none.
+HV_EXPORT int hssl_get_alpn_selected(hssl_t ssl, const unsigned char** proto);
 #endif
 
 END_EXTERN_C
@@ -203,4 +203,8 @@ int hssl_set_sni_hostname(hssl_t ssl, const char* hostname) {
     return HSSL_OK;
 }
 
+int hssl_ktls_send(hssl_t ssl) {
+    return 0;
+}
+
 #endif // WITH_MBEDTLS
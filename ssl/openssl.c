@@ -80,6 +80,14 @@ hssl_ctx_t hssl_ctx_new(hssl_ctx_opt_t* param) {
 #ifdef SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER
     SSL_CTX_set_mode(ctx, SSL_CTX_get_mode(ctx) | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 #endif
+    if (param && param->ktls) {
+#ifdef SSL_OP_ENABLE_KTLS
+        // NOTE: fallback to userspace silently if cipher or kernel not supported.
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#else
+        fprintf(stderr, "ssl ktls not supported by this openssl!\n");
+#endif
+    }
     SSL_CTX_set_verify(ctx, mode, NULL);
     return ctx;
 error:
@@ -169,6 +177,15 @@ int hssl_set_sni_hostname(hssl_t ssl, const char* hostname) {
     return HSSL_OK;
 }
 
+int hssl_ktls_send(hssl_t ssl) {
+#ifdef SSL_OP_ENABLE_KTLS
+    if (ssl && BIO_get_ktls_send(SSL_get_wbio((SSL*)ssl))) {
+        return 1;
+    }
+#endif
+    return 0;
+}
+
 #ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
 static int hssl_ctx_alpn_select_cb(SSL *ssl,
     const unsigned char **out, unsigned char *outlen,
@@ -200,4 +217,22 @@ int hssl_ctx_set_alpn_protos(hssl_ctx_t ssl_ctx, const unsigned char* protos, un
     return ret;
 }
 
+int hssl_set_alpn_protos(hssl_t ssl, const unsigned char* protos, unsigned int protos_len) {
+    int ret = -1;
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+    // NOTE: SSL_set_alpn_protos returns 0 on success
+    ret = SSL_set_alpn_protos((SSL*)ssl, protos, protos_len) == 0 ? 0 : -1;
+#endif
+    return ret;
+}
+
+int hssl_get_alpn_selected(hssl_t ssl, const unsigned char** proto) {
+    unsigned int len = 0;
+    *proto = NULL;
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+    SSL_get0_alpn_selected((SSL*)ssl, proto, &len);
+#endif
+    return len;
+}
+
 #endif // WITH_OPENSSL
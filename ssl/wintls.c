@@ -835,4 +835,9 @@ int hssl_set_sni_hostname(hssl_t _ssl, const char* hostname)
     return 0;
 }
 
+int hssl_ktls_send(hssl_t ssl)
+{
+    return 0;
+}
+
 #endif // WITH_WINTLS
@@ -0,0 +1,127 @@
+/*
+ * eventloop_post_test: EventLoop::postEvent from many threads.
+ *
+ *   1. events of every producer are handled in posted order, none is lost or
+ *      handled twice, events posted by callbacks in the loop thread are handled too.
+ *   2. a throwing callback does not lose the events after it,
+ *      they are handled by the next run of the loop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "EventLoop.h"
+
+using namespace hv;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define PRODUCERS       8
+#define EVENTS          100000 // per producer
+#define TOTAL_EVENTS    (PRODUCERS * EVENTS)
+
+static void test_ordering() {
+    EventLoop loop;
+    // in loop thread
+    std::vector<int> next_seq(PRODUCERS, 0);
+    int nhandled = 0;
+    int nreposted = 0;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&loop, &next_seq, &nhandled, &nreposted, p]() {
+            for (int seq = 0; seq < EVENTS; ++seq) {
+                auto cb = [&loop, &next_seq, &nhandled, &nreposted, p, seq]() {
+                    CHECK(loop.isInLoopThread());
+                    CHECK(next_seq[p] == seq);
+                    ++next_seq[p];
+                    ++nhandled;
+                    if (seq % 1000 == 0) {
+                        // posted in loop thread, handled after
+                        loop.queueInLoop([&loop, &nhandled, &nreposted]() {
+                            ++nreposted;
+                            if (nhandled == TOTAL_EVENTS && nreposted == TOTAL_EVENTS / 1000) {
+                                loop.stop();
+                            }
+                        });
+                    }
+                };
+                // both interfaces
+                if (p % 2 == 0) {
+                    loop.queueInLoop(cb);
+                } else {
+                    loop.postEvent([cb](Event* ev) {
+                        CHECK(ev != NULL);
+                        cb();
+                    });
+                }
+            }
+        });
+    }
+    loop.setTimeout(30000, [](TimerID timerID) {
+        (void)timerID;
+        printf("timeout!\n");
+        exit(1);
+    });
+    loop.run();
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    CHECK(nhandled == TOTAL_EVENTS);
+    CHECK(nreposted == TOTAL_EVENTS / 1000);
+    for (int p = 0; p < PRODUCERS; ++p) {
+        CHECK(next_seq[p] == EVENTS);
+    }
+    printf("%d producers x %d events in order OK\n", PRODUCERS, EVENTS);
+}
+
+static void test_throwing_callback() {
+    hloop_t* hloop = hloop_new(HLOOP_FLAG_RUN_ONCE);
+    CHECK(hloop != NULL);
+    std::vector<int> handled;
+    {
+        EventLoop loop(hloop);
+        loop.queueInLoop([&handled]() { handled.push_back(1); });
+        loop.queueInLoop([]() { throw std::runtime_error("callback"); });
+        loop.queueInLoop([&handled]() { handled.push_back(3); });
+        loop.queueInLoop([&handled]() { handled.push_back(4); });
+
+        bool thrown = false;
+        try {
+            hloop_run(hloop);
+        } catch (const std::runtime_error& e) {
+            (void)e;
+            thrown = true;
+        }
+        CHECK(thrown);
+        CHECK(handled.size() == 1 && handled[0] == 1);
+        // NOTE: hloop_run did not return, mark it stopped to run again
+        hloop_stop(hloop);
+
+        loop.queueInLoop([&handled]() { handled.push_back(5); });
+        CHECK(hloop_run(hloop) == 0);
+        CHECK(handled.size() == 4);
+        CHECK(handled[1] == 3 && handled[2] == 4 && handled[3] == 5);
+    }
+    hloop_free(&hloop);
+    printf("throwing callback OK\n");
+}
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    test_ordering();
+    test_throwing_callback();
+    printf("eventloop_post_test OK\n");
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hbase.h"
+#include "FileCache.h"
+
+#ifdef OS_LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define BIG_SIZE    (1 << 18)   // 256K, less than capacity of a shard
+
+static std::string s_dir;
+
+static std::string write_file(const char* name, size_t size, char c) {
+    std::string filepath = s_dir + name;
+    FILE* fp = fopen(filepath.c_str(), "wb");
+    CHECK(fp != NULL);
+    std::string content(size, c);
+    fwrite(content.data(), 1, content.size(), fp);
+    fclose(fp);
+    return filepath;
+}
+
+#ifdef OS_LINUX
+static void read_inotify(FileCache* cache, int fd) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    char buf[4096];
+    while (poll(&pfd, 1, 100) > 0) {
+        int nread = read(fd, buf, sizeof(buf));
+        if (nread <= 0) break;
+        cache->OnInotifyEvents(buf, nread);
+    }
+}
+#endif
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    char tmpl[] = "/tmp/file_cache_test.XXXXXX";
+    if (mkdtemp(tmpl) == NULL) {
+        perror("mkdtemp");
+        return -1;
+    }
+    s_dir = tmpl;
+    s_dir += '/';
+
+    FileCache cache(FILE_CACHE_SHARDS * (1 << 20)); // 1M per shard
+    cache.stat_interval = 0;
+#ifdef OS_LINUX
+    int inotify_fd = cache.OpenInotify();
+    if (inotify_fd < 0) {
+        perror("inotify");
+        return -1;
+    }
+#endif
+
+    // files are read into heap
+    std::string small = write_file("small.txt", 100, 's');
+    std::string big = write_file("big.js", BIG_SIZE, 'b');
+    FileCache::OpenParam param;
+    file_cache_ptr fc_new;
+    file_cache_ptr fc = cache.Open(small.c_str(), &param);
+    CHECK(fc && fc->filebuf.len == 100 && fc->filebuf.base == fc->buf.base);
+    CHECK(fc->content_type == "text/plain; charset=utf-8");
+    param = FileCache::OpenParam();
+    file_cache_ptr fc_big = cache.Open(big.c_str(), &param);
+    CHECK(fc_big && fc_big->filebuf.base == fc_big->buf.base);
+    CHECK(fc_big->filebuf.len == BIG_SIZE && fc_big->filebuf.base[0] == 'b');
+    CHECK(cache.Size() == 2);
+
+    // hit
+    param = FileCache::OpenParam();
+    fc_new = cache.Open(small.c_str(), &param);
+    CHECK(fc_new == fc);
+    CHECK(!param.need_read && param.filesize == 100);
+    printf("Open read OK\n");
+
+    // HEAD opens without content, GET loads a new entry
+    std::string head = write_file("head.html", 10, 'h');
+    param = FileCache::OpenParam();
+    param.need_read = false;
+    file_cache_ptr fc_head = cache.Open(head.c_str(), &param);
+    CHECK(fc_head && !fc_head->is_complete() && param.filesize == 10);
+    param = FileCache::OpenParam();
+    file_cache_ptr fc_get = cache.Open(head.c_str(), &param);
+    CHECK(fc_get != fc_head && fc_get->is_complete());
+    CHECK(fc_head->filebuf.len == 0);
+    printf("Open HEAD/GET OK\n");
+
+    // over limit
+    CHECK(cache.Close(big.c_str()));
+    param = FileCache::OpenParam();
+    param.max_read = 10;
+    fc_new = cache.Open(big.c_str(), &param);
+    CHECK(fc_new == NULL && param.error != 0);
+    CHECK(!cache.Exists(big.c_str()));
+    // referenced entry is still valid after removed
+    CHECK(fc_big->filebuf.base[fc_big->filebuf.len - 1] == 'b');
+    printf("Open over limit OK\n");
+
+    // referenced entry is still valid after the file truncated in place
+    write_file("big.js", 0, 'b');
+    CHECK(fc_big->filebuf.len == BIG_SIZE);
+    CHECK(fc_big->filebuf.base[0] == 'b' && fc_big->filebuf.base[BIG_SIZE - 1] == 'b');
+    fc_big = NULL;
+    printf("Truncate in place OK\n");
+
+    // evicted by bytes, not by count
+    cache.Clear();
+    char name[64];
+    for (int i = 0; i < 1000; ++i) {
+        snprintf(name, sizeof(name), "asset%d.css", i);
+        std::string filepath = write_file(name, 1000, 'a');
+        param = FileCache::OpenParam();
+        fc_new = cache.Open(filepath.c_str(), &param);
+        CHECK(fc_new != NULL);
+    }
+    CHECK(cache.Size() == 1000);
+    for (int i = 0; i < 64; ++i) {
+        snprintf(name, sizeof(name), "large%d.bin", i);
+        std::string filepath = write_file(name, 512 * 1024, 'l');
+        param = FileCache::OpenParam();
+        fc_new = cache.Open(filepath.c_str(), &param);
+        CHECK(fc_new != NULL);
+    }
+    CHECK(cache.Bytes() <= cache.capacity);
+    CHECK(cache.Size() < 1064);
+    printf("Evict by bytes OK: size=%zu bytes=%zu\n", cache.Size(), cache.Bytes());
+
+    // precompressed sidecar is encoded once, read out of the entry lock
+    cache.Clear();
+    std::string app = write_file("app.js", 1000, 'j');
+    write_file("app.js.gz", 100, 'z');
+    param = FileCache::OpenParam();
+    fc = cache.Open(app.c_str(), &param);
+    CHECK(fc != NULL);
+    std::vector<file_cache_ptr> variants(8);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&cache, &fc, &variants, i]() {
+            variants[i] = cache.Encode(fc, HTTP_ENCODING_GZIP | HTTP_ENCODING_BR, true);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK(variants[0] && variants[0]->content_encoding == "gzip");
+    CHECK(variants[0]->filebuf.len == 100 && variants[0]->filebuf.base[0] == 'z');
+    for (int i = 1; i < 8; ++i) {
+        CHECK(variants[i] == variants[0]);
+    }
+    CHECK(cache.Encode(fc, HTTP_ENCODING_BR, true) == NULL);
+    printf("Encode precompressed OK\n");
+
+#ifdef OS_LINUX
+    // invalidated by inotify, not by stat
+    cache.Clear();
+    cache.stat_interval = 3600;
+    param = FileCache::OpenParam();
+    fc = cache.Open(small.c_str(), &param);
+    CHECK(fc && fc->watched);
+    read_inotify(&cache, inotify_fd);
+    CHECK(cache.Exists(small.c_str()));
+    write_file("small.txt", 200, 'm');
+    read_inotify(&cache, inotify_fd);
+    CHECK(!cache.Exists(small.c_str()));
+    param = FileCache::OpenParam();
+    fc_new = cache.Open(small.c_str(), &param);
+    CHECK(fc_new != fc && fc_new->filebuf.len == 200 && fc_new->filebuf.base[0] == 'm');
+    CHECK(fc->filebuf.len == 100 && fc->filebuf.base[0] == 's');
+
+    // index page of dir is invalidated by new file
+    param = FileCache::OpenParam();
+    file_cache_ptr fc_dir = cache.Open(s_dir.c_str(), &param);
+    CHECK(fc_dir && S_ISDIR(fc_dir->st.st_mode));
+    read_inotify(&cache, inotify_fd);
+    CHECK(cache.Exists(s_dir.c_str()));
+    write_file("new.txt", 1, 'n');
+    read_inotify(&cache, inotify_fd);
+    CHECK(!cache.Exists(s_dir.c_str()));
+    printf("Invalidate by inotify OK\n");
+#endif
+
+    // invalidated by stat
+    FileCache stat_cache;
+    stat_cache.stat_interval = -1;
+    std::string stat_file = write_file("stat.txt", 10, '1');
+    param = FileCache::OpenParam();
+    fc = stat_cache.Open(stat_file.c_str(), &param);
+    CHECK(fc && !fc->watched);
+    write_file("stat.txt", 20, '2');
+    param = FileCache::OpenParam();
+    fc_new = stat_cache.Open(stat_file.c_str(), &param);
+    CHECK(fc_new != fc && fc_new->filebuf.len == 20);
+    printf("Invalidate by stat OK\n");
+
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", tmpl);
+    system(cmd);
+    printf("file_cache_test OK\n");
+    return 0;
+}
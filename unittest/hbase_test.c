@@ -5,6 +5,18 @@ int main(int argc, char* argv[]) {
     printf("hv_rand(10, 99) -> %d\n", hv_rand(10, 99));
     printf("hv_random_string(buf, 10) -> %s\n", hv_random_string(buf, 10));
 
+    char dir[MAX_PATH] = {0};
+    printf("get_temp_dir -> %s\n", get_temp_dir(dir, sizeof(dir)));
+#ifndef OS_WIN
+    setenv("TMPDIR", "/var/tmp//", 1);
+    assert(strcmp(get_temp_dir(dir, sizeof(dir)), "/var/tmp") == 0);
+    setenv("TMPDIR", "/", 1);
+    assert(strcmp(get_temp_dir(dir, sizeof(dir)), "/") == 0);
+    unsetenv("TMPDIR");
+    assert(strcmp(get_temp_dir(dir, sizeof(dir)), "/tmp") == 0);
+    assert(get_temp_dir(buf, 4) == NULL);
+#endif
+
     assert(hv_getboolean("1"));
     assert(hv_getboolean("yes"));
 
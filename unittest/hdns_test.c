@@ -12,10 +12,17 @@
  *   4. cache hit (second resolve does not hit the mock server)
  *   5. cancel before completion (callback not invoked)
  *   6. NXDOMAIN handling
+ *   7. cancel before completion
+ *   8. identical queries in flight coalesced, also if the first is cancelled
+ *   9. cache shared by loops
+ *  10. stale-while-revalidate refresh before TTL expiry, cache stats
+ *  11. truncated answer over UDP asked again over TCP
+ *  12. FORMERR to EDNS0 asked again without it
+ *  13. SRV query
  */
 
-#include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "hloop.h"
@@ -24,17 +31,61 @@
 #include "hbase.h"
 #include "htime.h"
 
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
 //------------------------------------------------------------------------------
 // Mock DNS nameserver: parses the incoming question and replies with A records
-// based on a tiny built-in zone. Runs in the same loop.
+// based on a tiny built-in zone. Runs in the same loop, over UDP and TCP of
+// the same port.
 //------------------------------------------------------------------------------
 
 static int g_mock_queries = 0;   // count of questions received by the mock
+static int g_mock_tcp_queries = 0;
+static int g_mock_edns_queries = 0; // with an OPT record
 static int g_mock_port = 0;
 
+#define MOCK_BIG_NADDRS 40
+
+// answer: name pointer -> 0xC00C (qname at offset 12), class IN
+static int mock_put_rr(uint8_t* resp, int roff, int resplen, uint16_t type,
+                       uint8_t ttl, const uint8_t* rdata, int rdlen) {
+    if (roff + 12 + rdlen > resplen) return -1;
+    resp[roff++] = 0xC0; resp[roff++] = 0x0C;
+    resp[roff++] = (uint8_t)(type >> 8); resp[roff++] = (uint8_t)type;
+    resp[roff++] = 0x00; resp[roff++] = 0x01; // class IN
+    resp[roff++] = 0x00; resp[roff++] = 0x00;
+    resp[roff++] = 0x00; resp[roff++] = ttl;
+    resp[roff++] = (uint8_t)(rdlen >> 8); resp[roff++] = (uint8_t)rdlen;
+    memcpy(resp + roff, rdata, rdlen);
+    return roff + rdlen;
+}
+
+// SRV rdata: priority, weight, port, target labels
+static int mock_srv_rdata(uint8_t* rdata, int priority, int weight, int port, const char* label) {
+    int len = (int)strlen(label);
+    rdata[0] = 0; rdata[1] = (uint8_t)priority;
+    rdata[2] = 0; rdata[3] = (uint8_t)weight;
+    rdata[4] = (uint8_t)(port >> 8); rdata[5] = (uint8_t)port;
+    rdata[6] = (uint8_t)len;
+    memcpy(rdata + 7, label, len);
+    memcpy(rdata + 7 + len, "\x04test\x00", 6);
+    return 7 + len + 6;
+}
+
 // Build a minimal DNS response for the given request buffer.
-// Answers with 93.184.216.34 for any A query except "nx.test" (NXDOMAIN).
-static int mock_build_response(const uint8_t* req, int reqlen, uint8_t* resp, int resplen) {
+// Answers with 93.184.216.34 for any A query except "nx.test" (NXDOMAIN),
+// ttl 2 for "short.*", 60 for others.
+// "big.test": truncated over UDP, MOCK_BIG_NADDRS A records over TCP.
+// "noedns.test": FORMERR to a query with an OPT record.
+// "_svc._tcp.test": 3 SRV records.
+static int mock_build_response(const uint8_t* req, int reqlen, int tcp,
+                               uint8_t* resp, int resplen) {
     if (reqlen < 12) return -1;
     // copy header, set QR=1, RA=1
     memcpy(resp, req, 12);
@@ -61,7 +112,12 @@ static int mock_build_response(const uint8_t* req, int reqlen, uint8_t* resp, in
     int qend = off;
 
     int is_nx = (strcasecmp(name, "nx.test") == 0);
+    uint8_t ttl = strncasecmp(name, "short.", 6) == 0 ? 2 : 60;
     int answer_a = (qtype == 1 && !is_nx); // only answer A here
+    int arcount = (req[10] << 8) | req[11];
+    if (arcount) ++g_mock_edns_queries;
+    int is_big = (strcasecmp(name, "big.test") == 0);
+    int is_srv = (qtype == 33 && strcasecmp(name, "_svc._tcp.test") == 0);
 
     // counts
     resp[4] = req[4]; resp[5] = req[5];  // qdcount = 1
@@ -79,6 +135,39 @@ static int mock_build_response(const uint8_t* req, int reqlen, uint8_t* resp, in
     memcpy(resp + 12, req + 12, qend - 12);
     int roff = qend;
 
+    if (strcasecmp(name, "noedns.test") == 0 && arcount) {
+        resp[3] = 0x81; // rcode = 1 FORMERR
+        resp[7] = 0;
+        return roff;
+    }
+    if (is_big && !tcp) {
+        resp[2] |= 0x02; // TC=1
+        resp[7] = 0;
+        return roff;
+    }
+    if (is_big) {
+        resp[7] = MOCK_BIG_NADDRS;
+        for (int i = 0; i < MOCK_BIG_NADDRS; ++i) {
+            uint8_t ip[4] = { 10, 0, 0, (uint8_t)(i + 1) };
+            roff = mock_put_rr(resp, roff, resplen, 1, ttl, ip, 4);
+            if (roff < 0) return -1;
+        }
+        return roff;
+    }
+    if (is_srv) {
+        // in the wire order not sorted
+        uint8_t rdata[64];
+        resp[7] = 3;
+        int rdlen = mock_srv_rdata(rdata, 20, 0, 8003, "c");
+        roff = mock_put_rr(resp, roff, resplen, 33, ttl, rdata, rdlen);
+        if (roff < 0) return -1;
+        rdlen = mock_srv_rdata(rdata, 10, 5, 8002, "b");
+        roff = mock_put_rr(resp, roff, resplen, 33, ttl, rdata, rdlen);
+        if (roff < 0) return -1;
+        rdlen = mock_srv_rdata(rdata, 10, 60, 8001, "a");
+        return mock_put_rr(resp, roff, resplen, 33, ttl, rdata, rdlen);
+    }
+
     if (answer_a) {
         // answer: name pointer -> 0xC00C, type A, class IN, ttl 60, rdlen 4
         if (roff + 16 > resplen) return -1;
@@ -86,7 +175,7 @@ static int mock_build_response(const uint8_t* req, int reqlen, uint8_t* resp, in
         resp[roff++] = 0x00; resp[roff++] = 0x01; // type A
         resp[roff++] = 0x00; resp[roff++] = 0x01; // class IN
         resp[roff++] = 0x00; resp[roff++] = 0x00;
-        resp[roff++] = 0x00; resp[roff++] = 0x3C; // ttl 60
+        resp[roff++] = 0x00; resp[roff++] = ttl;
         resp[roff++] = 0x00; resp[roff++] = 0x04; // rdlen 4
         resp[roff++] = 93;  resp[roff++] = 184;
         resp[roff++] = 216; resp[roff++] = 34;
@@ -97,21 +186,44 @@ static int mock_build_response(const uint8_t* req, int reqlen, uint8_t* resp, in
 static void mock_on_recv(hio_t* io, void* buf, int readbytes) {
     ++g_mock_queries;
     uint8_t resp[512];
-    int rlen = mock_build_response((const uint8_t*)buf, readbytes, resp, sizeof(resp));
+    int rlen = mock_build_response((const uint8_t*)buf, readbytes, 0, resp, sizeof(resp));
     if (rlen > 0) {
         // reply to sender (peeraddr was set by recvfrom)
         hio_sendto(io, resp, rlen, hio_peeraddr(io));
     }
 }
 
+// NOTE: a query of 2-byte length + message in one read on loopback
+static void mock_on_tcp_recv(hio_t* io, void* buf, int readbytes) {
+    ++g_mock_queries;
+    ++g_mock_tcp_queries;
+    uint8_t resp[2 + 4096];
+    if (readbytes < 2) return;
+    int rlen = mock_build_response((const uint8_t*)buf + 2, readbytes - 2, 1, resp + 2, sizeof(resp) - 2);
+    if (rlen > 0) {
+        resp[0] = (uint8_t)(rlen >> 8);
+        resp[1] = (uint8_t)rlen;
+        hio_write(io, resp, rlen + 2);
+    }
+}
+
+static void mock_on_accept(hio_t* io) {
+    hio_setcb_read(io, mock_on_tcp_recv);
+    hio_read(io);
+}
+
 static hio_t* start_mock_nameserver(hloop_t* loop) {
     // bind an ephemeral UDP port on 127.0.0.1
     hio_t* io = hloop_create_udp_server(loop, "127.0.0.1", 0);
-    assert(io != NULL);
+    CHECK(io != NULL);
     struct sockaddr* la = hio_localaddr(io);
     g_mock_port = ntohs(((struct sockaddr_in*)la)->sin_port);
     hio_setcb_read(io, mock_on_recv);
     hio_read(io);
+    // and TCP of the same port
+    hio_t* listenio = hloop_create_tcp_server(loop, "127.0.0.1", g_mock_port, mock_on_accept);
+    CHECK(listenio != NULL);
+    (void)listenio;
     return io;
 }
 
@@ -132,9 +244,9 @@ static void on_expect(hdns_t* query, const hdns_result_t* result, void* userdata
     expect_t* e = (expect_t*)userdata;
     e->got = 1;
     printf("[%s] status=%d naddrs=%d\n", e->label, result->status, result->naddrs);
-    assert(result->status == e->want_status);
+    CHECK(result->status == e->want_status);
     if (result->status == HDNS_STATUS_OK) {
-        assert(result->naddrs >= e->want_min_addrs);
+        CHECK(result->naddrs >= e->want_min_addrs);
     }
     hloop_stop(e->loop);
 }
@@ -148,9 +260,9 @@ static void run_expect(hloop_t* loop, const char* host, const hdns_setting_t* op
     e.want_min_addrs = want_min_addrs;
     e.loop = loop;
     hdns_t* q = hdns_resolve_ex(loop, host, opt, on_expect, &e);
-    assert(q != NULL);
+    CHECK(q != NULL);
     hloop_run(loop);
-    assert(e.got == 1);
+    CHECK(e.got == 1);
 }
 
 // callback that must NEVER be invoked (cancel test)
@@ -162,6 +274,34 @@ static void on_never(hdns_t* query, const hdns_result_t* result, void* userdata)
 static void stop_after(htimer_t* timer) {
     hloop_stop(hevent_loop(timer));
 }
+static void run_for(hloop_t* loop, int ms) {
+    htimer_add(loop, stop_after, ms, 1);
+    hloop_run(loop);
+}
+
+static int g_ok_count = 0;
+static void on_count(hdns_t* query, const hdns_result_t* result, void* userdata) {
+    (void)query; (void)userdata;
+    CHECK(result->status == HDNS_STATUS_OK && result->naddrs == 1);
+    ++g_ok_count;
+}
+
+typedef struct {
+    int         got;
+    hloop_t*    loop;
+} srv_expect_t;
+
+static void on_srv(hdns_t* query, const hdns_srv_result_t* result, void* userdata) {
+    (void)query;
+    srv_expect_t* e = (srv_expect_t*)userdata;
+    e->got = 1;
+    printf("[%s] status=%d nsrvs=%d\n", result->name, result->status, result->nsrvs);
+    CHECK(result->status == HDNS_STATUS_OK && result->nsrvs == 3);
+    CHECK(result->srvs[0].port == 8001 && strcmp(result->srvs[0].target, "a.test") == 0);
+    CHECK(result->srvs[1].port == 8002 && result->srvs[1].weight == 5);
+    CHECK(result->srvs[2].port == 8003 && result->srvs[2].priority == 20);
+    hloop_stop(e->loop);
+}
 
 int main() {
     hloop_t* loop = hloop_new(0);
@@ -195,21 +335,21 @@ int main() {
         hdns_setting_t oh = opt;
         oh.family = HDNS_QUERY_BOTH;
         run_expect(loop, "localhost", &oh, HDNS_STATUS_OK, 1);
-        assert(g_mock_queries == before); // hosts hit, no query sent
+        CHECK(g_mock_queries == before); // hosts hit, no query sent
     }
 
     // 4) real query round-trip against the mock nameserver
     {
         int before = g_mock_queries;
         run_expect(loop, "example.test", &opt, HDNS_STATUS_OK, 1);
-        assert(g_mock_queries > before); // a question reached the mock
+        CHECK(g_mock_queries > before); // a question reached the mock
     }
 
     // 5) cache hit: second resolve of same host must not query the mock again
     {
         int before = g_mock_queries;
         run_expect(loop, "example.test", &opt, HDNS_STATUS_OK, 1);
-        assert(g_mock_queries == before); // served from cache
+        CHECK(g_mock_queries == before); // served from cache
     }
 
     // 6) NXDOMAIN
@@ -227,15 +367,108 @@ int main() {
         // use a host the mock does not answer quickly? It answers immediately,
         // so cancel synchronously right after issuing, before the deferred send.
         hdns_t* q = hdns_resolve_ex(loop, "cancel.test", &oc, on_never, NULL);
-        assert(q != NULL);
+        CHECK(q != NULL);
         hdns_cancel(q);
         // spin the loop briefly to ensure no callback is delivered
         htimer_add(loop, stop_after, 200, 1);
         hloop_run(loop);
-        assert(g_cancel_cb_called == 0);
+        CHECK(g_cancel_cb_called == 0);
         printf("[cancel.test] callback correctly NOT called\n");
     }
 
+    // 8) identical queries in flight: one question, all callbacks
+    {
+        hdns_cache_stats_t st0, st1;
+        hdns_cache_stats(&st0);
+        int before = g_mock_queries;
+        g_ok_count = 0;
+        for (int i = 0; i < 3; ++i) {
+            hdns_resolve_ex(loop, "co.test", &opt, on_count, NULL);
+        }
+        // the first cancelled, the others still answered
+        g_cancel_cb_called = 0;
+        hdns_t* q = hdns_resolve_ex(loop, "co2.test", &opt, on_never, NULL);
+        hdns_resolve_ex(loop, "co2.test", &opt, on_count, NULL);
+        hdns_cancel(q);
+        run_for(loop, 200);
+        CHECK(g_ok_count == 4);
+        CHECK(g_cancel_cb_called == 0);
+        CHECK(g_mock_queries == before + 2);
+        hdns_cache_stats(&st1);
+        CHECK(st1.coalesced == st0.coalesced + 3);
+        printf("[co.test] coalesced %d queries\n", (int)(st1.coalesced - st0.coalesced));
+    }
+
+    // 9) cache shared by loops: another loop hits without a question
+    {
+        int before = g_mock_queries;
+        hloop_t* loop2 = hloop_new(0);
+        run_expect(loop2, "example.test", &opt, HDNS_STATUS_OK, 1);
+        hloop_free(&loop2);
+        CHECK(g_mock_queries == before);
+    }
+
+    // 10) stale-while-revalidate: ttl 2s, refreshed in its last 1s
+    {
+        hdns_cache_stats_t st0, st1;
+        run_expect(loop, "short.test", &opt, HDNS_STATUS_OK, 1);
+        run_for(loop, 1200);
+        hdns_cache_stats(&st0);
+        int before = g_mock_queries;
+        g_ok_count = 0;
+        hdns_resolve_ex(loop, "short.test", &opt, on_count, NULL);
+        hdns_resolve_ex(loop, "short.test", &opt, on_count, NULL);
+        run_for(loop, 200);
+        CHECK(g_ok_count == 2);
+        // served stale, one refresh in the background
+        CHECK(g_mock_queries == before + 1);
+        hdns_cache_stats(&st1);
+        CHECK(st1.stale_hits == st0.stale_hits + 2);
+        CHECK(st1.hits == st0.hits + 2);
+        // refreshed: still a hit after the old ttl
+        run_for(loop, 1000);
+        run_expect(loop, "short.test", &opt, HDNS_STATUS_OK, 1);
+        hdns_cache_stats(&st0);
+        CHECK(st0.misses == st1.misses && st0.hits == st1.hits + 1);
+        printf("[short.test] refreshed before expiry\n");
+
+        hdns_clear_cache(NULL);
+        hdns_cache_stats(&st1);
+        CHECK(st1.entries == 0);
+    }
+
+    // 11) truncated over UDP: asked again over TCP, more addresses than fit in 512 bytes
+    {
+        int before = g_mock_tcp_queries;
+        hdns_setting_t ob = opt;
+        ob.use_cache = 0;
+        run_expect(loop, "big.test", &ob, HDNS_STATUS_OK, MOCK_BIG_NADDRS);
+        CHECK(g_mock_tcp_queries == before + 1);
+    }
+
+    // 12) FORMERR to EDNS0: asked again without the OPT record
+    {
+        int before = g_mock_queries;
+        int edns_before = g_mock_edns_queries;
+        hdns_setting_t oe = opt;
+        oe.use_cache = 0;
+        run_expect(loop, "noedns.test", &oe, HDNS_STATUS_OK, 1);
+        CHECK(g_mock_queries == before + 2);
+        CHECK(g_mock_edns_queries == edns_before + 1);
+    }
+
+    // 13) SRV, sorted by priority then weight
+    {
+        srv_expect_t e;
+        memset(&e, 0, sizeof(e));
+        e.loop = loop;
+        hdns_t* q = hdns_resolve_srv(loop, "_svc._tcp.test", &opt, on_srv, &e);
+        CHECK(q != NULL);
+        (void)q;
+        hloop_run(loop);
+        CHECK(e.got == 1);
+    }
+
     hio_close(mock);
     hloop_free(&loop);
     printf("\nALL hdns_test PASSED\n");
@@ -0,0 +1,295 @@
+/*
+ * hio_migrate_test: move ios between running loops.
+ *
+ *   1. write from another thread while moving: data arrives, write_queue is flushed
+ *      by the new loop, and reads go on in the new loop.
+ *   2. close in the new loop before hio_migrate_event_cb runs.
+ *   3. keepalive and read timeouts fire in the new loop.
+ *   4. TcpServer rebalance: connections move to the idle worker loop, echo still
+ *      works, and EventLoop::connectionNum stays balanced.
+ */
+
+#include <string.h>
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hsocket.h"
+#include "htime.h"
+#include "EventLoopThread.h"
+#include "TcpServer.h"
+
+using namespace hv;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            return -1; \
+        } \
+    } while (0)
+
+static void runSync(const EventLoopPtr& loop, std::function<void()> fn) {
+    std::promise<void> done;
+    loop->runInLoop([&fn, &done]() {
+        fn();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+// block loop in a queued callback until fn returns true
+static void blockLoop(const EventLoopPtr& loop, std::function<bool()> fn) {
+    std::promise<void> blocked;
+    loop->queueInLoop([&blocked, fn]() {
+        blocked.set_value();
+        while (!fn()) hv_msleep(1);
+    });
+    blocked.get_future().wait();
+}
+
+static bool waitFor(std::function<bool()> fn, int timeout_ms = 3000) {
+    uint64_t end = gettick_ms() + timeout_ms;
+    while (!fn()) {
+        if (gettick_ms() > end) return false;
+        hv_msleep(1);
+    }
+    return true;
+}
+
+static int newSocketpair(int fds[2]) {
+    if (Socketpair(AF_INET, SOCK_STREAM, 0, fds) != 0) return -1;
+    // small buffers, so writes are queued
+    int bufsize = 16 * 1024;
+    for (int i = 0; i < 2; ++i) {
+        setsockopt(fds[i], SOL_SOCKET, SO_SNDBUF, (const char*)&bufsize, sizeof(bufsize));
+        setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, (const char*)&bufsize, sizeof(bufsize));
+    }
+    // fail rather than hang if never sent
+    so_rcvtimeo(fds[1], 3000);
+    return 0;
+}
+
+struct IoState {
+    std::atomic<long>   read_tid{0};
+    std::atomic<long>   close_tid{0};
+    std::atomic<int>    close_cnt{0};
+    std::string         readbuf;
+};
+
+static void on_read(hio_t* io, void* buf, int readbytes) {
+    IoState* state = (IoState*)hevent_userdata(io);
+    state->readbuf.append((const char*)buf, readbytes);
+    state->read_tid = hv_gettid();
+}
+
+static void on_close(hio_t* io) {
+    IoState* state = (IoState*)hevent_userdata(io);
+    state->close_tid = hv_gettid();
+    ++state->close_cnt;
+}
+
+static hio_t* newIo(const EventLoopPtr& loop, int fd, IoState* state) {
+    hio_t* io = NULL;
+    runSync(loop, [&]() {
+        io = hio_get(loop->loop(), fd);
+        hevent_set_userdata(io, state);
+        hio_setcb_read(io, on_read);
+        hio_setcb_close(io, on_close);
+        hio_read(io);
+    });
+    return io;
+}
+
+static int migrate(const EventLoopPtr& from, hio_t* io, const EventLoopPtr& to) {
+    int ret = -1;
+    runSync(from, [&]() {
+        ret = hio_migrate(io, to->loop());
+    });
+    return ret;
+}
+
+static int test_write_while_moving(const EventLoopPtr& a, const EventLoopPtr& b) {
+    int fds[2];
+    CHECK(newSocketpair(fds) == 0);
+    IoState state;
+    hio_t* io = newIo(a, fds[0], &state);
+
+    std::atomic<bool> release(false);
+    blockLoop(b, [&release]() { return release.load(); });
+    CHECK(migrate(a, io, b) == 0);
+
+    // write from a third thread while the new loop has not attached io yet
+    const int total = 4 * 1024 * 1024;
+    const int chunk = 64 * 1024;
+    std::string data(total, '\0');
+    for (int i = 0; i < total; ++i) data[i] = (char)(i % 251);
+    std::thread writer([io, &data, chunk, total]() {
+        for (int off = 0; off < total; off += chunk) {
+            hio_write(io, data.data() + off, chunk);
+        }
+    });
+    writer.join();
+    CHECK(hio_write_bufsize(io) > 0);
+    release = true;
+
+    // the new loop flushes write_queue as the peer reads
+    std::string recvd;
+    char buf[65536];
+    while ((int)recvd.size() < total) {
+        int n = recv(fds[1], buf, sizeof(buf), 0);
+        if (n <= 0) break;
+        recvd.append(buf, n);
+    }
+    CHECK(recvd == data);
+    bool complete = false;
+    runSync(b, [&]() {
+        complete = hevent_loop(io) == b->loop() && hio_write_is_complete(io);
+    });
+    CHECK(complete);
+
+    // and reads in the new loop
+    CHECK(send(fds[1], "ping", 4, 0) == 4);
+    CHECK(waitFor([&state]() { return state.read_tid != 0; }));
+    CHECK(state.read_tid == b->tid());
+
+    runSync(b, [io]() { hio_close(io); });
+    CHECK(state.close_cnt == 1 && state.close_tid == b->tid());
+    closesocket(fds[1]);
+    printf("write while moving OK\n");
+    return 0;
+}
+
+static int test_close_before_attached(const EventLoopPtr& a, const EventLoopPtr& b) {
+    int fds[2];
+    CHECK(newSocketpair(fds) == 0);
+    IoState state;
+    hio_t* io = newIo(a, fds[0], &state);
+
+    // close in the new loop thread, before hio_migrate_event_cb queued after this
+    std::atomic<bool> migrated(false);
+    blockLoop(b, [&migrated, io]() {
+        if (!migrated) return false;
+        hio_close(io);
+        return true;
+    });
+    CHECK(migrate(a, io, b) == 0);
+    migrated = true;
+
+    CHECK(waitFor([&state]() { return state.close_cnt != 0; }));
+    // hio_migrate_event_cb runs after, not reopened
+    runSync(b, []() {});
+    CHECK(state.close_cnt == 1 && state.close_tid == b->tid());
+    char buf[16];
+    CHECK(recv(fds[1], buf, sizeof(buf), 0) == 0);
+    closesocket(fds[1]);
+    printf("close before attached OK\n");
+    return 0;
+}
+
+static int test_timeouts(const EventLoopPtr& a, const EventLoopPtr& b) {
+    int fds[2][2];
+    IoState states[2];
+    hio_t* ios[2];
+    for (int i = 0; i < 2; ++i) {
+        CHECK(newSocketpair(fds[i]) == 0);
+        ios[i] = newIo(a, fds[i][0], &states[i]);
+    }
+    runSync(a, [&ios]() {
+        hio_set_keepalive_timeout(ios[0], 300);
+        hio_set_read_timeout(ios[1], 300);
+    });
+    uint64_t start = gettick_ms();
+    for (int i = 0; i < 2; ++i) {
+        CHECK(migrate(a, ios[i], b) == 0);
+    }
+    for (int i = 0; i < 2; ++i) {
+        CHECK(waitFor([&states, i]() { return states[i].close_cnt != 0; }));
+        CHECK(states[i].close_tid == b->tid());
+        closesocket(fds[i][1]);
+    }
+    CHECK(gettick_ms() - start >= 250);
+    printf("timeouts in new loop OK\n");
+    return 0;
+}
+
+static int test_rebalance() {
+    const int nclients = 8;
+    int port = 40866;
+    TcpServer srv;
+    CHECK(srv.createsocket(port, "127.0.0.1") >= 0);
+    srv.onMessage = [](const SocketChannelPtr& channel, Buffer* buf) {
+        channel->write(buf);
+    };
+    srv.setThreadNum(2);
+    srv.setRebalance(100, 10, 64);
+    srv.start();
+    EventLoopPtr busy = srv.loop(0);
+    EventLoopPtr idle = srv.loop(1);
+
+    std::vector<int> clients;
+    for (int i = 0; i < nclients; ++i) {
+        int fd = ConnectTimeout("127.0.0.1", port, 3000);
+        CHECK(fd >= 0);
+        so_rcvtimeo(fd, 3000);
+        clients.push_back(fd);
+    }
+    CHECK(waitFor([&srv]() { return srv.connectionNum() == nclients; }));
+    CHECK(busy->connectionNum + idle->connectionNum == nclients);
+
+    // keep loop 0 busy 80% of the time
+    TimerID spin = busy->setInterval(10, [](TimerID) {
+        uint64_t end = gettick_ms() + 8;
+        while (gettick_ms() < end) {}
+    });
+    CHECK(waitFor([&idle]() { return idle->connectionNum == nclients - 1; }, 5000));
+    busy->killTimer(spin);
+    hv_msleep(300);
+    CHECK(busy->connectionNum + idle->connectionNum == nclients);
+    CHECK(srv.connectionNum() == nclients);
+
+    // echo on moved connections
+    for (int fd : clients) {
+        char buf[16] = {0};
+        CHECK(send(fd, "hello", 5, 0) == 5);
+        int n = 0;
+        while (n < 5) {
+            int nread = recv(fd, buf + n, sizeof(buf) - n, 0);
+            if (nread <= 0) break;
+            n += nread;
+        }
+        CHECK(n == 5 && strcmp(buf, "hello") == 0);
+    }
+
+    for (int fd : clients) {
+        closesocket(fd);
+    }
+    CHECK(waitFor([&srv]() { return srv.connectionNum() == 0; }));
+    CHECK(waitFor([&busy, &idle]() { return busy->connectionNum == 0 && idle->connectionNum == 0; }));
+    srv.stop();
+    printf("rebalance OK\n");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (strcmp(hio_engine(), "io_uring") == 0) {
+        // NOTE: hio_migrate refuses ios driven by io_uring
+        printf("hio_migrate not supported by io_uring, skip\n");
+        return 0;
+    }
+    EventLoopThread a, b;
+    a.start();
+    b.start();
+    if (test_write_while_moving(a.loop(), b.loop()) != 0) return -1;
+    if (test_close_before_attached(a.loop(), b.loop()) != 0) return -1;
+    if (test_timeouts(a.loop(), b.loop()) != 0) return -1;
+    a.stop();
+    b.stop();
+    if (test_rebalance() != 0) return -1;
+    printf("hio_migrate_test OK\n");
+    return 0;
+}
@@ -1,4 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "hlog.h"
+#include "hthread.h"
+
+#define ASYNC_BEGIN     100000
+#define ASYNC_END       199999
+#define ASYNC2_BEGIN    200000
+#define ASYNC2_END      299999
+
+static HTHREAD_ROUTINE(async_writer) {
+    for (int i = ASYNC2_BEGIN; i <= ASYNC2_END; ++i) {
+        hlogi("[%d] async2 xxxxxxxxxxxxxxxxxxxxxxxx", i);
+    }
+    return 0;
+}
+
+// records of each writer all there in order, before "show sync after async"
+static int check_async(const char* logfile) {
+    FILE* fp = fopen(logfile, "r");
+    if (fp == NULL) {
+        printf("open %s failed!\n", logfile);
+        return -1;
+    }
+    int next = ASYNC_BEGIN;
+    int next2 = ASYNC2_BEGIN;
+    int sync_after = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        if (strstr(line, "show sync after async")) {
+            sync_after = 1;
+            break;
+        }
+        const char* p = strstr(line, "] async");
+        if (p == NULL) continue;
+        const char* num = strchr(line, '[');
+        int i = num ? atoi(num + 1) : -1;
+        int* pnext = p[7] == '2' ? &next2 : &next;
+        if (i != *pnext) {
+            printf("async record [%d], want [%d]\n", i, *pnext);
+            fclose(fp);
+            return -1;
+        }
+        ++*pnext;
+    }
+    fclose(fp);
+    if (next != ASYNC_END + 1 || next2 != ASYNC2_END + 1 || !sync_after) {
+        printf("async records lost: next=%d next2=%d sync_after=%d\n", next, next2, sync_after);
+        return -1;
+    }
+    return 0;
+}
 
 int main(int argc, char* argv[]) {
     char logfile[] = "hlog_test.log";
@@ -18,5 +71,22 @@ int main(int argc, char* argv[]) {
     hloge("%s", "show error");
     hlogf("%s", "show fatal");
 
+    // test async: 2 writers, per-thread rings batched into writev
+    hlog_set_max_filesize_by_str("64M");
+    logger_set_async_policy(hlog, LOG_ASYNC_BLOCK);
+    hlog_enable_async();
+    hthread_t th = hthread_create(async_writer, NULL);
+    for (int i = ASYNC_BEGIN; i <= ASYNC_END; ++i) {
+        hlogi("[%d] async xxxxxxxxxxxxxxxxxxxxxxxxx", i);
+    }
+    hthread_join(th);
+    hlog_disable_async();
+    hlogi("%s", "show sync after async");
+    hlog_fsync();
+
+    if (check_async(hlog_get_cur_file()) != 0) {
+        return -1;
+    }
+    printf("hlog_test OK\n");
     return 0;
 }
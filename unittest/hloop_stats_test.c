@@ -0,0 +1,113 @@
+/*
+ * hloop_stats_test: the slowest callback of hloop_stats.
+ *
+ *   1. a slow timer is recorded as its htimer_cb.
+ *   2. a slow accept is recorded as haccept_cb with the fd of listenio.
+ *   3. a slow read is recorded as hread_cb with the fd of connio,
+ *      io events are not recorded as the internal dispatcher.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hloop.h"
+#include "hsocket.h"
+#include "hbase.h"
+#include "htime.h"
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define SLOW_MS     50
+
+static hio_t*   listen_io = NULL;
+static hio_t*   server_io = NULL;
+static int      nread = 0;
+
+// NOTE: busy instead of sleep, cb_time is measured by gethrtime_us
+static void busy_wait(int ms) {
+    uint64_t end = gethrtime_us() + ms * 1000;
+    while (gethrtime_us() < end);
+}
+
+static void check_max_cb(hloop_t* loop, void* cb, hevent_type_e type, int fd) {
+    hloop_stats_t stats;
+    hloop_stats(loop, &stats);
+    CHECK((void*)stats.max_cb == cb);
+    CHECK(stats.max_cb_type == type);
+    CHECK(stats.max_cb_fd == fd);
+    CHECK(stats.max_cb_time >= SLOW_MS * 1000);
+    hloop_reset_stats(loop);
+}
+
+static void on_timeout(htimer_t* timer) {
+    (void)timer;
+    printf("timeout!\n");
+    exit(1);
+}
+
+static void on_slow_timer(htimer_t* timer) {
+    (void)timer;
+    busy_wait(SLOW_MS);
+}
+
+static void on_read(hio_t* io, void* buf, int readbytes);
+
+static void on_accept(hio_t* io) {
+    busy_wait(SLOW_MS);
+    server_io = io;
+    hio_setcb_read(io, on_read);
+    hio_read(io);
+}
+
+static void on_read(hio_t* io, void* buf, int readbytes) {
+    (void)buf; (void)readbytes;
+    // 2. slow accept
+    check_max_cb(hevent_loop(io), (void*)on_accept, HEVENT_TYPE_IO, hio_fd(listen_io));
+    busy_wait(SLOW_MS);
+    ++nread;
+}
+
+static void on_connect(hio_t* io) {
+    hio_write(io, "hello", 5);
+}
+
+static void on_check(htimer_t* timer) {
+    hloop_t* loop = hevent_loop(timer);
+    if (server_io == NULL) {
+        // 1. slow timer
+        check_max_cb(loop, (void*)on_slow_timer, HEVENT_TYPE_TIMEOUT, -1);
+        sockaddr_u addr;
+        socklen_t addrlen = sizeof(addr);
+        CHECK(getsockname(hio_fd(listen_io), &addr.sa, &addrlen) == 0);
+        hio_t* io = hloop_create_tcp_client(loop, "127.0.0.1", sockaddr_port(&addr), on_connect, NULL);
+        CHECK(io != NULL);
+        htimer_add(loop, on_check, 500, 1);
+        return;
+    }
+    // 3. slow read
+    CHECK(nread == 1);
+    check_max_cb(loop, (void*)on_read, HEVENT_TYPE_IO, hio_fd(server_io));
+    hloop_stop(loop);
+}
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    hloop_t* loop = hloop_new(HLOOP_FLAG_STATS);
+    CHECK(loop != NULL);
+    htimer_add(loop, on_timeout, 5000, 1);
+    listen_io = hloop_create_tcp_server(loop, "127.0.0.1", 0, on_accept);
+    CHECK(listen_io != NULL);
+    htimer_add(loop, on_slow_timer, 10, 1);
+    htimer_add(loop, on_check, 200, 1);
+    hloop_run(loop);
+    hloop_free(&loop);
+    printf("hloop_stats_test OK\n");
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * http2_client_test: AsyncHttpClient multiplexes HTTP2 requests over one connection.
+ *
+ *   1. h2c: concurrent requests are streams of one connection up to
+ *      SETTINGS_MAX_CONCURRENT_STREAMS of the server, the rest go to a new connection.
+ *   2. h2 over TLS negotiated by ALPN, with openssl only,
+ *      otherwise https requests are sent by HTTP/1.1.
+ *
+ * usage: run in the root directory of libhv, cert/server.crt and cert/server.key are used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include "HttpServer.h"
+#include "AsyncHttpClient.h"
+#include "EventLoop.h"
+#include "hssl.h"
+#include "htime.h"
+
+using namespace hv;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define TEST_PORT       40892
+#define TEST_HTTPS_PORT 40893
+// NOTE: SETTINGS_MAX_CONCURRENT_STREAMS of Http2Parser
+#define MAX_STREAMS     100
+#define TEST_REQUESTS   150
+// NOTE: responses are held until all requests arrived
+#define HOLD_MS         300
+
+static std::mutex           s_mutex;
+static std::map<int, int>   s_active; // client port => requests in handling
+static int                  s_max_active = 0;
+static std::set<int>        s_http_majors;
+
+static void reset_server_stats() {
+    std::lock_guard<std::mutex> locker(s_mutex);
+    s_active.clear();
+    s_max_active = 0;
+    s_http_majors.clear();
+}
+
+static int on_echo(const HttpContextPtr& ctx) {
+    int port = ctx->request->client_addr.port;
+    {
+        std::lock_guard<std::mutex> locker(s_mutex);
+        int active = ++s_active[port];
+        if (active > s_max_active) s_max_active = active;
+        s_http_majors.insert(ctx->request->http_major);
+    }
+    setTimeout(HOLD_MS, [ctx, port](TimerID timerID) {
+        (void)timerID;
+        {
+            std::lock_guard<std::mutex> locker(s_mutex);
+            --s_active[port];
+        }
+        ctx->send(ctx->param("id"));
+    });
+    return HTTP_STATUS_UNFINISHED;
+}
+
+static int send_requests(AsyncHttpClient* cli, const char* scheme, int port, int num) {
+    std::atomic<int> nresp(0);
+    std::atomic<int> nok(0);
+    for (int i = 0; i < num; ++i) {
+        auto req = std::make_shared<HttpRequest>();
+        req->http_major = 2;
+        req->http_minor = 0;
+        req->timeout = 10;
+        req->url = std::string(scheme) + "://127.0.0.1:" + std::to_string(port) + "/echo?id=" + std::to_string(i);
+        std::string expected = std::to_string(i);
+        cli->send(req, [&nresp, &nok, expected](const HttpResponsePtr& resp) {
+            if (resp && resp->status_code == HTTP_STATUS_OK && resp->body == expected) {
+                ++nok;
+            }
+            ++nresp;
+        });
+    }
+    for (int i = 0; i < 1000 && nresp < num; ++i) {
+        hv_msleep(10);
+    }
+    CHECK(nresp == num);
+    return nok;
+}
+
+static void test_multiplex(AsyncHttpClient* cli, const char* scheme, int port, int expected_http_major) {
+    // NOTE: SETTINGS of server are known by the connection after the first response
+    CHECK(send_requests(cli, scheme, port, 1) == 1);
+    reset_server_stats();
+    CHECK(send_requests(cli, scheme, port, TEST_REQUESTS) == TEST_REQUESTS);
+    std::lock_guard<std::mutex> locker(s_mutex);
+    CHECK(s_http_majors.size() == 1 && *s_http_majors.begin() == expected_http_major);
+    if (expected_http_major == 2) {
+        CHECK(s_max_active == MAX_STREAMS);
+        CHECK(s_active.size() == (TEST_REQUESTS + MAX_STREAMS - 1) / MAX_STREAMS);
+    }
+    printf("%s %d requests by HTTP/%d over %d connections OK\n",
+           scheme, TEST_REQUESTS, expected_http_major, (int)s_active.size());
+}
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    HttpService service;
+    service.GET("/echo", on_echo);
+    HttpServer server(&service);
+    server.setHost("127.0.0.1");
+    server.setPort(TEST_PORT);
+    server.setThreadNum(1);
+    bool with_openssl = strcmp(hssl_backend(), "openssl") == 0;
+    if (HV_WITH_SSL) {
+        server.https_port = TEST_HTTPS_PORT;
+        hssl_ctx_opt_t param;
+        memset(&param, 0, sizeof(param));
+        param.crt_file = "cert/server.crt";
+        param.key_file = "cert/server.key";
+        param.endpoint = HSSL_SERVER;
+        CHECK(server.newSslCtx(&param) == 0);
+    }
+    CHECK(server.start() == 0);
+
+    AsyncHttpClient cli;
+    // 1. h2c
+    test_multiplex(&cli, "http", TEST_PORT, 2);
+    // 2. h2 by ALPN
+    if (HV_WITH_SSL) {
+        test_multiplex(&cli, "https", TEST_HTTPS_PORT, with_openssl ? 2 : 1);
+    }
+
+    CHECK(server.stop() == 0);
+    printf("http2_client_test OK\n");
+    return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * http2_server_test: HttpServer streams of one HTTP2 connection (h2c prior knowledge).
+ *
+ *   1. streams are answered out of order: a sync handler is not blocked by
+ *      async handlers before it, async handlers complete in order of their delays.
+ *   2. async handlers write on hv::async threads, every write is posted to the loop,
+ *      bodies larger than the stream window arrive complete.
+ *   3. closed streams are reaped: requests of all streams are freed after the responses.
+ *   4. proxy routes are not supported over HTTP2, answered with 502.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "HttpServer.h"
+#include "EventLoop.h"
+#include "hsocket.h"
+#include "htime.h"
+#include "hasync.h"
+
+#include <nghttp2/nghttp2.h>
+
+using namespace hv;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define TEST_PORT       40891
+#define ASYNC_STREAMS   8
+#define ASYNC_CHUNKS    8
+#define ASYNC_CHUNK     (16 * 1024)
+#define ASYNC_BODYSIZE  (ASYNC_CHUNKS * ASYNC_CHUNK)
+
+static std::mutex                           s_mutex;
+static std::vector<std::weak_ptr<HttpRequest>> s_requests;
+
+static char async_byte(int id, int i) {
+    return (char)('a' + (id + i) % 26);
+}
+
+static void async_handler(const HttpRequestPtr& req, const HttpResponseWriterPtr& writer) {
+    {
+        std::lock_guard<std::mutex> locker(s_mutex);
+        s_requests.push_back(req);
+    }
+    int id = atoi(req->GetParam("id").c_str());
+    hv_msleep(atoi(req->GetParam("ms").c_str()));
+    writer->Begin();
+    writer->WriteStatus(HTTP_STATUS_OK);
+    writer->WriteHeader("Content-Type", "application/octet-stream");
+    std::string chunk(ASYNC_CHUNK, '\0');
+    for (int i = 0; i < ASYNC_CHUNKS; ++i) {
+        memset(&chunk[0], async_byte(id, i), ASYNC_CHUNK);
+        CHECK(writer->WriteBody(chunk) >= 0);
+    }
+    writer->End();
+}
+
+//------------------h2 client------------------------------------
+struct h2_stream_t {
+    std::string path;
+    int         status;
+    std::string body;
+    bool        closed;
+    uint32_t    error_code;
+};
+
+struct h2_client_t {
+    int                         fd;
+    nghttp2_session*            session;
+    std::map<int32_t, h2_stream_t> streams;
+    std::vector<int32_t>        closed_order;
+};
+
+static ssize_t on_send(nghttp2_session* session, const uint8_t* data, size_t length, int flags, void* userdata) {
+    (void)session; (void)flags;
+    h2_client_t* cli = (h2_client_t*)userdata;
+    size_t nsend = 0;
+    while (nsend < length) {
+        ssize_t n = send(cli->fd, (const char*)data + nsend, length - nsend, 0);
+        if (n <= 0) return NGHTTP2_ERR_CALLBACK_FAILURE;
+        nsend += n;
+    }
+    return length;
+}
+
+static int on_header(nghttp2_session* session, const nghttp2_frame* frame,
+                     const uint8_t* name, size_t namelen, const uint8_t* value, size_t valuelen,
+                     uint8_t flags, void* userdata) {
+    (void)session; (void)flags;
+    h2_client_t* cli = (h2_client_t*)userdata;
+    auto iter = cli->streams.find(frame->hd.stream_id);
+    if (iter != cli->streams.end() && namelen == 7 && memcmp(name, ":status", 7) == 0) {
+        iter->second.status = atoi(std::string((const char*)value, valuelen).c_str());
+    }
+    return 0;
+}
+
+static int on_data_chunk(nghttp2_session* session, uint8_t flags, int32_t stream_id,
+                         const uint8_t* data, size_t len, void* userdata) {
+    (void)session; (void)flags;
+    h2_client_t* cli = (h2_client_t*)userdata;
+    auto iter = cli->streams.find(stream_id);
+    CHECK(iter != cli->streams.end());
+    iter->second.body.append((const char*)data, len);
+    return 0;
+}
+
+static int on_stream_close(nghttp2_session* session, int32_t stream_id, uint32_t error_code, void* userdata) {
+    (void)session;
+    h2_client_t* cli = (h2_client_t*)userdata;
+    auto iter = cli->streams.find(stream_id);
+    CHECK(iter != cli->streams.end());
+    iter->second.closed = true;
+    iter->second.error_code = error_code;
+    cli->closed_order.push_back(stream_id);
+    return 0;
+}
+
+static void h2_client_init(h2_client_t* cli, int port) {
+    cli->fd = ConnectTimeout("127.0.0.1", port, 3000);
+    CHECK(cli->fd >= 0);
+    so_rcvtimeo(cli->fd, 5000);
+    nghttp2_session_callbacks* callbacks = NULL;
+    nghttp2_session_callbacks_new(&callbacks);
+    nghttp2_session_callbacks_set_send_callback(callbacks, on_send);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, on_header);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, on_data_chunk);
+    nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, on_stream_close);
+    CHECK(nghttp2_session_client_new(&cli->session, callbacks, cli) == 0);
+    nghttp2_session_callbacks_del(callbacks);
+    CHECK(nghttp2_submit_settings(cli->session, NGHTTP2_FLAG_NONE, NULL, 0) == 0);
+}
+
+static void h2_client_cleanup(h2_client_t* cli) {
+    nghttp2_session_del(cli->session);
+    closesocket(cli->fd);
+}
+
+static int32_t h2_client_get(h2_client_t* cli, const std::string& path) {
+    std::string authority = "127.0.0.1:" + std::to_string(TEST_PORT);
+#define MAKE_NV(name, value) \
+    { (uint8_t*)name, (uint8_t*)value.c_str(), sizeof(name) - 1, value.size(), NGHTTP2_NV_FLAG_NONE }
+    std::string method = "GET", scheme = "http";
+    nghttp2_nv nva[] = {
+        MAKE_NV(":method", method),
+        MAKE_NV(":scheme", scheme),
+        MAKE_NV(":authority", authority),
+        MAKE_NV(":path", path),
+    };
+#undef MAKE_NV
+    int32_t stream_id = nghttp2_submit_request(cli->session, NULL, nva, sizeof(nva) / sizeof(nva[0]), NULL, NULL);
+    CHECK(stream_id > 0);
+    h2_stream_t& stream = cli->streams[stream_id];
+    stream.path = path;
+    stream.status = 0;
+    stream.closed = false;
+    stream.error_code = 0;
+    return stream_id;
+}
+
+static void h2_client_run(h2_client_t* cli) {
+    char buf[16 * 1024];
+    while (cli->closed_order.size() < cli->streams.size()) {
+        CHECK(nghttp2_session_send(cli->session) == 0);
+        int n = recv(cli->fd, buf, sizeof(buf), 0);
+        CHECK(n > 0);
+        CHECK(nghttp2_session_mem_recv(cli->session, (const uint8_t*)buf, n) == n);
+    }
+    CHECK(nghttp2_session_send(cli->session) == 0);
+}
+
+//------------------test------------------------------------
+static void test_http2_streams() {
+    HttpService service;
+    service.GET("/sync", [](HttpRequest* req, HttpResponse* resp) {
+        (void)req;
+        return resp->String("sync");
+    });
+    service.GET("/async", async_handler);
+    service.Proxy("/proxy/", "http://127.0.0.1:9/");
+    // NOTE: one thread per async stream, all of them sleep at the same time
+    hv::async::startup(ASYNC_STREAMS, ASYNC_STREAMS);
+    HttpServer server(&service);
+    server.setHost("127.0.0.1");
+    server.setPort(TEST_PORT);
+    server.setThreadNum(1);
+    CHECK(server.start() == 0);
+
+    h2_client_t cli;
+    h2_client_init(&cli, TEST_PORT);
+    // async streams complete in reverse order of submission
+    std::vector<int32_t> async_ids;
+    for (int id = 0; id < ASYNC_STREAMS; ++id) {
+        int ms = (ASYNC_STREAMS - id) * 100;
+        async_ids.push_back(h2_client_get(&cli, "/async?id=" + std::to_string(id) + "&ms=" + std::to_string(ms)));
+    }
+    int32_t sync_id = h2_client_get(&cli, "/sync");
+    int32_t proxy_id = h2_client_get(&cli, "/proxy/get");
+    h2_client_run(&cli);
+
+    // 1. out of order
+    CHECK(cli.closed_order.size() == ASYNC_STREAMS + 2);
+    CHECK(cli.closed_order[0] == sync_id || cli.closed_order[0] == proxy_id);
+    CHECK(cli.closed_order[1] == sync_id || cli.closed_order[1] == proxy_id);
+    for (int i = 0; i < ASYNC_STREAMS; ++i) {
+        CHECK(cli.closed_order[i + 2] == async_ids[ASYNC_STREAMS - 1 - i]);
+    }
+    const h2_stream_t& sync_stream = cli.streams[sync_id];
+    CHECK(sync_stream.status == 200 && sync_stream.body == "sync" && sync_stream.error_code == 0);
+
+    // 2. bodies written from hv::async threads
+    for (int id = 0; id < ASYNC_STREAMS; ++id) {
+        const h2_stream_t& stream = cli.streams[async_ids[id]];
+        CHECK(stream.status == 200 && stream.error_code == 0);
+        CHECK(stream.body.size() == ASYNC_BODYSIZE);
+        for (int i = 0; i < ASYNC_CHUNKS; ++i) {
+            CHECK(stream.body[i * ASYNC_CHUNK] == async_byte(id, i));
+            CHECK(stream.body[(i + 1) * ASYNC_CHUNK - 1] == async_byte(id, i));
+        }
+    }
+    printf("%d async streams + 1 sync stream out of order OK\n", ASYNC_STREAMS);
+
+    // 3. closed streams reaped by the loop
+    {
+        std::lock_guard<std::mutex> locker(s_mutex);
+        CHECK(s_requests.size() == ASYNC_STREAMS);
+    }
+    // NOTE: requests of reaped streams are reset into the message pool of the loop
+    std::shared_ptr<EventLoop> loop = server.loop(0);
+    CHECK(loop != NULL);
+    bool reaped = false;
+    for (int i = 0; i < 100 && !reaped; ++i) {
+        std::promise<bool> promise;
+        loop->runInLoop([&promise]() {
+            bool all = true;
+            for (auto& weak : s_requests) {
+                HttpRequestPtr req = weak.lock();
+                if (req && !req->query_params.empty()) all = false;
+            }
+            promise.set_value(all);
+        });
+        reaped = promise.get_future().get();
+        if (!reaped) hv_msleep(10);
+    }
+    CHECK(reaped);
+    printf("closed streams reaped OK\n");
+
+    // 4. proxy
+    const h2_stream_t& proxy_stream = cli.streams[proxy_id];
+    CHECK(proxy_stream.status == HTTP_STATUS_BAD_GATEWAY);
+    printf("proxy over http2 502 OK\n");
+
+    h2_client_cleanup(&cli);
+    CHECK(server.stop() == 0);
+}
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    test_http2_streams();
+    printf("http2_server_test OK\n");
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "hbase.h"
+#include "HttpCompressor.h"
+#include "FileCache.h"
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+
+static std::string gunzip(const std::string& in) {
+    std::string out;
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) return out;
+    zs.next_in = (Bytef*)in.data();
+    zs.avail_in = in.size();
+    char buf[4096];
+    int ret = Z_OK;
+    while (ret == Z_OK) {
+        zs.next_out = (Bytef*)buf;
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    }
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END ? out : std::string();
+}
+#endif
+
+static std::string write_file(const std::string& filepath, const std::string& content) {
+    FILE* fp = fopen(filepath.c_str(), "wb");
+    CHECK(fp != NULL);
+    fwrite(content.data(), 1, content.size(), fp);
+    fclose(fp);
+    return filepath;
+}
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    // Accept-Encoding
+    CHECK(http_accept_encodings(NULL) == 0);
+    CHECK(http_accept_encodings("") == 0);
+    CHECK(http_accept_encodings("identity") == 0);
+    CHECK(http_accept_encodings("gzip, deflate, br") == (HTTP_ENCODING_GZIP | HTTP_ENCODING_BR));
+    CHECK(http_accept_encodings("br;q=1.0, gzip;q=0.8, zstd") == (HTTP_ENCODING_BR | HTTP_ENCODING_GZIP | HTTP_ENCODING_ZSTD));
+    CHECK(http_accept_encodings("GZIP;q=0, br") == HTTP_ENCODING_BR);
+    CHECK(http_accept_encodings("gzip; q=0.000") == 0);
+    CHECK(http_accept_encodings("gzip;q=0.01") == HTTP_ENCODING_GZIP);
+    CHECK(http_accept_encodings("x-gzip") == HTTP_ENCODING_GZIP);
+    CHECK(http_accept_encodings("*") == (HTTP_ENCODING_BR | HTTP_ENCODING_ZSTD | HTTP_ENCODING_GZIP));
+    CHECK(http_accept_encodings("gzip;q=0, *") == (HTTP_ENCODING_BR | HTTP_ENCODING_ZSTD));
+    CHECK(http_accept_encodings("*, br;q=0") == (HTTP_ENCODING_ZSTD | HTTP_ENCODING_GZIP));
+    CHECK(http_accept_encodings("*;q=0") == 0);
+    CHECK(http_accept_encodings("gzip, *;q=0") == HTTP_ENCODING_GZIP);
+    CHECK(strcmp(http_encoding_str(HTTP_ENCODING_ZSTD), "zstd") == 0);
+    CHECK(strcmp(http_encoding_suffix(HTTP_ENCODING_GZIP), ".gz") == 0);
+    CHECK(http_content_compressible("text/html; charset=utf-8"));
+    CHECK(http_content_compressible("application/json"));
+    CHECK(!http_content_compressible("image/png"));
+    printf("Accept-Encoding OK\n");
+
+    char tmpl[] = "/tmp/http_compress_test.XXXXXX";
+    if (mkdtemp(tmpl) == NULL) {
+        perror("mkdtemp");
+        return -1;
+    }
+    std::string dir(tmpl);
+    std::string text;
+    for (int i = 0; i < 1000; ++i) {
+        text += "hello libhv ";
+    }
+    std::string filepath = write_file(dir + "/index.html", text);
+
+    // precompressed sidecar is preferred by encoding order
+    write_file(filepath + ".br", "br");
+    write_file(filepath + ".gz", "gz");
+    FileCache cache;
+    FileCache::OpenParam param;
+    file_cache_ptr fc = cache.Open(filepath.c_str(), &param);
+    CHECK(fc != NULL);
+    file_cache_ptr encoded = cache.Encode(fc, HTTP_ENCODING_GZIP | HTTP_ENCODING_BR, true);
+    CHECK(encoded && encoded->content_encoding == "br");
+    CHECK(encoded->filebuf.len == 2 && memcmp(encoded->filebuf.base, "br", 2) == 0);
+    CHECK(strcmp(encoded->etag, fc->etag) != 0);
+    CHECK(cache.Encode(fc, HTTP_ENCODING_GZIP | HTTP_ENCODING_BR, true) == encoded);
+    encoded = cache.Encode(fc, HTTP_ENCODING_GZIP | HTTP_ENCODING_ZSTD, true);
+    CHECK(encoded && encoded->content_encoding == "gzip");
+    CHECK(cache.Encode(fc, HTTP_ENCODING_ZSTD, true) == NULL);
+    CHECK(cache.Encode(fc, HTTP_ENCODING_BR, false) == NULL);
+    printf("Precompressed OK\n");
+
+#ifdef WITH_ZLIB
+    // one shot
+    std::string gz;
+    int ret = hv::HttpCompressor::Compress(HTTP_ENCODING_GZIP, text.data(), text.size(), gz);
+    CHECK(ret == 0 && gz.size() < text.size());
+    CHECK(gunzip(gz) == text);
+
+    // streaming with sync flush
+    hv::HttpCompressor compressor;
+    ret = compressor.Init(HTTP_ENCODING_GZIP);
+    CHECK(ret == 0);
+    gz.clear();
+    for (size_t offset = 0; offset < text.size(); offset += 1000) {
+        size_t len = text.size() - offset < 1000 ? text.size() - offset : 1000;
+        ret = compressor.Compress(text.data() + offset, len, gz, true);
+        CHECK(ret == 0);
+    }
+    ret = compressor.Finish(gz);
+    CHECK(ret == 0);
+    CHECK(gunzip(gz) == text);
+
+    // on the fly, cached as variant
+    std::string other = write_file(dir + "/app.js", text);
+    param = FileCache::OpenParam();
+    fc = cache.Open(other.c_str(), &param);
+    CHECK(fc != NULL);
+    CHECK(cache.Encode(fc, HTTP_ENCODING_GZIP, true, -1) == NULL);
+    encoded = cache.Encode(fc, HTTP_ENCODING_GZIP, true, 0);
+    CHECK(encoded && encoded->content_encoding == "gzip");
+    CHECK((size_t)encoded->st.st_size == encoded->filebuf.len);
+    CHECK(gunzip(std::string(encoded->filebuf.base, encoded->filebuf.len)) == text);
+    CHECK(cache.Encode(fc, HTTP_ENCODING_GZIP, true, 0) == encoded);
+    CHECK(cache.Encode(fc, HTTP_ENCODING_GZIP, true, text.size() + 1) == NULL);
+    printf("Compress OK\n");
+#endif
+
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", tmpl);
+    system(cmd);
+    printf("http_compress_test OK\n");
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <string>
+
+#include "HttpHeaders.h"
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    hv::HttpHeaders headers;
+    CHECK(headers.empty());
+    headers["Content-Type"] = "text/plain";
+    headers["Content-Length"] = "10";
+    headers["Connection"] = "keep-alive";
+    CHECK(headers.size() == 3);
+
+    // case-insensitive
+    CHECK(headers["content-type"] == "text/plain");
+    CHECK(headers.count("CONTENT-LENGTH") == 1);
+    CHECK(headers.find("connection")->second == "keep-alive");
+    CHECK(headers.find("Host") == headers.end());
+    CHECK(headers.size() == 3);
+
+    // insertion order
+    auto iter = headers.begin();
+    CHECK(iter->first == "Content-Type");
+    ++iter;
+    CHECK(iter->first == "Content-Length");
+
+    // insert does not overwrite
+    auto ret = headers.insert(std::make_pair(std::string("content-type"), std::string("text/html")));
+    CHECK(!ret.second && ret.first->second == "text/plain");
+    ret = headers.emplace("Host", "example.com");
+    CHECK(ret.second && headers.size() == 4);
+
+    // references are kept by insert
+    std::string& host = headers["Host"];
+    for (int i = 0; i < 100; ++i) {
+        headers["X-Header-" + std::to_string(i)] = std::to_string(i);
+    }
+    CHECK(host == "example.com");
+    headers["A"] = headers["B"] = "ab";
+    CHECK(headers["A"] == "ab");
+
+    // erase
+    CHECK(headers.erase("content-length") == 1);
+    CHECK(headers.erase("content-length") == 0);
+    CHECK(headers.find("Connection") != headers.end());
+    size_t size = headers.size();
+    for (iter = headers.begin(); iter != headers.end();) {
+        if (iter->first.compare(0, 9, "X-Header-") == 0) {
+            iter = headers.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    CHECK(headers.size() == size - 100);
+    printf("HttpHeaders map interface OK\n");
+
+    // copy and clear
+    hv::HttpHeaders copy = headers;
+    CHECK(copy.size() == headers.size() && copy["host"] == "example.com");
+    // iterators of different headers are not equal
+    CHECK(copy.end() != headers.end() && copy.cbegin() != headers.begin());
+    CHECK(headers.cend() == headers.end());
+    const std::string* key = &headers.begin()->first;
+    headers.clear();
+    CHECK(headers.empty() && headers.find("Host") == headers.end());
+    headers["Server"] = "libhv";
+    // entry reused after clear
+    CHECK(&headers.begin()->first == key);
+    CHECK(headers.size() == 1);
+
+    // from map and initializer_list
+    std::map<std::string, std::string> m;
+    m["a"] = "1";
+    m["b"] = "2";
+    hv::HttpHeaders from_map(m.begin(), m.end());
+    CHECK(from_map.size() == 2 && from_map["A"] == "1");
+    hv::HttpHeaders from_list = {{"X", "1"}, {"x", "2"}};
+    CHECK(from_list.size() == 1 && from_list["X"] == "1");
+    printf("HttpHeaders copy/clear OK\n");
+
+    printf("http_headers_test OK\n");
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Http1Parser: requests fed in one piece take the fast path if they can,
+ * fed byte by byte always go through http_parser, both must be the same.
+ */
+
+#include <stdio.h>
+
+#include <string>
+
+#include "HttpParser.h"
+
+struct ParseResult {
+    int         nparse;
+    bool        complete;
+    std::string events; // states of http_cb
+    HttpRequest req;
+};
+
+static void parse(const std::string& str, size_t step, ParseResult& res) {
+    HttpParser* parser = HttpParser::New(HTTP_SERVER, HTTP_V1);
+    res.events.clear();
+    res.req.http_cb = [&res](HttpMessage* msg, http_parser_state state, const char* data, size_t size) {
+        char event = 'a' + (char)state;
+        if (res.events.empty() || res.events.back() != event) {
+            res.events += event;
+        }
+        if (state == HP_BODY) {
+            msg->body.append(data, size);
+        }
+    };
+    parser->InitRequest(&res.req);
+    res.nparse = 0;
+    for (size_t offset = 0; offset < str.size(); offset += step) {
+        size_t len = str.size() - offset < step ? str.size() - offset : step;
+        int nparse = parser->FeedRecvData(str.data() + offset, len);
+        if (nparse != (int)len) {
+            res.nparse = -1;
+            break;
+        }
+        res.nparse += nparse;
+    }
+    res.complete = parser->IsComplete();
+    delete parser;
+}
+
+static bool same(const ParseResult& a, const ParseResult& b) {
+    if (a.nparse != b.nparse || a.complete != b.complete || a.events != b.events) return false;
+    if (a.nparse < 0) return true;
+    const HttpRequest& r1 = a.req;
+    const HttpRequest& r2 = b.req;
+    if (r1.method != r2.method || r1.url != r2.url ||
+        r1.http_major != r2.http_major || r1.http_minor != r2.http_minor ||
+        r1.content_length != r2.content_length || r1.content_type != r2.content_type ||
+        r1.body != r2.body || r1.cookies.size() != r2.cookies.size() ||
+        r1.headers.size() != r2.headers.size()) {
+        return false;
+    }
+    for (auto iter = r1.headers.begin(); iter != r1.headers.end(); ++iter) {
+        auto found = r2.headers.find(iter->first);
+        if (found == r2.headers.end() || found->second != iter->second) return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    const char* requests[] = {
+        // fast path
+        "GET / HTTP/1.1\r\n\r\n",
+        "GET /index.html?a=1&b=2#frag HTTP/1.1\r\n"
+        "Host: 127.0.0.1:8080\r\n"
+        "User-Agent: curl/7.68.0\r\n"
+        "Accept: */*\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Cookie: sessionid=abc; theme=dark\r\n"
+        "X-Empty:\r\n"
+        "X-Tab:\tvalue with spaces and \t tab  \r\n"
+        "X-Token!#$%&'*+-.^_`|~: 1\r\n"
+        "x-dup: 1\r\n"
+        "X-Dup: 2\r\n"
+        "\r\n",
+        "POST /echo HTTP/1.0\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 17\r\n"
+        "\r\n"
+        "{\"hello\":\"world\"}",
+        "PUT /a HTTP/1.1\r\nContent-Length: 0\r\n\r\n",
+        "DELETE /a HTTP/1.1\r\n\r\n",
+        "HEAD /a HTTP/1.1\r\n\r\n",
+        "OPTIONS /a HTTP/1.1\r\n\r\n",
+        "PATCH /a HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc",
+        "GET /utf8 HTTP/1.1\r\nX-Utf8: \xe4\xbd\xa0\xe5\xa5\xbd\r\n\r\n",
+        // fallback to http_parser
+        "POST /chunked HTTP/1.1\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "5\r\nhello\r\n0\r\n\r\n",
+        "GET /chat HTTP/1.1\r\n"
+        "Connection: Upgrade\r\n"
+        "Upgrade: websocket\r\n"
+        "\r\n",
+        "POST /partial HTTP/1.1\r\nContent-Length: 10\r\n\r\nabc",
+        "GET /pipelined HTTP/1.1\r\n\r\nGET / HTTP/1.1\r\n\r\n",
+        "GET /fold HTTP/1.1\r\nX-Fold: a\r\n b\r\n\r\n",
+        "GET /lf HTTP/1.1\nHost: a\n\n",
+        "GET  /spaces HTTP/1.1\r\n\r\n",
+        "GET /space HTTP/1.1\r\nX-Space : a\r\n\r\n",
+        "GET /ctl HTTP/1.1\r\nX-Ctl: a\x01" "b\r\n\r\n",
+        "CONNECT example.com:443 HTTP/1.1\r\n\r\n",
+        "GET http://example.com/ HTTP/1.1\r\n\r\n",
+        "GET / HTTP/2.0\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 1\r\n\r\na",
+        "POST / HTTP/1.1\r\nContent-Length: 1a\r\n\r\n",
+        "\r\nGET / HTTP/1.1\r\n\r\n",
+        "get / HTTP/1.1\r\n\r\n",
+    };
+
+    for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); ++i) {
+        std::string str(requests[i]);
+        ParseResult whole, bytes;
+        parse(str, str.size(), whole);
+        parse(str, 1, bytes);
+        if (!same(whole, bytes)) {
+            printf("mismatch: %s\n", requests[i]);
+            return -1;
+        }
+    }
+    printf("fast path == http_parser OK\n");
+
+    // long url and headers for the vectorized loops
+    std::string str = "GET /" + std::string(1000, 'a') + " HTTP/1.1\r\n";
+    for (int i = 0; i < 60; ++i) {
+        str += "X-Header-" + std::to_string(i) + ": " + std::string(i * 3, 'v') + "\r\n";
+    }
+    str += "\r\n";
+    ParseResult whole, bytes;
+    parse(str, str.size(), whole);
+    parse(str, 1, bytes);
+    if (!same(whole, bytes) || !whole.complete || whole.req.GetHeader("X-Header-59") != std::string(59 * 3, 'v')) {
+        printf("mismatch: long request\n");
+        return -1;
+    }
+    // bad bytes at each position of a long value
+    for (size_t pos = 0; pos < 40; ++pos) {
+        std::string value(40, 'v');
+        value[pos] = '\x7f';
+        str = "GET / HTTP/1.1\r\nX-Value: " + value + "\r\n\r\n";
+        parse(str, str.size(), whole);
+        parse(str, 1, bytes);
+        if (!same(whole, bytes)) {
+            printf("mismatch: DEL at %d\n", (int)pos);
+            return -1;
+        }
+    }
+    printf("vectorized scan OK\n");
+
+    printf("http_parser_test OK\n");
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * http_reuseport_test: HttpServer with SO_REUSEPORT listenfd per worker.
+ *
+ *   1. start and stop twice on the same port,
+ *      no listenfd of any worker is left after stop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "HttpServer.h"
+#include "requests.h"
+#include "hsocket.h"
+
+using namespace hv;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define TEST_PORT       40890
+#define TEST_THREADS    4
+
+static void test_reuseport_restart() {
+    HttpService service;
+    service.GET("/ping", [](HttpRequest* req, HttpResponse* resp) {
+        (void)req;
+        return resp->String("pong");
+    });
+    HttpServer server(&service);
+    server.setHost("127.0.0.1");
+    server.setPort(TEST_PORT);
+    server.setThreadNum(TEST_THREADS);
+    server.setReusePort();
+    std::string url = "http://127.0.0.1:" + std::to_string(TEST_PORT) + "/ping";
+    for (int round = 0; round < 2; ++round) {
+        CHECK(server.start() == 0);
+        // NOTE: SO_REUSEPORT dispatches by hash of client port, all workers get some.
+        for (int i = 0; i < TEST_THREADS * 4; ++i) {
+            auto resp = requests::get(url.c_str());
+            CHECK(resp != NULL && resp->status_code == HTTP_STATUS_OK && resp->body == "pong");
+        }
+        CHECK(server.loop(TEST_THREADS - 1) != NULL);
+        CHECK(server.stop() == 0);
+        // NOTE: a listenfd left would accept some connections into its backlog.
+        for (int i = 0; i < TEST_THREADS * 4; ++i) {
+            int connfd = ConnectTimeout("127.0.0.1", TEST_PORT, 1000);
+            CHECK(connfd < 0);
+        }
+        printf("round %d: start, %d requests, stop OK\n", round, TEST_THREADS * 4);
+    }
+}
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    test_reuseport_restart();
+    printf("http_reuseport_test OK\n");
+    return 0;
+}
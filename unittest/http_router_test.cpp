@@ -1,13 +1,24 @@
-#include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "HttpRouter.h"
 
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
 int main() {
     hv::HttpRouter<int> router;
     std::map<std::string, std::string> params;
@@ -23,51 +34,51 @@ int main() {
     router.Insert("/dup", 7);
     router.Insert("/dup", 8);
 
-    assert(router.Match("/hello", value, params));
-    assert(value == 1);
-    assert(params.empty());
+    CHECK(router.Match("/hello", value, params));
+    CHECK(value == 1);
+    CHECK(params.empty());
     printf("Match /hello\n");
 
     params.clear();
-    assert(router.Match("/users/123", value, params));
-    assert(value == 2);
-    assert(params["id"] == "123");
+    CHECK(router.Match("/users/123", value, params));
+    CHECK(value == 2);
+    CHECK(params["id"] == "123");
     printf("Match /users/:id\n");
 
     params.clear();
-    assert(router.Match("/orders/42", value, params));
-    assert(value == 3);
-    assert(params["orderId"] == "42");
+    CHECK(router.Match("/orders/42", value, params));
+    CHECK(value == 3);
+    CHECK(params["orderId"] == "42");
     printf("Match /orders/{orderId}\n");
 
     params.clear();
-    assert(router.Match("/wildcard-tail", value, params));
-    assert(value == 4);
-    assert(params.empty());
+    CHECK(router.Match("/wildcard-tail", value, params));
+    CHECK(value == 4);
+    CHECK(params.empty());
     printf("Match /wildcard*\n");
 
     params.clear();
-    assert(router.Match("/www.index.html", value, params));
-    assert(value == 5);
-    assert(params.empty());
+    CHECK(router.Match("/www.index.html", value, params));
+    CHECK(value == 5);
+    CHECK(params.empty());
     printf("Match /www.*.html\n");
 
     params.clear();
-    assert(router.Match("/users/list", value, params));
-    assert(value == 6);
-    assert(params.empty());
+    CHECK(router.Match("/users/list", value, params));
+    CHECK(value == 6);
+    CHECK(params.empty());
     printf("Match /users/list\n");
 
     params.clear();
-    assert(router.Match("/dup", value, params));
-    assert(value == 8);
-    assert(params.empty());
+    CHECK(router.Match("/dup", value, params));
+    CHECK(value == 8);
+    CHECK(params.empty());
     printf("Match /dup\n");
 
     params["keep"] = "yes";
-    assert(router.Match("/missing", value, params));
-    assert(value == 404);
-    assert(params["keep"] == "yes");
+    CHECK(router.Match("/missing", value, params));
+    CHECK(value == 404);
+    CHECK(params["keep"] == "yes");
     printf("Match *\n");
 
     std::vector<std::string> paths = router.Paths();
@@ -97,37 +108,160 @@ int main() {
             has_any_wildcard_route = true;
         }
     }
-    assert(dup_count == 1);
-    assert(has_colon_param_route);
-    assert(has_brace_param_route);
-    assert(has_wildcard_route);
-    assert(has_suffix_wildcard_route);
-    assert(has_any_wildcard_route);
+    CHECK(dup_count == 1);
+    CHECK(has_colon_param_route);
+    CHECK(has_brace_param_route);
+    CHECK(has_wildcard_route);
+    CHECK(has_suffix_wildcard_route);
+    CHECK(has_any_wildcard_route);
 
     hv::HttpRouter<std::shared_ptr<int>> literal_router;
     std::shared_ptr<int> literal_value;
     std::map<std::string, std::string> literal_params;
 
     literal_router.Insert("/users/:id", std::make_shared<int>(1));
-    assert(!literal_router.Find("/users/list", literal_value));
+    CHECK(!literal_router.Find("/users/list", literal_value));
 
     literal_value = std::make_shared<int>(2);
     literal_router.Insert("/users/list", literal_value);
 
     std::shared_ptr<int> matched_value;
     literal_params.clear();
-    assert(literal_router.Match("/users/list", matched_value, literal_params));
-    assert(matched_value);
-    assert(*matched_value == 2);
-    assert(literal_params.empty());
+    CHECK(literal_router.Match("/users/list", matched_value, literal_params));
+    CHECK(matched_value);
+    CHECK(*matched_value == 2);
+    CHECK(literal_params.empty());
     printf("Match /users/list\n");
 
     literal_params.clear();
-    assert(literal_router.Match("/users/123", matched_value, literal_params));
-    assert(matched_value);
-    assert(*matched_value == 1);
-    assert(literal_params["id"] == "123");
+    CHECK(literal_router.Match("/users/123", matched_value, literal_params));
+    CHECK(matched_value);
+    CHECK(*matched_value == 1);
+    CHECK(literal_params["id"] == "123");
     printf("Match /users/:id\n");
 
+    // radix tree: shared prefixes are split, literal is prior to param at each segment
+    hv::HttpRouter<int> radix_router;
+    radix_router.Insert("/api/users", 1);
+    radix_router.Insert("/api/user", 2);
+    radix_router.Insert("/api/users/:id/posts/:pid", 3);
+    radix_router.Insert("/api/users/me/posts/:pid", 4);
+    radix_router.Insert("/api/:version/status", 5);
+    radix_router.Insert("/a", 6);
+    radix_router.Freeze();
+
+    params.clear();
+    CHECK(radix_router.Match("/api/users", value, params) && value == 1);
+    CHECK(radix_router.Match("/api/user", value, params) && value == 2);
+    CHECK(!radix_router.Match("/api/use", value, params));
+    CHECK(!radix_router.Match("/api/usersx", value, params));
+    CHECK(radix_router.Match("/a", value, params) && value == 6);
+    CHECK(params.empty());
+    printf("Match radix literal\n");
+
+    params.clear();
+    CHECK(radix_router.Match("/api/users/7/posts/9", value, params));
+    CHECK(value == 3 && params["id"] == "7" && params["pid"] == "9");
+    params.clear();
+    CHECK(radix_router.Match("/api/users/me/posts/9", value, params));
+    CHECK(value == 4 && params.size() == 1 && params["pid"] == "9");
+    params.clear();
+    CHECK(radix_router.Match("/api/v2/status", value, params));
+    CHECK(value == 5 && params["version"] == "v2");
+    // backtrack: /api/users is literal, but /api/users/status is /api/:version/status
+    params.clear();
+    CHECK(radix_router.Match("/api/users/status", value, params));
+    CHECK(value == 5 && params.size() == 1 && params["version"] == "users");
+    printf("Match radix param\n");
+
+    // empty segments are ignored by param routes
+    params.clear();
+    CHECK(radix_router.Match("//api//users/7/posts//9/", value, params));
+    CHECK(value == 3 && params["id"] == "7" && params["pid"] == "9");
+    params.clear();
+    CHECK(radix_router.Match("api/v3/status", value, params));
+    CHECK(value == 5 && params["version"] == "v3");
+    params.clear();
+    CHECK(!radix_router.Match("/api/users/7/posts", value, params));
+    CHECK(!radix_router.Match("/api/users/7/posts/9/x", value, params));
+    printf("Match radix empty segments\n");
+
+    // allocation-free Match refers to path
+    const char* path = "/api/users/7/posts/9?page=1";
+    const int* handler = NULL;
+    hv::RouteParams route_params;
+    CHECK(radix_router.Match(path, strchr(path, '?') - path, handler, route_params));
+    CHECK(*handler == 3);
+    CHECK(route_params.size == 2);
+    CHECK(*route_params.params[0].name == "id");
+    CHECK(route_params.params[0].value == path + 11 && route_params.params[0].len == 1);
+    CHECK(*route_params.params[1].name == "pid");
+    CHECK(std::string(route_params.params[1].value, route_params.params[1].len) == "9");
+    printf("Match RouteParams\n");
+
+    // Insert after Freeze is rejected, Clear to insert again
+    CHECK(!radix_router.Insert("/api/users/:id", 7));
+    CHECK(!radix_router.Insert("/api/users", 8));
+    params.clear();
+    CHECK(radix_router.Match("/api/users", value, params) && value == 1);
+    CHECK(!radix_router.Match("/api/users/8", value, params));
+    radix_router.Clear();
+    CHECK(radix_router.Empty() && !radix_router.Frozen());
+    CHECK(!radix_router.Match("/api/users", value, params));
+    CHECK(!radix_router.Insert("/api/users", 1));
+    radix_router.Clear();
+    CHECK(radix_router.Insert("/api/users/:id", 7));
+    params.clear();
+    CHECK(radix_router.Match("/api/users/8", value, params));
+    CHECK(value == 7 && params["id"] == "8");
+    printf("Insert after Freeze\n");
+
+    // routes with more than HTTP_ROUTE_MAX_PARAMS params are rejected
+    hv::HttpRouter<int> params_router;
+    std::string max_route, max_path, over_route;
+    for (int i = 0; i < HTTP_ROUTE_MAX_PARAMS; ++i) {
+        max_route += "/:p" + std::to_string(i);
+        max_path += "/" + std::to_string(i);
+    }
+    over_route = max_route + "/{over}";
+    CHECK(params_router.Insert(max_route, 1));
+    CHECK(!params_router.Insert(over_route, 2));
+    CHECK(params_router.Paths().size() == 1);
+    params.clear();
+    CHECK(params_router.Match(max_path, value, params));
+    CHECK(value == 1 && params.size() == HTTP_ROUTE_MAX_PARAMS);
+    CHECK(params["p0"] == "0" && params["p15"] == "15");
+    CHECK(!params_router.Match(max_path + "/16", value, params));
+    printf("Insert max params\n");
+
+    // concurrent first Match freezes once
+    hv::HttpRouter<int> shared_router;
+    shared_router.Insert("/hello", 1);
+    shared_router.Insert("/users/:id", 2);
+    std::atomic<int> nmatched(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&shared_router, &nmatched, i]() {
+            for (int j = 0; j < 1000; ++j) {
+                const int* matched = NULL;
+                hv::RouteParams matched_params;
+                std::string id = std::to_string(i * 1000 + j);
+                std::string users_path = "/users/" + id;
+                if (shared_router.Match("/hello", 6, matched, matched_params) && *matched == 1 &&
+                    shared_router.Match(users_path.data(), users_path.size(), matched, matched_params) && *matched == 2 &&
+                    matched_params.size == 1 && std::string(matched_params.params[0].value, matched_params.params[0].len) == id) {
+                    ++nmatched;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK(shared_router.Frozen());
+    CHECK(nmatched == 8 * 1000);
+    CHECK(!shared_router.Insert("/world", 3));
+    printf("Match concurrently\n");
+
     return 0;
 }
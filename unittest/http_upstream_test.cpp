@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+
+#include "HttpUpstream.h"
+#include "HttpServer.h"
+#include "requests.h"
+#include "hthread.h"
+
+using namespace hv;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+static std::string select_port(HttpUpstreamGroup& group, const char* key = NULL,
+                               const std::vector<HttpUpstreamServer*>* tried = NULL) {
+    HttpUpstreamServer* server = group.Select(key, tried);
+    if (server == NULL) return "";
+    group.Release(server, false);
+    return std::to_string(server->port);
+}
+
+#define BACKEND_PORT    40880
+#define PROXY_PORT      40881
+
+// body of backend responses is the port of proxy connection to backend
+static std::string proxy_get(const char* path, int* status_code) {
+    std::string url = "http://127.0.0.1:" + std::to_string(PROXY_PORT) + path;
+    auto resp = requests::get(url.c_str());
+    *status_code = resp ? resp->status_code : 0;
+    return resp ? resp->body : "";
+}
+
+// reverse proxy connections to backend are reused, stale ones retried on a fresh connection
+static int test_proxy_keepalive() {
+    std::atomic<int> drops(0);
+    HttpService backend_service;
+    backend_service.keepalive_timeout = 500;
+    backend_service.GET("/port", [](HttpRequest* req, HttpResponse* resp) {
+        return resp->String(std::to_string(req->client_addr.port));
+    });
+    // close connection without response, as if closed by keepalive_timeout while request sent
+    backend_service.GET("/drop", [&drops](HttpRequest* req, HttpResponse* resp) {
+        if (drops > 0) {
+            --drops;
+            return (int)HTTP_STATUS_CLOSE;
+        }
+        return resp->String(std::to_string(req->client_addr.port));
+    });
+    HttpServer backend(&backend_service);
+    backend.setHost("127.0.0.1");
+    backend.setPort(BACKEND_PORT);
+    backend.setThreadNum(1);
+    if (backend.start() != 0) {
+        printf("backend start failed!\n");
+        return -1;
+    }
+
+    HttpService proxy_service;
+    proxy_service.Upstream("backend")->AddServer("127.0.0.1:" + std::to_string(BACKEND_PORT));
+    proxy_service.Proxy("/", "http://backend/");
+    HttpServer proxy(&proxy_service);
+    proxy.setHost("127.0.0.1");
+    proxy.setPort(PROXY_PORT);
+    proxy.setThreadNum(1);
+    if (proxy.start() != 0) {
+        printf("proxy start failed!\n");
+        return -1;
+    }
+
+    // sequential requests on one backend connection
+    int status_code = 0;
+    std::string conn = proxy_get("/port", &status_code);
+    CHECK(status_code == 200 && !conn.empty());
+    for (int i = 0; i < 10; ++i) {
+        std::string port = proxy_get("/port", &status_code);
+        CHECK(status_code == 200 && port == conn);
+    }
+    CHECK(backend.connectionNum() == 1);
+    printf("proxy keepalive %s OK\n", conn.c_str());
+
+    // reused connection closed by backend after request sent: retried on a fresh one
+    drops = 1;
+    std::string retried = proxy_get("/drop", &status_code);
+    CHECK(status_code == 200 && !retried.empty() && retried != conn);
+    CHECK(drops == 0);
+    std::string port = proxy_get("/port", &status_code);
+    CHECK(status_code == 200 && port == retried);
+    printf("proxy stale retry %s OK\n", retried.c_str());
+
+    // idle connection closed by backend keepalive_timeout: not reused
+    hv_msleep(1000);
+    CHECK(backend.connectionNum() == 0);
+    port = proxy_get("/port", &status_code);
+    CHECK(status_code == 200 && !port.empty() && port != retried);
+    printf("proxy idle closed %s OK\n", port.c_str());
+
+    proxy.stop();
+    backend.stop();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    // smooth weighted round-robin: a a b a c a b ...
+    HttpUpstreamGroup rr("rr", LB_RoundRobin);
+    rr.AddServer("127.0.0.1:8001", 4);
+    rr.AddServer("127.0.0.1:8002", 2);
+    rr.AddServer("http://127.0.0.1:8003");
+    CHECK(rr.Size() == 3);
+    std::map<std::string, int> counts;
+    std::string seq;
+    for (int i = 0; i < 7; ++i) {
+        std::string port = select_port(rr);
+        ++counts[port];
+        seq += port.back();
+    }
+    CHECK(counts["8001"] == 4 && counts["8002"] == 2 && counts["8003"] == 1);
+    CHECK(seq == "1213121");
+    printf("round_robin %s OK\n", seq.c_str());
+
+    // least connections per weight
+    HttpUpstreamGroup lc("lc", LB_LeastConnections);
+    lc.AddServer("127.0.0.1:8001", 2);
+    lc.AddServer("127.0.0.1:8002");
+    HttpUpstreamServer* s1 = lc.Select(NULL);
+    HttpUpstreamServer* s2 = lc.Select(NULL);
+    HttpUpstreamServer* s3 = lc.Select(NULL);
+    // 8001 takes 2 of 3 in progress
+    CHECK((s1->port == 8001) + (s2->port == 8001) + (s3->port == 8001) == 2);
+    lc.Release(s1, false);
+    lc.Release(s2, false);
+    lc.Release(s3, false);
+    CHECK(s1->conns == 0 && s2->conns == 0 && s3->conns == 0);
+    printf("least_conn OK\n");
+
+    // consistent hash: the same key the same server, a removed server moves its keys only
+    HttpUpstreamGroup hash3("hash", LB_UrlHash);
+    HttpUpstreamGroup hash4("hash", LB_UrlHash);
+    for (int port = 8001; port <= 8004; ++port) {
+        std::string url = "127.0.0.1:" + std::to_string(port);
+        if (port != 8004) hash3.AddServer(url);
+        hash4.AddServer(url);
+    }
+    int moved = 0;
+    counts.clear();
+    for (int i = 0; i < 1000; ++i) {
+        std::string key = "/path/" + std::to_string(i);
+        std::string port3 = select_port(hash3, key.c_str());
+        std::string again = select_port(hash3, key.c_str());
+        CHECK(again == port3);
+        std::string port4 = select_port(hash4, key.c_str());
+        ++counts[port4];
+        if (port3 != port4) {
+            CHECK(port4 == "8004");
+            ++moved;
+        }
+    }
+    // about 1/4 moved to the added server, spread evenly
+    CHECK(moved > 150 && moved < 350);
+    for (auto& pair : counts) {
+        CHECK(pair.second > 150 && pair.second < 350);
+    }
+    printf("url_hash moved %d/1000 OK\n", moved);
+
+    // passive health check: max_fails=1 marked down, others tried
+    HttpUpstreamGroup down("down", LB_RoundRobin);
+    down.AddServer("127.0.0.1:8001", 1, 1, 10);
+    down.AddServer("127.0.0.1:8002", 1, 2, 10);
+    HttpUpstreamServer* server = down.Select(NULL);
+    CHECK(server->port == 8001);
+    down.Release(server, true);
+    for (int i = 0; i < 4; ++i) {
+        std::string port = select_port(down);
+        CHECK(port == "8002");
+    }
+    // 8002 fails 2 times, all down: still selected
+    server = down.Select(NULL);
+    down.Release(server, true);
+    server = down.Select(NULL);
+    down.Release(server, true);
+    std::string port = select_port(down);
+    CHECK(!port.empty());
+    // tried servers are not selected again
+    std::vector<HttpUpstreamServer*> tried;
+    server = down.Select(NULL, &tried);
+    tried.push_back(server);
+    down.Release(server, true);
+    server = down.Select(NULL, &tried);
+    CHECK(server && server != tried[0]);
+    tried.push_back(server);
+    down.Release(server, false);
+    server = down.Select(NULL, &tried);
+    CHECK(server == NULL);
+    printf("max_fails OK\n");
+
+    if (test_proxy_keepalive() != 0) return -1;
+
+    printf("http_upstream_test OK\n");
+    return 0;
+}
@@ -0,0 +1,298 @@
+/*
+ * io_uring_test: completion-based tcp io of the io_uring iowatcher.
+ *
+ *   1. accept/connect/recv/send completions: hio_write queues without writing,
+ *      hwrite_cb reports every completed send, echoed data arrives in order.
+ *   2. a failed send is reported by hclose_cb after completion, not by hwrite_cb.
+ *   3. multishot accept and recv from the provided buffer ring:
+ *      more connections than ring buffers read at once, the buffers are lent to hread_cb.
+ *   4. hio_read_stop cancels the multishot recv, data is delivered after hio_read again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hloop.h"
+#include "hsocket.h"
+#include "hbase.h"
+#include "hbuf.h"
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+static int listen_port(hio_t* listenio) {
+    sockaddr_u addr;
+    socklen_t addrlen = sizeof(addr);
+    CHECK(getsockname(hio_fd(listenio), &addr.sa, &addrlen) == 0);
+    return sockaddr_port(&addr);
+}
+
+static void on_timeout(htimer_t* timer) {
+    printf("timeout!\n");
+    exit(1);
+}
+
+static hloop_t* new_loop(uint32_t timeout_ms) {
+    hloop_t* loop = hloop_new(0);
+    CHECK(loop != NULL);
+    htimer_add(loop, on_timeout, timeout_ms, 1);
+    return loop;
+}
+
+//------------------------------------------------------------------------------
+// 1. echo
+//------------------------------------------------------------------------------
+#define ECHO_TOTAL  (4 * 1024 * 1024)
+#define ECHO_CHUNK  (256 * 1024)
+
+static char*    echo_data = NULL;
+static int      echo_in_write = 0;
+static size_t   echo_written = 0;
+static size_t   echo_recvd = 0;
+
+static void on_echo(hio_t* io, void* buf, int readbytes) {
+    CHECK(hio_write(io, buf, readbytes) == 0);
+}
+
+static void on_echo_accept(hio_t* io) {
+    hio_setcb_read(io, on_echo);
+    hio_read(io);
+}
+
+static void on_echo_write(hio_t* io, const void* buf, int writebytes) {
+    CHECK(!echo_in_write);
+    CHECK(memcmp(buf, echo_data + echo_written, writebytes) == 0);
+    echo_written += writebytes;
+}
+
+static void on_echo_read(hio_t* io, void* buf, int readbytes) {
+    CHECK(echo_recvd + readbytes <= ECHO_TOTAL);
+    CHECK(memcmp(buf, echo_data + echo_recvd, readbytes) == 0);
+    echo_recvd += readbytes;
+    if (echo_recvd == ECHO_TOTAL) {
+        CHECK(echo_written == ECHO_TOTAL);
+        CHECK(hio_write_is_complete(io));
+        hio_close(io);
+    }
+}
+
+static void on_echo_close(hio_t* io) {
+    CHECK(echo_recvd == ECHO_TOTAL);
+    hloop_stop(hevent_loop(io));
+}
+
+static void on_echo_connect(hio_t* io) {
+    int bufsize = 16 * 1024;
+    setsockopt(hio_fd(io), SOL_SOCKET, SO_SNDBUF, (const char*)&bufsize, sizeof(bufsize));
+    hio_setcb_write(io, on_echo_write);
+    hio_setcb_read(io, on_echo_read);
+    hio_read(io);
+    echo_in_write = 1;
+    for (int off = 0; off < ECHO_TOTAL; off += ECHO_CHUNK) {
+        // NOTE: nothing is written until IORING_OP_SEND completed
+        CHECK(hio_write(io, echo_data + off, ECHO_CHUNK) == 0);
+    }
+    echo_in_write = 0;
+    CHECK(hio_write_bufsize(io) == ECHO_TOTAL);
+}
+
+static void test_echo() {
+    echo_data = (char*)malloc(ECHO_TOTAL);
+    for (int i = 0; i < ECHO_TOTAL; ++i) echo_data[i] = (char)(i % 251);
+    hloop_t* loop = new_loop(10000);
+    hio_t* listenio = hloop_create_tcp_server(loop, "127.0.0.1", 0, on_echo_accept);
+    CHECK(listenio != NULL);
+    hio_t* io = hloop_create_tcp_client(loop, "127.0.0.1", listen_port(listenio), on_echo_connect, on_echo_close);
+    CHECK(io != NULL);
+    hloop_run(loop);
+    hloop_free(&loop);
+    free(echo_data);
+    printf("echo %d bytes OK\n", ECHO_TOTAL);
+}
+
+//------------------------------------------------------------------------------
+// 2. send failed on completion
+//------------------------------------------------------------------------------
+static int reset_written = 0;
+
+static void on_reset_accept(hio_t* io) {
+    // NOTE: RST instead of FIN
+    struct linger linger = { 1, 0 };
+    setsockopt(hio_fd(io), SOL_SOCKET, SO_LINGER, (const char*)&linger, sizeof(linger));
+    hio_close(io);
+}
+
+static void on_reset_write(hio_t* io, const void* buf, int writebytes) {
+    reset_written += writebytes;
+}
+
+static void on_reset_close(hio_t* io) {
+    CHECK(reset_written == 0);
+    CHECK(hio_error(io) != 0);
+    hloop_stop(hevent_loop(io));
+}
+
+static void on_reset_timer(htimer_t* timer) {
+    hio_t* io = (hio_t*)hevent_userdata(timer);
+    CHECK(hio_write(io, "hello", 5) == 0);
+}
+
+static void on_reset_connect(hio_t* io) {
+    hio_setcb_write(io, on_reset_write);
+    // write after the RST arrived
+    htimer_t* timer = htimer_add(hevent_loop(io), on_reset_timer, 100, 1);
+    hevent_set_userdata(timer, io);
+}
+
+static void test_send_failed() {
+    hloop_t* loop = new_loop(5000);
+    hio_t* listenio = hloop_create_tcp_server(loop, "127.0.0.1", 0, on_reset_accept);
+    CHECK(listenio != NULL);
+    hio_t* io = hloop_create_tcp_client(loop, "127.0.0.1", listen_port(listenio), on_reset_connect, on_reset_close);
+    CHECK(io != NULL);
+    hloop_run(loop);
+    hloop_free(&loop);
+    printf("send failed OK\n");
+}
+
+//------------------------------------------------------------------------------
+// 3. buffer ring
+//------------------------------------------------------------------------------
+// NOTE: more than IO_URING_PBUF_ENTRIES of io_uring.c
+#define PBUF_CONNS  600
+#define PBUF_MSGLEN 16
+
+static hio_t*   pbuf_servers[PBUF_CONNS];
+static int      pbuf_accepted = 0;
+static int      pbuf_sent = 0;
+static int      pbuf_recvd = 0;
+static char     pbuf_marks[PBUF_CONNS];
+
+static void pbuf_read_all() {
+    if (pbuf_accepted < PBUF_CONNS || pbuf_sent < PBUF_CONNS) return;
+    // NOTE: every connection has data, all recvs complete in one batch
+    for (int i = 0; i < PBUF_CONNS; ++i) {
+        hio_read(pbuf_servers[i]);
+    }
+}
+
+static void on_pbuf_read(hio_t* io, void* buf, int readbytes) {
+    // NOTE: lent from the buffer ring, not copied into readbuf
+    CHECK((char*)buf != hio_get_readbuf(io)->base);
+    CHECK(readbytes == PBUF_MSGLEN);
+    int idx = atoi((char*)buf);
+    CHECK(idx >= 0 && idx < PBUF_CONNS && !pbuf_marks[idx]);
+    pbuf_marks[idx] = 1;
+    if (++pbuf_recvd == PBUF_CONNS) {
+        for (int i = 0; i < PBUF_CONNS; ++i) {
+            hio_close(pbuf_servers[i]);
+        }
+        hloop_stop(hevent_loop(io));
+    }
+}
+
+static void on_pbuf_accept(hio_t* io) {
+    CHECK(pbuf_accepted < PBUF_CONNS);
+    pbuf_servers[pbuf_accepted++] = io;
+    hio_setcb_read(io, on_pbuf_read);
+    pbuf_read_all();
+}
+
+static void on_pbuf_write(hio_t* io, const void* buf, int writebytes) {
+    CHECK(writebytes == PBUF_MSGLEN);
+    ++pbuf_sent;
+    pbuf_read_all();
+}
+
+static void on_pbuf_connect(hio_t* io) {
+    char msg[PBUF_MSGLEN] = {0};
+    snprintf(msg, sizeof(msg), "%d", (int)(intptr_t)hevent_userdata(io));
+    hio_setcb_write(io, on_pbuf_write);
+    CHECK(hio_write(io, msg, PBUF_MSGLEN) == 0);
+}
+
+static void test_buffer_ring() {
+    hloop_t* loop = new_loop(10000);
+    hio_t* listenio = hloop_create_tcp_server(loop, "127.0.0.1", 0, on_pbuf_accept);
+    CHECK(listenio != NULL);
+    int port = listen_port(listenio);
+    for (int i = 0; i < PBUF_CONNS; ++i) {
+        hio_t* io = hloop_create_tcp_client(loop, "127.0.0.1", port, on_pbuf_connect, NULL);
+        CHECK(io != NULL);
+        hevent_set_userdata(io, (void*)(intptr_t)i);
+    }
+    hloop_run(loop);
+    hloop_free(&loop);
+    CHECK(pbuf_recvd == PBUF_CONNS);
+    printf("buffer ring %d conns OK\n", PBUF_CONNS);
+}
+
+//------------------------------------------------------------------------------
+// 4. hio_read_stop
+//------------------------------------------------------------------------------
+static hio_t*   pause_server = NULL;
+static hio_t*   pause_client = NULL;
+static char     pause_recvd[8] = {0};
+
+static void on_pause_read(hio_t* io, void* buf, int readbytes) {
+    CHECK(strlen(pause_recvd) + readbytes < sizeof(pause_recvd));
+    strncat(pause_recvd, (char*)buf, readbytes);
+    if (strcmp(pause_recvd, "a") == 0) {
+        hio_read_stop(io);
+    }
+    else if (strcmp(pause_recvd, "ab") == 0) {
+        hio_close(pause_client);
+        hloop_stop(hevent_loop(io));
+    }
+}
+
+static void on_pause_resume(htimer_t* timer) {
+    // not delivered while stopped
+    CHECK(strcmp(pause_recvd, "a") == 0);
+    hio_read(pause_server);
+}
+
+static void on_pause_send(htimer_t* timer) {
+    CHECK(strcmp(pause_recvd, "a") == 0);
+    CHECK(hio_write(pause_client, "b", 1) == 0);
+    htimer_add(hevent_loop(timer), on_pause_resume, 200, 1);
+}
+
+static void on_pause_accept(hio_t* io) {
+    pause_server = io;
+    hio_setcb_read(io, on_pause_read);
+    hio_read(io);
+}
+
+static void on_pause_connect(hio_t* io) {
+    CHECK(hio_write(io, "a", 1) == 0);
+    htimer_add(hevent_loop(io), on_pause_send, 100, 1);
+}
+
+static void test_read_stop() {
+    hloop_t* loop = new_loop(5000);
+    hio_t* listenio = hloop_create_tcp_server(loop, "127.0.0.1", 0, on_pause_accept);
+    CHECK(listenio != NULL);
+    pause_client = hloop_create_tcp_client(loop, "127.0.0.1", listen_port(listenio), on_pause_connect, NULL);
+    CHECK(pause_client != NULL);
+    hloop_run(loop);
+    hloop_free(&loop);
+    CHECK(strcmp(pause_recvd, "ab") == 0);
+    printf("read stop OK\n");
+}
+
+int main() {
+    CHECK(strcmp(hio_engine(), "io_uring") == 0);
+    test_echo();
+    test_send_failed();
+    test_buffer_ring();
+    test_read_stop();
+    printf("io_uring_test OK\n");
+    return 0;
+}
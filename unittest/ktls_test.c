@@ -0,0 +1,134 @@
+/*
+ * ktls_test: ssl server with kernel TLS offload.
+ *
+ *   hio_write, hio_writev and hio_sendfile of the server are sent by send/sendmsg/sendfile
+ *   on the socket, nothing is written by SSL_write, the client reads the same plain data.
+ *   If the kernel or openssl has no ktls, the same data goes through SSL_write.
+ *
+ * usage: run in the root directory of libhv, cert/server.crt and cert/server.key are used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hloop.h"
+#include "hsocket.h"
+#include "hssl.h"
+#include "hbase.h"
+
+#include <openssl/ssl.h>
+#include <openssl/bio.h>
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define WRITE_LEN       (1024 * 1024)
+#define WRITEV_LEN      (64 * 1024)
+#define SENDFILE_LEN    (4 * 1024 * 1024)
+#define TOTAL_LEN       (WRITE_LEN + 2 * WRITEV_LEN + SENDFILE_LEN)
+
+static const char*  tmpfile_path = "ktls_test.tmp";
+static char*        data = NULL;
+static size_t       recvd = 0;
+static int          ktls = 0;
+static unsigned long ssl_written = 0;
+
+static unsigned long ssl_number_written(hio_t* io) {
+    return BIO_number_written(SSL_get_wbio((SSL*)hio_get_ssl(io)));
+}
+
+static void on_timeout(htimer_t* timer) {
+    (void)timer;
+    printf("timeout!\n");
+    exit(1);
+}
+
+static void on_server_write(hio_t* io, const void* buf, int writebytes) {
+    (void)buf; (void)writebytes;
+    if (ktls) {
+        // NOTE: no record made by openssl after handshake
+        CHECK(ssl_number_written(io) == ssl_written);
+    }
+}
+
+static void on_accept(hio_t* io) {
+    ktls = hssl_ktls_send(hio_get_ssl(io));
+    printf("ktls send: %s\n", ktls ? "on" : "off, through SSL_write");
+    ssl_written = ssl_number_written(io);
+    hio_setcb_write(io, on_server_write);
+
+    CHECK(hio_write(io, data, WRITE_LEN) >= 0);
+    struct iovec iov[2];
+    iov[0].iov_base = data + WRITE_LEN;
+    iov[0].iov_len = WRITEV_LEN;
+    iov[1].iov_base = data + WRITE_LEN + WRITEV_LEN;
+    iov[1].iov_len = WRITEV_LEN;
+    CHECK(hio_writev(io, iov, 2) >= 0);
+    FILE* fp = fopen(tmpfile_path, "rb");
+    CHECK(fp != NULL);
+    CHECK(hio_sendfile(io, fileno(fp), WRITE_LEN + 2 * WRITEV_LEN, SENDFILE_LEN) == 0);
+    // NOTE: fd is duplicated by hio_sendfile
+    fclose(fp);
+    if (!ktls) {
+        CHECK(ssl_number_written(io) > ssl_written);
+    }
+}
+
+static void on_client_read(hio_t* io, void* buf, int readbytes) {
+    CHECK(recvd + readbytes <= TOTAL_LEN);
+    CHECK(memcmp(buf, data + recvd, readbytes) == 0);
+    recvd += readbytes;
+    if (recvd == TOTAL_LEN) {
+        hio_close(io);
+        hloop_stop(hevent_loop(io));
+    }
+}
+
+static void on_connect(hio_t* io) {
+    hio_setcb_read(io, on_client_read);
+    hio_read(io);
+}
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    data = (char*)malloc(TOTAL_LEN);
+    CHECK(data != NULL);
+    for (int i = 0; i < TOTAL_LEN; ++i) data[i] = (char)(i % 251);
+    // [WRITE_LEN + 2 * WRITEV_LEN, TOTAL_LEN) is sent from the file
+    FILE* fp = fopen(tmpfile_path, "wb");
+    CHECK(fp != NULL);
+    CHECK(fwrite(data, 1, TOTAL_LEN, fp) == TOTAL_LEN);
+    fclose(fp);
+
+    hloop_t* loop = hloop_new(0);
+    htimer_add(loop, on_timeout, 10000, 1);
+    hio_t* listenio = hloop_create_ssl_server(loop, "127.0.0.1", 0, on_accept);
+    CHECK(listenio != NULL);
+    hssl_ctx_opt_t opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.crt_file = "cert/server.crt";
+    opt.key_file = "cert/server.key";
+    opt.endpoint = HSSL_SERVER;
+    opt.ktls = 1;
+    CHECK(hio_new_ssl_ctx(listenio, &opt) == 0);
+
+    sockaddr_u addr;
+    socklen_t addrlen = sizeof(addr);
+    CHECK(getsockname(hio_fd(listenio), &addr.sa, &addrlen) == 0);
+    hio_t* io = hloop_create_ssl_client(loop, "127.0.0.1", sockaddr_port(&addr), on_connect, NULL);
+    CHECK(io != NULL);
+    hloop_run(loop);
+    hloop_free(&loop);
+
+    remove(tmpfile_path);
+    free(data);
+    CHECK(recvd == TOTAL_LEN);
+    printf("ktls_test OK\n");
+    return 0;
+}
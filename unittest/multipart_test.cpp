@@ -0,0 +1,75 @@
+#include <stdio.h>
+
+#include <string>
+
+#include "http_content.h"
+
+using namespace hv;
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    MultiPart mp;
+    mp["user"] = FormData("libhv");
+    mp["empty"] = FormData("");
+    std::string content;
+    for (int i = 0; i < 1000; ++i) {
+        content += "line " + std::to_string(i) + "\r\n--\r\n";
+    }
+    mp["file"].filename = "test.txt";
+    mp["file"].content = content;
+    std::string body = dump_multipart(mp);
+
+    MultiPart parsed;
+    if (parse_multipart(body, parsed, DEFAULT_MULTIPART_BOUNDARY) != 0 ||
+        parsed.size() != 3 ||
+        parsed["user"].content != "libhv" ||
+        parsed["file"].filename != "test.txt" ||
+        parsed["file"].content != content) {
+        printf("parse_multipart failed!\n");
+        return -1;
+    }
+    printf("parse_multipart OK\n");
+
+    // fed in pieces of any size, the same parts
+    for (size_t step = 1; step < 100; step += 7) {
+        MultiPart streamed;
+        FormData* formdata = NULL;
+        MultipartParser parser(DEFAULT_MULTIPART_BOUNDARY);
+        parser.onPartBegin = [&streamed, &formdata](const std::string& name, const std::string& filename) {
+            formdata = &streamed[name];
+            formdata->filename = filename;
+        };
+        parser.onPartData = [&formdata](const char* data, size_t size) {
+            formdata->content.append(data, size);
+        };
+        parser.onPartEnd = [&formdata]() {
+            formdata = NULL;
+        };
+        for (size_t offset = 0; offset < body.size(); offset += step) {
+            size_t len = body.size() - offset < step ? body.size() - offset : step;
+            if (parser.FeedRecvData(body.data() + offset, len) != len) {
+                printf("MultipartParser error at %d!\n", (int)offset);
+                return -1;
+            }
+        }
+        if (!parser.IsComplete() || streamed.size() != 3 ||
+            streamed["user"].content != "libhv" ||
+            streamed["empty"].content != "" ||
+            streamed["file"].filename != "test.txt" ||
+            streamed["file"].content != content) {
+            printf("MultipartParser step=%d failed!\n", (int)step);
+            return -1;
+        }
+    }
+    printf("MultipartParser OK\n");
+
+    // bad boundary
+    MultipartParser parser("bad-boundary");
+    if (parser.FeedRecvData(body.data(), body.size()) == body.size()) {
+        printf("MultipartParser should fail!\n");
+        return -1;
+    }
+
+    printf("multipart_test OK\n");
+    return 0;
+}
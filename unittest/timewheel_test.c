@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "timewheel.h"
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d CHECK(%s) failed!\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define NNODES  10000
+
+struct timer {
+    struct timewheel_node   node;
+    uint64_t                expire;
+    int                     fired;
+    int                     removed;
+};
+
+static struct timer timers[NNODES];
+
+static int advance(struct timewheel* tw, uint64_t now_tick) {
+    uint64_t prev_tick = tw->cur_tick;
+    struct list_head expired;
+    list_init(&expired);
+    int n = timewheel_advance(tw, now_tick, &expired);
+    int cnt = 0;
+    while (!list_empty(&expired)) {
+        struct timer* t = container_of(expired.next, struct timer, node.list);
+        list_del_init(&t->node.list);
+        // never early, never late
+        CHECK(!t->removed && !t->fired);
+        CHECK(t->expire > prev_tick && t->expire <= now_tick);
+        t->fired = 1;
+        ++cnt;
+    }
+    CHECK(cnt == n);
+    return n;
+}
+
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+    struct timewheel tw;
+    uint64_t start = 123456789;
+    timewheel_init(&tw, start);
+    srand(2024);
+
+    // expire in [1, 64^4 + 1000), some far beyond max ticks
+    for (int i = 0; i < NNODES; ++i) {
+        struct timer* t = &timers[i];
+        timewheel_node_init(&t->node);
+        uint64_t delta = 1 + (uint64_t)rand() % (i % 10 == 0 ? 20000000 : (i % 2 ? 300 : 100000));
+        t->expire = start + delta;
+        t->node.expire = t->expire;
+        timewheel_add(&tw, &t->node);
+    }
+    CHECK(tw.nelts == NNODES);
+
+    // remove every 7th
+    int nremoved = 0;
+    for (int i = 0; i < NNODES; i += 7) {
+        timewheel_remove(&tw, &timers[i].node);
+        timers[i].removed = 1;
+        ++nremoved;
+    }
+    CHECK(tw.nelts == (uint32_t)(NNODES - nremoved));
+
+    // advance tick by tick for a while, then in random steps,
+    // sometimes over the next expiry like a loop blocked for long.
+    int nfired = 0;
+    uint64_t now = start;
+    while (tw.nelts) {
+        uint64_t next = tw.cur_tick + timewheel_next_ticks(&tw);
+        CHECK(next > tw.cur_tick);
+        now += (now - start < 200000) ? 1 : 1 + rand() % 500;
+        if (now > next && rand() % 2) now = next;
+        nfired += advance(&tw, now);
+    }
+    CHECK(nfired == NNODES - nremoved);
+    for (int i = 0; i < NNODES; ++i) {
+        CHECK(timers[i].fired != timers[i].removed);
+    }
+    printf("timewheel_test OK: fired=%d removed=%d\n", nfired, nremoved);
+    return 0;
+}